@@ -18,13 +18,49 @@ G_BEGIN_DECLS
 typedef struct _Package Package;
 typedef struct _PackageDep PackageDep;
 typedef struct _PackageConflict PackageConflict;
+typedef struct _DbStatementCache DbStatementCache;
+typedef struct _DbWriter DbWriter;
+typedef struct _VenvSnapshot VenvSnapshot;
+typedef struct _FuzzyIndex FuzzyIndex;
+
+// Package filter flags
+typedef enum {
+    PACKAGE_FILTER_NONE = 0,
+    PACKAGE_FILTER_DIRECT = 1 << 0,
+    PACKAGE_FILTER_DEPS = 1 << 1,
+    PACKAGE_FILTER_CONFLICTS = 1 << 2
+} PackageFilterFlags;
+
+// Package list sort orders
+typedef enum {
+    PACKAGE_SORT_NAME,
+    PACKAGE_SORT_VERSION,
+    PACKAGE_SORT_SIZE,
+    PACKAGE_SORT_TOTAL_SIZE,   // Own size plus everything it depends on
+    PACKAGE_SORT_FAN_IN,       // Installed packages depending on it
+    PACKAGE_SORT_FAN_OUT,      // Installed packages it depends on
+    PACKAGE_SORT_N_KEYS
+} PackageSortKey;
 
 // Main analyzer structure
 typedef struct {
     char venv_path[MAX_PATH_LEN];
     Package* packages;
     GVC_t* gvc;  // Changed from GvContext to GVC_t
-    sqlite3* db;
+    sqlite3* db;                 // Read-only; writes go through db_writer
+    DbStatementCache* db_stmts;  // Prepared statements cached for db
+    DbWriter* db_writer;         // Thread owning the read-write connection
+    GError* db_error;            // Why opening the database failed, if it did
+    VenvSnapshot* snapshot;      // Mapped snapshot the packages came from, or NULL
+
+    // Package list view state (see venv_analyzer_refresh_view)
+    PackageFilterFlags filter_flags;
+    PackageSortKey sort_key;
+    gboolean sort_ascending;
+    char* search_term;
+    GHashTable* search_matches;  // Normalized name matching search_term -> rank
+    GHashTable* view_keys;       // Package -> sort keys and filter facts
+    FuzzyIndex* name_index;      // Normalized names for fuzzy search
     
     // GUI components
     GtkWidget* status_bar;
@@ -41,17 +77,12 @@ typedef enum {
     VENV_ANALYZER_ERROR_INVALID_PATH,
     VENV_ANALYZER_ERROR_SCAN_FAILED,
     VENV_ANALYZER_ERROR_DB_FAILED,
-    VENV_ANALYZER_ERROR_EXPORT_FAILED
+    VENV_ANALYZER_ERROR_EXPORT_FAILED,
+    VENV_ANALYZER_ERROR_INVALID_SNAPSHOT,
+    VENV_ANALYZER_ERROR_LAYOUT_FAILED,
+    VENV_ANALYZER_ERROR_NO_RECORD
 } VenvAnalyzerError;
 
-// Package filter flags
-typedef enum {
-    PACKAGE_FILTER_NONE = 0,
-    PACKAGE_FILTER_DIRECT = 1 << 0,
-    PACKAGE_FILTER_DEPS = 1 << 1,
-    PACKAGE_FILTER_CONFLICTS = 1 << 2
-} PackageFilterFlags;
-
 // Core functions
 VenvAnalyzer*   venv_analyzer_new         (const char* venv_path);
 void            venv_analyzer_free        (VenvAnalyzer* analyzer);
@@ -72,9 +103,23 @@ gboolean        venv_analyzer_export_dot  (VenvAnalyzer* analyzer,
 void            venv_analyzer_set_filter  (VenvAnalyzer* analyzer,
                                          PackageFilterFlags flags);
 void            venv_analyzer_set_sort    (VenvAnalyzer* analyzer,
+                                         PackageSortKey key,
                                          gboolean ascending);
 void            venv_analyzer_set_search  (VenvAnalyzer* analyzer,
                                          const char* term);
+void            venv_analyzer_refresh_view(VenvAnalyzer* analyzer);
+gboolean        venv_analyzer_package_visible(VenvAnalyzer* analyzer,
+                                             const Package* pkg);
+int             venv_analyzer_package_compare(VenvAnalyzer* analyzer,
+                                             const Package* a,
+                                             const Package* b);
+guint64         venv_analyzer_package_sort_key(VenvAnalyzer* analyzer,
+                                              const Package* pkg,
+                                              PackageSortKey key);
+// Position among the search results, best first from 1; 0 for every
+// package when there is no search
+guint64         venv_analyzer_package_search_rank(VenvAnalyzer* analyzer,
+                                                 const Package* pkg);
 
 // Version comparison utilities
 int             venv_analyzer_version_compare(const char* ver1,
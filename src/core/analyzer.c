@@ -1,102 +1,78 @@
 #include "analyzer.h"
 #include "package.h"
+#include "snapshot.h"
+#include "export.h"
+#include "fuzzy_match.h"
+#include "../db/database.h"
+#include "../db/db_writer.h"
 #include <glib/gstdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <gtk/gtk.h>
 
-#define COMMAND_BUFFER_SIZE 1024
-#define OUTPUT_BUFFER_SIZE 4096
-
 static char error_buffer[256] = {0};
 
-// Helper function to execute pip commands
-// In analyzer.c, update the execute_pip_command function:
+G_DEFINE_QUARK(venv-analyzer-error-quark, venv_analyzer_error)
 
-static char* execute_pip_command(const char* venv_path, const char* command) {
+// Runs python -m pip <command> [package] with the venv's interpreter and
+// returns its standard output. Keeps no state and spawns without a shell,
+// so it is safe from scan and revalidation workers.
+static char* execute_pip_command(const char* venv_path, const char* command,
+                                 const char* package, GError** error) {
     if (!venv_path || !venv_path[0]) {
-        g_snprintf(error_buffer, sizeof(error_buffer), "No virtual environment path set");
+        g_set_error(error, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_INVALID_PATH,
+                    "No virtual environment path set");
         return NULL;
     }
 
-    g_print("Debug: Checking venv path: %s\n", venv_path);
     if (!g_file_test(venv_path, G_FILE_TEST_IS_DIR)) {
-        g_print("Debug: Venv path is not a directory\n");
+        g_set_error(error, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_INVALID_PATH,
+                    "%s is not a directory", venv_path);
         return NULL;
     }
 
-    // Create the full command using python -m pip
-    char full_command[COMMAND_BUFFER_SIZE];
-    char python_path[COMMAND_BUFFER_SIZE];
-    
     // Find Python executable
-    const char* python_paths[] = {
-        "/bin/python",
-        "/bin/python3",
+    static const char* const python_paths[] = {
+        "bin/python",
+        "bin/python3",
         "Scripts/python.exe",  // Windows support
         NULL
     };
-    
-    const char* python_exe = NULL;
-    for (const char** path = python_paths; *path; path++) {
-        g_snprintf(python_path, sizeof(python_path), "%s/%s", venv_path, *path);
-        if (g_file_test(python_path, G_FILE_TEST_EXISTS | G_FILE_TEST_IS_EXECUTABLE)) {
-            python_exe = *path;
-            break;
-        }
-    }
-    
-    if (!python_exe) {
-        g_snprintf(error_buffer, sizeof(error_buffer), 
-                  "Python executable not found in virtual environment");
-        return NULL;
-    }
 
-    // Build the full command
-    if (g_strcmp0(command, "freeze") == 0) {
-        g_snprintf(full_command, sizeof(full_command),
-                  "%s/%s -m pip freeze", venv_path, python_exe);
-    } else {
-        g_snprintf(full_command, sizeof(full_command),
-                  "%s/%s -m pip show %s", venv_path, python_exe, command);
+    char* python = NULL;
+    for (const char* const* path = python_paths; *path && !python; path++) {
+        char* candidate = g_build_filename(venv_path, *path, NULL);
+        if (g_file_test(candidate, G_FILE_TEST_IS_EXECUTABLE)) {
+            python = candidate;
+        } else {
+            g_free(candidate);
+        }
     }
 
-    g_print("Debug: Executing command: %s\n", full_command);
-
-    // Execute command
-    FILE* pipe = popen(full_command, "r");
-    if (!pipe) {
-        g_snprintf(error_buffer, sizeof(error_buffer),
-                  "Failed to execute command: %s", full_command);
+    if (!python) {
+        g_set_error(error, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_INVALID_PATH,
+                    "Python executable not found in %s", venv_path);
         return NULL;
     }
 
-    char* output = g_malloc(OUTPUT_BUFFER_SIZE);
-    size_t total = 0;
-    size_t bytes_read;
-    char buffer[1024];
-
-    while ((bytes_read = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
-        if (total + bytes_read >= OUTPUT_BUFFER_SIZE) {
-            g_snprintf(error_buffer, sizeof(error_buffer), "Output buffer overflow");
-            g_free(output);
-            pclose(pipe);
-            return NULL;
-        }
-        memcpy(output + total, buffer, bytes_read);
-        total += bytes_read;
-    }
-
-    output[total] = '\0';
-    int status = pclose(pipe);
-
-    if (status != 0) {
-        g_snprintf(error_buffer, sizeof(error_buffer),
-                  "Command failed with status %d", status);
-        g_free(output);
-        return NULL;
+    const char* argv[] = { python, "-m", "pip", command, package, NULL };
+    char* output = NULL;
+    char* errors = NULL;
+    int status = 0;
+    GError* local_error = NULL;
+    if (!g_spawn_sync(NULL, (char**)argv, NULL, G_SPAWN_DEFAULT, NULL, NULL,
+                      &output, &errors, &status, &local_error) ||
+        !g_spawn_check_wait_status(status, &local_error)) {
+        g_set_error(error, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_SCAN_FAILED,
+                    "pip %s%s%s failed: %s", command, package ? " " : "",
+                    package ? package : "",
+                    errors && errors[0] ? g_strstrip(errors) : local_error->message);
+        g_clear_error(&local_error);
+        g_clear_pointer(&output, g_free);
     }
 
+    g_free(errors);
+    g_free(python);
     return output;
 }
 
@@ -119,6 +95,7 @@ VenvAnalyzer* venv_analyzer_new(const char* path) {
     analyzer->packages = NULL;
     analyzer->gvc = (GVC_t*)gvContext();  // Cast to proper type
     analyzer->db = NULL;
+    analyzer->sort_ascending = TRUE;
 
     // Initialize GUI components
     analyzer->package_store = g_list_store_new(PACKAGE_TYPE);
@@ -139,6 +116,12 @@ VenvAnalyzer* venv_analyzer_new(const char* path) {
     return analyzer;
 }
 
+VenvAnalyzer* venv_analyzer_new_headless(void) {
+    VenvAnalyzer* analyzer = g_new0(VenvAnalyzer, 1);
+    analyzer->sort_ascending = TRUE;
+    return analyzer;
+}
+
 void venv_analyzer_free(VenvAnalyzer* analyzer) {
     if (!analyzer) return;
     
@@ -169,10 +152,23 @@ void venv_analyzer_free(VenvAnalyzer* analyzer) {
         gvFreeContext((GVC_t*)analyzer->gvc);  // Cast to proper type
     }
 
-    // Close database connection
-    if (analyzer->db) {
-        sqlite3_close(analyzer->db);
+    // Close database connections, committing any queued writes
+    db_close(analyzer);
+    db_writer_free(analyzer->db_writer);
+    g_clear_error(&analyzer->db_error);
+
+    if (analyzer->snapshot) {
+        venv_snapshot_unref(analyzer->snapshot);
+    }
+
+    g_free(analyzer->search_term);
+    if (analyzer->search_matches) {
+        g_hash_table_unref(analyzer->search_matches);
     }
+    if (analyzer->view_keys) {
+        g_hash_table_unref(analyzer->view_keys);
+    }
+    fuzzy_index_free(analyzer->name_index);
     
     g_free(analyzer);
 }
@@ -195,15 +191,23 @@ static void parse_pip_freeze(VenvAnalyzer* analyzer, const char* output) {
     g_strfreev(lines);
 }
 
-static void analyze_package_dependencies(VenvAnalyzer* analyzer, Package* package) {
-    // Change how we build the command
-    char* output = execute_pip_command(analyzer->venv_path, package->name);
-    if (!output) return;
+// Fills in summary, requirements and size from pip show
+static gboolean analyze_package_dependencies(const char* venv_path, Package* package,
+                                             GError** error) {
+    char* output = execute_pip_command(venv_path, "show", package->name, error);
+    if (!output) return FALSE;
     
     char** lines = g_strsplit(output, "\n", -1);
     bool in_requires = false;
        
     for (char** line = lines; *line; line++) {
+        if (g_str_has_prefix(*line, "Summary: ")) {
+            char* summary = g_strstrip(g_strdup(*line + 9));
+            g_strlcpy(package->description, summary, sizeof(package->description));
+            g_free(summary);
+            continue;
+        }
+
         if (g_str_has_prefix(*line, "Requires: ")) {
             in_requires = true;
             continue;
@@ -219,57 +223,586 @@ static void analyze_package_dependencies(VenvAnalyzer* analyzer, Package* packag
     }
     
     g_strfreev(lines);
+    gboolean ok = package_update_size_from_pip(package, output, error);
     g_free(output);
+    return ok;
 }
 
-gboolean venv_analyzer_update_package_list(VenvAnalyzer* analyzer) {
-    if (!analyzer || !analyzer->package_store) {
-        g_print("Debug: Cannot update package list - invalid analyzer or store\n");
-        return TRUE; // Remove source
+char* venv_analyzer_find_site_packages(const char* venv_path) {
+    // Windows layout first, then lib/pythonX.Y/site-packages
+    char* path = g_build_filename(venv_path, "Lib", "site-packages", NULL);
+    if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+        return path;
+    }
+    g_free(path);
+    path = NULL;
+
+    char* lib_dir = g_build_filename(venv_path, "lib", NULL);
+    GDir* dir = g_dir_open(lib_dir, 0, NULL);
+    if (dir) {
+        const char* entry;
+        while (!path && (entry = g_dir_read_name(dir)) != NULL) {
+            if (!g_str_has_prefix(entry, "python")) continue;
+
+            char* candidate = g_build_filename(lib_dir, entry, "site-packages", NULL);
+            if (g_file_test(candidate, G_FILE_TEST_IS_DIR)) {
+                path = candidate;
+            } else {
+                g_free(candidate);
+            }
+        }
+        g_dir_close(dir);
+    }
+    g_free(lib_dir);
+    return path;
+}
+
+typedef struct {
+    char* dir_name;
+    char version[MAX_VERSION_LEN];
+    guint64 fingerprint;
+} DistInfo;
+
+static void dist_info_free(gpointer data) {
+    DistInfo* info = data;
+    g_free(info->dir_name);
+    g_free(info);
+}
+
+static guint64 fnv1a_update(guint64 hash, const void* data, gsize len) {
+    const guint8* bytes = data;
+    for (gsize i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Hashes the metadata directory name with RECORD's inode, size and mtime;
+// pip rewrites RECORD on every install, upgrade and reinstall
+static guint64 compute_fingerprint(const char* site_packages, const char* dir_name) {
+    guint64 hash = fnv1a_update(0xcbf29ce484222325ULL, dir_name, strlen(dir_name));
+
+    const char* files[] = { "RECORD", "installed-files.txt", "PKG-INFO", NULL };
+    for (const char** file = files; *file; file++) {
+        char* path = g_build_filename(site_packages, dir_name, *file, NULL);
+        GStatBuf st;
+        int rc = g_stat(path, &st);
+        g_free(path);
+        if (rc == 0) {
+            guint64 fields[3] = { st.st_ino, st.st_size, st.st_mtime };
+            return fnv1a_update(hash, fields, sizeof(fields));
+        }
+    }
+    return hash;
+}
+
+// Maps normalized package names to the dist-info/egg-info entries in site-packages
+static GHashTable* collect_dist_info(const char* site_packages) {
+    GHashTable* table = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                              g_free, dist_info_free);
+    GDir* dir = g_dir_open(site_packages, 0, NULL);
+    if (!dir) return table;
+
+    const char* entry;
+    while ((entry = g_dir_read_name(dir)) != NULL) {
+        const char* suffix = NULL;
+        if (g_str_has_suffix(entry, ".dist-info")) {
+            suffix = ".dist-info";
+        } else if (g_str_has_suffix(entry, ".egg-info")) {
+            suffix = ".egg-info";
+        } else {
+            continue;
+        }
+
+        // <name>-<version>.dist-info; versions never contain "-"
+        char* stem = g_strndup(entry, strlen(entry) - strlen(suffix));
+        char* dash = strrchr(stem, '-');
+        if (!dash || dash == stem) {
+            g_free(stem);
+            continue;
+        }
+        *dash = '\0';
+
+        DistInfo* info = g_new0(DistInfo, 1);
+        info->dir_name = g_strdup(entry);
+        g_strlcpy(info->version, dash + 1, sizeof(info->version));
+        info->fingerprint = compute_fingerprint(site_packages, entry);
+
+        g_hash_table_replace(table, package_normalize_name(stem), info);
+        g_free(stem);
+    }
+    g_dir_close(dir);
+    return table;
+}
+
+static void set_dependency_specifier(Package* package, const char* name,
+                                     const char* specifier) {
+    char* key = package_normalize_name(name);
+    for (PackageDep* dep = package->dependencies; dep; dep = dep->next) {
+        char* dep_key = package_normalize_name(dep->name);
+        gboolean same = strcmp(dep_key, key) == 0;
+        g_free(dep_key);
+        if (same) {
+            g_strlcpy(dep->version, specifier, sizeof(dep->version));
+            break;
+        }
     }
+    g_free(key);
+}
+
+// pip show lists requirements without their specifiers, so these come from
+// the Requires-Dist headers ("idna<4,>=2.5", "urllib3 (<3,>=1.21.1)").
+// Requirements behind an environment marker are left at "*", since which
+// of them apply here is not known.
+static void read_requirement_specifiers(const char* site_packages, const DistInfo* info,
+                                        Package* package) {
+    const char* files[] = { "METADATA", "PKG-INFO", NULL };
+    char* contents = NULL;
+    for (const char** file = files; *file && !contents; file++) {
+        char* path = g_build_filename(site_packages, info->dir_name, *file, NULL);
+        if (!g_file_get_contents(path, &contents, NULL, NULL)) contents = NULL;
+        g_free(path);
+    }
+    if (!contents) return;
+
+    // Headers end at the first blank line
+    char** lines = g_strsplit(contents, "\n", -1);
+    for (char** line = lines; *line && **line && **line != '\r'; line++) {
+        if (!g_str_has_prefix(*line, "Requires-Dist: ") || strchr(*line, ';')) continue;
+
+        const char* name = *line + strlen("Requires-Dist: ");
+        const char* p = name;
+        while (g_ascii_isalnum(*p) || *p == '-' || *p == '_' || *p == '.') p++;
+        char* dep_name = g_strndup(name, p - name);
+        if (*p == '[') {
+            const char* extras_end = strchr(p, ']');
+            p = extras_end ? extras_end + 1 : p + strlen(p);
+        }
+
+        GString* specifier = g_string_new(NULL);
+        for (; *p; p++) {
+            if (!g_ascii_isspace(*p) && *p != '(' && *p != ')') {
+                g_string_append_c(specifier, *p);
+            }
+        }
+        // A truncated specifier would mean something else
+        if (specifier->len > 0 && specifier->len < MAX_VERSION_LEN) {
+            set_dependency_specifier(package, dep_name, specifier->str);
+        }
+        g_string_free(specifier, TRUE);
+        g_free(dep_name);
+    }
+    g_strfreev(lines);
+    g_free(contents);
+}
 
-    // Clear existing items
-    g_list_store_remove_all(analyzer->package_store);
+// Fingerprints and requirement specifiers from the dist-info metadata
+static void read_dist_info(VenvAnalyzer* analyzer) {
+    char* site_packages = venv_analyzer_find_site_packages(analyzer->venv_path);
+    if (!site_packages) return;
 
-    // Add packages to store
+    GHashTable* dist_info = collect_dist_info(site_packages);
     for (Package* pkg = analyzer->packages; pkg; pkg = pkg->next) {
-        g_list_store_append(analyzer->package_store, pkg);
+        char* key = package_normalize_name(pkg->name);
+        DistInfo* info = g_hash_table_lookup(dist_info, key);
+        pkg->fingerprint = info ? info->fingerprint : 0;
+        if (info) read_requirement_specifiers(site_packages, info, pkg);
+        g_free(key);
     }
 
-    g_print("Debug: Updated package store with %u items\n", g_list_model_get_n_items(G_LIST_MODEL(analyzer->package_store)));
-    return TRUE; // Remove source after updating
+    g_hash_table_unref(dist_info);
+    g_free(site_packages);
 }
 
-gboolean venv_analyzer_update_graph_view(VenvAnalyzer* analyzer) {
-    if (!analyzer || !analyzer->details_view) {
-        g_print("Debug: Cannot update graph view - invalid analyzer or view\n");
-        return TRUE; // Remove source
+GHashTable* venv_analyzer_find_records(const char* venv_path) {
+    char* site_packages = venv_analyzer_find_site_packages(venv_path);
+    if (!site_packages) return NULL;
+
+    GHashTable* records = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    GHashTable* dist_info = collect_dist_info(site_packages);
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, dist_info);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        DistInfo* info = value;
+        char* path = g_build_filename(site_packages, info->dir_name, "RECORD", NULL);
+        if (g_file_test(path, G_FILE_TEST_IS_REGULAR)) {
+            g_hash_table_insert(records, g_strdup(key), path);
+        } else {
+            g_free(path);
+        }
     }
 
-    // Create new graph
-    Agraph_t* g = agopen("venv_dependencies", Agdirected, NULL);
-    
-    // Add nodes and edges
+    g_hash_table_unref(dist_info);
+    g_free(site_packages);
+    return records;
+}
+
+// Reads the project name as spelled in the metadata ("Name: ...")
+static char* read_dist_name(const char* site_packages, const DistInfo* info) {
+    const char* files[] = { "METADATA", "PKG-INFO", NULL };
+    for (const char** file = files; *file; file++) {
+        char* path = g_build_filename(site_packages, info->dir_name, *file, NULL);
+        char* contents = NULL;
+        gboolean ok = g_file_get_contents(path, &contents, NULL, NULL);
+        g_free(path);
+        if (!ok) continue;
+
+        char* name = NULL;
+        char** lines = g_strsplit(contents, "\n", 32);
+        for (char** line = lines; *line && **line; line++) {
+            if (g_str_has_prefix(*line, "Name: ")) {
+                name = g_strstrip(g_strdup(*line + 6));
+                break;
+            }
+        }
+        g_strfreev(lines);
+        g_free(contents);
+        if (name) return name;
+    }
+    return NULL;
+}
+
+typedef struct {
+    char version[MAX_VERSION_LEN];
+    guint64 fingerprint;
+} KnownPackage;
+
+typedef struct {
+    VenvAnalyzer* analyzer;
+    char* venv_path;
+    GHashTable* known;     // normalized name -> KnownPackage
+} RevalidateData;
+
+typedef struct {
+    GPtrArray* updated;    // freshly scanned Package* for new or changed entries
+    GHashTable* stale;     // normalized names to drop from the loaded scan
+} RevalidateResult;
+
+static void revalidate_data_free(gpointer data) {
+    RevalidateData* rd = data;
+    g_free(rd->venv_path);
+    g_hash_table_unref(rd->known);
+    g_free(rd);
+}
+
+static void revalidate_result_free(gpointer data) {
+    RevalidateResult* result = data;
+    g_ptr_array_unref(result->updated);
+    g_hash_table_unref(result->stale);
+    g_free(result);
+}
+
+static void revalidate_thread(GTask* task,
+                              gpointer source_object G_GNUC_UNUSED,
+                              gpointer task_data,
+                              GCancellable* cancellable) {
+    RevalidateData* rd = task_data;
+    GError* error = NULL;
+
+    char* site_packages = venv_analyzer_find_site_packages(rd->venv_path);
+    if (!site_packages) {
+        g_task_return_new_error(task, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_INVALID_PATH,
+                                "No site-packages directory in %s", rd->venv_path);
+        return;
+    }
+
+    GHashTable* current = collect_dist_info(site_packages);
+    RevalidateResult* result = g_new0(RevalidateResult, 1);
+    result->updated = g_ptr_array_new_with_free_func((GDestroyNotify)package_free);
+    result->stale = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    // Anything loaded that is no longer installed, or whose metadata changed
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, rd->known);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        KnownPackage* known = value;
+        DistInfo* info = g_hash_table_lookup(current, key);
+        if (!info || info->fingerprint != known->fingerprint) {
+            g_hash_table_add(result->stale, g_strdup(key));
+        }
+    }
+
+    // Only new or changed distributions go back through pip
+    g_hash_table_iter_init(&iter, current);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        if (g_cancellable_is_cancelled(cancellable)) break;
+
+        DistInfo* info = value;
+        KnownPackage* known = g_hash_table_lookup(rd->known, key);
+        if (known && known->fingerprint == info->fingerprint) continue;
+
+        char* name = read_dist_name(site_packages, info);
+        Package* pkg = package_new(name ? name : key, info->version);
+        g_free(name);
+
+        pkg->fingerprint = info->fingerprint;
+        g_ptr_array_add(result->updated, pkg);
+        if (!analyze_package_dependencies(rd->venv_path, pkg, &error)) break;
+        read_requirement_specifiers(site_packages, info, pkg);
+    }
+
+    g_hash_table_unref(current);
+    g_free(site_packages);
+
+    if (error) {
+        revalidate_result_free(result);
+        g_task_return_error(task, error);
+        return;
+    }
+    if (g_task_return_error_if_cancelled(task)) {
+        revalidate_result_free(result);
+        return;
+    }
+    g_task_return_pointer(task, result, revalidate_result_free);
+}
+
+void venv_analyzer_revalidate_async(VenvAnalyzer* analyzer,
+                                    GCancellable* cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data) {
+    GTask* task = g_task_new(NULL, cancellable, callback, user_data);
+
+    // The worker only sees copies; analyzer->packages stays on the main thread
+    RevalidateData* rd = g_new0(RevalidateData, 1);
+    rd->analyzer = analyzer;
+    rd->venv_path = g_strdup(analyzer->venv_path);
+    rd->known = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
     for (Package* pkg = analyzer->packages; pkg; pkg = pkg->next) {
-        Agnode_t* pkg_node = agnode(g, pkg->name, TRUE);
-        
+        KnownPackage* known = g_new0(KnownPackage, 1);
+        g_strlcpy(known->version, pkg->version, sizeof(known->version));
+        known->fingerprint = pkg->fingerprint;
+        g_hash_table_replace(rd->known, package_normalize_name(pkg->name), known);
+    }
+
+    g_task_set_task_data(task, rd, revalidate_data_free);
+    g_task_run_in_thread(task, revalidate_thread);
+    g_object_unref(task);
+}
+
+gboolean venv_analyzer_revalidate_finish(VenvAnalyzer* analyzer,
+                                         GAsyncResult* result,
+                                         guint* n_changed,
+                                         GError** error) {
+    RevalidateData* rd = g_task_get_task_data(G_TASK(result));
+    g_return_val_if_fail(rd->analyzer == analyzer, FALSE);
+
+    RevalidateResult* changes = g_task_propagate_pointer(G_TASK(result), error);
+    if (!changes) return FALSE;
+
+    // The scan may have been replaced while the worker ran
+    if (g_strcmp0(rd->venv_path, analyzer->venv_path) != 0) {
+        revalidate_result_free(changes);
+        if (n_changed) *n_changed = 0;
+        return TRUE;
+    }
+
+    // Drop stale entries, keeping the order of everything that survived
+    Package* head = NULL;
+    Package* tail = NULL;
+    Package* pkg = analyzer->packages;
+    while (pkg) {
+        Package* next = pkg->next;
+        char* key = package_normalize_name(pkg->name);
+        gboolean stale = g_hash_table_contains(changes->stale, key);
+        g_free(key);
+
+        if (stale) {
+            package_free(pkg);
+        } else {
+            pkg->next = NULL;
+            if (tail) tail->next = pkg; else head = pkg;
+            tail = pkg;
+        }
+        pkg = next;
+    }
+
+    guint changed = g_hash_table_size(changes->stale);
+    for (guint i = 0; i < changes->updated->len; i++) {
+        Package* updated = g_ptr_array_index(changes->updated, i);
+        char* key = package_normalize_name(updated->name);
+        if (!g_hash_table_contains(changes->stale, key)) {
+            changed++;  // newly installed rather than replaced
+        }
+        g_free(key);
+
+        updated->next = NULL;
+        if (tail) tail->next = updated; else head = updated;
+        tail = updated;
+    }
+    analyzer->packages = head;
+    venv_analyzer_check_conflicts(analyzer);
+
+    // The merged list now owns the updated packages
+    g_ptr_array_set_free_func(changes->updated, NULL);
+    revalidate_result_free(changes);
+
+    if (n_changed) *n_changed = changed;
+    return TRUE;
+}
+
+// Records on each package the installed requirements whose version falls
+// outside its specifier, replacing whatever an earlier list worked out.
+// Returns whether any package has a conflict.
+static bool find_conflicts(Package* packages) {
+    GHashTable* installed = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for (Package* pkg = packages; pkg; pkg = pkg->next) {
+        package_clear_conflicts(pkg);
+        g_hash_table_replace(installed, package_normalize_name(pkg->name), pkg);
+    }
+
+    bool has_conflicts = false;
+    for (Package* pkg = packages; pkg; pkg = pkg->next) {
         for (PackageDep* dep = pkg->dependencies; dep; dep = dep->next) {
-            Agnode_t* dep_node = agnode(g, dep->name, TRUE);
-            agedge(g, pkg_node, dep_node, NULL, TRUE);
+            char* key = package_normalize_name(dep->name);
+            Package* dep_pkg = g_hash_table_lookup(installed, key);
+            g_free(key);
+            if (dep_pkg && !package_version_satisfies(dep_pkg->version, dep->version)) {
+                package_add_conflict(pkg, dep_pkg->name, dep_pkg->version);
+                has_conflicts = true;
+            }
         }
     }
 
-    // Layout the graph using proper type casting
-    gvLayout((GVC_t*)analyzer->gvc, g, "dot");
-    
-    // Update the graph view widget
-    gtk_widget_queue_draw(GTK_WIDGET(analyzer->details_view));
+    g_hash_table_unref(installed);
+    return has_conflicts;
+}
 
-    // Cleanup with proper type casting
-    gvFreeLayout((GVC_t*)analyzer->gvc, g);
-    agclose(g);
-    
-    return TRUE; // Remove source after updating
+// Swaps in the old object for every package that came back unchanged, so
+// the list model can tell it apart from real changes by identity alone.
+// Consumes both lists and returns the merged one in fresh's order.
+static Package* keep_unchanged_packages(Package* fresh, Package* old) {
+    // Relinking overwrites next pointers, so remember the old list first
+    GPtrArray* previous = g_ptr_array_new();
+    GHashTable* by_name = g_hash_table_new(g_str_hash, g_str_equal);
+    GHashTable* reused = g_hash_table_new(NULL, NULL);
+    for (Package* pkg = old; pkg; pkg = pkg->next) {
+        g_ptr_array_add(previous, pkg);
+        g_hash_table_insert(by_name, pkg->name, pkg);
+    }
+
+    Package* head = NULL;
+    Package* tail = NULL;
+    Package* pkg = fresh;
+    while (pkg) {
+        Package* next = pkg->next;
+        Package* same = g_hash_table_lookup(by_name, pkg->name);
+        if (same && package_equal(same, pkg)) {
+            g_hash_table_remove(by_name, pkg->name);
+            g_hash_table_add(reused, same);
+            package_free(pkg);
+            pkg = same;
+        }
+        pkg->next = NULL;
+        if (tail) tail->next = pkg; else head = pkg;
+        tail = pkg;
+        pkg = next;
+    }
+
+    // Whatever is left was removed or replaced
+    for (guint i = 0; i < previous->len; i++) {
+        if (!g_hash_table_contains(reused, g_ptr_array_index(previous, i))) {
+            package_free(g_ptr_array_index(previous, i));
+        }
+    }
+    g_ptr_array_unref(previous);
+    g_hash_table_unref(reused);
+    g_hash_table_unref(by_name);
+    return head;
+}
+
+static gint compare_package_names(gconstpointer a, gconstpointer b) {
+    const Package* x = *(Package* const*)a;
+    const Package* y = *(Package* const*)b;
+    return strcmp(x->name, y->name);
+}
+
+static void flush_splice(GListStore* store, guint position, guint* n_removals,
+                         GPtrArray* additions) {
+    if (*n_removals == 0 && additions->len == 0) return;
+
+    g_list_store_splice(store, position, *n_removals, additions->pdata, additions->len);
+    *n_removals = 0;
+    g_ptr_array_set_size(additions, 0);
+}
+
+guint venv_analyzer_sync_package_store(VenvAnalyzer* analyzer) {
+    g_return_val_if_fail(analyzer && analyzer->package_store, 0);
+
+    GPtrArray* fresh = g_ptr_array_new();
+    for (Package* pkg = analyzer->packages; pkg; pkg = pkg->next) {
+        g_ptr_array_add(fresh, pkg);
+    }
+    g_ptr_array_sort(fresh, compare_package_names);
+
+    // The store is kept in name order, so a merge of the two sorted
+    // sequences finds every difference. Unchanged packages are the same
+    // object (see keep_unchanged_packages); each run between two of them
+    // becomes one splice, so rows that did not change are never touched.
+    GListModel* model = G_LIST_MODEL(analyzer->package_store);
+    GPtrArray* additions = g_ptr_array_new();
+    guint n_removals = 0;
+    guint position = 0;   // Start of the pending run in the current store
+    guint old_index = 0;  // Next old item, counted from position
+    guint changed = 0;
+    guint i = 0;
+
+    for (;;) {
+        Package* old = g_list_model_get_item(model, position + old_index);
+        Package* pkg = i < fresh->len ? g_ptr_array_index(fresh, i) : NULL;
+        if (!old && !pkg) break;
+
+        int order = !old ? 1 : !pkg ? -1 : strcmp(old->name, pkg->name);
+        if (old == pkg) {
+            guint n_added = additions->len;
+            flush_splice(analyzer->package_store, position, &n_removals, additions);
+            position += n_added + 1;
+            old_index = 0;
+            i++;
+        } else {
+            // A replaced package is a removal and an addition in one run
+            if (order <= 0) {
+                n_removals++;
+                old_index++;
+                changed++;
+            }
+            if (order >= 0) {
+                g_ptr_array_add(additions, pkg);
+                i++;
+                if (order > 0) changed++;
+            }
+        }
+        if (old) g_object_unref(old);
+    }
+    flush_splice(analyzer->package_store, position, &n_removals, additions);
+
+    g_ptr_array_unref(additions);
+    g_ptr_array_unref(fresh);
+    return changed;
+}
+
+gboolean venv_analyzer_update_package_list(VenvAnalyzer* analyzer) {
+    if (!analyzer || !analyzer->package_store) {
+        g_print("Debug: Cannot update package list - invalid analyzer or store\n");
+        return G_SOURCE_REMOVE;
+    }
+
+    venv_analyzer_sync_package_store(analyzer);
+    return G_SOURCE_REMOVE;
+}
+
+// The graph view lays out the graph itself (see graph_layout.c); this only
+// asks for a repaint
+gboolean venv_analyzer_update_graph_view(VenvAnalyzer* analyzer) {
+    if (!analyzer || !analyzer->details_view) {
+        g_print("Debug: Cannot update graph view - invalid analyzer or view\n");
+        return G_SOURCE_REMOVE;
+    }
+
+    gtk_widget_queue_draw(GTK_WIDGET(analyzer->details_view));
+    return G_SOURCE_REMOVE;
 }
 
 gboolean venv_analyzer_scan(VenvAnalyzer* analyzer, GError** error) {
@@ -279,30 +812,38 @@ gboolean venv_analyzer_scan(VenvAnalyzer* analyzer, GError** error) {
         return FALSE;
     }
 
-    char* output = execute_pip_command(analyzer->venv_path, "freeze");
+    char* output = execute_pip_command(analyzer->venv_path, "freeze", NULL, error);
     if (!output) {
-        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                   "Failed to get package list: %s", venv_analyzer_get_last_error());
+        g_prefix_error(error, "Failed to get package list: ");
         return FALSE;
     }
     
-    // Clear existing packages
-    Package* pkg = analyzer->packages;
-    while (pkg) {
-        Package* next = pkg->next;
-        package_free(pkg);
-        pkg = next;
-    }
+    // Parse into a fresh list; the old one is only consulted for reuse
+    Package* previous = analyzer->packages;
     analyzer->packages = NULL;
     
     parse_pip_freeze(analyzer, output);
     g_free(output);
 
-    for (pkg = analyzer->packages; pkg; pkg = pkg->next) {
-        analyze_package_dependencies(analyzer, pkg);
-        package_update_size_from_pip(pkg);
+    for (Package* pkg = analyzer->packages; pkg; pkg = pkg->next) {
+        if (analyze_package_dependencies(analyzer->venv_path, pkg, error)) continue;
+
+        // Keep the previous scan on failure
+        while (analyzer->packages) {
+            Package* next = analyzer->packages->next;
+            package_free(analyzer->packages);
+            analyzer->packages = next;
+        }
+        analyzer->packages = previous;
+        return FALSE;
     }
 
+    g_clear_pointer(&analyzer->snapshot, venv_snapshot_unref);
+
+    read_dist_info(analyzer);
+    venv_analyzer_check_conflicts(analyzer);
+    analyzer->packages = keep_unchanged_packages(analyzer->packages, previous);
+
     // Add these lines to update the GUI after scanning
     g_idle_add((GSourceFunc)venv_analyzer_update_package_list, analyzer);
     g_idle_add((GSourceFunc)venv_analyzer_update_graph_view, analyzer);
@@ -310,22 +851,235 @@ gboolean venv_analyzer_scan(VenvAnalyzer* analyzer, GError** error) {
     return TRUE;
 }
 
-bool venv_analyzer_check_conflicts(VenvAnalyzer* analyzer) {
-    bool has_conflicts = false;
+char* venv_analyzer_get_db_path(void) {
+    char* dir = g_build_filename(g_get_user_data_dir(), "venv-analyzer", NULL);
+    g_mkdir_with_parents(dir, 0700);
+    char* path = g_build_filename(dir, "venv-analyzer.db", NULL);
+    g_free(dir);
+    return path;
+}
 
-    for (Package* pkg = analyzer->packages; pkg; pkg = pkg->next) {
-        PackageDep* dep = pkg->dependencies;
-        while (dep) {
-            Package* dep_pkg = venv_analyzer_get_package(analyzer, dep->name);
-            if (dep_pkg && !package_version_satisfies(dep_pkg->version, dep->version)) {
-                package_add_conflict(pkg, dep_pkg->name, dep_pkg->version);
-                has_conflicts = true;
-            }
-            dep = dep->next;
-        }
+// Opens the database on first use. A failure is kept, so later calls
+// report it again instead of retrying the open.
+static gboolean ensure_db(VenvAnalyzer* analyzer, GError** error) {
+    if (analyzer->db) return TRUE;
+    if (analyzer->db_error) {
+        g_propagate_error(error, g_error_copy(analyzer->db_error));
+        return FALSE;
     }
-    
-    return has_conflicts;
+
+    // The writer creates the schema, so it has to exist before any reader
+    char* db_path = venv_analyzer_get_db_path();
+    if (!analyzer->db_writer) {
+        analyzer->db_writer = db_writer_new(db_path);
+    }
+    DbError rc = analyzer->db_writer ? db_init_readonly(analyzer, db_path) : DB_ERROR_INIT;
+    g_free(db_path);
+    if (rc != DB_SUCCESS) {
+        analyzer->db_error = g_error_new(VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_DB_FAILED,
+                                         "Failed to open database: %s", db_get_last_error());
+        g_propagate_error(error, g_error_copy(analyzer->db_error));
+        db_close(analyzer);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+gboolean venv_analyzer_save_to_db(VenvAnalyzer* analyzer, GError** error) {
+    if (!ensure_db(analyzer, error)) return FALSE;
+
+    if (db_writer_save_state(analyzer->db_writer, analyzer->venv_path,
+                             analyzer->packages) != DB_SUCCESS) {
+        g_set_error(error, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_DB_FAILED,
+                   "Failed to save scan: %s", db_get_last_error());
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+void venv_analyzer_save_to_db_async(VenvAnalyzer* analyzer,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data) {
+    GError* error = NULL;
+    if (!ensure_db(analyzer, &error)) {
+        GTask* task = g_task_new(NULL, NULL, callback, user_data);
+        g_task_return_error(task, error);
+        g_object_unref(task);
+        return;
+    }
+
+    db_writer_save_state_async(analyzer->db_writer, analyzer->venv_path,
+                               analyzer->packages, callback, user_data);
+}
+
+gboolean venv_analyzer_save_to_db_finish(VenvAnalyzer* analyzer G_GNUC_UNUSED,
+                                         GAsyncResult* result,
+                                         GError** error) {
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+void venv_analyzer_flush_db(VenvAnalyzer* analyzer) {
+    if (analyzer->db_writer) {
+        db_writer_flush(analyzer->db_writer);
+    }
+}
+
+gboolean venv_analyzer_load_from_db(VenvAnalyzer* analyzer, GError** error) {
+    if (!ensure_db(analyzer, error)) return FALSE;
+
+    if (db_load_state(analyzer) != DB_SUCCESS) {
+        g_set_error(error, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_DB_FAILED,
+                   "Failed to load saved scan: %s", db_get_last_error());
+        return FALSE;
+    }
+
+    venv_analyzer_check_conflicts(analyzer);
+    g_clear_pointer(&analyzer->snapshot, venv_snapshot_unref);
+    return TRUE;
+}
+
+gboolean venv_analyzer_write_snapshot(VenvAnalyzer* analyzer,
+                                      const char* path,
+                                      GError** error) {
+    return venv_snapshot_write(path, analyzer->venv_path, analyzer->packages, error);
+}
+
+typedef gboolean (*ExportFunc)(ExportWriter* writer, VenvAnalyzer* analyzer);
+
+static gboolean export_to_file(VenvAnalyzer* analyzer, const char* filepath,
+                               ExportFunc write, GError** error) {
+    ExportWriter writer;
+    if (!export_writer_open(&writer, filepath, error)) return FALSE;
+    write(&writer, analyzer);
+    return export_writer_close(&writer, filepath, error);
+}
+
+static gboolean write_json(ExportWriter* writer, VenvAnalyzer* analyzer) {
+    // No environment chosen yet, e.g. after loading an older database
+    const char* venv_path = analyzer->venv_path[0] ? analyzer->venv_path : NULL;
+    return export_write_json(writer, venv_path, analyzer->packages);
+}
+
+static gboolean write_dot(ExportWriter* writer, VenvAnalyzer* analyzer) {
+    return export_write_dot(writer, analyzer->packages);
+}
+
+gboolean venv_analyzer_export_json(VenvAnalyzer* analyzer,
+                                   const char* filepath,
+                                   GError** error) {
+    return export_to_file(analyzer, filepath, write_json, error);
+}
+
+gboolean venv_analyzer_export_dot(VenvAnalyzer* analyzer,
+                                  const char* filepath,
+                                  GError** error) {
+    return export_to_file(analyzer, filepath, write_dot, error);
+}
+
+gboolean venv_analyzer_open_snapshot(VenvAnalyzer* analyzer,
+                                     const char* path,
+                                     GError** error) {
+    VenvSnapshot* snapshot = venv_snapshot_open(path, error);
+    if (!snapshot) return FALSE;
+
+    Package* packages = venv_snapshot_to_packages(snapshot);
+    find_conflicts(packages);
+    analyzer->packages = keep_unchanged_packages(packages, analyzer->packages);
+    g_strlcpy(analyzer->venv_path, venv_snapshot_get_venv_path(snapshot),
+              sizeof(analyzer->venv_path));
+
+    if (analyzer->snapshot) venv_snapshot_unref(analyzer->snapshot);
+    analyzer->snapshot = snapshot;
+    return TRUE;
+}
+
+GPtrArray* venv_analyzer_search_saved(VenvAnalyzer* analyzer,
+                                      const char* term,
+                                      const char* venv_path,
+                                      GError** error) {
+    if (!ensure_db(analyzer, error)) return NULL;
+
+    GPtrArray* results = NULL;
+    if (db_search_packages(analyzer, term, venv_path, 0, &results) != DB_SUCCESS) {
+        g_set_error(error, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_DB_FAILED,
+                   "Failed to search packages: %s", db_get_last_error());
+        return NULL;
+    }
+
+    return results;
+}
+
+GPtrArray* venv_analyzer_list_saved_scans(VenvAnalyzer* analyzer,
+                                          const char* venv_path,
+                                          GError** error) {
+    if (!ensure_db(analyzer, error)) return NULL;
+
+    return db_list_snapshots(analyzer, venv_path);
+}
+
+GPtrArray* venv_analyzer_diff_saved_scans(VenvAnalyzer* analyzer,
+                                          gint64 old_scan,
+                                          gint64 new_scan,
+                                          GError** error) {
+    if (!ensure_db(analyzer, error)) return NULL;
+
+    GPtrArray* changes = NULL;
+    if (db_diff_snapshots(analyzer, old_scan, new_scan, &changes) != DB_SUCCESS) {
+        g_set_error(error, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_DB_FAILED,
+                   "Failed to compare scans: %s", db_get_last_error());
+        return NULL;
+    }
+
+    return changes;
+}
+
+// Shared tail of the environment queries
+static GPtrArray* environments_or_error(DbError rc, GPtrArray* environments,
+                                        GError** error) {
+    if (rc != DB_SUCCESS) {
+        g_set_error(error, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_DB_FAILED,
+                   "Failed to query environments: %s", db_get_last_error());
+        return NULL;
+    }
+    return environments;
+}
+
+GPtrArray* venv_analyzer_list_saved_environments(VenvAnalyzer* analyzer,
+                                                 guint limit,
+                                                 GError** error) {
+    if (!ensure_db(analyzer, error)) return NULL;
+
+    GPtrArray* environments = NULL;
+    DbError rc = limit ? db_largest_environments(analyzer, limit, &environments)
+                       : db_list_environments(analyzer, &environments);
+    return environments_or_error(rc, environments, error);
+}
+
+GPtrArray* venv_analyzer_find_saved_environments(VenvAnalyzer* analyzer,
+                                                 const char* package_name,
+                                                 const char* specifier,
+                                                 GError** error) {
+    if (!ensure_db(analyzer, error)) return NULL;
+
+    GPtrArray* environments = NULL;
+    DbError rc = db_find_environments_with_package(analyzer, package_name, specifier,
+                                                   &environments);
+    return environments_or_error(rc, environments, error);
+}
+
+GPtrArray* venv_analyzer_find_saved_dependents(VenvAnalyzer* analyzer,
+                                               const char* package_name,
+                                               GError** error) {
+    if (!ensure_db(analyzer, error)) return NULL;
+
+    GPtrArray* environments = NULL;
+    DbError rc = db_find_environments_depending_on(analyzer, package_name, &environments);
+    return environments_or_error(rc, environments, error);
+}
+
+bool venv_analyzer_check_conflicts(VenvAnalyzer* analyzer) {
+    return find_conflicts(analyzer->packages);
 }
 
 Package* venv_analyzer_get_package(VenvAnalyzer* analyzer, const char* name) {
@@ -337,6 +1091,457 @@ Package* venv_analyzer_get_package(VenvAnalyzer* analyzer, const char* name) {
     return NULL;
 }
 
+int venv_analyzer_version_compare(const char* ver1, const char* ver2) {
+    guint8 key1[VERSION_KEY_LEN];
+    guint8 key2[VERSION_KEY_LEN];
+
+    package_version_key(ver1, key1);
+    package_version_key(ver2, key2);
+
+    int cmp = memcmp(key1, key2, VERSION_KEY_LEN);
+    return (cmp > 0) - (cmp < 0);
+}
+
 const char* venv_analyzer_get_last_error(void) {
     return error_buffer[0] ? error_buffer : "No error";
-}
\ No newline at end of file
+}
+
+// Package list view state
+
+// Sort keys and filter facts derived from the whole package set, so the
+// list's sort and filter models only look them up
+typedef struct {
+    guint64 sort_keys[PACKAGE_SORT_N_KEYS];
+    gboolean required;  // Some installed package depends on it
+    char* normalized_name;  // See package_normalize_name
+    char* search_text;  // Casefolded name, summary and dependency names
+} PackageViewKeys;
+
+static void view_keys_free(gpointer data) {
+    PackageViewKeys* keys = data;
+    g_free(keys->normalized_name);
+    g_free(keys->search_text);
+    g_free(keys);
+}
+
+void venv_analyzer_set_filter(VenvAnalyzer* analyzer, PackageFilterFlags flags) {
+    analyzer->filter_flags = flags;
+}
+
+void venv_analyzer_set_sort(VenvAnalyzer* analyzer, PackageSortKey key, gboolean ascending) {
+    g_return_if_fail(key < PACKAGE_SORT_N_KEYS);
+    analyzer->sort_key = key;
+    analyzer->sort_ascending = ascending;
+}
+
+static const PackageViewKeys* get_view_keys(VenvAnalyzer* analyzer, const Package* pkg);
+
+// The saved scan of this environment holds the same packages as memory, so
+// the list searches here and leaves the FTS index to fleet-wide queries
+// (venv_analyzer_search_saved). Keystrokes never touch the database.
+// Packages not already in matches are added with rank.
+static void search_in_memory(VenvAnalyzer* analyzer, GHashTable* matches, guint rank) {
+    char* needle = g_utf8_casefold(analyzer->search_term, -1);
+
+    for (Package* pkg = analyzer->packages; pkg; pkg = pkg->next) {
+        const PackageViewKeys* keys = get_view_keys(analyzer, pkg);
+        if (keys->search_text && strstr(keys->search_text, needle) &&
+            !g_hash_table_contains(matches, keys->normalized_name)) {
+            g_hash_table_insert(matches, g_strdup(keys->normalized_name),
+                                GUINT_TO_POINTER(rank));
+        }
+    }
+
+    g_free(needle);
+}
+
+// Names matching as fragments, e.g. "grpcst" for grpcio-status, rank by
+// their fuzzy score from 1 up; packages matching only in their summary or
+// dependencies come after all of them
+static void update_search_matches(VenvAnalyzer* analyzer) {
+    if (analyzer->search_matches) {
+        g_hash_table_unref(analyzer->search_matches);
+        analyzer->search_matches = NULL;
+    }
+    if (!analyzer->search_term) return;
+
+    analyzer->search_matches = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    guint rank = 1;
+    if (analyzer->name_index) {
+        GArray* matches = g_array_new(FALSE, FALSE, sizeof(FuzzyMatch));
+        fuzzy_index_search(analyzer->name_index, analyzer->search_term, matches);
+        fuzzy_index_rank(analyzer->name_index, matches, 0);
+        for (guint i = 0; i < matches->len; i++) {
+            guint index = g_array_index(matches, FuzzyMatch, i).index;
+            const char* name = fuzzy_index_get_name(analyzer->name_index, index);
+            if (!g_hash_table_contains(analyzer->search_matches, name)) {
+                g_hash_table_insert(analyzer->search_matches, g_strdup(name),
+                                    GUINT_TO_POINTER(rank++));
+            }
+        }
+        g_array_unref(matches);
+    }
+    search_in_memory(analyzer, analyzer->search_matches, rank);
+}
+
+void venv_analyzer_set_search(VenvAnalyzer* analyzer, const char* term) {
+    g_free(analyzer->search_term);
+    analyzer->search_term = term && *term ? g_strdup(term) : NULL;
+    update_search_matches(analyzer);
+}
+
+static gint compare_name_indices(gconstpointer a, gconstpointer b, gpointer user_data) {
+    Package** packages = user_data;
+    const Package* x = packages[*(const guint*)a];
+    const Package* y = packages[*(const guint*)b];
+    int order = g_ascii_strcasecmp(x->name, y->name);
+    return order ? order : strcmp(x->name, y->name);
+}
+
+static gint compare_version_indices(gconstpointer a, gconstpointer b, gpointer user_data) {
+    const guint8* version_keys = user_data;
+    return memcmp(&version_keys[*(const guint*)a * VERSION_KEY_LEN],
+                  &version_keys[*(const guint*)b * VERSION_KEY_LEN], VERSION_KEY_LEN);
+}
+
+// Ranks stand in for names and versions, so every sort is numeric
+static GArray* sorted_indices(guint n, GCompareDataFunc compare, gpointer user_data) {
+    GArray* order = g_array_sized_new(FALSE, FALSE, sizeof(guint), n);
+    for (guint i = 0; i < n; i++) {
+        g_array_append_val(order, i);
+    }
+    g_array_sort_with_data(order, compare, user_data);
+    return order;
+}
+
+// Tarjan's algorithm without recursion, so deep chains cannot overflow
+// the stack. Components are numbered in the order they complete, which
+// puts every component after the ones it depends on.
+// @return Number of components; component[i] is the one holding node i
+static guint find_components(guint n, const guint* dep_start, const guint* deps,
+                             guint* component) {
+    guint* index = g_new0(guint, MAX(n, 1));     // Visit order + 1, 0 = unvisited
+    guint* lowlink = g_new(guint, MAX(n, 1));
+    guint* next_dep = g_new(guint, MAX(n, 1));
+    gboolean* on_stack = g_new0(gboolean, MAX(n, 1));
+    GArray* stack = g_array_new(FALSE, FALSE, sizeof(guint));
+    GArray* path = g_array_new(FALSE, FALSE, sizeof(guint));
+    guint visited = 0;
+    guint n_components = 0;
+
+    for (guint root = 0; root < n; root++) {
+        if (index[root]) continue;
+        g_array_append_val(path, root);
+        index[root] = lowlink[root] = ++visited;
+        next_dep[root] = dep_start[root];
+        g_array_append_val(stack, root);
+        on_stack[root] = TRUE;
+
+        while (path->len > 0) {
+            guint v = g_array_index(path, guint, path->len - 1);
+            if (next_dep[v] < dep_start[v + 1]) {
+                guint w = deps[next_dep[v]++];
+                if (!index[w]) {
+                    index[w] = lowlink[w] = ++visited;
+                    next_dep[w] = dep_start[w];
+                    g_array_append_val(stack, w);
+                    on_stack[w] = TRUE;
+                    g_array_append_val(path, w);
+                } else if (on_stack[w]) {
+                    lowlink[v] = MIN(lowlink[v], index[w]);
+                }
+                continue;
+            }
+
+            g_array_set_size(path, path->len - 1);
+            if (path->len > 0) {
+                guint parent = g_array_index(path, guint, path->len - 1);
+                lowlink[parent] = MIN(lowlink[parent], lowlink[v]);
+            }
+            if (lowlink[v] == index[v]) {
+                guint w;
+                do {
+                    w = g_array_index(stack, guint, stack->len - 1);
+                    g_array_set_size(stack, stack->len - 1);
+                    on_stack[w] = FALSE;
+                    component[w] = n_components;
+                } while (w != v);
+                n_components++;
+            }
+        }
+    }
+
+    g_array_unref(path);
+    g_array_unref(stack);
+    g_free(on_stack);
+    g_free(next_dep);
+    g_free(lowlink);
+    g_free(index);
+    return n_components;
+}
+
+// Sums sizes over the packages reachable from each one, itself included.
+// Components of the dependency graph are visited dependencies first, and
+// each one's reachable set is its members plus the union of its
+// dependencies' sets, kept as bitsets; a set is freed once every component
+// depending on it has used it.
+// @return Total per node, free with g_free
+static guint64* reachable_sizes(guint n, const guint* dep_start, const guint* deps,
+                                const guint64* sizes) {
+    guint64* totals = g_new0(guint64, MAX(n, 1));
+    guint* component = g_new(guint, MAX(n, 1));
+    guint n_components = find_components(n, dep_start, deps, component);
+
+    // Members of each component, as CSR
+    guint* member_start = g_new0(guint, n_components + 1);
+    guint* members = g_new(guint, MAX(n, 1));
+    for (guint i = 0; i < n; i++) {
+        member_start[component[i] + 1]++;
+    }
+    for (guint c = 0; c < n_components; c++) {
+        member_start[c + 1] += member_start[c];
+    }
+    guint* fill = g_memdup2(member_start, (n_components + 1) * sizeof(guint));
+    for (guint i = 0; i < n; i++) {
+        members[fill[component[i]]++] = i;
+    }
+    g_free(fill);
+
+    // Dependencies between components, deduplicated, as CSR
+    guint* succ_start = g_new0(guint, n_components + 1);
+    GArray* succ = g_array_new(FALSE, FALSE, sizeof(guint));
+    guint* users = g_new0(guint, MAX(n_components, 1));  // Components depending on this one
+    guint* seen = g_new0(guint, MAX(n_components, 1));   // Last component + 1 to name it
+    for (guint c = 0; c < n_components; c++) {
+        for (guint m = member_start[c]; m < member_start[c + 1]; m++) {
+            guint i = members[m];
+            for (guint d = dep_start[i]; d < dep_start[i + 1]; d++) {
+                guint s = component[deps[d]];
+                if (s != c && seen[s] != c + 1) {
+                    seen[s] = c + 1;
+                    g_array_append_val(succ, s);
+                    users[s]++;
+                }
+            }
+        }
+        succ_start[c + 1] = succ->len;
+    }
+
+    gsize words = (n + 63) / 64;
+    guint64** reach = g_new0(guint64*, MAX(n_components, 1));
+    for (guint c = 0; c < n_components; c++) {
+        guint64* set = g_new0(guint64, MAX(words, 1));
+        guint64 total = 0;
+        for (guint m = member_start[c]; m < member_start[c + 1]; m++) {
+            set[members[m] / 64] |= G_GUINT64_CONSTANT(1) << (members[m] % 64);
+            total += sizes[members[m]];
+        }
+
+        for (guint e = succ_start[c]; e < succ_start[c + 1]; e++) {
+            guint s = g_array_index(succ, guint, e);
+            for (gsize w = 0; w < words; w++) {
+                guint64 added = reach[s][w] & ~set[w];
+                set[w] |= added;
+                while (added) {
+                    total += sizes[w * 64 + __builtin_ctzll(added)];
+                    added &= added - 1;
+                }
+            }
+            if (--users[s] == 0) {
+                g_clear_pointer(&reach[s], g_free);
+            }
+        }
+
+        for (guint m = member_start[c]; m < member_start[c + 1]; m++) {
+            totals[members[m]] = total;
+        }
+        if (users[c] > 0) {
+            reach[c] = set;
+        } else {
+            g_free(set);
+        }
+    }
+
+    g_free(reach);
+    g_free(seen);
+    g_free(users);
+    g_array_unref(succ);
+    g_free(succ_start);
+    g_free(members);
+    g_free(member_start);
+    g_free(component);
+    return totals;
+}
+
+static void compute_view_keys(VenvAnalyzer* analyzer) {
+    GPtrArray* packages = g_ptr_array_new();
+    GHashTable* index_of = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    fuzzy_index_free(analyzer->name_index);
+    analyzer->name_index = fuzzy_index_new();
+    for (Package* pkg = analyzer->packages; pkg; pkg = pkg->next) {
+        char* name = package_normalize_name(pkg->name);
+        fuzzy_index_add(analyzer->name_index, name);
+        g_hash_table_insert(index_of, name, GUINT_TO_POINTER(packages->len));
+        g_ptr_array_add(packages, pkg);
+    }
+    guint n = packages->len;
+    PackageViewKeys* keys = g_new0(PackageViewKeys, MAX(n, 1));
+
+    // Dependencies on installed packages, deduplicated, as CSR
+    guint* dep_start = g_new0(guint, n + 1);
+    GArray* dep_items = g_array_new(FALSE, FALSE, sizeof(guint));
+    guint* seen = g_new0(guint, MAX(n, 1));  // Last package + 1 to name it
+    for (guint i = 0; i < n; i++) {
+        Package* pkg = g_ptr_array_index(packages, i);
+        keys[i].normalized_name = package_normalize_name(pkg->name);
+        for (PackageDep* dep = pkg->dependencies; dep; dep = dep->next) {
+            char* name = package_normalize_name(dep->name);
+            gpointer value;
+            if (g_hash_table_lookup_extended(index_of, name, NULL, &value)) {
+                guint j = GPOINTER_TO_UINT(value);
+                if (j != i && seen[j] != i + 1) {
+                    seen[j] = i + 1;
+                    g_array_append_val(dep_items, j);
+                    keys[j].required = TRUE;
+                    keys[j].sort_keys[PACKAGE_SORT_FAN_IN]++;
+                }
+            }
+            g_free(name);
+        }
+        dep_start[i + 1] = dep_items->len;
+        keys[i].sort_keys[PACKAGE_SORT_FAN_OUT] = dep_start[i + 1] - dep_start[i];
+        keys[i].sort_keys[PACKAGE_SORT_SIZE] = pkg->size;
+
+        // Newlines keep a search term from matching across two fields
+        GString* text = g_string_new(pkg->name);
+        g_string_append_c(text, '\n');
+        g_string_append(text, pkg->description);
+        for (PackageDep* dep = pkg->dependencies; dep; dep = dep->next) {
+            g_string_append_c(text, '\n');
+            g_string_append(text, dep->name);
+        }
+        keys[i].search_text = g_utf8_casefold(text->str, text->len);
+        g_string_free(text, TRUE);
+    }
+
+    // Total size counts every package reachable from this one once
+    guint64* sizes = g_new(guint64, MAX(n, 1));
+    for (guint i = 0; i < n; i++) {
+        sizes[i] = keys[i].sort_keys[PACKAGE_SORT_SIZE];
+    }
+    guint64* totals = reachable_sizes(n, dep_start, (const guint*)dep_items->data, sizes);
+    for (guint i = 0; i < n; i++) {
+        keys[i].sort_keys[PACKAGE_SORT_TOTAL_SIZE] = totals[i];
+    }
+    g_free(totals);
+    g_free(sizes);
+
+    GArray* order = sorted_indices(n, compare_name_indices, packages->pdata);
+    for (guint r = 0; r < n; r++) {
+        keys[g_array_index(order, guint, r)].sort_keys[PACKAGE_SORT_NAME] = r;
+    }
+    g_array_unref(order);
+
+    // Equal versions share a rank
+    guint8* version_keys = g_new(guint8, MAX(n, 1) * VERSION_KEY_LEN);
+    for (guint i = 0; i < n; i++) {
+        Package* pkg = g_ptr_array_index(packages, i);
+        package_version_key(pkg->version, &version_keys[i * VERSION_KEY_LEN]);
+    }
+    order = sorted_indices(n, compare_version_indices, version_keys);
+    guint64 rank = 0;
+    for (guint r = 0; r < n; r++) {
+        guint i = g_array_index(order, guint, r);
+        if (r > 0 && compare_version_indices(&g_array_index(order, guint, r - 1), &i,
+                                             version_keys) != 0) {
+            rank++;
+        }
+        keys[i].sort_keys[PACKAGE_SORT_VERSION] = rank;
+    }
+    g_array_unref(order);
+    g_free(version_keys);
+
+    if (analyzer->view_keys) {
+        g_hash_table_unref(analyzer->view_keys);
+    }
+    analyzer->view_keys = g_hash_table_new_full(NULL, NULL, NULL, view_keys_free);
+    for (guint i = 0; i < n; i++) {
+        g_hash_table_insert(analyzer->view_keys, g_ptr_array_index(packages, i),
+                            g_memdup2(&keys[i], sizeof(PackageViewKeys)));
+    }
+
+    g_free(keys);
+    g_free(seen);
+    g_free(dep_start);
+    g_array_unref(dep_items);
+    g_hash_table_unref(index_of);
+    g_ptr_array_unref(packages);
+}
+
+void venv_analyzer_refresh_view(VenvAnalyzer* analyzer) {
+    compute_view_keys(analyzer);
+    update_search_matches(analyzer);
+}
+
+static const PackageViewKeys* get_view_keys(VenvAnalyzer* analyzer, const Package* pkg) {
+    static const PackageViewKeys none;
+    const PackageViewKeys* keys = analyzer->view_keys
+        ? g_hash_table_lookup(analyzer->view_keys, pkg) : NULL;
+    return keys ? keys : &none;
+}
+
+gboolean venv_analyzer_package_visible(VenvAnalyzer* analyzer, const Package* pkg) {
+    gboolean visible = TRUE;
+
+    if (analyzer->search_matches) {
+        const char* key = get_view_keys(analyzer, pkg)->normalized_name;
+        visible = key && g_hash_table_contains(analyzer->search_matches, key);
+    }
+
+    PackageFilterFlags flags = analyzer->filter_flags;
+    if (visible && (flags & (PACKAGE_FILTER_DIRECT | PACKAGE_FILTER_DEPS))) {
+        gboolean required = get_view_keys(analyzer, pkg)->required;
+        visible = ((flags & PACKAGE_FILTER_DIRECT) && !required) ||
+                  ((flags & PACKAGE_FILTER_DEPS) && required);
+    }
+    if (visible && (flags & PACKAGE_FILTER_CONFLICTS)) {
+        visible = pkg->conflicts != NULL;
+    }
+
+    return visible;
+}
+
+guint64 venv_analyzer_package_search_rank(VenvAnalyzer* analyzer, const Package* pkg) {
+    if (!analyzer->search_matches) return 0;
+    const char* key = get_view_keys(analyzer, pkg)->normalized_name;
+    gpointer rank;
+    if (key && g_hash_table_lookup_extended(analyzer->search_matches, key, NULL, &rank)) {
+        return GPOINTER_TO_UINT(rank);
+    }
+    return G_MAXUINT64;
+}
+
+guint64 venv_analyzer_package_sort_key(VenvAnalyzer* analyzer,
+                                       const Package* pkg,
+                                       PackageSortKey key) {
+    g_return_val_if_fail(key < PACKAGE_SORT_N_KEYS, 0);
+    return get_view_keys(analyzer, pkg)->sort_keys[key];
+}
+
+// Ties in the chosen key fall back to name order
+int venv_analyzer_package_compare(VenvAnalyzer* analyzer,
+                                  const Package* a,
+                                  const Package* b) {
+    const PackageViewKeys* x = get_view_keys(analyzer, a);
+    const PackageViewKeys* y = get_view_keys(analyzer, b);
+    guint64 key_a = x->sort_keys[analyzer->sort_key];
+    guint64 key_b = y->sort_keys[analyzer->sort_key];
+    int order = (key_a > key_b) - (key_a < key_b);
+    if (!analyzer->sort_ascending) order = -order;
+    if (order == 0) {
+        guint64 name_a = x->sort_keys[PACKAGE_SORT_NAME];
+        guint64 name_b = y->sort_keys[PACKAGE_SORT_NAME];
+        order = (name_a > name_b) - (name_a < name_b);
+    }
+    return order;
+}
@@ -31,6 +31,13 @@ typedef struct {
  */
 VenvAnalyzer* venv_analyzer_new(const char* venv_path);
 
+/**
+ * Creates an analyzer without GUI components, for command-line use where
+ * GTK is not initialized
+ * @return New analyzer instance
+ */
+VenvAnalyzer* venv_analyzer_new_headless(void);
+
 /**
  * Frees analyzer instance and all resources
  */
@@ -67,15 +74,149 @@ AnalyzerError venv_analyzer_update_package(VenvAnalyzer* analyzer,
  */
 const char* venv_analyzer_get_last_error(void);
 
+/**
+ * Returns the per-user database path, creating its directory if needed
+ * @return Newly allocated path, free with g_free
+ */
+char* venv_analyzer_get_db_path(void);
+
+/**
+ * Queues the current packages for the database writer thread and returns
+ * without waiting for the commit; see venv_analyzer_save_to_db to wait
+ */
+void venv_analyzer_save_to_db_async(VenvAnalyzer* analyzer,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data);
+gboolean venv_analyzer_save_to_db_finish(VenvAnalyzer* analyzer,
+                                         GAsyncResult* result,
+                                         GError** error);
+
+/**
+ * Blocks until every queued database write has been committed
+ */
+void venv_analyzer_flush_db(VenvAnalyzer* analyzer);
+
+/**
+ * Writes the current packages as a binary snapshot (see snapshot.h)
+ * @return FALSE on error
+ */
+gboolean venv_analyzer_write_snapshot(VenvAnalyzer* analyzer,
+                                      const char* path,
+                                      GError** error);
+
+/**
+ * Maps a snapshot file and replaces the current packages with its contents.
+ * The mapping stays open in analyzer->snapshot for direct graph access.
+ * @return FALSE on error
+ */
+gboolean venv_analyzer_open_snapshot(VenvAnalyzer* analyzer,
+                                     const char* path,
+                                     GError** error);
+
+/**
+ * Searches package names, summaries and dependency names in the saved scan
+ * of venv_path, or of every saved environment when venv_path is NULL
+ * @return GPtrArray of DbSearchResult* or NULL on error
+ */
+GPtrArray* venv_analyzer_search_saved(VenvAnalyzer* analyzer,
+                                      const char* term,
+                                      const char* venv_path,
+                                      GError** error);
+
+/**
+ * Lists the saved scans of venv_path, newest first
+ * @return GPtrArray of DbSnapshot* or NULL on error
+ */
+GPtrArray* venv_analyzer_list_saved_scans(VenvAnalyzer* analyzer,
+                                          const char* venv_path,
+                                          GError** error);
+
+/**
+ * Compares two saved scans of the same environment
+ * @return GPtrArray of SnapshotChange* or NULL on error
+ */
+GPtrArray* venv_analyzer_diff_saved_scans(VenvAnalyzer* analyzer,
+                                          gint64 old_scan,
+                                          gint64 new_scan,
+                                          GError** error);
+
+/**
+ * Lists saved environments by path, or the limit largest by total size
+ * when limit is not 0
+ * @return GPtrArray of DbEnvironment* or NULL on error
+ */
+GPtrArray* venv_analyzer_list_saved_environments(VenvAnalyzer* analyzer,
+                                                 guint limit,
+                                                 GError** error);
+
+/**
+ * Finds saved environments that have package_name installed at a version
+ * matching specifier, or at any version when specifier is NULL
+ * @return GPtrArray of DbEnvironment* or NULL on error
+ */
+GPtrArray* venv_analyzer_find_saved_environments(VenvAnalyzer* analyzer,
+                                                 const char* package_name,
+                                                 const char* specifier,
+                                                 GError** error);
+
+/**
+ * Finds saved environments where installed packages depend on
+ * package_name, directly or transitively
+ * @return GPtrArray of DbEnvironment* or NULL on error
+ */
+GPtrArray* venv_analyzer_find_saved_dependents(VenvAnalyzer* analyzer,
+                                               const char* package_name,
+                                               GError** error);
+
+/**
+ * Locates the site-packages directory of a virtual environment
+ * @return Newly allocated path or NULL if none exists
+ */
+char* venv_analyzer_find_site_packages(const char* venv_path);
+
+/**
+ * Locates the RECORD file of every distribution installed in a virtual
+ * environment; egg-info installs have none. Safe to call from any thread.
+ * @return Normalized package name -> RECORD path, or NULL if there is no
+ *         site-packages directory
+ */
+GHashTable* venv_analyzer_find_records(const char* venv_path);
+
+/**
+ * Compares the loaded scan against the dist-info fingerprints on disk in a
+ * worker thread, re-running pip only for new or changed distributions
+ */
+void venv_analyzer_revalidate_async(VenvAnalyzer* analyzer,
+                                    GCancellable* cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data);
+
+/**
+ * Merges the revalidation result into analyzer->packages (main thread)
+ * @param n_changed Number of packages added, removed or changed
+ * @return FALSE on error
+ */
+gboolean venv_analyzer_revalidate_finish(VenvAnalyzer* analyzer,
+                                         GAsyncResult* result,
+                                         guint* n_changed,
+                                         GError** error);
+
+/**
+ * Brings package_store in line with the current package list, splicing
+ * in only the packages that were added, removed or replaced
+ * @return Number of rows that changed
+ */
+guint venv_analyzer_sync_package_store(VenvAnalyzer* analyzer);
+
 /**
  * Updates the package list in the GUI
- * @return TRUE to remove source, FALSE to keep it
+ * @return G_SOURCE_REMOVE, so it can run as a one-off idle source
  */
 gboolean venv_analyzer_update_package_list(VenvAnalyzer* analyzer);
 
 /**
  * Updates the graph view in the GUI
- * @return TRUE to remove source, FALSE to keep it
+ * @return G_SOURCE_REMOVE, so it can run as a one-off idle source
  */
 gboolean venv_analyzer_update_graph_view(VenvAnalyzer* analyzer);
 
@@ -0,0 +1,218 @@
+#include "export.h"
+#include "graph_layout.h"
+#include <math.h>
+#include <stdarg.h>
+#include <string.h>
+
+// Large enough that the file stream sees few, big writes
+#define EXPORT_BUFFER_SIZE (256 * 1024)
+
+gboolean export_writer_open(ExportWriter* writer, const char* path, GError** error) {
+    GFile* file = g_file_new_for_path(path);
+    GFileOutputStream* stream = g_file_replace(file, NULL, FALSE,
+                                               G_FILE_CREATE_REPLACE_DESTINATION,
+                                               NULL, error);
+    g_object_unref(file);
+    if (!stream) return FALSE;
+
+    writer->out = g_buffered_output_stream_new_sized(G_OUTPUT_STREAM(stream),
+                                                     EXPORT_BUFFER_SIZE);
+    writer->error = NULL;
+    writer->cancellable = NULL;
+    g_object_unref(stream);
+    return TRUE;
+}
+
+gboolean export_writer_close(ExportWriter* writer, const char* path, GError** error) {
+    // Closing with a cancelled cancellable abandons the replacement
+    if (writer->error) {
+        GCancellable* abandon = g_cancellable_new();
+        g_cancellable_cancel(abandon);
+        g_output_stream_close(writer->out, abandon, NULL);
+        g_object_unref(abandon);
+    } else {
+        g_output_stream_close(writer->out, NULL, &writer->error);
+    }
+    g_clear_object(&writer->out);
+
+    if (!writer->error) return TRUE;
+    g_set_error(error, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_EXPORT_FAILED,
+                "Failed to export %s: %s", path, writer->error->message);
+    g_clear_error(&writer->error);
+    return FALSE;
+}
+
+// Most writes only fill the buffer, so cancellation is checked here
+// rather than left to the stream
+static gboolean writer_failed(ExportWriter* writer) {
+    return writer->error ||
+           g_cancellable_set_error_if_cancelled(writer->cancellable, &writer->error);
+}
+
+void export_write(ExportWriter* writer, const void* data, gsize length) {
+    if (length == 0 || writer_failed(writer)) return;
+    g_output_stream_write_all(writer->out, data, length, NULL,
+                              writer->cancellable, &writer->error);
+}
+
+void export_printf(ExportWriter* writer, const char* format, ...) {
+    if (writer_failed(writer)) return;
+    va_list args;
+    va_start(args, format);
+    g_output_stream_vprintf(writer->out, NULL, writer->cancellable, &writer->error,
+                            format, args);
+    va_end(args);
+}
+
+void export_write_number(ExportWriter* writer, double value) {
+    char buffer[G_ASCII_DTOSTR_BUF_SIZE];
+    if (fabs(value) < 0.005) value = 0.0;  // Not "-0"
+    g_ascii_formatd(buffer, sizeof(buffer), "%.2f", value);
+
+    // Trailing zeros add up over hundreds of thousands of coordinates
+    char* end = buffer + strlen(buffer);
+    if (strchr(buffer, '.')) {
+        while (end[-1] == '0') end--;
+        if (end[-1] == '.') end--;
+    }
+    export_write(writer, buffer, end - buffer);
+}
+
+static const char* escape_char(char c, ExportEscape escape, char buffer[8]) {
+    switch (escape) {
+        case EXPORT_ESCAPE_JSON:
+            if (c == '"') return "\\\"";
+            if (c == '\\') return "\\\\";
+            if (c == '\n') return "\\n";
+            if (c == '\t') return "\\t";
+            if ((guchar)c < 0x20) {
+                g_snprintf(buffer, 8, "\\u%04x", (guchar)c);
+                return buffer;
+            }
+            return NULL;
+        case EXPORT_ESCAPE_DOT:
+            if (c == '"') return "\\\"";
+            if (c == '\\') return "\\\\";
+            if (c == '\n') return "\\n";
+            if ((guchar)c < 0x20) return "";
+            return NULL;
+        case EXPORT_ESCAPE_XML:
+            if (c == '&') return "&amp;";
+            if (c == '<') return "&lt;";
+            if (c == '>') return "&gt;";
+            if (c == '"') return "&quot;";
+            // XML 1.0 has no way to write other control characters
+            if ((guchar)c < 0x20 && c != '\n' && c != '\t') return "";
+            return NULL;
+    }
+    return NULL;
+}
+
+// Runs of plain characters go out in one write
+void export_write_escaped(ExportWriter* writer, const char* text, ExportEscape escape) {
+    char* valid = NULL;
+    if (!g_utf8_validate(text, -1, NULL)) {
+        valid = g_utf8_make_valid(text, -1);
+        text = valid;
+    }
+
+    const char* run = text;
+    for (const char* p = text; *p; p++) {
+        char buffer[8];
+        const char* replacement = escape_char(*p, escape, buffer);
+        if (!replacement) continue;
+        export_write(writer, run, p - run);
+        export_write(writer, replacement, strlen(replacement));
+        run = p + 1;
+    }
+    export_write(writer, run, strlen(run));
+    g_free(valid);
+}
+
+static void write_json_string(ExportWriter* writer, const char* text) {
+    export_write_literal(writer, "\"");
+    export_write_escaped(writer, text, EXPORT_ESCAPE_JSON);
+    export_write_literal(writer, "\"");
+}
+
+static void write_json_deps(ExportWriter* writer, const char* key,
+                            const PackageDep* deps, const char* version_key) {
+    export_printf(writer, ",\n      \"%s\": [", key);
+    for (const PackageDep* dep = deps; dep; dep = dep->next) {
+        export_printf(writer, "%s\n        { \"name\": ", dep == deps ? "" : ",");
+        write_json_string(writer, dep->name);
+        export_printf(writer, ", \"%s\": ", version_key);
+        write_json_string(writer, dep->version);
+        export_write_literal(writer, " }");
+    }
+    export_printf(writer, "%s]", deps ? "\n      " : "");
+}
+
+gboolean export_write_json(ExportWriter* writer, const char* venv_path, Package* packages) {
+    export_write_literal(writer, "{\n  \"venv_path\": ");
+    if (venv_path) {
+        write_json_string(writer, venv_path);
+    } else {
+        export_write_literal(writer, "null");
+    }
+    export_write_literal(writer, ",\n  \"packages\": [");
+
+    for (Package* pkg = packages; pkg && !writer->error; pkg = pkg->next) {
+        export_printf(writer, "%s\n    {\n      \"name\": ", pkg == packages ? "" : ",");
+        write_json_string(writer, pkg->name);
+        export_write_literal(writer, ",\n      \"version\": ");
+        write_json_string(writer, pkg->version);
+        export_write_literal(writer, ",\n      \"summary\": ");
+        write_json_string(writer, pkg->description);
+        export_printf(writer, ",\n      \"size\": %" G_GUINT64_FORMAT, (guint64)pkg->size);
+        write_json_deps(writer, "dependencies", pkg->dependencies, "required");
+        write_json_deps(writer, "conflicts", pkg->conflicts, "version");
+        export_write_literal(writer, "\n    }");
+    }
+
+    export_printf(writer, "%s]\n}\n", packages ? "\n  " : "");
+    return writer->error == NULL;
+}
+
+static void write_dot_id(ExportWriter* writer, const char* name) {
+    char* id = package_normalize_name(name);
+    export_write_literal(writer, "\"");
+    export_write_escaped(writer, id, EXPORT_ESCAPE_DOT);
+    export_write_literal(writer, "\"");
+    g_free(id);
+}
+
+gboolean export_write_dot(ExportWriter* writer, Package* packages) {
+    export_printf(writer, "digraph dependencies {\n"
+                          "  node [shape=box, fontname=\"%s\"];\n", GRAPH_LAYOUT_FONT);
+
+    for (Package* pkg = packages; pkg && !writer->error; pkg = pkg->next) {
+        export_write_literal(writer, "  ");
+        write_dot_id(writer, pkg->name);
+        export_write_literal(writer, " [label=\"");
+        export_write_escaped(writer, pkg->name, EXPORT_ESCAPE_DOT);
+        export_write_literal(writer, "\\n");
+        export_write_escaped(writer, pkg->version, EXPORT_ESCAPE_DOT);
+        export_write_literal(writer, "\"");
+        if (pkg->conflicts) {
+            export_write_literal(writer, ", style=filled, fillcolor=\"#ffe6e6\"");
+        }
+        export_write_literal(writer, "];\n");
+
+        for (const PackageDep* dep = pkg->dependencies; dep; dep = dep->next) {
+            export_write_literal(writer, "  ");
+            write_dot_id(writer, pkg->name);
+            export_write_literal(writer, " -> ");
+            write_dot_id(writer, dep->name);
+            if (dep->version[0]) {
+                export_write_literal(writer, " [label=\"");
+                export_write_escaped(writer, dep->version, EXPORT_ESCAPE_DOT);
+                export_write_literal(writer, "\"]");
+            }
+            export_write_literal(writer, ";\n");
+        }
+    }
+
+    export_write_literal(writer, "}\n");
+    return writer->error == NULL;
+}
@@ -0,0 +1,64 @@
+#ifndef CORE_EXPORT_H
+#define CORE_EXPORT_H
+
+#include "../include/venv_analyzer.h"
+#include "package.h"
+#include <gio/gio.h>
+
+// Exports are written straight from the in-memory packages or layout to a
+// buffered stream, one element at a time, so memory use does not grow
+// with what is exported. The file is replaced atomically on success and
+// left untouched on error.
+
+typedef struct {
+    GOutputStream* out;    // Buffered
+    GError* error;         // First error; later writes are skipped
+    GCancellable* cancellable;  // Fails the next write once cancelled, or NULL
+} ExportWriter;
+
+/**
+ * Starts replacing path, with no cancellable
+ * @return FALSE on error
+ */
+gboolean export_writer_open(ExportWriter* writer, const char* path, GError** error);
+
+/**
+ * Flushes and commits the file, or discards it if a write failed
+ * @return FALSE on error, with VENV_ANALYZER_ERROR_EXPORT_FAILED
+ */
+gboolean export_writer_close(ExportWriter* writer, const char* path, GError** error);
+
+void export_write(ExportWriter* writer, const void* data, gsize length);
+#define export_write_literal(writer, text) export_write((writer), (text), sizeof(text) - 1)
+void export_printf(ExportWriter* writer, const char* format, ...) G_GNUC_PRINTF(2, 3);
+
+/**
+ * Writes value in the C locale, with at most two decimals
+ */
+void export_write_number(ExportWriter* writer, double value);
+
+typedef enum {
+    EXPORT_ESCAPE_JSON,    // Inside a JSON string
+    EXPORT_ESCAPE_DOT,     // Inside a quoted DOT ID
+    EXPORT_ESCAPE_XML      // Text or attribute value
+} ExportEscape;
+
+/**
+ * Writes text escaped for the given context. Invalid UTF-8 is replaced.
+ */
+void export_write_escaped(ExportWriter* writer, const char* text, ExportEscape escape);
+
+/**
+ * Writes packages with their requirements and conflicts as one JSON
+ * document; venv_path is null if NULL
+ */
+gboolean export_write_json(ExportWriter* writer, const char* venv_path, Package* packages);
+
+/**
+ * Writes the dependency graph of packages as a Graphviz digraph. Nodes
+ * are named by normalized name, so requirements connect to the package
+ * that satisfies them whatever spelling they use.
+ */
+gboolean export_write_dot(ExportWriter* writer, Package* packages);
+
+#endif // CORE_EXPORT_H
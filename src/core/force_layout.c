@@ -0,0 +1,436 @@
+#include "graph_layout-private.h"
+#include <math.h>
+#include <string.h>
+
+// Force-directed layout after Fruchterman and Reingold: edges pull their
+// ends together, all nodes push each other apart and a cooling step size
+// lets the picture settle. Repulsion between all pairs is approximated
+// with a Barnes-Hut quadtree, so an iteration costs O(n log n), and is
+// split across worker threads. Intermediate positions are published about
+// once per frame so large graphs show up right away.
+
+#define IDEAL_EDGE_LENGTH 150.0
+#define THETA 0.9                 // Cell size / distance below which a cell is one body
+#define GRAVITY 0.5               // Pull towards the centre, keeps components together
+#define COOLING 0.98
+#define MIN_STEP 0.5              // Points; settled once steps are this small
+#define MAX_ITERATIONS 400
+#define QUAD_MAX_DEPTH 24         // Deeper cells lump their bodies together
+#define NODES_PER_WORKER 256
+#define FRAME_INTERVAL_US (G_USEC_PER_SEC / 60)
+
+typedef struct {
+    double cx;                    // Centre of the square
+    double cy;
+    double half;                  // Half the side length
+    double mass;
+    double mx;                    // Mass weighted position sum
+    double my;
+    int child[4];                 // Cell indices, -1 for none
+    int body;                     // The one node in a leaf, or -1
+} QuadCell;
+
+typedef struct {
+    QuadCell* cells;
+    guint n_cells;
+    guint capacity;
+} QuadTree;
+
+typedef struct {
+    guint n;
+    double* x;
+    double* y;
+    double* dx;                   // Displacement of the current iteration
+    double* dy;
+    QuadTree tree;
+
+    // Workers take chunks of nodes for the repulsion pass
+    GThreadPool* pool;
+    GMutex lock;
+    GCond done;
+    guint remaining;
+} ForceState;
+
+typedef struct {
+    ForceState* state;
+    guint start;
+    guint end;
+} ForceChunk;
+
+static int quad_cell_new(QuadTree* tree, double cx, double cy, double half) {
+    if (tree->n_cells == tree->capacity) {
+        tree->capacity = MAX(64, tree->capacity * 2);
+        tree->cells = g_renew(QuadCell, tree->cells, tree->capacity);
+    }
+    QuadCell* cell = &tree->cells[tree->n_cells];
+    *cell = (QuadCell){ cx, cy, half, 0, 0, 0, { -1, -1, -1, -1 }, -1 };
+    return (int)tree->n_cells++;
+}
+
+// Child of c in the quadrant containing (x, y), created on demand
+static int quad_child(QuadTree* tree, int c, double x, double y) {
+    QuadCell* cell = &tree->cells[c];
+    int quadrant = (x >= cell->cx) | ((y >= cell->cy) << 1);
+    if (cell->child[quadrant] < 0) {
+        double half = cell->half / 2;
+        double cx = cell->cx + (quadrant & 1 ? half : -half);
+        double cy = cell->cy + (quadrant & 2 ? half : -half);
+        int child = quad_cell_new(tree, cx, cy, half);
+        // The array may have moved
+        tree->cells[c].child[quadrant] = child;
+    }
+    return tree->cells[c].child[quadrant];
+}
+
+static void quad_add_mass(QuadCell* cell, double x, double y) {
+    cell->mass += 1;
+    cell->mx += x;
+    cell->my += y;
+}
+
+static void quad_insert(QuadTree* tree, const ForceState* state, guint i) {
+    double x = state->x[i];
+    double y = state->y[i];
+    int c = 0;
+    for (guint depth = 0;; depth++) {
+        QuadCell* cell = &tree->cells[c];
+        if (cell->mass == 0) {
+            cell->body = (int)i;
+            quad_add_mass(cell, x, y);
+            return;
+        }
+        if (depth == QUAD_MAX_DEPTH) {
+            cell->body = -1;
+            quad_add_mass(cell, x, y);
+            return;
+        }
+
+        // A leaf with one body becomes an inner cell
+        if (cell->body >= 0) {
+            guint b = (guint)cell->body;
+            cell->body = -1;
+            int child = quad_child(tree, c, state->x[b], state->y[b]);
+            tree->cells[child].body = (int)b;
+            quad_add_mass(&tree->cells[child], state->x[b], state->y[b]);
+        }
+        quad_add_mass(&tree->cells[c], x, y);
+        c = quad_child(tree, c, x, y);
+    }
+}
+
+static void quad_build(ForceState* state) {
+    double min_x = INFINITY, min_y = INFINITY;
+    double max_x = -INFINITY, max_y = -INFINITY;
+    for (guint i = 0; i < state->n; i++) {
+        min_x = MIN(min_x, state->x[i]);
+        max_x = MAX(max_x, state->x[i]);
+        min_y = MIN(min_y, state->y[i]);
+        max_y = MAX(max_y, state->y[i]);
+    }
+
+    QuadTree* tree = &state->tree;
+    tree->n_cells = 0;
+    double half = MAX(max_x - min_x, max_y - min_y) / 2 + 1;
+    quad_cell_new(tree, (min_x + max_x) / 2, (min_y + max_y) / 2, half);
+    for (guint i = 0; i < state->n; i++) {
+        quad_insert(tree, state, i);
+    }
+}
+
+// Repulsion k^2 / d on node i from everything in the tree
+static void repel(ForceState* state, guint i) {
+    const QuadCell* cells = state->tree.cells;
+    const double k2 = IDEAL_EDGE_LENGTH * IDEAL_EDGE_LENGTH;
+    double x = state->x[i];
+    double y = state->y[i];
+    double fx = 0, fy = 0;
+
+    int stack[4 * QUAD_MAX_DEPTH + 4];
+    guint depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        const QuadCell* cell = &cells[stack[--depth]];
+        if (cell->body == (int)i) continue;
+
+        double ox = x - cell->mx / cell->mass;
+        double oy = y - cell->my / cell->mass;
+        double d2 = ox * ox + oy * oy;
+        gboolean leaf = cell->child[0] < 0 && cell->child[1] < 0 &&
+                        cell->child[2] < 0 && cell->child[3] < 0;
+        if (!leaf && 4 * cell->half * cell->half >= THETA * THETA * d2) {
+            for (int q = 0; q < 4; q++) {
+                if (cell->child[q] >= 0) stack[depth++] = cell->child[q];
+            }
+            continue;
+        }
+
+        // Coincident nodes are pushed apart in a direction fixed by index
+        double mass = cell->mass;
+        if (d2 < 1e-2) {
+            if (cell->body < 0) mass -= 1;  // Lumped leaf that includes i
+            ox = cos(i);
+            oy = sin(i);
+            d2 = 1;
+        }
+        fx += ox / d2 * k2 * mass;
+        fy += oy / d2 * k2 * mass;
+    }
+
+    state->dx[i] = fx;
+    state->dy[i] = fy;
+}
+
+static void repel_range(ForceState* state, guint start, guint end) {
+    for (guint i = start; i < end; i++) {
+        repel(state, i);
+    }
+}
+
+static void repel_chunk(gpointer data, gpointer user_data G_GNUC_UNUSED) {
+    ForceChunk* chunk = data;
+    ForceState* state = chunk->state;
+    repel_range(state, chunk->start, chunk->end);
+
+    g_mutex_lock(&state->lock);
+    if (--state->remaining == 0) {
+        g_cond_signal(&state->done);
+    }
+    g_mutex_unlock(&state->lock);
+}
+
+static void repel_all(ForceState* state, ForceChunk* chunks, guint n_chunks) {
+    if (!state->pool) {
+        repel_range(state, 0, state->n);
+        return;
+    }
+
+    state->remaining = n_chunks;
+    for (guint c = 0; c < n_chunks; c++) {
+        g_thread_pool_push(state->pool, &chunks[c], NULL);
+    }
+    g_mutex_lock(&state->lock);
+    while (state->remaining > 0) {
+        g_cond_wait(&state->done, &state->lock);
+    }
+    g_mutex_unlock(&state->lock);
+}
+
+// Attraction d^2 / k along edges and a pull towards the centre
+static void attract(ForceState* state, LayoutRequest* request) {
+    for (guint e = 0; e < request->edges->len; e++) {
+        EdgeKey* edge = &g_array_index(request->edges, EdgeKey, e);
+        if (edge->from == edge->to) continue;
+
+        double ox = state->x[edge->to] - state->x[edge->from];
+        double oy = state->y[edge->to] - state->y[edge->from];
+        double d = sqrt(ox * ox + oy * oy);
+        double f = d / IDEAL_EDGE_LENGTH;
+        state->dx[edge->from] += ox * f;
+        state->dy[edge->from] += oy * f;
+        state->dx[edge->to] -= ox * f;
+        state->dy[edge->to] -= oy * f;
+    }
+
+    double cx = 0, cy = 0;
+    for (guint i = 0; i < state->n; i++) {
+        cx += state->x[i];
+        cy += state->y[i];
+    }
+    cx /= state->n;
+    cy /= state->n;
+    for (guint i = 0; i < state->n; i++) {
+        state->dx[i] -= GRAVITY * (state->x[i] - cx);
+        state->dy[i] -= GRAVITY * (state->y[i] - cy);
+    }
+}
+
+// Moves every node along its displacement, by at most step
+// @return Largest distance moved
+static double move_nodes(ForceState* state, double step) {
+    double largest = 0;
+    for (guint i = 0; i < state->n; i++) {
+        double d = sqrt(state->dx[i] * state->dx[i] + state->dy[i] * state->dy[i]);
+        if (d < 1e-9) continue;
+
+        double move = MIN(d, step);
+        state->x[i] += state->dx[i] / d * move;
+        state->y[i] += state->dy[i] / d * move;
+        largest = MAX(largest, move);
+    }
+    return largest;
+}
+
+// Nodes from the previous layout start where they were. New nodes start
+// next to their placed neighbours, or on a sunflower spiral around the
+// centre, so the result only depends on the graph.
+// @return Number of nodes placed from the previous layout
+static guint initial_positions(ForceState* state, LayoutRequest* request) {
+    gboolean* placed = g_new0(gboolean, state->n);
+    guint n_known = 0;
+
+    GraphLayout* previous = request->previous;
+    if (previous) {
+        GHashTable* prev_index = g_hash_table_new(g_str_hash, g_str_equal);
+        for (guint i = 0; i < previous->n_nodes; i++) {
+            g_hash_table_insert(prev_index, previous->nodes[i].name, &previous->nodes[i]);
+        }
+        for (guint i = 0; i < state->n; i++) {
+            LayoutNode* node = g_hash_table_lookup(prev_index,
+                                                   g_ptr_array_index(request->names, i));
+            if (!node) continue;
+            state->x[i] = node->x;
+            state->y[i] = node->y;
+            placed[i] = TRUE;
+            n_known++;
+        }
+        g_hash_table_unref(prev_index);
+    }
+
+    double cx = 0, cy = 0;
+    for (guint i = 0; i < state->n; i++) {
+        if (!placed[i]) continue;
+        cx += state->x[i] / n_known;
+        cy += state->y[i] / n_known;
+    }
+
+    // Sum and count of placed neighbours
+    double* sum_x = g_new0(double, state->n);
+    double* sum_y = g_new0(double, state->n);
+    guint* count = g_new0(guint, state->n);
+    for (guint e = 0; e < request->edges->len; e++) {
+        EdgeKey* edge = &g_array_index(request->edges, EdgeKey, e);
+        if (placed[edge->from] && !placed[edge->to]) {
+            sum_x[edge->to] += state->x[edge->from];
+            sum_y[edge->to] += state->y[edge->from];
+            count[edge->to]++;
+        } else if (placed[edge->to] && !placed[edge->from]) {
+            sum_x[edge->from] += state->x[edge->to];
+            sum_y[edge->from] += state->y[edge->to];
+            count[edge->from]++;
+        }
+    }
+
+    const double golden_angle = M_PI * (3 - sqrt(5));
+    for (guint i = 0; i < state->n; i++) {
+        if (placed[i]) continue;
+
+        double angle = i * golden_angle;
+        if (count[i] > 0) {
+            state->x[i] = sum_x[i] / count[i] + IDEAL_EDGE_LENGTH / 2 * cos(angle);
+            state->y[i] = sum_y[i] / count[i] + IDEAL_EDGE_LENGTH / 2 * sin(angle);
+        } else {
+            double radius = IDEAL_EDGE_LENGTH / 2 * sqrt(i + 1);
+            state->x[i] = cx + radius * cos(angle);
+            state->y[i] = cy + radius * sin(angle);
+        }
+    }
+
+    g_free(placed);
+    g_free(sum_x);
+    g_free(sum_y);
+    g_free(count);
+    return n_known;
+}
+
+// Snapshot of the current positions, moved so the bounding box starts at 0
+static GraphLayout* build_layout(ForceState* state, LayoutRequest* request) {
+    GraphLayout* layout = graph_layout_new_for_request(request);
+
+    double min_x = INFINITY, min_y = INFINITY;
+    for (guint i = 0; i < state->n; i++) {
+        LayoutNode* node = &layout->nodes[i];
+        node->width = graph_layout_node_width(request, i);
+        node->height = LAYOUT_NODE_HEIGHT;
+        min_x = MIN(min_x, state->x[i] - node->width / 2);
+        min_y = MIN(min_y, state->y[i] - node->height / 2);
+    }
+    for (guint i = 0; i < state->n; i++) {
+        LayoutNode* node = &layout->nodes[i];
+        node->x = state->x[i] - min_x;
+        node->y = state->y[i] - min_y;
+        layout->width = MAX(layout->width, node->x + node->width / 2);
+        layout->height = MAX(layout->height, node->y + node->height / 2);
+    }
+
+    // Straight lines between centres; nodes are drawn over the ends
+    for (guint e = 0; e < layout->n_edges; e++) {
+        LayoutEdge* edge = &layout->edges[e];
+        if (edge->from == edge->to) continue;
+
+        const LayoutNode* a = &layout->nodes[edge->from];
+        const LayoutNode* b = &layout->nodes[edge->to];
+        edge->n_points = 4;
+        edge->points = g_new(double, 8);
+        for (guint p = 0; p < 4; p++) {
+            edge->points[2 * p] = a->x + (b->x - a->x) * p / 3;
+            edge->points[2 * p + 1] = a->y + (b->y - a->y) * p / 3;
+        }
+    }
+    return layout;
+}
+
+GraphLayout* force_layout_compute(LayoutRequest* request, GCancellable* cancellable) {
+    ForceState state = { 0 };
+    state.n = request->names->len;
+    if (state.n == 0) {
+        return graph_layout_new_for_request(request);
+    }
+
+    state.x = g_new(double, state.n);
+    state.y = g_new(double, state.n);
+    state.dx = g_new(double, state.n);
+    state.dy = g_new(double, state.n);
+    g_mutex_init(&state.lock);
+    g_cond_init(&state.done);
+
+    guint n_chunks = MIN(g_get_num_processors(), (state.n + NODES_PER_WORKER - 1) / NODES_PER_WORKER);
+    n_chunks = MAX(n_chunks, 1);
+    ForceChunk* chunks = g_new(ForceChunk, n_chunks);
+    for (guint c = 0; c < n_chunks; c++) {
+        chunks[c] = (ForceChunk){ &state, state.n * c / n_chunks, state.n * (c + 1) / n_chunks };
+    }
+    if (n_chunks > 1) {
+        state.pool = g_thread_pool_new(repel_chunk, NULL, (int)n_chunks, TRUE, NULL);
+    }
+
+    // A graph that was laid out before only needs to settle its changes
+    guint n_known = initial_positions(&state, request);
+    double step = IDEAL_EDGE_LENGTH * (n_known == state.n ? 0.1 : 1.0) *
+                  sqrt((double)(state.n - n_known) + 1);
+
+    gint64 last_publish = g_get_monotonic_time();
+    gboolean cancelled = FALSE;
+    for (guint iteration = 0; iteration < MAX_ITERATIONS && step >= MIN_STEP; iteration++) {
+        if (g_cancellable_is_cancelled(cancellable)) {
+            cancelled = TRUE;
+            break;
+        }
+
+        quad_build(&state);
+        repel_all(&state, chunks, n_chunks);
+        attract(&state, request);
+        if (move_nodes(&state, step) < MIN_STEP) break;
+        step *= COOLING;
+
+        gint64 now = g_get_monotonic_time();
+        if (request->progress && now - last_publish >= FRAME_INTERVAL_US) {
+            graph_layout_publish(request, build_layout(&state, request));
+            last_publish = now;
+        }
+    }
+
+    GraphLayout* layout = cancelled ? NULL : build_layout(&state, request);
+
+    if (state.pool) {
+        g_thread_pool_free(state.pool, FALSE, TRUE);
+    }
+    g_free(chunks);
+    g_cond_clear(&state.done);
+    g_mutex_clear(&state.lock);
+    g_free(state.tree.cells);
+    g_free(state.x);
+    g_free(state.y);
+    g_free(state.dx);
+    g_free(state.dy);
+    return layout;
+}
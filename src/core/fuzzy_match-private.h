@@ -0,0 +1,24 @@
+#ifndef FUZZY_MATCH_PRIVATE_H
+#define FUZZY_MATCH_PRIVATE_H
+
+#include "fuzzy_match.h"
+
+// Implementations of the mask prefilter. They must all give the same
+// candidates; the tests run each one the CPU supports against the scalar
+// loop.
+typedef enum {
+    FUZZY_PREFILTER_BEST,  // Fastest the CPU supports
+    FUZZY_PREFILTER_SCALAR,
+    FUZZY_PREFILTER_SSE2,
+    FUZZY_PREFILTER_AVX2,
+} FuzzyPrefilter;
+
+gboolean fuzzy_prefilter_supported(FuzzyPrefilter kind);
+
+/**
+ * fuzzy_index_search with a given prefilter, which must be supported
+ */
+void fuzzy_index_search_with(const FuzzyIndex* index, FuzzyPrefilter kind,
+                             const char* query, GArray* matches);
+
+#endif // FUZZY_MATCH_PRIVATE_H
@@ -0,0 +1,291 @@
+#include "fuzzy_match-private.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FUZZY_X86 1
+#endif
+
+// A matched character scores SCORE_MATCH plus bonuses for where it is;
+// gaps between matched characters cost a penalty per skipped character
+#define SCORE_MATCH 16
+#define BONUS_START 12        // First character of the name
+#define BONUS_BOUNDARY 8      // First character after a separator
+#define BONUS_CONSECUTIVE 6   // Directly after the previous match
+#define PENALTY_GAP_START 3
+#define PENALTY_GAP 1
+
+// Up to this many best matches are selected rather than sorted
+#define FUZZY_SELECT_MAX 8
+
+struct _FuzzyIndex {
+    GByteArray* names;  // Folded names, NUL-terminated, back to back
+    GArray* offsets;    // guint32 start of each name in names
+    GArray* lengths;    // guint32 length of each name
+    GArray* masks;      // guint64 characters each name contains
+};
+
+// Letters and digits get a bit each, everything else shares the rest
+static guint64 char_bit(guchar c) {
+    if (c >= 'a' && c <= 'z') return G_GUINT64_CONSTANT(1) << (c - 'a');
+    if (c >= '0' && c <= '9') return G_GUINT64_CONSTANT(1) << (26 + c - '0');
+    return G_GUINT64_CONSTANT(1) << (36 + c % 28);
+}
+
+static gboolean is_separator(char c) {
+    return c == '-' || c == '_' || c == '.' || c == ' ';
+}
+
+FuzzyIndex* fuzzy_index_new(void) {
+    FuzzyIndex* index = g_new0(FuzzyIndex, 1);
+    index->names = g_byte_array_new();
+    index->offsets = g_array_new(FALSE, FALSE, sizeof(guint32));
+    index->lengths = g_array_new(FALSE, FALSE, sizeof(guint32));
+    index->masks = g_array_new(FALSE, FALSE, sizeof(guint64));
+    return index;
+}
+
+void fuzzy_index_free(FuzzyIndex* index) {
+    if (!index) return;
+
+    g_byte_array_unref(index->names);
+    g_array_unref(index->offsets);
+    g_array_unref(index->lengths);
+    g_array_unref(index->masks);
+    g_free(index);
+}
+
+guint fuzzy_index_add(FuzzyIndex* index, const char* name) {
+    guint32 offset = index->names->len;
+    guint32 length = strlen(name);
+    guint64 mask = 0;
+
+    g_byte_array_set_size(index->names, offset + length + 1);
+    char* folded = (char*)index->names->data + offset;
+    for (guint32 i = 0; i < length; i++) {
+        folded[i] = g_ascii_tolower(name[i]);
+        mask |= char_bit(folded[i]);
+    }
+    folded[length] = '\0';
+
+    g_array_append_val(index->offsets, offset);
+    g_array_append_val(index->lengths, length);
+    g_array_append_val(index->masks, mask);
+    return index->offsets->len - 1;
+}
+
+guint fuzzy_index_get_size(const FuzzyIndex* index) {
+    return index->offsets->len;
+}
+
+const char* fuzzy_index_get_name(const FuzzyIndex* index, guint i) {
+    g_return_val_if_fail(i < index->offsets->len, NULL);
+    return (const char*)index->names->data + g_array_index(index->offsets, guint32, i);
+}
+
+// Writes the index of every mask containing all of want's bits to out
+static guint prefilter_scalar(const guint64* masks, guint start, guint n,
+                              guint64 want, guint32* out, guint n_out) {
+    for (guint i = start; i < n; i++) {
+        out[n_out] = i;
+        n_out += (masks[i] & want) == want;
+    }
+    return n_out;
+}
+
+#ifdef FUZZY_X86
+// Without a 64-bit compare, a mask passes when both of its 32-bit halves do
+__attribute__((target("sse2")))
+static guint prefilter_sse2(const guint64* masks, guint n, guint64 want, guint32* out) {
+    __m128i wanted = _mm_set1_epi64x((long long)want);
+    guint n_out = 0;
+    guint i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i m = _mm_loadu_si128((const __m128i*)&masks[i]);
+        int equal = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(m, wanted), wanted));
+        out[n_out] = i;
+        n_out += (equal & 0xff) == 0xff;
+        out[n_out] = i + 1;
+        n_out += (equal >> 8) == 0xff;
+    }
+    return prefilter_scalar(masks, i, n, want, out, n_out);
+}
+
+__attribute__((target("avx2")))
+static guint prefilter_avx2(const guint64* masks, guint n, guint64 want, guint32* out) {
+    __m256i wanted = _mm256_set1_epi64x((long long)want);
+    guint n_out = 0;
+    guint i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i m = _mm256_loadu_si256((const __m256i*)&masks[i]);
+        __m256i equal = _mm256_cmpeq_epi64(_mm256_and_si256(m, wanted), wanted);
+        int passed = _mm256_movemask_pd(_mm256_castsi256_pd(equal));
+        while (passed) {
+            out[n_out++] = i + __builtin_ctz(passed);
+            passed &= passed - 1;
+        }
+    }
+    return prefilter_scalar(masks, i, n, want, out, n_out);
+}
+#endif
+
+gboolean fuzzy_prefilter_supported(FuzzyPrefilter kind) {
+    switch (kind) {
+    case FUZZY_PREFILTER_BEST:
+    case FUZZY_PREFILTER_SCALAR:
+        return TRUE;
+#ifdef FUZZY_X86
+    case FUZZY_PREFILTER_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case FUZZY_PREFILTER_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return FALSE;
+    }
+}
+
+static guint prefilter(FuzzyPrefilter kind, const guint64* masks, guint n, guint64 want,
+                       guint32* out) {
+#ifdef FUZZY_X86
+    if (kind == FUZZY_PREFILTER_BEST) {
+        kind = __builtin_cpu_supports("avx2") ? FUZZY_PREFILTER_AVX2 :
+                    __builtin_cpu_supports("sse2") ? FUZZY_PREFILTER_SSE2 :
+                    FUZZY_PREFILTER_SCALAR;
+    }
+    if (kind == FUZZY_PREFILTER_AVX2) return prefilter_avx2(masks, n, want, out);
+    if (kind == FUZZY_PREFILTER_SSE2) return prefilter_sse2(masks, n, want, out);
+#endif
+    return prefilter_scalar(masks, 0, n, want, out, 0);
+}
+
+static int score_window(const char* name, const char* start, const char* end,
+                        const char* query) {
+    int total = 0;
+    const char* last = NULL;
+    guint q = 0;
+    for (const char* c = start; c < end && query[q]; c++) {
+        if (*c != query[q]) continue;
+
+        total += SCORE_MATCH;
+        if (c == name) {
+            total += BONUS_START;
+        } else if (is_separator(c[-1])) {
+            total += BONUS_BOUNDARY;
+        }
+        if (last && c == last + 1) {
+            total += BONUS_CONSECUTIVE;
+        } else if (last) {
+            total -= PENALTY_GAP_START + PENALTY_GAP * (int)(c - last - 2);
+        }
+        last = c;
+        q++;
+    }
+    return total;
+}
+
+// Finds where the query first completes as a subsequence and the latest
+// start that still completes there, and scores the query greedily from
+// both that start and the first possible one (fzf's fast mode, which
+// only tries the former, misses start-of-name bonuses)
+static gboolean score_name(const char* name, guint32 length,
+                           const char* query, guint query_length, int* score) {
+    const char* first = memchr(name, query[0], length);
+    if (!first) return FALSE;
+
+    const char* end = first + 1;
+    for (guint q = 1; q < query_length; q++) {
+        end = memchr(end, query[q], name + length - end);
+        if (!end) return FALSE;
+        end++;
+    }
+
+    const char* start = end;
+    for (guint q = query_length; q > 0; q--) {
+        do start--; while (*start != query[q - 1]);
+    }
+
+    *score = score_window(name, start, end, query);
+    if (start != first) {
+        *score = MAX(*score, score_window(name, first, end, query));
+    }
+    return TRUE;
+}
+
+static gint compare_matches(gconstpointer a, gconstpointer b, gpointer user_data) {
+    const FuzzyMatch* x = a;
+    const FuzzyMatch* y = b;
+    const guint32* lengths = user_data;
+
+    if (x->score != y->score) return y->score > x->score ? 1 : -1;
+    if (lengths[x->index] != lengths[y->index]) {
+        return lengths[x->index] > lengths[y->index] ? 1 : -1;
+    }
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+void fuzzy_index_search(const FuzzyIndex* index, const char* query, GArray* matches) {
+    fuzzy_index_search_with(index, FUZZY_PREFILTER_BEST, query, matches);
+}
+
+void fuzzy_index_search_with(const FuzzyIndex* index, FuzzyPrefilter kind,
+                             const char* query, GArray* matches) {
+    g_return_if_fail(fuzzy_prefilter_supported(kind));
+    g_array_set_size(matches, 0);
+
+    char* folded = g_ascii_strdown(query, -1);
+    guint query_length = strlen(folded);
+    guint64 want = 0;
+    for (guint q = 0; q < query_length; q++) {
+        want |= char_bit(folded[q]);
+    }
+
+    guint n = index->masks->len;
+    if (query_length == 0 || n == 0) {
+        g_free(folded);
+        return;
+    }
+
+    guint32* candidates = g_new(guint32, n);
+    guint n_candidates = prefilter(kind, (const guint64*)index->masks->data, n, want,
+                                   candidates);
+
+    const guint32* offsets = (const guint32*)index->offsets->data;
+    const guint32* lengths = (const guint32*)index->lengths->data;
+    for (guint c = 0; c < n_candidates; c++) {
+        guint i = candidates[c];
+        FuzzyMatch match = { i, 0 };
+        if (lengths[i] >= query_length &&
+            score_name((const char*)index->names->data + offsets[i], lengths[i],
+                       folded, query_length, &match.score)) {
+            g_array_append_val(matches, match);
+        }
+    }
+    g_free(candidates);
+    g_free(folded);
+}
+
+void fuzzy_index_rank(const FuzzyIndex* index, GArray* matches, guint limit) {
+    gpointer lengths = index->lengths->data;
+
+    // The best few are picked out without sorting the rest
+    if (limit > 0 && limit <= FUZZY_SELECT_MAX && matches->len > limit) {
+        for (guint k = 0; k < limit; k++) {
+            guint best = k;
+            for (guint m = k + 1; m < matches->len; m++) {
+                if (compare_matches(&g_array_index(matches, FuzzyMatch, m),
+                                    &g_array_index(matches, FuzzyMatch, best), lengths) < 0) {
+                    best = m;
+                }
+            }
+            FuzzyMatch swap = g_array_index(matches, FuzzyMatch, k);
+            g_array_index(matches, FuzzyMatch, k) = g_array_index(matches, FuzzyMatch, best);
+            g_array_index(matches, FuzzyMatch, best) = swap;
+        }
+    } else {
+        g_array_sort_with_data(matches, compare_matches, lengths);
+    }
+    if (limit > 0 && matches->len > limit) {
+        g_array_set_size(matches, limit);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef CORE_FUZZY_MATCH_H
+#define CORE_FUZZY_MATCH_H
+
+#include <glib.h>
+
+// Fuzzy matching of short queries against many names, e.g. "grpcst" for
+// grpcio-status. Names are kept case-folded in one contiguous buffer with
+// a bitmask of the characters each contains; a search first drops every
+// name missing one of the query's characters, several masks per
+// instruction where the CPU allows, then checks and scores the query as a
+// subsequence of what is left.
+
+typedef struct _FuzzyIndex FuzzyIndex;
+
+typedef struct {
+    guint index;  // As returned by fuzzy_index_add
+    int score;    // Higher is better
+} FuzzyMatch;
+
+FuzzyIndex* fuzzy_index_new(void);
+void fuzzy_index_free(FuzzyIndex* index);
+
+/**
+ * Adds a name, matched case-insensitively
+ * @return Index of the name, counting from 0 in order of adding
+ */
+guint fuzzy_index_add(FuzzyIndex* index, const char* name);
+
+guint fuzzy_index_get_size(const FuzzyIndex* index);
+
+/**
+ * @return The name at index as added, lowercased
+ */
+const char* fuzzy_index_get_name(const FuzzyIndex* index, guint i);
+
+/**
+ * Replaces matches with the FuzzyMatch of every name containing the
+ * query's characters in order, in index order
+ */
+void fuzzy_index_search(const FuzzyIndex* index, const char* query, GArray* matches);
+
+/**
+ * Orders matches from fuzzy_index_search best first, ties going to
+ * shorter names, and drops all but the first limit
+ * @param limit Matches to keep, or 0 for all
+ */
+void fuzzy_index_rank(const FuzzyIndex* index, GArray* matches, guint limit);
+
+#endif // CORE_FUZZY_MATCH_H
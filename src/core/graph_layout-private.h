@@ -0,0 +1,89 @@
+#ifndef GRAPH_LAYOUT_PRIVATE_H
+#define GRAPH_LAYOUT_PRIVATE_H
+
+#include "graph_layout.h"
+
+// Node boxes for the built-in engines, in points
+#define LAYOUT_NODE_HEIGHT 36.0
+#define LAYOUT_NODE_MIN_WIDTH 54.0
+#define LAYOUT_LABEL_PADDING 18.0
+
+typedef struct {
+    guint from;
+    guint to;
+    guint count;            // See LayoutEdge
+} EdgeKey;
+
+// Copy of the graph taken on the main thread for the worker. Nodes are
+// sorted by name and edges by node index, so an unchanged environment
+// always gives the same request, key and layout.
+typedef struct {
+    GPtrArray* names;       // Unique package names, index = node index
+    GArray* conflicts;      // gboolean per node
+    GArray* hidden;         // guint per node, see LayoutNode
+    GArray* members;        // guint per node, see LayoutNode
+    GPtrArray* groups;      // Group name per node or NULL, see LayoutNode
+    GArray* edges;          // EdgeKey
+    GArray* widths;         // double per node, measured on the worker
+    GraphLayoutEngine engine;
+    GraphLayout* previous;  // Layout currently shown, or NULL
+    char* key;              // Hash of engine, names and edges
+
+    // Intermediate layouts, see graph_layout_publish
+    GTask* task;            // Not owned; the task owns the request
+    GraphLayoutProgressFunc progress;
+    gpointer progress_data;
+    GMutex progress_lock;
+    GraphLayout* pending;   // Published but not yet delivered
+} LayoutRequest;
+
+/**
+ * Allocates a layout for request with names, flags and edge ends filled in
+ * and everything else zeroed
+ */
+GraphLayout* graph_layout_new_for_request(LayoutRequest* request);
+
+/**
+ * Builds layout->index; done on the worker before a layout is handed out
+ */
+void graph_layout_build_index(GraphLayout* layout);
+void graph_layout_index_free(GraphLayoutIndex* index);
+
+/**
+ * Width of the box for a node's label, from the text as shaped with
+ * GRAPH_LAYOUT_FONT. Only valid on the worker once labels were measured.
+ */
+double graph_layout_node_width(LayoutRequest* request, guint node);
+
+/**
+ * Hands an intermediate layout to the caller's progress function on its
+ * main context, taking ownership of layout. Layouts published faster than
+ * the main context picks them up replace each other. Does nothing but
+ * free layout if no progress function was given.
+ */
+void graph_layout_publish(LayoutRequest* request, GraphLayout* layout);
+
+/**
+ * Sugiyama-style layered layout (see layered_layout.c)
+ * @return New layout or NULL if cancelled
+ */
+GraphLayout* layered_layout_compute(LayoutRequest* request, GCancellable* cancellable);
+
+/**
+ * Crossings between the segments joining two ranks, counted as
+ * inversions with a Fenwick tree (Barth, Jünger and Mutzel)
+ * @param ends Position in the lower rank of each segment's end, by
+ *             position of the upper end and then of the lower one
+ * @param n_lower Nodes in the lower rank; tree needs n_lower + 1 entries
+ */
+guint64 layered_layout_count_crossings(const guint* ends, guint n_ends, guint n_lower,
+                                       guint* tree);
+
+/**
+ * Force-directed layout with Barnes-Hut repulsion (see force_layout.c).
+ * Publishes intermediate layouts while it settles.
+ * @return New layout or NULL if cancelled
+ */
+GraphLayout* force_layout_compute(LayoutRequest* request, GCancellable* cancellable);
+
+#endif // GRAPH_LAYOUT_PRIVATE_H
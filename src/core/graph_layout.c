@@ -0,0 +1,927 @@
+#include "graph_layout-private.h"
+#include "requirement_owners.h"
+#include <graphviz/gvc.h>
+#include <glib/gstdio.h>
+#include <pango/pangocairo.h>
+#include <string.h>
+
+// Graphviz keeps global layout state, so layouts run one at a time
+static GMutex graphviz_lock;
+static GVC_t* graphviz_context;
+
+// Bump when the layout parameters or the cache format change
+#define LAYOUT_CACHE_VERSION 5
+#define LAYOUT_CACHE_TYPE "(udda(ddddi)a(uuad))"
+// Least recently used layouts are removed past this total size
+#define LAYOUT_CACHE_MAX_BYTES (32 * 1024 * 1024)
+
+// Serializes pruning between layout threads
+static GMutex layout_cache_lock;
+
+static void layout_request_free(gpointer data) {
+    LayoutRequest* request = data;
+    g_ptr_array_unref(request->names);
+    g_array_free(request->conflicts, TRUE);
+    g_array_free(request->hidden, TRUE);
+    g_array_free(request->members, TRUE);
+    g_ptr_array_unref(request->groups);
+    g_array_free(request->edges, TRUE);
+    if (request->widths) {
+        g_array_free(request->widths, TRUE);
+    }
+    if (request->previous) {
+        graph_layout_unref(request->previous);
+    }
+    if (request->pending) {
+        graph_layout_unref(request->pending);
+    }
+    g_mutex_clear(&request->progress_lock);
+    g_free(request->key);
+    g_free(request);
+}
+
+static gint compare_names(gconstpointer a, gconstpointer b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static gint compare_edges(gconstpointer a, gconstpointer b) {
+    const EdgeKey* x = a;
+    const EdgeKey* y = b;
+    if (x->from != y->from) return x->from < y->from ? -1 : 1;
+    return (x->to > y->to) - (x->to < y->to);
+}
+
+static void checksum_update_u32(GChecksum* checksum, guint32 value) {
+    guint32 le = GUINT32_TO_LE(value);
+    g_checksum_update(checksum, (const guchar*)&le, sizeof(le));
+}
+
+// Conflict flags and edge counts only change how the layout is drawn,
+// so they are not part of the key
+static char* layout_request_key(LayoutRequest* request) {
+    GChecksum* checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    checksum_update_u32(checksum, LAYOUT_CACHE_VERSION);
+    checksum_update_u32(checksum, request->engine);
+    checksum_update_u32(checksum, request->names->len);
+    checksum_update_u32(checksum, request->edges->len);
+
+    for (guint i = 0; i < request->names->len; i++) {
+        const char* name = g_ptr_array_index(request->names, i);
+        g_checksum_update(checksum, (const guchar*)name, strlen(name) + 1);
+        checksum_update_u32(checksum, g_array_index(request->hidden, guint, i));
+        checksum_update_u32(checksum, g_array_index(request->members, guint, i));
+    }
+    for (guint i = 0; i < request->edges->len; i++) {
+        EdgeKey* edge = &g_array_index(request->edges, EdgeKey, i);
+        checksum_update_u32(checksum, edge->from);
+        checksum_update_u32(checksum, edge->to);
+    }
+
+    char* key = g_strdup(g_checksum_get_string(checksum));
+    g_checksum_free(checksum);
+    return key;
+}
+
+// Every package by name; the first of duplicate names wins
+static GHashTable* index_packages(Package* packages) {
+    GHashTable* by_name = g_hash_table_new(g_str_hash, g_str_equal);
+    for (Package* pkg = packages; pkg; pkg = pkg->next) {
+        if (!g_hash_table_contains(by_name, pkg->name)) {
+            g_hash_table_insert(by_name, pkg->name, pkg);
+        }
+    }
+    return by_name;
+}
+
+// Installed packages that depend on each package, by name
+static GHashTable* index_dependents(Package* packages, GHashTable* by_name) {
+    GHashTable* dependents = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                                   (GDestroyNotify)g_ptr_array_unref);
+    for (Package* pkg = packages; pkg; pkg = pkg->next) {
+        if (g_hash_table_lookup(by_name, pkg->name) != pkg) continue;
+
+        for (PackageDep* dep = pkg->dependencies; dep; dep = dep->next) {
+            Package* target = g_hash_table_lookup(by_name, dep->name);
+            if (!target) continue;
+
+            GPtrArray* list = g_hash_table_lookup(dependents, target->name);
+            if (!list) {
+                list = g_ptr_array_new();
+                g_hash_table_insert(dependents, target->name, list);
+            }
+            g_ptr_array_add(list, pkg);
+        }
+    }
+    return dependents;
+}
+
+// Calls func on every installed package pkg depends on or is a dependency of
+static void foreach_neighbour(Package* pkg, GHashTable* by_name, GHashTable* dependents,
+                              void (*func)(Package* neighbour, gpointer data), gpointer data) {
+    for (PackageDep* dep = pkg->dependencies; dep; dep = dep->next) {
+        Package* target = g_hash_table_lookup(by_name, dep->name);
+        if (target) func(target, data);
+    }
+    GPtrArray* list = g_hash_table_lookup(dependents, pkg->name);
+    for (guint i = 0; list && i < list->len; i++) {
+        func(g_ptr_array_index(list, i), data);
+    }
+}
+
+typedef struct {
+    GHashTable* included;   // name -> Package*
+    GQueue* queue;          // Package* reached but not yet followed
+    GHashTable* expanded;   // Only these are followed, if set
+    GHashTable* outside;    // Names of neighbours left out, for counting
+} FocusWalk;
+
+static void visit_neighbour(Package* neighbour, gpointer data) {
+    FocusWalk* walk = data;
+    if (g_hash_table_contains(walk->included, neighbour->name)) return;
+
+    g_hash_table_insert(walk->included, neighbour->name, neighbour);
+    if (!walk->expanded || g_hash_table_contains(walk->expanded, neighbour->name)) {
+        g_queue_push_tail(walk->queue, neighbour);
+    }
+}
+
+static void count_outside(Package* neighbour, gpointer data) {
+    FocusWalk* walk = data;
+    if (!g_hash_table_contains(walk->included, neighbour->name)) {
+        g_hash_table_add(walk->outside, neighbour->name);
+    }
+}
+
+// Breadth first walk from the focus package up to focus->hops edges in
+// either direction, then on through the expanded packages it reached.
+// Only the neighbourhood is visited, apart from building the indexes.
+// @return name -> Package* of the included packages
+static GHashTable* focus_packages(GHashTable* by_name, GHashTable* dependents,
+                                  const GraphLayoutFocus* focus) {
+    FocusWalk walk = { 0 };
+    walk.included = g_hash_table_new(g_str_hash, g_str_equal);
+    walk.queue = g_queue_new();
+
+    Package* centre = g_hash_table_lookup(by_name, focus->package);
+    if (centre) {
+        g_hash_table_insert(walk.included, centre->name, centre);
+        g_queue_push_tail(walk.queue, centre);
+    }
+
+    for (guint hop = 0; hop < focus->hops && !g_queue_is_empty(walk.queue); hop++) {
+        for (guint n = g_queue_get_length(walk.queue); n > 0; n--) {
+            foreach_neighbour(g_queue_pop_head(walk.queue), by_name, dependents,
+                              visit_neighbour, &walk);
+        }
+    }
+    g_queue_clear(walk.queue);
+
+    // Expanded packages show all their neighbours, which may be expanded too
+    if (focus->expanded) {
+        GList* reached = g_hash_table_get_values(walk.included);
+        for (GList* l = reached; l; l = l->next) {
+            Package* pkg = l->data;
+            if (g_hash_table_contains(focus->expanded, pkg->name)) {
+                g_queue_push_tail(walk.queue, pkg);
+            }
+        }
+        g_list_free(reached);
+
+        walk.expanded = focus->expanded;
+        while (!g_queue_is_empty(walk.queue)) {
+            foreach_neighbour(g_queue_pop_head(walk.queue), by_name, dependents,
+                              visit_neighbour, &walk);
+        }
+    }
+
+    g_queue_free(walk.queue);
+    return walk.included;
+}
+
+// Names the group of every package that has a separator in its name
+// after the first segment, "google-cloud-storage" -> "google-*"
+static void prefix_groups(LayoutRequest* request, char** groups) {
+    for (guint i = 0; i < request->names->len; i++) {
+        const char* name = g_ptr_array_index(request->names, i);
+        if (g_array_index(request->hidden, guint, i) > 0) continue;
+
+        size_t length = strcspn(name, "-_.");
+        if (length > 0 && name[length] != '\0') {
+            groups[i] = g_strdup_printf("%.*s-*", (int)length, name);
+        }
+    }
+}
+
+// Names the group of every package only one top-level requirement (a
+// package nothing shown depends on) leads to after that requirement.
+// Stubs take no part.
+static void requirement_groups(LayoutRequest* request, char** groups) {
+    guint n_nodes = request->names->len;
+    gboolean* stubs = g_new(gboolean, MAX(n_nodes, 1));
+    for (guint i = 0; i < n_nodes; i++) {
+        stubs[i] = g_array_index(request->hidden, guint, i) > 0;
+    }
+    guint* owner = requirement_owners_find(n_nodes, request->edges, stubs);
+
+    for (guint i = 0; i < n_nodes; i++) {
+        if (owner[i] < n_nodes) {
+            groups[i] = g_strdup(g_ptr_array_index(request->names, owner[i]));
+        }
+    }
+    g_free(owner);
+    g_free(stubs);
+}
+
+// Replaces the members of every collapsed group with one node. Groups of
+// a single package are left alone. Edges that end up joining the same
+// nodes merge, adding up their counts, and edges inside a group go.
+static void group_request(LayoutRequest* request, const GraphLayoutGroups* groups) {
+    guint n_nodes = request->names->len;
+    char** keys = g_new0(char*, n_nodes);
+    if (groups->by == GRAPH_LAYOUT_GROUP_BY_PREFIX) {
+        prefix_groups(request, keys);
+    } else {
+        requirement_groups(request, keys);
+    }
+
+    // group name -> member count
+    GHashTable* sizes = g_hash_table_new(g_str_hash, g_str_equal);
+    for (guint i = 0; i < n_nodes; i++) {
+        if (!keys[i]) continue;
+        guint size = GPOINTER_TO_UINT(g_hash_table_lookup(sizes, keys[i]));
+        g_hash_table_insert(sizes, keys[i], GUINT_TO_POINTER(size + 1));
+    }
+
+    // New node names; collapsed members all become their group's node
+    GPtrArray* names = g_ptr_array_new_with_free_func(g_free);
+    char** node_names = g_new(char*, n_nodes);
+    GHashTable* group_nodes = g_hash_table_new(g_str_hash, g_str_equal);
+    for (guint i = 0; i < n_nodes; i++) {
+        node_names[i] = g_ptr_array_index(request->names, i);
+        if (!keys[i]) continue;
+        if (GPOINTER_TO_UINT(g_hash_table_lookup(sizes, keys[i])) < 2) {
+            g_clear_pointer(&keys[i], g_free);
+            continue;
+        }
+        if (groups->expanded && g_hash_table_contains(groups->expanded, keys[i])) continue;
+
+        char* group_node = g_hash_table_lookup(group_nodes, keys[i]);
+        if (!group_node) {
+            group_node = g_strconcat(GRAPH_LAYOUT_GROUP_PREFIX, keys[i], NULL);
+            g_hash_table_insert(group_nodes, keys[i], group_node);
+            g_ptr_array_add(names, group_node);
+        }
+        node_names[i] = group_node;
+    }
+    for (guint i = 0; i < n_nodes; i++) {
+        if (node_names[i] == g_ptr_array_index(request->names, i)) {
+            g_ptr_array_add(names, g_strdup(node_names[i]));
+        }
+    }
+    g_ptr_array_sort(names, compare_names);
+
+    // Per new node, merging the flags of collapsed members
+    guint n_grouped = names->len;
+    GArray* conflicts = g_array_sized_new(FALSE, TRUE, sizeof(gboolean), n_grouped);
+    GArray* hidden = g_array_sized_new(FALSE, TRUE, sizeof(guint), n_grouped);
+    GArray* members = g_array_sized_new(FALSE, TRUE, sizeof(guint), n_grouped);
+    g_array_set_size(conflicts, n_grouped);
+    g_array_set_size(hidden, n_grouped);
+    g_array_set_size(members, n_grouped);
+    GPtrArray* group_names = g_ptr_array_new_full(n_grouped, g_free);
+    g_ptr_array_set_size(group_names, n_grouped);
+    GHashTable* index = g_hash_table_new(g_str_hash, g_str_equal);
+    for (guint i = 0; i < n_grouped; i++) {
+        g_hash_table_insert(index, g_ptr_array_index(names, i), GUINT_TO_POINTER(i));
+    }
+
+    guint* map = g_new(guint, n_nodes);
+    for (guint i = 0; i < n_nodes; i++) {
+        guint node = GPOINTER_TO_UINT(g_hash_table_lookup(index, node_names[i]));
+        map[i] = node;
+        g_array_index(conflicts, gboolean, node) |= g_array_index(request->conflicts, gboolean, i);
+        g_array_index(hidden, guint, node) = g_array_index(request->hidden, guint, i);
+        if (node_names[i] != g_ptr_array_index(request->names, i)) {
+            g_array_index(members, guint, node)++;
+        }
+        if (keys[i] && !g_ptr_array_index(group_names, node)) {
+            g_ptr_array_index(group_names, node) = g_strdup(keys[i]);
+        }
+    }
+
+    GArray* edges = g_array_new(FALSE, FALSE, sizeof(EdgeKey));
+    for (guint e = 0; e < request->edges->len; e++) {
+        EdgeKey edge = g_array_index(request->edges, EdgeKey, e);
+        edge.from = map[edge.from];
+        edge.to = map[edge.to];
+        if (edge.from != edge.to) {
+            g_array_append_val(edges, edge);
+        }
+    }
+    g_array_sort(edges, compare_edges);
+    guint n_merged = 0;
+    for (guint e = 0; e < edges->len; e++) {
+        EdgeKey* edge = &g_array_index(edges, EdgeKey, e);
+        EdgeKey* last = n_merged > 0 ? &g_array_index(edges, EdgeKey, n_merged - 1) : NULL;
+        if (last && last->from == edge->from && last->to == edge->to) {
+            last->count += edge->count;
+        } else {
+            g_array_index(edges, EdgeKey, n_merged++) = *edge;
+        }
+    }
+    g_array_set_size(edges, n_merged);
+
+    g_ptr_array_unref(request->names);
+    g_array_free(request->conflicts, TRUE);
+    g_array_free(request->hidden, TRUE);
+    g_array_free(request->members, TRUE);
+    g_ptr_array_unref(request->groups);
+    g_array_free(request->edges, TRUE);
+    request->names = names;
+    request->conflicts = conflicts;
+    request->hidden = hidden;
+    request->members = members;
+    request->groups = group_names;
+    request->edges = edges;
+
+    g_free(map);
+    g_hash_table_unref(index);
+    g_hash_table_unref(group_nodes);
+    g_free(node_names);
+    g_hash_table_unref(sizes);
+    for (guint i = 0; i < n_nodes; i++) {
+        g_free(keys[i]);
+    }
+    g_free(keys);
+}
+
+static LayoutRequest* layout_request_new(Package* packages,
+                                         GraphLayoutEngine engine,
+                                         GraphLayout* previous,
+                                         const GraphLayoutFocus* focus,
+                                         const GraphLayoutGroups* groups) {
+    LayoutRequest* request = g_new0(LayoutRequest, 1);
+    request->names = g_ptr_array_new_with_free_func(g_free);
+    request->conflicts = g_array_new(FALSE, FALSE, sizeof(gboolean));
+    request->hidden = g_array_new(FALSE, FALSE, sizeof(guint));
+    request->members = g_array_new(FALSE, TRUE, sizeof(guint));
+    request->groups = g_ptr_array_new_with_free_func(g_free);
+    request->edges = g_array_new(FALSE, FALSE, sizeof(EdgeKey));
+
+    GHashTable* by_name = index_packages(packages);
+    GHashTable* dependents = NULL;
+    GHashTable* included = by_name;
+    if (focus && focus->package) {
+        dependents = index_dependents(packages, by_name);
+        included = focus_packages(by_name, dependents, focus);
+    }
+
+    // Node names, with a stub for every package whose neighbours are not
+    // all shown; name -> hidden neighbour count
+    GHashTable* hidden = g_hash_table_new(g_str_hash, g_str_equal);
+    FocusWalk walk = { .included = included };
+    if (dependents) {
+        walk.outside = g_hash_table_new(g_str_hash, g_str_equal);
+    }
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, included);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        Package* pkg = value;
+        g_ptr_array_add(request->names, g_strdup(pkg->name));
+        if (!dependents) continue;
+
+        g_hash_table_remove_all(walk.outside);
+        foreach_neighbour(pkg, by_name, dependents, count_outside, &walk);
+        guint n_outside = g_hash_table_size(walk.outside);
+        if (n_outside > 0) {
+            char* stub = g_strconcat(GRAPH_LAYOUT_STUB_PREFIX, pkg->name, NULL);
+            g_hash_table_insert(hidden, stub, GUINT_TO_POINTER(n_outside));
+            g_ptr_array_add(request->names, stub);
+        }
+    }
+
+    // name -> node index + 1 once sorted
+    g_ptr_array_sort(request->names, compare_names);
+    GHashTable* index = g_hash_table_new(g_str_hash, g_str_equal);
+    for (guint i = 0; i < request->names->len; i++) {
+        char* name = g_ptr_array_index(request->names, i);
+        Package* pkg = g_hash_table_lookup(included, name);
+        gboolean conflict = pkg && pkg->conflicts != NULL;
+        guint n_hidden = GPOINTER_TO_UINT(g_hash_table_lookup(hidden, name));
+        g_array_append_val(request->conflicts, conflict);
+        g_array_append_val(request->hidden, n_hidden);
+        g_ptr_array_add(request->groups, NULL);
+        g_hash_table_insert(index, name, GUINT_TO_POINTER(i + 1));
+    }
+
+    // Dependencies that are not installed or not shown have no node to
+    // point at; stubs hang off their package
+    for (guint i = 0; i < request->names->len; i++) {
+        char* name = g_ptr_array_index(request->names, i);
+        if (g_array_index(request->hidden, guint, i) > 0) {
+            const char* owner = name + strlen(GRAPH_LAYOUT_STUB_PREFIX);
+            guint from = GPOINTER_TO_UINT(g_hash_table_lookup(index, owner)) - 1;
+            EdgeKey edge = { from, i, 1 };
+            g_array_append_val(request->edges, edge);
+            continue;
+        }
+
+        Package* pkg = g_hash_table_lookup(included, name);
+        for (PackageDep* dep = pkg->dependencies; dep; dep = dep->next) {
+            guint to = GPOINTER_TO_UINT(g_hash_table_lookup(index, dep->name));
+            if (!to) continue;
+            EdgeKey edge = { i, to - 1, 1 };
+            g_array_append_val(request->edges, edge);
+        }
+    }
+    g_array_sort(request->edges, compare_edges);
+
+    g_hash_table_unref(index);
+    g_hash_table_unref(hidden);
+    if (walk.outside) {
+        g_hash_table_unref(walk.outside);
+    }
+    if (included != by_name) {
+        g_hash_table_unref(included);
+    }
+    if (dependents) {
+        g_hash_table_unref(dependents);
+    }
+    g_hash_table_unref(by_name);
+
+    g_array_set_size(request->members, request->names->len);
+    if (groups && groups->by != GRAPH_LAYOUT_GROUP_BY_NONE) {
+        group_request(request, groups);
+    }
+
+    if (engine == GRAPH_LAYOUT_AUTO) {
+        engine = request->names->len > GRAPH_LAYOUT_AUTO_LIMIT ?
+                 GRAPH_LAYOUT_LAYERED : GRAPH_LAYOUT_DOT;
+    }
+    request->engine = engine;
+    request->previous = previous ? graph_layout_ref(previous) : NULL;
+    request->key = layout_request_key(request);
+    g_mutex_init(&request->progress_lock);
+    return request;
+}
+
+GraphLayout* graph_layout_ref(GraphLayout* layout) {
+    g_atomic_int_inc(&layout->ref_count);
+    return layout;
+}
+
+void graph_layout_unref(GraphLayout* layout) {
+    if (!layout || !g_atomic_int_dec_and_test(&layout->ref_count)) return;
+
+    for (guint i = 0; i < layout->n_nodes; i++) {
+        g_free(layout->nodes[i].name);
+        g_free(layout->nodes[i].group);
+    }
+    for (guint i = 0; i < layout->n_edges; i++) {
+        g_free(layout->edges[i].points);
+    }
+    graph_layout_index_free(layout->index);
+    g_free(layout->nodes);
+    g_free(layout->edges);
+    g_free(layout);
+}
+
+GraphLayout* graph_layout_new_for_request(LayoutRequest* request) {
+    GraphLayout* layout = g_new0(GraphLayout, 1);
+    layout->ref_count = 1;
+
+    layout->n_nodes = request->names->len;
+    layout->nodes = g_new0(LayoutNode, layout->n_nodes);
+    for (guint i = 0; i < layout->n_nodes; i++) {
+        layout->nodes[i].name = g_strdup(g_ptr_array_index(request->names, i));
+        layout->nodes[i].conflict = g_array_index(request->conflicts, gboolean, i);
+        layout->nodes[i].hidden = g_array_index(request->hidden, guint, i);
+        layout->nodes[i].members = g_array_index(request->members, guint, i);
+        layout->nodes[i].group = g_strdup(g_ptr_array_index(request->groups, i));
+        layout->nodes[i].rank = -1;
+    }
+
+    layout->n_edges = request->edges->len;
+    layout->edges = g_new0(LayoutEdge, layout->n_edges);
+    for (guint i = 0; i < layout->n_edges; i++) {
+        EdgeKey* edge = &g_array_index(request->edges, EdgeKey, i);
+        layout->edges[i].from = edge->from;
+        layout->edges[i].to = edge->to;
+        layout->edges[i].count = edge->count;
+    }
+    return layout;
+}
+
+char* graph_layout_node_label(const LayoutNode* node) {
+    if (node->hidden > 0) {
+        return g_strdup_printf("+%u more", node->hidden);
+    }
+    if (node->members > 0) {
+        return g_strdup_printf("%s (%u)", node->group, node->members);
+    }
+    return g_strdup(node->name);
+}
+
+double graph_layout_node_width(LayoutRequest* request, guint node) {
+    return g_array_index(request->widths, double, node);
+}
+
+// Shapes every label with the font the view draws it in, so boxes fit
+// the real text in any script. Pango's default font map is per thread,
+// which makes this safe on the worker.
+static void measure_labels(LayoutRequest* request) {
+    PangoContext* context = pango_font_map_create_context(pango_cairo_font_map_get_default());
+    pango_context_set_round_glyph_positions(context, FALSE);
+    PangoFontDescription* font = pango_font_description_from_string(GRAPH_LAYOUT_FONT);
+    pango_font_description_set_absolute_size(font, GRAPH_LAYOUT_FONT_SIZE * PANGO_SCALE);
+    PangoLayout* text = pango_layout_new(context);
+    pango_layout_set_font_description(text, font);
+
+    guint n_nodes = request->names->len;
+    request->widths = g_array_sized_new(FALSE, FALSE, sizeof(double), n_nodes);
+    for (guint i = 0; i < n_nodes; i++) {
+        LayoutNode probe = {
+            .name = g_ptr_array_index(request->names, i),
+            .hidden = g_array_index(request->hidden, guint, i),
+            .members = g_array_index(request->members, guint, i),
+            .group = g_ptr_array_index(request->groups, i),
+        };
+        char* label = graph_layout_node_label(&probe);
+        pango_layout_set_text(text, label, -1);
+        g_free(label);
+
+        int text_width;
+        pango_layout_get_size(text, &text_width, NULL);
+        double width = MAX(LAYOUT_NODE_MIN_WIDTH,
+                           (double)text_width / PANGO_SCALE + 2 * LAYOUT_LABEL_PADDING);
+        g_array_append_val(request->widths, width);
+    }
+
+    g_object_unref(text);
+    pango_font_description_free(font);
+    g_object_unref(context);
+}
+
+static gboolean deliver_progress(gpointer data) {
+    GTask* task = data;
+    LayoutRequest* request = g_task_get_task_data(task);
+
+    g_mutex_lock(&request->progress_lock);
+    GraphLayout* layout = g_steal_pointer(&request->pending);
+    g_mutex_unlock(&request->progress_lock);
+
+    // The final layout may already have been delivered
+    if (layout && !g_task_get_completed(task) &&
+        !g_cancellable_is_cancelled(g_task_get_cancellable(task))) {
+        request->progress(layout, request->progress_data);
+    }
+    if (layout) {
+        graph_layout_unref(layout);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+void graph_layout_publish(LayoutRequest* request, GraphLayout* layout) {
+    if (!request->progress) {
+        graph_layout_unref(layout);
+        return;
+    }
+    graph_layout_build_index(layout);
+
+    g_mutex_lock(&request->progress_lock);
+    gboolean scheduled = request->pending != NULL;
+    if (request->pending) {
+        graph_layout_unref(request->pending);
+    }
+    request->pending = layout;
+    g_mutex_unlock(&request->progress_lock);
+
+    if (!scheduled) {
+        g_main_context_invoke_full(g_task_get_context(request->task), G_PRIORITY_DEFAULT,
+                                   deliver_progress, g_object_ref(request->task),
+                                   g_object_unref);
+    }
+}
+
+// Copies positions out of the graphviz graph so it can be freed right away
+static GraphLayout* extract_layout(Agraph_t* graph, LayoutRequest* request,
+                                   Agnode_t** nodes, Agedge_t** edges) {
+    GraphLayout* layout = graph_layout_new_for_request(request);
+
+    for (guint i = 0; i < layout->n_nodes; i++) {
+        LayoutNode* node = &layout->nodes[i];
+        pointf pos = ND_coord(nodes[i]);
+        node->x = pos.x;
+        node->y = pos.y;
+        node->width = ND_width(nodes[i]) * 72;  // inches to points
+        node->height = ND_height(nodes[i]) * 72;
+    }
+
+    for (guint i = 0; i < layout->n_edges; i++) {
+        LayoutEdge* edge = &layout->edges[i];
+        splines* spl = ED_spl(edges[i]);
+        if (!spl || spl->size < 1 || spl->list[0].size < 4) continue;
+
+        bezier* bz = &spl->list[0];
+        edge->n_points = bz->size;
+        edge->points = g_new(double, 2 * bz->size);
+        for (int p = 0; p < bz->size; p++) {
+            edge->points[2 * p] = bz->list[p].x;
+            edge->points[2 * p + 1] = bz->list[p].y;
+        }
+    }
+
+    boxf bb = GD_bb(graph);
+    layout->width = bb.UR.x;
+    layout->height = bb.UR.y;
+    return layout;
+}
+
+static char* layout_cache_dir(void) {
+    return g_build_filename(g_get_user_cache_dir(), "venv-analyzer", "layouts", NULL);
+}
+
+// Files are prefixed with the cache version, so pruning can find layouts
+// written by older versions without reading them
+static char* layout_cache_path(const char* key) {
+    char* dir = layout_cache_dir();
+    g_mkdir_with_parents(dir, 0700);
+    char* name = g_strdup_printf("v%u-%s", LAYOUT_CACHE_VERSION, key);
+    char* path = g_build_filename(dir, name, NULL);
+    g_free(name);
+    g_free(dir);
+    return path;
+}
+
+typedef struct {
+    char* path;
+    gint64 mtime;
+    gint64 size;
+} CacheEntry;
+
+static gint compare_cache_entries(gconstpointer a, gconstpointer b) {
+    const CacheEntry* x = a;
+    const CacheEntry* y = b;
+    return (x->mtime > y->mtime) - (x->mtime < y->mtime);
+}
+
+// Removes layouts from other cache versions, then the least recently used
+// ones until the cache fits in LAYOUT_CACHE_MAX_BYTES. Hits refresh the
+// file's mtime, so mtime order is use order.
+static void prune_layout_cache(void) {
+    char* dir_path = layout_cache_dir();
+    GDir* dir = g_dir_open(dir_path, 0, NULL);
+    if (!dir) {
+        g_free(dir_path);
+        return;
+    }
+
+    char* prefix = g_strdup_printf("v%u-", LAYOUT_CACHE_VERSION);
+    GArray* entries = g_array_new(FALSE, FALSE, sizeof(CacheEntry));
+    gint64 total = 0;
+    const char* name;
+    while ((name = g_dir_read_name(dir))) {
+        char* path = g_build_filename(dir_path, name, NULL);
+        GStatBuf st;
+        if (!g_str_has_prefix(name, prefix)) {
+            g_unlink(path);
+            g_free(path);
+        } else if (g_stat(path, &st) == 0) {
+            CacheEntry entry = { path, st.st_mtime, st.st_size };
+            g_array_append_val(entries, entry);
+            total += st.st_size;
+        } else {
+            g_free(path);
+        }
+    }
+    g_dir_close(dir);
+
+    g_array_sort(entries, compare_cache_entries);
+    for (guint i = 0; i < entries->len; i++) {
+        CacheEntry* entry = &g_array_index(entries, CacheEntry, i);
+        if (total > LAYOUT_CACHE_MAX_BYTES && g_unlink(entry->path) == 0) {
+            total -= entry->size;
+        }
+        g_free(entry->path);
+    }
+
+    g_array_free(entries, TRUE);
+    g_free(prefix);
+    g_free(dir_path);
+}
+
+// Layouts are cached as serialized GVariants named by the request key.
+// Node names and conflict flags come from the request, so only positions
+// are stored.
+static GraphLayout* load_cached_layout(LayoutRequest* request) {
+    char* path = layout_cache_path(request->key);
+    char* contents = NULL;
+    gsize length = 0;
+    gboolean found = g_file_get_contents(path, &contents, &length, NULL);
+    if (found) {
+        // Marks the layout as recently used for prune_layout_cache
+        g_utime(path, NULL);
+    }
+    g_free(path);
+    if (!found) return NULL;
+
+    GVariant* cached = g_variant_ref_sink(
+        g_variant_new_from_data(G_VARIANT_TYPE(LAYOUT_CACHE_TYPE), contents, length,
+                                FALSE, g_free, contents));
+    guint32 version;
+    double width, height;
+    GVariant* nodes;
+    GVariant* edges;
+    g_variant_get(cached, "(udd@a(ddddi)@a(uuad))", &version, &width, &height, &nodes, &edges);
+
+    GraphLayout* layout = NULL;
+    if (version == LAYOUT_CACHE_VERSION &&
+        g_variant_n_children(nodes) == request->names->len &&
+        g_variant_n_children(edges) == request->edges->len) {
+        layout = graph_layout_new_for_request(request);
+        layout->width = width;
+        layout->height = height;
+
+        for (guint i = 0; i < layout->n_nodes; i++) {
+            LayoutNode* node = &layout->nodes[i];
+            g_variant_get_child(nodes, i, "(ddddi)", &node->x, &node->y,
+                                &node->width, &node->height, &node->rank);
+        }
+
+        for (guint i = 0; i < layout->n_edges && layout; i++) {
+            LayoutEdge* edge = &layout->edges[i];
+            guint32 from, to;
+            GVariant* points;
+            g_variant_get_child(edges, i, "(uu@ad)", &from, &to, &points);
+
+            gsize n_values = 0;
+            const double* values = g_variant_get_fixed_array(points, &n_values, sizeof(double));
+            if (from != edge->from || to != edge->to || n_values % 2 != 0) {
+                g_clear_pointer(&layout, graph_layout_unref);
+            } else if (n_values > 0) {
+                edge->n_points = n_values / 2;
+                edge->points = g_memdup2(values, n_values * sizeof(double));
+            }
+            g_variant_unref(points);
+        }
+    }
+
+    g_variant_unref(nodes);
+    g_variant_unref(edges);
+    g_variant_unref(cached);
+    return layout;
+}
+
+static void save_cached_layout(LayoutRequest* request, GraphLayout* layout) {
+    GVariantBuilder nodes;
+    g_variant_builder_init(&nodes, G_VARIANT_TYPE("a(ddddi)"));
+    for (guint i = 0; i < layout->n_nodes; i++) {
+        LayoutNode* node = &layout->nodes[i];
+        g_variant_builder_add(&nodes, "(ddddi)", node->x, node->y, node->width,
+                              node->height, node->rank);
+    }
+
+    GVariantBuilder edges;
+    g_variant_builder_init(&edges, G_VARIANT_TYPE("a(uuad)"));
+    for (guint i = 0; i < layout->n_edges; i++) {
+        LayoutEdge* edge = &layout->edges[i];
+        GVariant* points = g_variant_new_fixed_array(G_VARIANT_TYPE_DOUBLE, edge->points,
+                                                     2 * edge->n_points, sizeof(double));
+        g_variant_builder_add(&edges, "(uu@ad)", edge->from, edge->to, points);
+    }
+
+    GVariant* cached = g_variant_ref_sink(
+        g_variant_new(LAYOUT_CACHE_TYPE, (guint32)LAYOUT_CACHE_VERSION,
+                      layout->width, layout->height, &nodes, &edges));
+
+    char* path = layout_cache_path(request->key);
+    GError* error = NULL;
+    if (!g_file_set_contents(path, g_variant_get_data(cached),
+                             g_variant_get_size(cached), &error)) {
+        g_debug("Failed to cache layout: %s", error->message);
+        g_error_free(error);
+    }
+    g_free(path);
+    g_variant_unref(cached);
+
+    g_mutex_lock(&layout_cache_lock);
+    prune_layout_cache();
+    g_mutex_unlock(&layout_cache_lock);
+}
+
+// Runs dot under the graphviz lock
+// @return New layout, or NULL if cancelled while waiting or dot failed
+static GraphLayout* dot_layout_compute(LayoutRequest* request, GCancellable* cancellable) {
+    g_mutex_lock(&graphviz_lock);
+    // Superseded while waiting for the previous layout
+    if (g_cancellable_is_cancelled(cancellable)) {
+        g_mutex_unlock(&graphviz_lock);
+        return NULL;
+    }
+    if (!graphviz_context) {
+        graphviz_context = gvContext();
+    }
+
+    Agraph_t* graph = agopen("deps", Agdirected, NULL);
+    agsafeset(graph, "rankdir", "LR", "");
+
+    guint n_nodes = request->names->len;
+    guint n_edges = request->edges->len;
+    Agnode_t** nodes = g_new(Agnode_t*, n_nodes);
+    Agedge_t** edges = g_new(Agedge_t*, n_edges);
+    for (guint i = 0; i < n_nodes; i++) {
+        nodes[i] = agnode(graph, g_ptr_array_index(request->names, i), TRUE);
+
+        // Boxes come from our own measurements rather than dot's fonts
+        char size[G_ASCII_DTOSTR_BUF_SIZE];
+        agsafeset(nodes[i], "fixedsize", "true", "false");
+        agsafeset(nodes[i], "width",
+                  g_ascii_dtostr(size, sizeof(size), graph_layout_node_width(request, i) / 72), "0.75");
+        agsafeset(nodes[i], "height",
+                  g_ascii_dtostr(size, sizeof(size), LAYOUT_NODE_HEIGHT / 72), "0.5");
+        guint hidden = g_array_index(request->hidden, guint, i);
+        if (hidden > 0) {
+            char* label = g_strdup_printf("+%u more", hidden);
+            agsafeset(nodes[i], "label", label, "\\N");
+            g_free(label);
+        }
+    }
+    for (guint i = 0; i < n_edges; i++) {
+        EdgeKey* edge = &g_array_index(request->edges, EdgeKey, i);
+        edges[i] = agedge(graph, nodes[edge->from], nodes[edge->to], NULL, TRUE);
+    }
+
+    GraphLayout* layout = NULL;
+    if (gvLayout(graphviz_context, graph, "dot") == 0) {
+        layout = extract_layout(graph, request, nodes, edges);
+        gvFreeLayout(graphviz_context, graph);
+    }
+    agclose(graph);
+    g_mutex_unlock(&graphviz_lock);
+
+    g_free(nodes);
+    g_free(edges);
+    return layout;
+}
+
+static void layout_thread(GTask* task,
+                          gpointer source_object G_GNUC_UNUSED,
+                          gpointer task_data,
+                          GCancellable* cancellable) {
+    LayoutRequest* request = task_data;
+
+    // An unchanged graph needs no layout at all
+    GraphLayout* layout = load_cached_layout(request);
+    if (!layout) {
+        measure_labels(request);
+        if (request->engine == GRAPH_LAYOUT_LAYERED) {
+            layout = layered_layout_compute(request, cancellable);
+        } else if (request->engine == GRAPH_LAYOUT_FORCE) {
+            layout = force_layout_compute(request, cancellable);
+        } else {
+            layout = dot_layout_compute(request, cancellable);
+        }
+        // Worth keeping even if this view no longer wants it
+        if (layout) {
+            save_cached_layout(request, layout);
+        }
+    }
+
+    if (g_task_return_error_if_cancelled(task)) {
+        graph_layout_unref(layout);
+        return;
+    }
+    if (!layout) {
+        g_task_return_new_error(task, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_LAYOUT_FAILED,
+                                "Failed to lay out the dependency graph");
+        return;
+    }
+    graph_layout_build_index(layout);
+    g_task_return_pointer(task, layout, (GDestroyNotify)graph_layout_unref);
+}
+
+void graph_layout_compute_async(Package* packages,
+                                GraphLayoutEngine engine,
+                                GraphLayout* previous,
+                                const GraphLayoutFocus* focus,
+                                const GraphLayoutGroups* groups,
+                                GCancellable* cancellable,
+                                GraphLayoutProgressFunc progress,
+                                GAsyncReadyCallback callback,
+                                gpointer user_data) {
+    LayoutRequest* request = layout_request_new(packages, engine, previous, focus, groups);
+    GTask* task = g_task_new(NULL, cancellable, callback, user_data);
+    request->task = task;
+    request->progress = progress;
+    request->progress_data = user_data;
+
+    g_task_set_source_tag(task, graph_layout_compute_async);
+    g_task_set_task_data(task, request, layout_request_free);
+    g_task_run_in_thread(task, layout_thread);
+    g_object_unref(task);
+}
+
+GraphLayout* graph_layout_compute_finish(GAsyncResult* result, GError** error) {
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
@@ -0,0 +1,178 @@
+#ifndef CORE_GRAPH_LAYOUT_H
+#define CORE_GRAPH_LAYOUT_H
+
+#include "../include/venv_analyzer.h"
+#include "package.h"
+#include <gio/gio.h>
+
+// Dependency graph layouts computed off the main thread. A finished layout
+// is immutable and reference counted, so the widget can swap in a new one
+// with a single pointer assignment while the old one is still drawn.
+
+typedef enum {
+    GRAPH_LAYOUT_AUTO,      // dot up to GRAPH_LAYOUT_AUTO_LIMIT nodes, layered above
+    GRAPH_LAYOUT_DOT,       // Graphviz dot
+    GRAPH_LAYOUT_LAYERED,   // Built-in layered layout, incremental
+    GRAPH_LAYOUT_FORCE      // Force-directed, refined progressively
+} GraphLayoutEngine;
+
+#define GRAPH_LAYOUT_AUTO_LIMIT 300
+
+typedef struct {
+    char* name;
+    double x;            // Centre, in points
+    double y;
+    double width;        // Size, in points
+    double height;
+    gboolean conflict;   // Package has conflicts
+    int rank;            // Column from the layered engine, -1 otherwise
+    guint hidden;        // Stubs only: neighbours of their package left out
+    guint members;       // Collapsed groups only: packages it stands for
+    char* group;         // Group the node belongs to or stands for, or NULL
+} LayoutNode;
+
+// Focus layouts add a "+N more" stub next to every package that has
+// neighbours outside the neighbourhood. A stub is named this prefix
+// followed by its package's name, which no package name can start with.
+#define GRAPH_LAYOUT_STUB_PREFIX "+"
+
+typedef enum {
+    GRAPH_LAYOUT_GROUP_BY_NONE,
+    GRAPH_LAYOUT_GROUP_BY_PREFIX,        // Packages sharing a first name segment, "google-*"
+    GRAPH_LAYOUT_GROUP_BY_REQUIREMENT    // A top-level requirement and the packages
+                                         // nothing else installed needs
+} GraphLayoutGrouping;
+
+// A collapsed group is one node named this prefix followed by the group's
+// name, which no package or stub name can start with
+#define GRAPH_LAYOUT_GROUP_PREFIX "*"
+
+// Font node labels are measured and drawn with; the size is in layout
+// units so boxes and text scale together
+#define GRAPH_LAYOUT_FONT "Sans"
+#define GRAPH_LAYOUT_FONT_SIZE 12.0
+
+/**
+ * Restricts a layout to the packages around one package
+ */
+typedef struct {
+    const char* package;     // Centre of the neighbourhood
+    guint hops;              // Dependency edges followed, in either direction
+    GHashTable* expanded;    // Names of packages shown with all their
+                             // neighbours regardless of distance, or NULL
+} GraphLayoutFocus;
+
+/**
+ * Collapses groups of packages into single nodes
+ */
+typedef struct {
+    GraphLayoutGrouping by;
+    GHashTable* expanded;    // Names of groups shown as their members, or NULL
+} GraphLayoutGroups;
+
+typedef struct {
+    guint from;          // Node indices
+    guint to;
+    guint count;         // Dependencies it stands for, more than 1 only
+                         // when it joins a collapsed group
+    guint n_points;      // Cubic bezier: start point, then 3 per segment
+    double* points;      // x, y pairs
+} LayoutEdge;
+
+typedef struct _GraphLayoutIndex GraphLayoutIndex;
+
+typedef struct {
+    gint ref_count;
+    LayoutNode* nodes;
+    guint n_nodes;
+    LayoutEdge* edges;
+    guint n_edges;
+    double width;        // Bounding box of the layout, in points
+    double height;
+    GraphLayoutIndex* index;  // Grid over nodes and edges, see graph_layout_query
+} GraphLayout;
+
+// Nodes whose centres share a cell of the index, for drawing far zoomed out
+typedef struct {
+    double x;            // Bounding box of the nodes' boxes
+    double y;
+    double width;
+    double height;
+    guint n_nodes;
+    gboolean conflict;   // Any of them has conflicts
+} LayoutCluster;
+
+GraphLayout* graph_layout_ref(GraphLayout* layout);
+void graph_layout_unref(GraphLayout* layout);
+
+/**
+ * @return Text drawn on node, free with g_free
+ */
+char* graph_layout_node_label(const LayoutNode* node);
+
+/**
+ * Collects the nodes and edges whose boxes intersect a rectangle in
+ * layout coordinates. Nodes come out in drawing order. Either array may
+ * be NULL; both are cleared first and hold guint indices.
+ */
+void graph_layout_query(GraphLayout* layout,
+                        double x, double y, double width, double height,
+                        GArray* nodes, GArray* edges);
+
+/**
+ * Collects the LayoutCluster of every index cell near a rectangle that
+ * holds at least one node. clusters is cleared first.
+ */
+void graph_layout_query_clusters(GraphLayout* layout,
+                                 double x, double y, double width, double height,
+                                 GArray* clusters);
+
+/**
+ * @return Side length of an index cell, in points
+ */
+double graph_layout_cluster_size(GraphLayout* layout);
+
+/**
+ * Finds the node whose box contains (x, y) in layout coordinates
+ * @return Node index or -1
+ */
+int graph_layout_node_at(GraphLayout* layout, double x, double y);
+
+/**
+ * Receives an intermediate layout. The layout is borrowed; take a
+ * reference to keep it.
+ */
+typedef void (*GraphLayoutProgressFunc)(GraphLayout* layout, gpointer user_data);
+
+/**
+ * Lays out the dependency graph of packages in a worker thread. The
+ * packages are copied first, so they may change while it runs. previous,
+ * if given, is the layout currently shown; the layered engine keeps the
+ * columns it does not need to change as they were, and the force engine
+ * starts from its positions. focus, if given, limits the layout to a
+ * neighbourhood; only the neighbourhood is copied and laid out. groups,
+ * if given, collapses every group not expanded into one node after that;
+ * edges to and from a group merge and count what they stand for.
+ * Engines that refine progressively call progress, if given, with
+ * intermediate layouts and user_data at most once per frame on the
+ * caller's main context, and never after callback.
+ * Cancelling makes the layout finish with G_IO_ERROR_CANCELLED; graphviz
+ * itself cannot be interrupted, so a running dot pass is discarded rather
+ * than stopped, and layouts still waiting for their turn are skipped.
+ */
+void graph_layout_compute_async(Package* packages,
+                                GraphLayoutEngine engine,
+                                GraphLayout* previous,
+                                const GraphLayoutFocus* focus,
+                                const GraphLayoutGroups* groups,
+                                GCancellable* cancellable,
+                                GraphLayoutProgressFunc progress,
+                                GAsyncReadyCallback callback,
+                                gpointer user_data);
+
+/**
+ * @return New layout or NULL on error
+ */
+GraphLayout* graph_layout_compute_finish(GAsyncResult* result, GError** error);
+
+#endif // CORE_GRAPH_LAYOUT_H
@@ -0,0 +1,960 @@
+#include "graph_layout-private.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Sugiyama-style layered layout, drawn left to right like dot with
+// rankdir=LR:
+//   1. break cycles by reversing DFS back edges
+//   2. rank by longest path, then pull sources next to their first use
+//   3. split long edges into chains of dummy nodes, one per rank crossed
+//   4. order each rank by barycentric sweeps, keeping the order with the
+//      fewest crossings
+//   5. place nodes within their rank with Brandes-Köpf
+// With a previous layout from this engine, ranks whose members did not
+// change keep their order and positions, and only the other ranks are
+// reordered and placed again.
+
+// Spacing in points, close to dot's defaults
+#define RANK_SEP 36.0
+#define NODE_SEP 18.0
+#define EDGE_SEP 10.0
+#define SWEEP_ROUNDS 8
+
+#define NO_NODE G_MAXUINT
+
+typedef struct {
+    LayoutRequest* request;
+    guint n_real;            // Request nodes come first, dummies after
+    guint n_nodes;
+    guint n_ranks;
+
+    // Per node
+    guint* rank;
+    double* width;           // Along the ranks (x)
+    double* size;            // Within the rank (y), 0 for dummies
+    double* prev_y;          // Position in the previous layout, or NAN
+    guint* pos;              // Index within its rank
+    double* y;
+
+    // Per rank
+    guint** layers;          // Node ids in order
+    guint* layer_len;
+    gboolean* affected;      // Order and positions may change
+
+    // Segments join nodes in adjacent ranks; upper is the lower rank number
+    guint n_segments;
+    guint* seg_upper;
+    guint* seg_lower;
+    gboolean* seg_conflict;  // Type 1 conflict, see mark_conflicts
+
+    // Per node segment lists (CSR), up = towards rank - 1
+    guint* up_start;
+    guint* up_segs;
+    guint* down_start;
+    guint* down_segs;
+
+    // Per request edge: nodes from the lower to the higher rank, empty for
+    // self loops
+    guint* chain_start;
+    guint* chain_nodes;
+    gboolean* reversed;
+} Layering;
+
+typedef struct {
+    double key;
+    guint tie;
+    guint node;
+} SortItem;
+
+static int compare_sort_items(const void* a, const void* b) {
+    const SortItem* x = a;
+    const SortItem* y = b;
+    if (x->key != y->key) return x->key < y->key ? -1 : 1;
+    return (x->tie > y->tie) - (x->tie < y->tie);
+}
+
+static gboolean is_dummy(const Layering* l, guint v) {
+    return v >= l->n_real;
+}
+
+static void layering_free(Layering* l) {
+    g_free(l->rank);
+    g_free(l->width);
+    g_free(l->size);
+    g_free(l->prev_y);
+    g_free(l->pos);
+    g_free(l->y);
+    for (guint r = 0; r < l->n_ranks; r++) {
+        g_free(l->layers[r]);
+    }
+    g_free(l->layers);
+    g_free(l->layer_len);
+    g_free(l->affected);
+    g_free(l->seg_upper);
+    g_free(l->seg_lower);
+    g_free(l->seg_conflict);
+    g_free(l->up_start);
+    g_free(l->up_segs);
+    g_free(l->down_start);
+    g_free(l->down_segs);
+    g_free(l->chain_start);
+    g_free(l->chain_nodes);
+    g_free(l->reversed);
+    g_free(l);
+}
+
+static EdgeKey* request_edge(const Layering* l, guint e) {
+    return &g_array_index(l->request->edges, EdgeKey, e);
+}
+
+// Lower and higher ranked end of an edge once cycles are broken
+static guint edge_low(const Layering* l, guint e) {
+    EdgeKey* edge = request_edge(l, e);
+    return l->reversed[e] ? edge->to : edge->from;
+}
+
+static guint edge_high(const Layering* l, guint e) {
+    EdgeKey* edge = request_edge(l, e);
+    return l->reversed[e] ? edge->from : edge->to;
+}
+
+// Reverses every edge that closes a cycle in an iterative DFS. Request
+// edges are sorted by source, so out-edges of v are a contiguous range.
+static void break_cycles(Layering* l) {
+    guint n = l->n_real;
+    guint n_edges = l->request->edges->len;
+    guint* out_start = g_new0(guint, n + 1);
+    for (guint e = 0; e < n_edges; e++) {
+        out_start[request_edge(l, e)->from + 1]++;
+    }
+    for (guint v = 0; v < n; v++) {
+        out_start[v + 1] += out_start[v];
+    }
+
+    guint8* state = g_new0(guint8, n);  // 0 unvisited, 1 on stack, 2 done
+    guint* next = g_new(guint, n);
+    guint* stack = g_new(guint, n);
+    for (guint s = 0; s < n; s++) {
+        if (state[s]) continue;
+
+        guint depth = 0;
+        stack[depth++] = s;
+        state[s] = 1;
+        next[s] = out_start[s];
+        while (depth > 0) {
+            guint v = stack[depth - 1];
+            if (next[v] == out_start[v + 1]) {
+                state[v] = 2;
+                depth--;
+                continue;
+            }
+
+            guint e = next[v]++;
+            guint w = request_edge(l, e)->to;
+            if (w == v) continue;
+            if (state[w] == 1) {
+                l->reversed[e] = TRUE;
+            } else if (state[w] == 0) {
+                state[w] = 1;
+                next[w] = out_start[w];
+                stack[depth++] = w;
+            }
+        }
+    }
+
+    g_free(out_start);
+    g_free(state);
+    g_free(next);
+    g_free(stack);
+}
+
+// Longest-path ranking over the acyclic graph, then sources are moved up
+// to one rank before their nearest dependency so top-level packages do
+// not sit far away from what they use. Empty ranks are squeezed out.
+static void assign_ranks(Layering* l) {
+    guint n = l->n_real;
+    guint n_edges = l->request->edges->len;
+
+    guint* in_degree = g_new0(guint, n);
+    guint* low_start = g_new0(guint, n + 1);
+    for (guint e = 0; e < n_edges; e++) {
+        if (request_edge(l, e)->from == request_edge(l, e)->to) continue;
+        in_degree[edge_high(l, e)]++;
+        low_start[edge_low(l, e) + 1]++;
+    }
+    for (guint v = 0; v < n; v++) {
+        low_start[v + 1] += low_start[v];
+    }
+    guint* low_edges = g_new(guint, MAX(low_start[n], 1));
+    guint* fill = g_memdup2(low_start, n * sizeof(guint));
+    for (guint e = 0; e < n_edges; e++) {
+        if (request_edge(l, e)->from == request_edge(l, e)->to) continue;
+        low_edges[fill[edge_low(l, e)]++] = e;
+    }
+    g_free(fill);
+
+    // Kahn's algorithm; the queue doubles as the topological order
+    guint* order = g_new(guint, n);
+    guint* remaining = g_memdup2(in_degree, n * sizeof(guint));
+    guint head = 0, tail = 0;
+    for (guint v = 0; v < n; v++) {
+        l->rank[v] = 0;
+        if (remaining[v] == 0) order[tail++] = v;
+    }
+    while (head < tail) {
+        guint v = order[head++];
+        for (guint i = low_start[v]; i < low_start[v + 1]; i++) {
+            guint w = edge_high(l, low_edges[i]);
+            l->rank[w] = MAX(l->rank[w], l->rank[v] + 1);
+            if (--remaining[w] == 0) order[tail++] = w;
+        }
+    }
+
+    for (guint i = tail; i-- > 0;) {
+        guint v = order[i];
+        if (in_degree[v] > 0 || low_start[v] == low_start[v + 1]) continue;
+
+        guint nearest = G_MAXUINT;
+        for (guint j = low_start[v]; j < low_start[v + 1]; j++) {
+            nearest = MIN(nearest, l->rank[edge_high(l, low_edges[j])]);
+        }
+        l->rank[v] = nearest - 1;
+    }
+
+    guint max_rank = 0;
+    for (guint v = 0; v < n; v++) {
+        max_rank = MAX(max_rank, l->rank[v]);
+    }
+    guint* dense = g_new0(guint, max_rank + 1);
+    for (guint v = 0; v < n; v++) {
+        dense[l->rank[v]] = 1;
+    }
+    guint n_ranks = 0;
+    for (guint r = 0; r <= max_rank; r++) {
+        guint used = dense[r];
+        dense[r] = n_ranks;
+        n_ranks += used;
+    }
+    for (guint v = 0; v < n; v++) {
+        l->rank[v] = dense[l->rank[v]];
+    }
+    l->n_ranks = MAX(n_ranks, 1);
+
+    g_free(dense);
+    g_free(order);
+    g_free(remaining);
+    g_free(in_degree);
+    g_free(low_start);
+    g_free(low_edges);
+}
+
+// Adds dummy nodes so that every segment joins adjacent ranks, and builds
+// the per-rank node lists and segment adjacency
+static void build_chains(Layering* l) {
+    guint n_edges = l->request->edges->len;
+
+    l->chain_start = g_new0(guint, n_edges + 1);
+    guint n_dummies = 0;
+    for (guint e = 0; e < n_edges; e++) {
+        guint length = 0;
+        if (request_edge(l, e)->from != request_edge(l, e)->to) {
+            length = l->rank[edge_high(l, e)] - l->rank[edge_low(l, e)] + 1;
+            n_dummies += length - 2;
+        }
+        l->chain_start[e + 1] = l->chain_start[e] + length;
+    }
+
+    l->n_nodes = l->n_real + n_dummies;
+    l->rank = g_renew(guint, l->rank, l->n_nodes);
+    l->chain_nodes = g_new(guint, MAX(l->chain_start[n_edges], 1));
+
+    guint dummy = l->n_real;
+    guint n_segments = 0;
+    for (guint e = 0; e < n_edges; e++) {
+        guint start = l->chain_start[e];
+        guint length = l->chain_start[e + 1] - start;
+        if (length == 0) continue;
+
+        guint low = edge_low(l, e);
+        l->chain_nodes[start] = low;
+        for (guint k = 1; k + 1 < length; k++) {
+            l->rank[dummy] = l->rank[low] + k;
+            l->chain_nodes[start + k] = dummy++;
+        }
+        l->chain_nodes[start + length - 1] = edge_high(l, e);
+        n_segments += length - 1;
+    }
+    l->n_segments = n_segments;
+
+    l->seg_upper = g_new(guint, MAX(n_segments, 1));
+    l->seg_lower = g_new(guint, MAX(n_segments, 1));
+    l->seg_conflict = g_new0(gboolean, MAX(n_segments, 1));
+    guint s = 0;
+    for (guint e = 0; e < n_edges; e++) {
+        for (guint i = l->chain_start[e]; i + 1 < l->chain_start[e + 1]; i++) {
+            l->seg_upper[s] = l->chain_nodes[i];
+            l->seg_lower[s] = l->chain_nodes[i + 1];
+            s++;
+        }
+    }
+
+    // Segment lists per node
+    l->up_start = g_new0(guint, l->n_nodes + 1);
+    l->down_start = g_new0(guint, l->n_nodes + 1);
+    for (s = 0; s < n_segments; s++) {
+        l->up_start[l->seg_lower[s] + 1]++;
+        l->down_start[l->seg_upper[s] + 1]++;
+    }
+    for (guint v = 0; v < l->n_nodes; v++) {
+        l->up_start[v + 1] += l->up_start[v];
+        l->down_start[v + 1] += l->down_start[v];
+    }
+    l->up_segs = g_new(guint, MAX(n_segments, 1));
+    l->down_segs = g_new(guint, MAX(n_segments, 1));
+    guint* up_fill = g_memdup2(l->up_start, l->n_nodes * sizeof(guint));
+    guint* down_fill = g_memdup2(l->down_start, l->n_nodes * sizeof(guint));
+    for (s = 0; s < n_segments; s++) {
+        l->up_segs[up_fill[l->seg_lower[s]]++] = s;
+        l->down_segs[down_fill[l->seg_upper[s]]++] = s;
+    }
+    g_free(up_fill);
+    g_free(down_fill);
+
+    // Ranks, initially in id order
+    l->layers = g_new0(guint*, l->n_ranks);
+    l->layer_len = g_new0(guint, l->n_ranks);
+    l->affected = g_new(gboolean, l->n_ranks);
+    for (guint v = 0; v < l->n_nodes; v++) {
+        l->layer_len[l->rank[v]]++;
+    }
+    for (guint r = 0; r < l->n_ranks; r++) {
+        l->layers[r] = g_new(guint, MAX(l->layer_len[r], 1));
+        l->layer_len[r] = 0;
+        l->affected[r] = TRUE;
+    }
+    l->pos = g_new(guint, l->n_nodes);
+    for (guint v = 0; v < l->n_nodes; v++) {
+        guint r = l->rank[v];
+        l->pos[v] = l->layer_len[r];
+        l->layers[r][l->layer_len[r]++] = v;
+    }
+}
+
+// Looks up where every node and dummy was in the previous layout. A rank
+// is unaffected if all of its members were there before, in the same
+// rank, and nothing else was.
+static void match_previous(Layering* l) {
+    l->prev_y = g_new(double, l->n_nodes);
+    for (guint v = 0; v < l->n_nodes; v++) {
+        l->prev_y[v] = NAN;
+    }
+
+    GraphLayout* previous = l->request->previous;
+    if (!previous || previous->n_nodes == 0) return;
+    for (guint i = 0; i < previous->n_nodes; i++) {
+        if (previous->nodes[i].rank < 0) return;  // Not from this engine
+    }
+
+    GHashTable* prev_index = g_hash_table_new(g_str_hash, g_str_equal);
+    guint n_prev_ranks = 0;
+    for (guint i = 0; i < previous->n_nodes; i++) {
+        g_hash_table_insert(prev_index, previous->nodes[i].name, GUINT_TO_POINTER(i + 1));
+        n_prev_ranks = MAX(n_prev_ranks, (guint)previous->nodes[i].rank + 1);
+    }
+
+    // Members per rank in the previous layout, dummies included
+    guint* prev_members = g_new0(guint, MAX(n_prev_ranks, l->n_ranks));
+    for (guint i = 0; i < previous->n_nodes; i++) {
+        prev_members[previous->nodes[i].rank]++;
+    }
+    GHashTable* prev_edges = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for (guint i = 0; i < previous->n_edges; i++) {
+        LayoutEdge* edge = &previous->edges[i];
+        int a = previous->nodes[edge->from].rank;
+        int b = previous->nodes[edge->to].rank;
+        for (int r = MIN(a, b) + 1; r < MAX(a, b); r++) {
+            prev_members[r]++;
+        }
+        char* key = g_strconcat(previous->nodes[edge->from].name, "\x1f",
+                                previous->nodes[edge->to].name, NULL);
+        if (!g_hash_table_contains(prev_edges, key)) {
+            g_hash_table_insert(prev_edges, key, GUINT_TO_POINTER(i + 1));
+        } else {
+            g_free(key);
+        }
+    }
+
+    for (guint v = 0; v < l->n_real; v++) {
+        guint i = GPOINTER_TO_UINT(g_hash_table_lookup(prev_index,
+                                   g_ptr_array_index(l->request->names, v)));
+        if (i && (guint)previous->nodes[i - 1].rank == l->rank[v]) {
+            l->prev_y[v] = previous->nodes[i - 1].y;
+        }
+    }
+
+    // Dummies sit on the segment ends of the previous edge's bezier
+    for (guint e = 0; e < l->request->edges->len; e++) {
+        guint start = l->chain_start[e];
+        guint length = l->chain_start[e + 1] - start;
+        if (length < 3) continue;
+
+        EdgeKey* edge = request_edge(l, e);
+        char* key = g_strconcat(g_ptr_array_index(l->request->names, edge->from), "\x1f",
+                                g_ptr_array_index(l->request->names, edge->to), NULL);
+        guint i = GPOINTER_TO_UINT(g_hash_table_lookup(prev_edges, key));
+        g_free(key);
+        if (!i) continue;
+
+        LayoutEdge* prev = &previous->edges[i - 1];
+        guint low = l->chain_nodes[start];
+        guint high = l->chain_nodes[start + length - 1];
+        if (isnan(l->prev_y[low]) || isnan(l->prev_y[high]) ||
+            prev->n_points != 1 + 3 * (length - 1)) {
+            continue;
+        }
+        for (guint k = 1; k + 1 < length; k++) {
+            guint point = 3 * (l->reversed[e] ? length - 1 - k : k);
+            l->prev_y[l->chain_nodes[start + k]] = prev->points[2 * point + 1];
+        }
+    }
+
+    for (guint r = 0; r < l->n_ranks; r++) {
+        guint known = 0;
+        for (guint i = 0; i < l->layer_len[r]; i++) {
+            known += !isnan(l->prev_y[l->layers[r][i]]);
+        }
+        l->affected[r] = known != l->layer_len[r] || known != prev_members[r];
+    }
+
+    g_free(prev_members);
+    g_hash_table_unref(prev_edges);
+    g_hash_table_unref(prev_index);
+}
+
+static void set_layer_order(Layering* l, guint r, const SortItem* items) {
+    for (guint i = 0; i < l->layer_len[r]; i++) {
+        l->layers[r][i] = items[i].node;
+        l->pos[items[i].node] = i;
+    }
+}
+
+// Mean position of the neighbours across the given segments, or NAN
+static double barycenter(const Layering* l, guint v, gboolean up) {
+    guint start = up ? l->up_start[v] : l->down_start[v];
+    guint end = up ? l->up_start[v + 1] : l->down_start[v + 1];
+    if (start == end) return NAN;
+
+    double sum = 0;
+    for (guint i = start; i < end; i++) {
+        guint s = up ? l->up_segs[i] : l->down_segs[i];
+        sum += l->pos[up ? l->seg_upper[s] : l->seg_lower[s]];
+    }
+    return sum / (end - start);
+}
+
+// Ranks are ordered top-down. Unchanged ranks take their previous order;
+// otherwise nodes that were there before keep their relative order and
+// new ones are merged in by the barycenter of their upper neighbours.
+static void initial_order(Layering* l, SortItem* items, SortItem* scratch) {
+    for (guint r = 0; r < l->n_ranks; r++) {
+        guint n = l->layer_len[r];
+        guint n_known = 0, n_new = 0;
+        SortItem* known = items;
+        SortItem* fresh = scratch;
+
+        for (guint i = 0; i < n; i++) {
+            guint v = l->layers[r][i];
+            double b = r > 0 ? barycenter(l, v, TRUE) : NAN;
+            if (!isnan(l->prev_y[v])) {
+                known[n_known++] = (SortItem){ l->prev_y[v], (guint)i, v };
+            } else {
+                fresh[n_new++] = (SortItem){ isnan(b) ? INFINITY : b, (guint)i, v };
+            }
+        }
+        qsort(known, n_known, sizeof(SortItem), compare_sort_items);
+        qsort(fresh, n_new, sizeof(SortItem), compare_sort_items);
+
+        // Merge by barycenter without reordering the known nodes
+        SortItem* merged = g_new(SortItem, MAX(n, 1));
+        guint i = 0, j = 0, k = 0;
+        while (i < n_known || j < n_new) {
+            gboolean take_new = j < n_new;
+            if (take_new && i < n_known) {
+                double b = r > 0 ? barycenter(l, known[i].node, TRUE) : NAN;
+                take_new = !isnan(b) && fresh[j].key < b;
+            }
+            merged[k++] = take_new ? fresh[j++] : known[i++];
+        }
+        set_layer_order(l, r, merged);
+        g_free(merged);
+    }
+}
+
+// Reorders one rank by the barycenter of its neighbours in the rank above
+// (up) or below. Nodes without such neighbours keep their position.
+static void sort_layer(Layering* l, guint r, gboolean up, SortItem* items) {
+    for (guint i = 0; i < l->layer_len[r]; i++) {
+        guint v = l->layers[r][i];
+        double b = barycenter(l, v, up);
+        items[i] = (SortItem){ isnan(b) ? (double)i : b, i, v };
+    }
+    qsort(items, l->layer_len[r], sizeof(SortItem), compare_sort_items);
+    set_layer_order(l, r, items);
+}
+
+guint64 layered_layout_count_crossings(const guint* ends, guint n_ends, guint n_lower,
+                                       guint* tree) {
+    memset(tree, 0, (n_lower + 1) * sizeof(guint));
+
+    guint64 crossings = 0;
+    for (guint i = 0; i < n_ends; i++) {
+        guint not_greater = 0;
+        for (guint p = ends[i] + 1; p > 0; p -= p & -p) not_greater += tree[p];
+        crossings += i - not_greater;
+        for (guint p = ends[i] + 1; p <= n_lower; p += p & -p) tree[p]++;
+    }
+    return crossings;
+}
+
+// Crossings between rank r and r + 1. ends must hold every segment
+// between them.
+static guint64 count_layer_crossings(const Layering* l, guint r, guint* tree, guint* ends) {
+    guint n_ends = 0;
+    for (guint i = 0; i < l->layer_len[r]; i++) {
+        guint v = l->layers[r][i];
+        guint first = n_ends;
+        for (guint j = l->down_start[v]; j < l->down_start[v + 1]; j++) {
+            ends[n_ends++] = l->pos[l->seg_lower[l->down_segs[j]]];
+        }
+        // Degrees are small; insertion sort
+        for (guint a = first + 1; a < n_ends; a++) {
+            guint value = ends[a];
+            guint b = a;
+            for (; b > first && ends[b - 1] > value; b--) ends[b] = ends[b - 1];
+            ends[b] = value;
+        }
+    }
+    return layered_layout_count_crossings(ends, n_ends, l->layer_len[r + 1], tree);
+}
+
+static guint64 count_crossings(const Layering* l, guint* tree, guint* ends) {
+    guint64 total = 0;
+    for (guint r = 0; r + 1 < l->n_ranks; r++) {
+        total += count_layer_crossings(l, r, tree, ends);
+    }
+    return total;
+}
+
+static gboolean reduce_crossings(Layering* l, GCancellable* cancellable) {
+    guint widest = 1;
+    for (guint r = 0; r < l->n_ranks; r++) {
+        widest = MAX(widest, l->layer_len[r]);
+    }
+
+    SortItem* items = g_new(SortItem, widest);
+    SortItem* scratch = g_new(SortItem, widest);
+    guint* tree = g_new(guint, widest + 1);
+    guint* ends = g_new(guint, MAX(l->n_segments, 1));
+    guint* best = g_new(guint, MAX(l->n_nodes, 1));
+
+    initial_order(l, items, scratch);
+
+    gboolean any_affected = FALSE;
+    for (guint r = 0; r < l->n_ranks; r++) {
+        any_affected |= l->affected[r];
+    }
+
+    guint64 best_crossings = count_crossings(l, tree, ends);
+    memcpy(best, l->pos, l->n_nodes * sizeof(guint));
+    for (guint round = 0; any_affected && best_crossings > 0 && round < SWEEP_ROUNDS; round++) {
+        if (g_cancellable_is_cancelled(cancellable)) break;
+
+        if (round % 2 == 0) {
+            for (guint r = 1; r < l->n_ranks; r++) {
+                if (l->affected[r]) sort_layer(l, r, TRUE, items);
+            }
+        } else {
+            for (guint r = l->n_ranks - 1; r-- > 0;) {
+                if (l->affected[r]) sort_layer(l, r, FALSE, items);
+            }
+        }
+
+        guint64 crossings = count_crossings(l, tree, ends);
+        if (crossings < best_crossings) {
+            best_crossings = crossings;
+            memcpy(best, l->pos, l->n_nodes * sizeof(guint));
+        }
+    }
+
+    // Restore the best order found
+    memcpy(l->pos, best, l->n_nodes * sizeof(guint));
+    for (guint v = 0; v < l->n_nodes; v++) {
+        l->layers[l->rank[v]][l->pos[v]] = v;
+    }
+
+    g_free(items);
+    g_free(scratch);
+    g_free(tree);
+    g_free(ends);
+    g_free(best);
+    return !g_cancellable_is_cancelled(cancellable);
+}
+
+// Marks segments that cross an inner segment (dummy to dummy), which
+// Brandes-Köpf must not align so long edges stay straight
+static void mark_conflicts(Layering* l) {
+    for (guint r = 1; r < l->n_ranks; r++) {
+        guint k0 = 0, scan = 0;
+        guint n = l->layer_len[r];
+        for (guint i = 0; i < n; i++) {
+            guint v = l->layers[r][i];
+            guint inner = NO_NODE;
+            if (is_dummy(l, v) && l->up_start[v + 1] > l->up_start[v]) {
+                guint u = l->seg_upper[l->up_segs[l->up_start[v]]];
+                if (is_dummy(l, u)) inner = u;
+            }
+            if (inner == NO_NODE && i + 1 < n) continue;
+
+            guint k1 = inner != NO_NODE ? l->pos[inner] : l->layer_len[r - 1];
+            for (guint j = scan; j <= i; j++) {
+                guint w = l->layers[r][j];
+                for (guint a = l->up_start[w]; a < l->up_start[w + 1]; a++) {
+                    guint s = l->up_segs[a];
+                    guint u = l->seg_upper[s];
+                    if ((l->pos[u] < k0 || k1 < l->pos[u]) && !(is_dummy(l, u) && is_dummy(l, w))) {
+                        l->seg_conflict[s] = TRUE;
+                    }
+                }
+            }
+            scan = i + 1;
+            k0 = k1;
+        }
+    }
+}
+
+static double separation(const Layering* l, guint u, guint v) {
+    double gap_u = is_dummy(l, u) ? EDGE_SEP : NODE_SEP;
+    double gap_v = is_dummy(l, v) ? EDGE_SEP : NODE_SEP;
+    return (l->size[u] + l->size[v]) / 2 + (gap_u + gap_v) / 2;
+}
+
+// One of the four Brandes-Köpf passes. The layering is viewed bottom-up
+// when from_below is set and right to left when from_right is set; the
+// result is in left-to-right coordinates either way.
+static void place_variant(const Layering* l, gboolean from_below, gboolean from_right,
+                          double* xs, guint* root, guint* align, SortItem* items) {
+    guint n = l->n_nodes;
+    for (guint v = 0; v < n; v++) {
+        root[v] = v;
+        align[v] = v;
+    }
+
+    #define LAYER_AT(k) (from_below ? l->n_ranks - 1 - (k) : (k))
+    #define NODE_AT(r, i) (l->layers[r][from_right ? l->layer_len[r] - 1 - (i) : (i)])
+    #define POS_OF(v) (from_right ? l->layer_len[l->rank[v]] - 1 - l->pos[v] : l->pos[v])
+
+    // Vertical alignment with the median neighbours
+    for (guint k = 0; k < l->n_ranks; k++) {
+        guint r = LAYER_AT(k);
+        int previous = -1;
+        for (guint i = 0; i < l->layer_len[r]; i++) {
+            guint v = NODE_AT(r, i);
+            guint start = from_below ? l->down_start[v] : l->up_start[v];
+            guint end = from_below ? l->down_start[v + 1] : l->up_start[v + 1];
+            guint d = end - start;
+            if (d == 0) continue;
+
+            for (guint j = 0; j < d; j++) {
+                guint s = from_below ? l->down_segs[start + j] : l->up_segs[start + j];
+                guint w = from_below ? l->seg_lower[s] : l->seg_upper[s];
+                items[j] = (SortItem){ POS_OF(w), s, w };
+            }
+            qsort(items, d, sizeof(SortItem), compare_sort_items);
+
+            for (guint m = (d - 1) / 2; m <= d / 2; m++) {
+                guint w = items[m].node;
+                if (align[v] == v && previous < (int)POS_OF(w) && !l->seg_conflict[items[m].tie]) {
+                    align[w] = v;
+                    root[v] = root[w];
+                    align[v] = root[v];
+                    previous = (int)POS_OF(w);
+                }
+            }
+        }
+    }
+
+    // Horizontal compaction over the graph of blocks: each block is kept
+    // at least its separation right of the block before it in every rank
+    guint n_links = 0;
+    for (guint r = 0; r < l->n_ranks; r++) {
+        n_links += l->layer_len[r] > 0 ? l->layer_len[r] - 1 : 0;
+    }
+    guint* link_from = g_new(guint, MAX(n_links, 1));
+    guint* link_to = g_new(guint, MAX(n_links, 1));
+    double* link_sep = g_new(double, MAX(n_links, 1));
+    guint* in_count = g_new0(guint, n);
+    guint* out_start = g_new0(guint, n + 1);
+    guint li = 0;
+    for (guint r = 0; r < l->n_ranks; r++) {
+        for (guint i = 1; i < l->layer_len[r]; i++) {
+            guint u = NODE_AT(r, i - 1);
+            guint v = NODE_AT(r, i);
+            link_from[li] = root[u];
+            link_to[li] = root[v];
+            link_sep[li] = separation(l, u, v);
+            in_count[root[v]]++;
+            out_start[root[u] + 1]++;
+            li++;
+        }
+    }
+    for (guint v = 0; v < n; v++) {
+        out_start[v + 1] += out_start[v];
+    }
+    guint* out_links = g_new(guint, MAX(n_links, 1));
+    guint* fill = g_memdup2(out_start, n * sizeof(guint));
+    for (li = 0; li < n_links; li++) {
+        out_links[fill[link_from[li]]++] = li;
+    }
+    g_free(fill);
+
+    guint* order = g_new(guint, n);
+    guint head = 0, tail = 0;
+    for (guint v = 0; v < n; v++) {
+        xs[v] = 0;
+        if (root[v] == v && in_count[v] == 0) order[tail++] = v;
+    }
+    while (head < tail) {
+        guint b = order[head++];
+        for (guint i = out_start[b]; i < out_start[b + 1]; i++) {
+            guint link = out_links[i];
+            guint c = link_to[link];
+            xs[c] = MAX(xs[c], xs[b] + link_sep[link]);
+            if (--in_count[c] == 0) order[tail++] = c;
+        }
+    }
+    // Pull blocks right towards their successors where there is slack
+    for (guint i = tail; i-- > 0;) {
+        guint b = order[i];
+        double limit = INFINITY;
+        for (guint j = out_start[b]; j < out_start[b + 1]; j++) {
+            guint link = out_links[j];
+            limit = MIN(limit, xs[link_to[link]] - link_sep[link]);
+        }
+        if (limit != INFINITY) xs[b] = MAX(xs[b], limit);
+    }
+
+    // Every member of a block shares its root's position
+    for (guint v = 0; v < n; v++) {
+        xs[v] = xs[root[v]];
+    }
+    if (from_right) {
+        for (guint v = 0; v < n; v++) xs[v] = -xs[v];
+    }
+
+    #undef LAYER_AT
+    #undef NODE_AT
+    #undef POS_OF
+
+    g_free(link_from);
+    g_free(link_to);
+    g_free(link_sep);
+    g_free(in_count);
+    g_free(out_start);
+    g_free(out_links);
+    g_free(order);
+}
+
+// Brandes-Köpf: four alignments, shifted onto the narrowest one, then the
+// average of the two median candidates per node
+static void assign_positions(Layering* l) {
+    guint n = l->n_nodes;
+    guint max_degree = 1;
+    for (guint v = 0; v < n; v++) {
+        max_degree = MAX(max_degree, l->up_start[v + 1] - l->up_start[v]);
+        max_degree = MAX(max_degree, l->down_start[v + 1] - l->down_start[v]);
+    }
+
+    double* xs[4];
+    guint* root = g_new(guint, n);
+    guint* align = g_new(guint, n);
+    SortItem* items = g_new(SortItem, max_degree);
+    for (int variant = 0; variant < 4; variant++) {
+        xs[variant] = g_new(double, n);
+        place_variant(l, variant & 1, variant & 2, xs[variant], root, align, items);
+    }
+
+    double min_x[4], max_x[4];
+    int narrowest = 0;
+    for (int variant = 0; variant < 4; variant++) {
+        min_x[variant] = INFINITY;
+        max_x[variant] = -INFINITY;
+        for (guint v = 0; v < n; v++) {
+            min_x[variant] = MIN(min_x[variant], xs[variant][v] - l->size[v] / 2);
+            max_x[variant] = MAX(max_x[variant], xs[variant][v] + l->size[v] / 2);
+        }
+        if (max_x[variant] - min_x[variant] < max_x[narrowest] - min_x[narrowest]) {
+            narrowest = variant;
+        }
+    }
+    for (int variant = 0; variant < 4; variant++) {
+        double delta = (variant & 2) ? max_x[narrowest] - max_x[variant]
+                                     : min_x[narrowest] - min_x[variant];
+        for (guint v = 0; v < n; v++) xs[variant][v] += delta;
+    }
+
+    for (guint v = 0; v < n; v++) {
+        double c[4] = { xs[0][v], xs[1][v], xs[2][v], xs[3][v] };
+        for (int a = 1; a < 4; a++) {
+            double value = c[a];
+            int b = a;
+            for (; b > 0 && c[b - 1] > value; b--) c[b] = c[b - 1];
+            c[b] = value;
+        }
+        l->y[v] = (c[1] + c[2]) / 2;
+    }
+
+    for (int variant = 0; variant < 4; variant++) g_free(xs[variant]);
+    g_free(root);
+    g_free(align);
+    g_free(items);
+}
+
+// Keeps the picture where it was: the new positions are shifted by the
+// mean movement of the nodes that were already there, and unaffected
+// ranks take their previous positions exactly. The whole layout only
+// moves if something would end up above 0.
+static void anchor_positions(Layering* l) {
+    double shift = 0;
+    guint n_known = 0;
+    for (guint v = 0; v < l->n_real; v++) {
+        if (isnan(l->prev_y[v])) continue;
+        shift += l->prev_y[v] - l->y[v];
+        n_known++;
+    }
+
+    if (n_known > 0) {
+        shift /= n_known;
+        for (guint v = 0; v < l->n_nodes; v++) {
+            l->y[v] = l->affected[l->rank[v]] ? l->y[v] + shift : l->prev_y[v];
+        }
+    }
+
+    double top = INFINITY;
+    for (guint v = 0; v < l->n_nodes; v++) {
+        top = MIN(top, l->y[v] - l->size[v] / 2);
+    }
+    if (n_known > 0 && top >= 0) return;
+    for (guint v = 0; v < l->n_nodes; v++) {
+        l->y[v] -= top;
+    }
+}
+
+// Edges leave the right side of the lower ranked node, pass through their
+// dummies and enter the left side of the other end, with horizontal
+// tangents at every joint
+static void route_edge(const Layering* l, guint e, const double* column_x,
+                       LayoutEdge* edge) {
+    guint start = l->chain_start[e];
+    guint length = l->chain_start[e + 1] - start;
+    if (length < 2) return;
+
+    edge->n_points = 1 + 3 * (length - 1);
+    edge->points = g_new(double, 2 * edge->n_points);
+
+    double* p = edge->points;
+    guint first = l->chain_nodes[start];
+    double ax = column_x[l->rank[first]] + l->width[first] / 2;
+    double ay = l->y[first];
+    *p++ = ax;
+    *p++ = ay;
+    for (guint k = 1; k < length; k++) {
+        guint v = l->chain_nodes[start + k];
+        double bx = column_x[l->rank[v]] - (k + 1 == length ? l->width[v] / 2 : 0);
+        double by = l->y[v];
+        double mid = (ax + bx) / 2;
+        *p++ = mid; *p++ = ay;
+        *p++ = mid; *p++ = by;
+        *p++ = bx;  *p++ = by;
+        ax = bx;
+        ay = by;
+    }
+
+    // Points run from the edge's source to its target
+    if (l->reversed[e]) {
+        for (guint a = 0, b = edge->n_points - 1; a < b; a++, b--) {
+            double tx = edge->points[2 * a], ty = edge->points[2 * a + 1];
+            edge->points[2 * a] = edge->points[2 * b];
+            edge->points[2 * a + 1] = edge->points[2 * b + 1];
+            edge->points[2 * b] = tx;
+            edge->points[2 * b + 1] = ty;
+        }
+    }
+}
+
+static GraphLayout* build_layout(Layering* l) {
+    // Columns are as wide as their widest node
+    double* column_width = g_new0(double, l->n_ranks);
+    double* column_x = g_new(double, l->n_ranks);
+    for (guint v = 0; v < l->n_real; v++) {
+        column_width[l->rank[v]] = MAX(column_width[l->rank[v]], l->width[v]);
+    }
+    double x = 0;
+    for (guint r = 0; r < l->n_ranks; r++) {
+        column_x[r] = x + column_width[r] / 2;
+        x += column_width[r] + RANK_SEP;
+    }
+
+    GraphLayout* layout = graph_layout_new_for_request(l->request);
+    for (guint v = 0; v < l->n_real; v++) {
+        LayoutNode* node = &layout->nodes[v];
+        node->x = column_x[l->rank[v]];
+        node->y = l->y[v];
+        node->width = l->width[v];
+        node->height = l->size[v];
+        node->rank = (int)l->rank[v];
+        layout->width = MAX(layout->width, node->x + node->width / 2);
+        layout->height = MAX(layout->height, node->y + node->height / 2);
+    }
+    for (guint e = 0; e < layout->n_edges; e++) {
+        route_edge(l, e, column_x, &layout->edges[e]);
+    }
+
+    g_free(column_width);
+    g_free(column_x);
+    return layout;
+}
+
+GraphLayout* layered_layout_compute(LayoutRequest* request, GCancellable* cancellable) {
+    Layering* l = g_new0(Layering, 1);
+    l->request = request;
+    l->n_real = request->names->len;
+    l->rank = g_new0(guint, MAX(l->n_real, 1));
+    l->reversed = g_new0(gboolean, MAX(request->edges->len, 1));
+
+    break_cycles(l);
+    assign_ranks(l);
+    build_chains(l);
+
+    l->width = g_new0(double, l->n_nodes);
+    l->size = g_new0(double, l->n_nodes);
+    l->y = g_new0(double, l->n_nodes);
+    for (guint v = 0; v < l->n_real; v++) {
+        l->width[v] = graph_layout_node_width(request, v);
+        l->size[v] = LAYOUT_NODE_HEIGHT;
+    }
+
+    match_previous(l);
+    if (!reduce_crossings(l, cancellable)) {
+        layering_free(l);
+        return NULL;
+    }
+
+    mark_conflicts(l);
+    assign_positions(l);
+    anchor_positions(l);
+
+    GraphLayout* layout = build_layout(l);
+    layering_free(l);
+    return layout;
+}
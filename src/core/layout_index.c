@@ -0,0 +1,302 @@
+#include "graph_layout-private.h"
+#include <math.h>
+
+// Uniform grid over a finished layout, so drawing and hit testing only
+// look at what is near the viewport. Nodes are filed under the cell that
+// holds their centre and queries widen the rectangle by the largest half
+// size instead, so every node is found once. Edges are filed under every
+// cell their control points' bounding box touches and reported from the
+// first cell they share with the query; edges spanning too many cells are
+// kept apart and tested against their box on every query.
+
+#define MIN_CELL_SIZE 64.0
+#define MAX_EDGE_CELLS 64
+
+struct _GraphLayoutIndex {
+    double origin_x;
+    double origin_y;
+    double cell_size;
+    guint cols;
+    guint rows;
+
+    guint* node_start;        // Per cell, into node_items (CSR)
+    guint* node_items;
+    LayoutCluster* clusters;  // Per cell, boxes of the nodes filed there
+
+    guint* edge_start;        // Per cell, into edge_items (CSR)
+    guint* edge_items;
+    guint* long_edges;
+    guint n_long_edges;
+    double* edge_box;         // x0, y0, x1, y1 per edge
+
+    double max_half_width;
+    double max_half_height;
+};
+
+typedef struct {
+    guint x0;
+    guint y0;
+    guint x1;
+    guint y1;
+} CellRange;
+
+static guint cell_column(const GraphLayoutIndex* index, double x) {
+    double c = floor((x - index->origin_x) / index->cell_size);
+    return (guint)CLAMP(c, 0, index->cols - 1);
+}
+
+static guint cell_row(const GraphLayoutIndex* index, double y) {
+    double r = floor((y - index->origin_y) / index->cell_size);
+    return (guint)CLAMP(r, 0, index->rows - 1);
+}
+
+static CellRange cell_range(const GraphLayoutIndex* index,
+                            double x0, double y0, double x1, double y1) {
+    return (CellRange){
+        cell_column(index, x0), cell_row(index, y0),
+        cell_column(index, x1), cell_row(index, y1),
+    };
+}
+
+static guint range_size(CellRange range) {
+    return (range.x1 - range.x0 + 1) * (range.y1 - range.y0 + 1);
+}
+
+static void edge_bounds(const LayoutEdge* edge, double* box) {
+    box[0] = box[1] = INFINITY;
+    box[2] = box[3] = -INFINITY;
+    for (guint p = 0; p < edge->n_points; p++) {
+        box[0] = MIN(box[0], edge->points[2 * p]);
+        box[1] = MIN(box[1], edge->points[2 * p + 1]);
+        box[2] = MAX(box[2], edge->points[2 * p]);
+        box[3] = MAX(box[3], edge->points[2 * p + 1]);
+    }
+}
+
+void graph_layout_build_index(GraphLayout* layout) {
+    GraphLayoutIndex* index = g_new0(GraphLayoutIndex, 1);
+
+    // Extent of everything drawn; layouts normally start at 0
+    double min_x = 0, min_y = 0;
+    double max_x = layout->width, max_y = layout->height;
+    for (guint i = 0; i < layout->n_nodes; i++) {
+        const LayoutNode* node = &layout->nodes[i];
+        min_x = MIN(min_x, node->x);
+        min_y = MIN(min_y, node->y);
+        max_x = MAX(max_x, node->x);
+        max_y = MAX(max_y, node->y);
+        index->max_half_width = MAX(index->max_half_width, node->width / 2);
+        index->max_half_height = MAX(index->max_half_height, node->height / 2);
+    }
+
+    // About one node per cell
+    double area = MAX(max_x - min_x, 1) * MAX(max_y - min_y, 1);
+    index->cell_size = MAX(MIN_CELL_SIZE, sqrt(area / MAX(layout->n_nodes, 1)));
+    index->origin_x = min_x;
+    index->origin_y = min_y;
+    index->cols = (guint)((max_x - min_x) / index->cell_size) + 1;
+    index->rows = (guint)((max_y - min_y) / index->cell_size) + 1;
+    guint n_cells = index->cols * index->rows;
+
+    index->node_start = g_new0(guint, n_cells + 1);
+    index->node_items = g_new(guint, MAX(layout->n_nodes, 1));
+    index->clusters = g_new0(LayoutCluster, n_cells);
+    guint* node_cell = g_new(guint, MAX(layout->n_nodes, 1));
+    for (guint i = 0; i < layout->n_nodes; i++) {
+        const LayoutNode* node = &layout->nodes[i];
+        node_cell[i] = cell_row(index, node->y) * index->cols + cell_column(index, node->x);
+        index->node_start[node_cell[i] + 1]++;
+
+        LayoutCluster* cluster = &index->clusters[node_cell[i]];
+        double x0 = node->x - node->width / 2, x1 = node->x + node->width / 2;
+        double y0 = node->y - node->height / 2, y1 = node->y + node->height / 2;
+        if (cluster->n_nodes == 0) {
+            *cluster = (LayoutCluster){ x0, y0, x1 - x0, y1 - y0, 0, FALSE };
+        } else {
+            double right = MAX(cluster->x + cluster->width, x1);
+            double bottom = MAX(cluster->y + cluster->height, y1);
+            cluster->x = MIN(cluster->x, x0);
+            cluster->y = MIN(cluster->y, y0);
+            cluster->width = right - cluster->x;
+            cluster->height = bottom - cluster->y;
+        }
+        cluster->n_nodes++;
+        cluster->conflict |= node->conflict;
+    }
+    for (guint c = 0; c < n_cells; c++) {
+        index->node_start[c + 1] += index->node_start[c];
+    }
+    guint* fill = g_memdup2(index->node_start, n_cells * sizeof(guint));
+    for (guint i = 0; i < layout->n_nodes; i++) {
+        index->node_items[fill[node_cell[i]]++] = i;
+    }
+    g_free(fill);
+    g_free(node_cell);
+
+    index->edge_box = g_new(double, 4 * MAX(layout->n_edges, 1));
+    index->edge_start = g_new0(guint, n_cells + 1);
+    index->long_edges = g_new(guint, MAX(layout->n_edges, 1));
+    CellRange* ranges = g_new(CellRange, MAX(layout->n_edges, 1));
+    for (guint e = 0; e < layout->n_edges; e++) {
+        double* box = &index->edge_box[4 * e];
+        edge_bounds(&layout->edges[e], box);
+        if (layout->edges[e].n_points == 0) continue;
+
+        ranges[e] = cell_range(index, box[0], box[1], box[2], box[3]);
+        if (range_size(ranges[e]) > MAX_EDGE_CELLS) {
+            index->long_edges[index->n_long_edges++] = e;
+            continue;
+        }
+        for (guint r = ranges[e].y0; r <= ranges[e].y1; r++) {
+            for (guint c = ranges[e].x0; c <= ranges[e].x1; c++) {
+                index->edge_start[r * index->cols + c + 1]++;
+            }
+        }
+    }
+    for (guint c = 0; c < n_cells; c++) {
+        index->edge_start[c + 1] += index->edge_start[c];
+    }
+    index->edge_items = g_new(guint, MAX(index->edge_start[n_cells], 1));
+    fill = g_memdup2(index->edge_start, n_cells * sizeof(guint));
+    for (guint e = 0; e < layout->n_edges; e++) {
+        if (layout->edges[e].n_points == 0 || range_size(ranges[e]) > MAX_EDGE_CELLS) continue;
+
+        for (guint r = ranges[e].y0; r <= ranges[e].y1; r++) {
+            for (guint c = ranges[e].x0; c <= ranges[e].x1; c++) {
+                index->edge_items[fill[r * index->cols + c]++] = e;
+            }
+        }
+    }
+    g_free(fill);
+    g_free(ranges);
+
+    layout->index = index;
+}
+
+void graph_layout_index_free(GraphLayoutIndex* index) {
+    if (!index) return;
+
+    g_free(index->node_start);
+    g_free(index->node_items);
+    g_free(index->clusters);
+    g_free(index->edge_start);
+    g_free(index->edge_items);
+    g_free(index->long_edges);
+    g_free(index->edge_box);
+    g_free(index);
+}
+
+static gint compare_indices(gconstpointer a, gconstpointer b) {
+    guint x = *(const guint*)a;
+    guint y = *(const guint*)b;
+    return (x > y) - (x < y);
+}
+
+static gboolean boxes_intersect(const double* box, double x0, double y0, double x1, double y1) {
+    return box[0] <= x1 && box[2] >= x0 && box[1] <= y1 && box[3] >= y0;
+}
+
+void graph_layout_query(GraphLayout* layout,
+                        double x, double y, double width, double height,
+                        GArray* nodes, GArray* edges) {
+    const GraphLayoutIndex* index = layout->index;
+    double x1 = x + width, y1 = y + height;
+
+    if (nodes) {
+        g_array_set_size(nodes, 0);
+        CellRange range = cell_range(index, x - index->max_half_width, y - index->max_half_height,
+                                     x1 + index->max_half_width, y1 + index->max_half_height);
+        for (guint r = range.y0; r <= range.y1; r++) {
+            for (guint c = range.x0; c <= range.x1; c++) {
+                guint cell = r * index->cols + c;
+                for (guint i = index->node_start[cell]; i < index->node_start[cell + 1]; i++) {
+                    guint n = index->node_items[i];
+                    const LayoutNode* node = &layout->nodes[n];
+                    double box[4] = { node->x - node->width / 2, node->y - node->height / 2,
+                                      node->x + node->width / 2, node->y + node->height / 2 };
+                    if (boxes_intersect(box, x, y, x1, y1)) {
+                        g_array_append_val(nodes, n);
+                    }
+                }
+            }
+        }
+        // Drawing order is index order
+        g_array_sort(nodes, compare_indices);
+    }
+
+    if (edges) {
+        g_array_set_size(edges, 0);
+        CellRange range = cell_range(index, x, y, x1, y1);
+        for (guint r = range.y0; r <= range.y1; r++) {
+            for (guint c = range.x0; c <= range.x1; c++) {
+                guint cell = r * index->cols + c;
+                for (guint i = index->edge_start[cell]; i < index->edge_start[cell + 1]; i++) {
+                    guint e = index->edge_items[i];
+                    const double* box = &index->edge_box[4 * e];
+                    if (!boxes_intersect(box, x, y, x1, y1)) continue;
+
+                    // Report only from the first cell shared with the query
+                    CellRange own = cell_range(index, box[0], box[1], box[2], box[3]);
+                    if (c == MAX(own.x0, range.x0) && r == MAX(own.y0, range.y0)) {
+                        g_array_append_val(edges, e);
+                    }
+                }
+            }
+        }
+        for (guint i = 0; i < index->n_long_edges; i++) {
+            guint e = index->long_edges[i];
+            if (boxes_intersect(&index->edge_box[4 * e], x, y, x1, y1)) {
+                g_array_append_val(edges, e);
+            }
+        }
+    }
+}
+
+// Hit testing runs on every pointer motion, so it looks at the few cells
+// around the point directly instead of collecting into an array
+int graph_layout_node_at(GraphLayout* layout, double x, double y) {
+    const GraphLayoutIndex* index = layout->index;
+    CellRange range = cell_range(index, x - index->max_half_width, y - index->max_half_height,
+                                 x + index->max_half_width, y + index->max_half_height);
+
+    // Later nodes are drawn on top
+    int hit = -1;
+    for (guint r = range.y0; r <= range.y1; r++) {
+        for (guint c = range.x0; c <= range.x1; c++) {
+            guint cell = r * index->cols + c;
+            for (guint i = index->node_start[cell]; i < index->node_start[cell + 1]; i++) {
+                guint n = index->node_items[i];
+                const LayoutNode* node = &layout->nodes[n];
+                if ((int)n > hit &&
+                    fabs(x - node->x) <= node->width / 2 &&
+                    fabs(y - node->y) <= node->height / 2) {
+                    hit = (int)n;
+                }
+            }
+        }
+    }
+    return hit;
+}
+
+void graph_layout_query_clusters(GraphLayout* layout,
+                                 double x, double y, double width, double height,
+                                 GArray* clusters) {
+    const GraphLayoutIndex* index = layout->index;
+    g_array_set_size(clusters, 0);
+
+    CellRange range = cell_range(index, x - index->max_half_width, y - index->max_half_height,
+                                 x + width + index->max_half_width,
+                                 y + height + index->max_half_height);
+    for (guint r = range.y0; r <= range.y1; r++) {
+        for (guint c = range.x0; c <= range.x1; c++) {
+            const LayoutCluster* cluster = &index->clusters[r * index->cols + c];
+            if (cluster->n_nodes > 0) {
+                g_array_append_val(clusters, *cluster);
+            }
+        }
+    }
+}
+
+double graph_layout_cluster_size(GraphLayout* layout) {
+    return layout->index->cell_size;
+}
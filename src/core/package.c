@@ -12,36 +12,11 @@
 #include <glib/gprintf.h>
 #include <glib/gstdio.h>
 
-#define COMMAND_BUFFER_SIZE 2048
-#define OUTPUT_BUFFER_SIZE 4096
 #define MAX_NAME_LEN 256
 // #define MAX_PACKAGE_NAME MAX_NAME_LEN
 
 static char error_message[256] = {0};
 
-// Utility function to execute pip commands and capture output
-static char* execute_pip_command(const char* command) {
-    FILE* pipe = popen(command, "r");
-    if (!pipe) {
-        snprintf(error_message, sizeof(error_message), "Failed to execute: %s", command);
-        return NULL;
-    }
-
-    char* output = malloc(OUTPUT_BUFFER_SIZE);
-    size_t total = 0;
-    char buffer[128];
-
-    while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-        size_t len = strlen(buffer);
-        if (total + len >= OUTPUT_BUFFER_SIZE) break;
-        strcpy(output + total, buffer);
-        total += len;
-    }
-
-    pclose(pipe);
-    return output;
-}
-
 #include "../include/venv_analyzer.h"
 #include "types.h"
 #include <string.h>
@@ -107,6 +82,57 @@ package_new(const char* name, const char* version)
     return pkg;
 }
 
+// Deep copy for handing packages to another thread; dependency and
+// conflict order is preserved. Entries are malloc'ed like the originals.
+Package*
+package_copy(Package* pkg)
+{
+    Package* copy = package_new(pkg->name, pkg->version);
+    g_strlcpy(copy->description, pkg->description, sizeof(copy->description));
+    copy->size = pkg->size;
+    copy->fingerprint = pkg->fingerprint;
+
+    PackageDep** tail = &copy->dependencies;
+    for (PackageDep* dep = pkg->dependencies; dep; dep = dep->next) {
+        *tail = malloc(sizeof(PackageDep));
+        if (!*tail) break;
+        memcpy(*tail, dep, sizeof(PackageDep));
+        tail = &(*tail)->next;
+    }
+    *tail = NULL;
+
+    tail = &copy->conflicts;
+    for (PackageDep* conflict = pkg->conflicts; conflict; conflict = conflict->next) {
+        *tail = malloc(sizeof(PackageDep));
+        if (!*tail) break;
+        memcpy(*tail, conflict, sizeof(PackageDep));
+        tail = &(*tail)->next;
+    }
+    *tail = NULL;
+
+    return copy;
+}
+
+static bool deps_equal(const PackageDep* a, const PackageDep* b) {
+    for (; a && b; a = a->next, b = b->next) {
+        if (strcmp(a->name, b->name) != 0 || strcmp(a->version, b->version) != 0) {
+            return false;
+        }
+    }
+    return a == b;
+}
+
+// Everything a view shows; the list link is not compared
+bool package_equal(const Package* a, const Package* b) {
+    return strcmp(a->name, b->name) == 0 &&
+           strcmp(a->version, b->version) == 0 &&
+           strcmp(a->description, b->description) == 0 &&
+           a->size == b->size &&
+           a->fingerprint == b->fingerprint &&
+           deps_equal(a->dependencies, b->dependencies) &&
+           deps_equal(a->conflicts, b->conflicts);
+}
+
 // Accessors
 const char* package_get_name(Package* pkg)
 {
@@ -156,47 +182,42 @@ void package_set_next(Package* pkg, Package* next)
     pkg->next = next;
 }
 
-bool package_update_size_from_pip(Package* package) {
-    char command[COMMAND_BUFFER_SIZE];
-    snprintf(command, sizeof(command), "pip show %s", package->name);
-    
-    char* output = execute_pip_command(command);
-    if (!output) return false;
-
-    // Parse pip show output for location
-    char* location = strstr(output, "Location: ");
-    if (location) {
-        location += 10; // Skip "Location: "
-        char* newline = strchr(location, '\n');
-        if (newline) *newline = '\0';
-
-        // Construct path safely using g_build_filename
-        char* pkg_path = g_build_filename(location, package->name, NULL);
-        if (!pkg_path) {
-            free(output);
-            return false;
-        }
-
-        // Use g_build_filename for command construction
-        char* quoted_path = g_shell_quote(pkg_path);
-        char* du_command = g_strdup_printf("du -sb %s 2>/dev/null", quoted_path);
-        
-        char* size_output = execute_pip_command(du_command);
-        if (size_output) {
-            package->size = strtoull(size_output, NULL, 10);
-            free(size_output);
-        }
-
-        g_free(quoted_path);
-        g_free(du_command);
+// Sizes the package directory under the Location: reported by pip show.
+// Runs du without a shell and keeps no state, so scan workers may call it.
+gboolean package_update_size_from_pip(Package* package, const char* pip_show_output,
+                                      GError** error) {
+    const char* location = strstr(pip_show_output, "Location: ");
+    if (!location) return TRUE;
+
+    location += 10; // Skip "Location: "
+    char* dir = g_strndup(location, strcspn(location, "\r\n"));
+    char* pkg_path = g_build_filename(dir, package->name, NULL);
+    g_free(dir);
+
+    // Distributions whose import name differs from the project name keep
+    // their size unknown, as before
+    if (!g_file_test(pkg_path, G_FILE_TEST_IS_DIR)) {
         g_free(pkg_path);
+        return TRUE;
     }
 
-    free(output);
-    return true;
-}
-
+    const char* argv[] = { "du", "-sb", pkg_path, NULL };
+    char* output = NULL;
+    int status = 0;
+    gboolean ok = g_spawn_sync(NULL, (char**)argv, NULL,
+                               G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL,
+                               NULL, NULL, &output, NULL, &status, error) &&
+                  g_spawn_check_wait_status(status, error);
+    if (ok) {
+        package->size = g_ascii_strtoull(output, NULL, 10);
+    } else {
+        g_prefix_error(error, "Failed to size %s: ", package->name);
+    }
 
+    g_free(output);
+    g_free(pkg_path);
+    return ok;
+}
 
 void package_add_dependency(Package* package, const char* name, const char* version) {
     PackageDep* dep = calloc(1, sizeof(PackageDep));
@@ -218,6 +239,14 @@ void package_add_conflict(Package* package, const char* name, const char* versio
     package->conflicts = conflict;
 }
 
+void package_clear_conflicts(Package* package) {
+    while (package->conflicts) {
+        PackageDep* next = package->conflicts->next;
+        free(package->conflicts);
+        package->conflicts = next;
+    }
+}
+
 bool package_has_dependency(Package* package, const char* name) {
     PackageDep* dep = package->dependencies;
     while (dep) {
@@ -227,48 +256,43 @@ bool package_has_dependency(Package* package, const char* name) {
     return false;
 }
 
+// A specifier that cannot be read is not held against the version
 bool package_version_satisfies(const char* version, const char* requirement) {
-    // Handle wildcard version requirement
-    if (strcmp(requirement, "*") == 0) return true;
-    
-    // Parse version strings into components
-    int v1[3] = {0}, v2[3] = {0};
-    if (sscanf(version, "%d.%d.%d", &v1[0], &v1[1], &v1[2]) < 1 ||
-        sscanf(requirement, "%d.%d.%d", &v2[0], &v2[1], &v2[2]) < 1) {
-        return false;
-    }
-
-    // Compare version components
-    for (int i = 0; i < 3; i++) {
-        if (v1[i] < v2[i]) return false;
-        if (v1[i] > v2[i]) return true;
-    }
-
-    return true;  // Versions are equal
+    VersionRange range;
+    if (!package_version_range_parse(requirement, &range)) return true;
+
+    guint8 key[VERSION_KEY_LEN];
+    package_version_key(version, key);
+    bool satisfied = package_version_range_contains(&range, key);
+    package_version_range_clear(&range);
+    return satisfied;
 }
 
-
 void package_free(Package* package) {
     if (!package) return;
 
-    // Free dependencies
-    PackageDep* dep = package->dependencies;
-    while (dep) {
-        PackageDep* next = dep->next;
-        g_free(dep);
-        dep = next;
-    }
+    // Dependency and conflict lists are released in package_finalize
+    g_object_unref(package);
+}
 
-    // Free conflicts
-    PackageDep* conflict = package->conflicts;
-    while (conflict) {
-        PackageDep* next = conflict->next;
-        g_free(conflict);
-        conflict = next;
+char* package_normalize_name(const char* name) {
+    // PEP 503: lowercase, runs of "-", "_" and "." collapse to one "-"
+    GString* normalized = g_string_sized_new(strlen(name));
+    bool in_separator = false;
+
+    for (const char* p = name; *p; p++) {
+        if (*p == '-' || *p == '_' || *p == '.') {
+            in_separator = true;
+            continue;
+        }
+        if (in_separator && normalized->len > 0) {
+            g_string_append_c(normalized, '-');
+        }
+        in_separator = false;
+        g_string_append_c(normalized, g_ascii_tolower(*p));
     }
 
-    // Since we're using GObject, we need to use g_object_unref
-    g_object_unref(package);
+    return g_string_free(normalized, FALSE);
 }
 
 VersionCompareResult package_compare_versions(const char* version1, const char* version2) {
@@ -287,6 +311,248 @@ VersionCompareResult package_compare_versions(const char* version1, const char*
     return VERSION_EQUAL;
 }
 
+#define VERSION_KEY_RELEASE_PARTS 6
+
+enum {
+    VERSION_PHASE_DEV = 0x10,
+    VERSION_PHASE_ALPHA = 0x20,
+    VERSION_PHASE_BETA = 0x30,
+    VERSION_PHASE_RC = 0x40,
+    VERSION_PHASE_FINAL = 0x80,
+    VERSION_PHASE_POST = 0x90
+};
+
+static void put_u32_be(guint8* out, guint32 value) {
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+static guint32 parse_version_number(const char** p) {
+    char* end;
+    unsigned long value = strtoul(*p, &end, 10);
+    *p = end;
+    return value > G_MAXUINT32 ? G_MAXUINT32 : (guint32)value;
+}
+
+void package_version_key(const char* version, guint8 key[VERSION_KEY_LEN]) {
+    // Longer spellings first so "alpha" is not read as "a" + garbage
+    static const struct {
+        const char* tag;
+        guint8 phase;
+    } phases[] = {
+        { "alpha", VERSION_PHASE_ALPHA }, { "beta", VERSION_PHASE_BETA },
+        { "preview", VERSION_PHASE_RC }, { "pre", VERSION_PHASE_RC },
+        { "rc", VERSION_PHASE_RC }, { "rev", VERSION_PHASE_POST },
+        { "post", VERSION_PHASE_POST }, { "dev", VERSION_PHASE_DEV },
+        { "a", VERSION_PHASE_ALPHA }, { "b", VERSION_PHASE_BETA },
+        { "c", VERSION_PHASE_RC }, { "r", VERSION_PHASE_POST },
+    };
+
+    memset(key, 0, VERSION_KEY_LEN);
+    const char* p = version;
+    if (*p == 'v' || *p == 'V') p++;
+
+    const char* bang = strchr(p, '!');
+    if (bang) {
+        put_u32_be(key, parse_version_number(&p));
+        p = bang + 1;
+    }
+
+    for (int part = 0; g_ascii_isdigit(*p); part++) {
+        guint32 value = parse_version_number(&p);
+        if (part < VERSION_KEY_RELEASE_PARTS) {
+            put_u32_be(key + 4 + part * 4, value);
+        }
+        if (*p != '.' || !g_ascii_isdigit(p[1])) break;
+        p++;
+    }
+
+    guint8 phase = VERSION_PHASE_FINAL;
+    guint32 number = 0;
+    while (*p == '.' || *p == '-' || *p == '_') p++;
+
+    if (*p && *p != '+') {
+        gboolean matched = FALSE;
+        for (gsize i = 0; i < G_N_ELEMENTS(phases); i++) {
+            gsize len = strlen(phases[i].tag);
+            if (g_ascii_strncasecmp(p, phases[i].tag, len) == 0) {
+                phase = phases[i].phase;
+                p += len;
+                matched = TRUE;
+                break;
+            }
+        }
+        while (*p == '.' || *p == '-' || *p == '_') p++;
+        if (g_ascii_isdigit(*p)) {
+            // A bare number after "-" is an implicit post release ("1.0-1")
+            if (!matched) phase = VERSION_PHASE_POST;
+            number = parse_version_number(&p);
+            number = MIN(number, 0xFFFFFFu);
+        }
+    }
+
+    key[28] = phase;
+    key[29] = number >> 16;
+    key[30] = number >> 8;
+    key[31] = number;
+}
+
+static int compare_version_keys(const guint8* a, gsize a_len, const guint8* b, gsize b_len) {
+    int order = memcmp(a, b, MIN(a_len, b_len));
+    if (order != 0) return order;
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+// Tighten one side of the range. Exclusive lower and inclusive upper
+// bounds use the key followed by its zero byte.
+static void range_raise_lower(VersionRange* range, const guint8* key, gboolean exclusive) {
+    gsize len = exclusive ? VERSION_KEY_LEN + 1 : VERSION_KEY_LEN;
+    if (compare_version_keys(key, len, range->lower, range->lower_len) > 0) {
+        memcpy(range->lower, key, len);
+        range->lower_len = len;
+    }
+}
+
+static void range_reduce_upper(VersionRange* range, const guint8* key, gboolean inclusive) {
+    gsize len = inclusive ? VERSION_KEY_LEN + 1 : VERSION_KEY_LEN;
+    if (compare_version_keys(key, len, range->upper, range->upper_len) < 0) {
+        memcpy(range->upper, key, len);
+        range->upper_len = len;
+    }
+}
+
+// Key of the first pre-release after bumping the release segment of
+// version at index keep - 1 ("1.4.5", 2 -> "1.5.dev0"). Used for "~=" and
+// "==X.*", whose upper bounds exclude pre-releases of the next release.
+static gboolean bumped_release_key(const char* version, guint keep, guint8* key) {
+    char* release = g_strndup(version, strspn(version, "0123456789."));
+    char** parts = g_strsplit(release, ".", -1);
+    guint n_parts = 0;
+    while (parts[n_parts] && parts[n_parts][0]) n_parts++;
+
+    gboolean ok = keep > 0 && keep <= n_parts;
+    if (ok) {
+        GString* bumped = g_string_new(NULL);
+        for (guint i = 0; i < keep; i++) {
+            guint64 part = g_ascii_strtoull(parts[i], NULL, 10);
+            g_string_append_printf(bumped, "%s%" G_GUINT64_FORMAT,
+                                   i ? "." : "", i == keep - 1 ? part + 1 : part);
+        }
+        g_string_append(bumped, ".dev0");
+        package_version_key(bumped->str, key);
+        g_string_free(bumped, TRUE);
+    }
+
+    g_strfreev(parts);
+    g_free(release);
+    return ok;
+}
+
+static guint count_release_parts(const char* version) {
+    guint n_parts = 0;
+    for (const char* p = version; g_ascii_isdigit(*p); ) {
+        while (g_ascii_isdigit(*p)) p++;
+        n_parts++;
+        if (*p != '.') break;
+        p++;
+    }
+    return n_parts;
+}
+
+gboolean package_version_range_parse(const char* specifier, VersionRange* range) {
+    range->lower_len = 0;
+    memset(range->upper, 0xFF, sizeof(range->upper));
+    range->upper_len = sizeof(range->upper);
+    range->excluded = g_array_new(FALSE, FALSE, VERSION_KEY_LEN);
+
+    if (!specifier) return TRUE;
+
+    static const char* const operators[] = { "~=", "==", "!=", "<=", ">=", "<", ">" };
+    char** clauses = g_strsplit(specifier, ",", -1);
+    gboolean ok = TRUE;
+
+    for (char** clause = clauses; *clause && ok; clause++) {
+        char* text = g_strstrip(*clause);
+        if (!text[0] || strcmp(text, "*") == 0) continue;
+
+        const char* op = NULL;
+        for (gsize i = 0; i < G_N_ELEMENTS(operators); i++) {
+            if (g_str_has_prefix(text, operators[i])) {
+                op = operators[i];
+                break;
+            }
+        }
+
+        const char* version = op ? text + strlen(op) : text;
+        while (g_ascii_isspace(*version)) version++;
+        if (!op) op = "==";
+        if (!version[0]) {
+            ok = FALSE;
+            break;
+        }
+
+        guint8 key[VERSION_KEY_LEN + 1] = {0};
+        guint8 bumped[VERSION_KEY_LEN];
+
+        if (strcmp(op, "==") == 0 && g_str_has_suffix(version, ".*")) {
+            char* prefix = g_strndup(version, strlen(version) - 2);
+            char* first = g_strconcat(prefix, ".dev0", NULL);
+            package_version_key(first, key);
+            ok = bumped_release_key(prefix, count_release_parts(prefix), bumped);
+            range_raise_lower(range, key, FALSE);
+            if (ok) range_reduce_upper(range, bumped, FALSE);
+            g_free(first);
+            g_free(prefix);
+            continue;
+        }
+
+        package_version_key(version, key);
+        if (strcmp(op, "<") == 0) {
+            range_reduce_upper(range, key, FALSE);
+        } else if (strcmp(op, "<=") == 0) {
+            range_reduce_upper(range, key, TRUE);
+        } else if (strcmp(op, ">") == 0) {
+            range_raise_lower(range, key, TRUE);
+        } else if (strcmp(op, ">=") == 0) {
+            range_raise_lower(range, key, FALSE);
+        } else if (strcmp(op, "==") == 0) {
+            range_raise_lower(range, key, FALSE);
+            range_reduce_upper(range, key, TRUE);
+        } else if (strcmp(op, "!=") == 0) {
+            g_array_append_vals(range->excluded, key, 1);
+        } else {
+            // "~=X.Y" means ">=X.Y, ==X.*"
+            ok = bumped_release_key(version, count_release_parts(version) - 1, bumped);
+            range_raise_lower(range, key, FALSE);
+            if (ok) range_reduce_upper(range, bumped, FALSE);
+        }
+    }
+
+    g_strfreev(clauses);
+    if (!ok) g_clear_pointer(&range->excluded, g_array_unref);
+    return ok;
+}
+
+gboolean package_version_range_contains(const VersionRange* range,
+                                        const guint8 key[VERSION_KEY_LEN]) {
+    if (compare_version_keys(key, VERSION_KEY_LEN, range->lower, range->lower_len) < 0 ||
+        compare_version_keys(key, VERSION_KEY_LEN, range->upper, range->upper_len) >= 0) {
+        return FALSE;
+    }
+    for (guint i = 0; i < range->excluded->len; i++) {
+        if (memcmp(range->excluded->data + i * VERSION_KEY_LEN, key, VERSION_KEY_LEN) == 0) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+void package_version_range_clear(VersionRange* range) {
+    g_clear_pointer(&range->excluded, g_array_unref);
+}
+
 const char* package_get_last_error(void) {
     return error_message[0] ? error_message : "No error";
 }
\ No newline at end of file
@@ -13,6 +13,7 @@ G_DECLARE_FINAL_TYPE(Package, package, PACKAGE, PACKAGE, GObject)
 // Constructor
 Package* package_new(const char* name, const char* version);
 void package_free(Package* package);
+Package* package_copy(Package* package);
 
 // Accessors
 const char* package_get_name(Package* pkg);
@@ -27,14 +28,50 @@ void package_set_next(Package* pkg, Package* next);
 // Operations
 void package_add_dependency(Package* pkg, const char* name, const char* version);
 void package_add_conflict(Package* pkg, const char* name, const char* version);
+void package_clear_conflicts(Package* pkg);
 bool package_has_dependency(Package* pkg, const char* name);
-bool package_update_size_from_pip(Package* pkg);
+bool package_equal(const Package* a, const Package* b);
+gboolean package_update_size_from_pip(Package* pkg, const char* pip_show_output,
+                                      GError** error);
 void package_set_size(Package* package, size_t size);
+char* package_normalize_name(const char* name);
 
 // Version comparison
 bool package_version_satisfies(const char* version, const char* requirement);
 VersionCompareResult package_compare_versions(const char* ver1, const char* ver2);
 
+/**
+ * Packs a PEP 440 version into a fixed-size key whose memcmp order is the
+ * version order: epoch, six release components, then a phase byte
+ * (dev < a < b < rc < final < post) and the phase number, all big-endian
+ */
+#define VERSION_KEY_LEN 32
+void package_version_key(const char* version, guint8 key[VERSION_KEY_LEN]);
+
+/**
+ * A version specifier as a half-open [lower, upper) range of version keys
+ * plus the keys excluded with "!=". A key followed by a zero byte sorts
+ * directly after the key itself, which turns inclusive bounds into
+ * exclusive ones without leaving an index range scan.
+ */
+typedef struct {
+    guint8 lower[VERSION_KEY_LEN + 1];
+    gsize lower_len;
+    guint8 upper[VERSION_KEY_LEN + 1];
+    gsize upper_len;
+    GArray* excluded;
+} VersionRange;
+
+/**
+ * Parses comma-separated PEP 440 clauses ("<2", ">=1.26,<2", "~=2.2",
+ * "==1.4.*", "!=1.5"). NULL, empty and "*" match every version. Returns
+ * FALSE, with nothing left to clear, for a malformed specifier.
+ */
+gboolean package_version_range_parse(const char* specifier, VersionRange* range);
+gboolean package_version_range_contains(const VersionRange* range,
+                                        const guint8 key[VERSION_KEY_LEN]);
+void package_version_range_clear(VersionRange* range);
+
 G_END_DECLS
 
 #endif // PACKAGE_H
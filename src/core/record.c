@@ -0,0 +1,281 @@
+#include "record.h"
+#include "analyzer.h"
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char* path;     // Points into the file contents
+    guint64 size;
+    gboolean size_known;
+} RecordEntry;
+
+// A directory waiting for its children, which are the entries from first
+// to last sharing its path as a prefix of prefix_length characters
+typedef struct {
+    guint node;
+    guint first;
+    guint last;
+    gsize prefix_length;
+} PendingDir;
+
+// '/' orders before every other character, so a directory's entries come
+// before names extending its own ("pkg/" before "pkg-1.0.dist-info/") and
+// siblings end up in name order
+static int path_byte(guchar c) {
+    return c == '/' ? 1 : c == '\0' ? 0 : c + 1;
+}
+
+static gint compare_entries(gconstpointer a, gconstpointer b) {
+    const guchar* x = (const guchar*)((const RecordEntry*)a)->path;
+    const guchar* y = (const guchar*)((const RecordEntry*)b)->path;
+    while (*x && *x == *y) {
+        x++;
+        y++;
+    }
+    return path_byte(*x) - path_byte(*y);
+}
+
+// Splits one CSV line in place. Paths with commas or quotes are quoted,
+// with quotes inside doubled; hashes never need quoting.
+static gboolean parse_line(char* line, RecordEntry* entry) {
+    char* field = line;
+    if (*line == '"') {
+        char* out = line;
+        char* in = line + 1;
+        while (*in && !(in[0] == '"' && in[1] != '"')) {
+            if (*in == '"') in++;
+            *out++ = *in++;
+        }
+        if (*in != '"') return FALSE;
+        *out = '\0';
+        field = in + 1;
+    } else {
+        field = strchr(line, ',');
+        if (!field) field = line + strlen(line);
+    }
+    entry->path = line;
+    entry->size = 0;
+    entry->size_known = FALSE;
+    if (*field == '\0') return *line != '\0';
+    *field++ = '\0';
+
+    // Skip the hash
+    char* size = strchr(field, ',');
+    if (size && g_ascii_isdigit(size[1])) {
+        entry->size = g_ascii_strtoull(size + 1, NULL, 10);
+        entry->size_known = TRUE;
+    }
+    return *line != '\0';
+}
+
+static void stat_entry(const char* site_packages, RecordEntry* entry) {
+    char* path = g_build_filename(site_packages, entry->path, NULL);
+    GStatBuf st;
+    if (g_stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+        entry->size = st.st_size;
+        entry->size_known = TRUE;
+    }
+    g_free(path);
+}
+
+static guint add_node(GArray* nodes, GStringChunk* names, guint parent,
+                      const char* name, gsize length, gboolean is_dir) {
+    RecordNode node = {
+        .name = g_string_chunk_insert_len(names, name, length),
+        .parent = parent,
+        .is_dir = is_dir,
+    };
+    g_array_append_val(nodes, node);
+    return nodes->len - 1;
+}
+
+// Entries sharing a directory are contiguous once sorted by path, so
+// every directory's children come from one run of entries and are
+// numbered as a block when it is taken off the queue
+static RecordTree* build_tree(RecordEntry* entries, guint n_entries) {
+    RecordTree* tree = g_new0(RecordTree, 1);
+    tree->ref_count = 1;
+    tree->names = g_string_chunk_new(4096);
+    GArray* nodes = g_array_sized_new(FALSE, FALSE, sizeof(RecordNode), n_entries + 1);
+    add_node(nodes, tree->names, RECORD_ROOT, "", 0, TRUE);
+
+    GQueue queue = G_QUEUE_INIT;
+    PendingDir* root = g_new(PendingDir, 1);
+    *root = (PendingDir){ RECORD_ROOT, 0, n_entries, 0 };
+    g_queue_push_tail(&queue, root);
+    while (!g_queue_is_empty(&queue)) {
+        PendingDir* dir = g_queue_pop_head(&queue);
+        guint first_child = nodes->len;
+        guint i = dir->first;
+        while (i < dir->last) {
+            const char* name = entries[i].path + dir->prefix_length;
+            gsize length = strcspn(name, "/");
+            if (name[length] == '\0') {
+                guint node = add_node(nodes, tree->names, dir->node, name, length, FALSE);
+                RecordNode* file = &g_array_index(nodes, RecordNode, node);
+                file->size = entries[i].size;
+                file->size_known = entries[i].size_known;
+                file->n_files = 1;
+                i++;
+                continue;
+            }
+
+            guint end = i + 1;
+            while (end < dir->last &&
+                   strncmp(entries[end].path + dir->prefix_length, name, length + 1) == 0) {
+                end++;
+            }
+            PendingDir* child = g_new(PendingDir, 1);
+            *child = (PendingDir){
+                add_node(nodes, tree->names, dir->node, name, length, TRUE),
+                i, end, dir->prefix_length + length + 1
+            };
+            g_queue_push_tail(&queue, child);
+            i = end;
+        }
+
+        RecordNode* node = &g_array_index(nodes, RecordNode, dir->node);
+        node->first_child = first_child;
+        node->n_children = nodes->len - first_child;
+        g_free(dir);
+    }
+
+    // Children come after their parents, so one backwards pass adds up
+    // every directory
+    tree->n_nodes = nodes->len;
+    tree->nodes = (RecordNode*)g_array_free(nodes, FALSE);
+    for (guint i = tree->n_nodes - 1; i > RECORD_ROOT; i--) {
+        RecordNode* parent = &tree->nodes[tree->nodes[i].parent];
+        parent->size += tree->nodes[i].size;
+        parent->n_files += tree->nodes[i].n_files;
+    }
+    return tree;
+}
+
+RecordTree* record_tree_load(const char* path, gboolean stat_missing, GError** error) {
+    char* contents = NULL;
+    gsize length = 0;
+    if (!g_file_get_contents(path, &contents, &length, error)) return NULL;
+
+    // RECORD sits in <site-packages>/<name>.dist-info/
+    char* dist_info = g_path_get_dirname(path);
+    char* site_packages = g_path_get_dirname(dist_info);
+    g_free(dist_info);
+
+    GArray* entries = g_array_new(FALSE, FALSE, sizeof(RecordEntry));
+    char* line = contents;
+    while (line < contents + length) {
+        char* end = memchr(line, '\n', contents + length - line);
+        if (!end) end = contents + length;
+        *end = '\0';
+        if (end > line && end[-1] == '\r') end[-1] = '\0';
+
+        RecordEntry entry;
+        if (parse_line(line, &entry)) {
+            if (!entry.size_known && stat_missing) {
+                stat_entry(site_packages, &entry);
+            }
+            g_array_append_val(entries, entry);
+        }
+        line = end + 1;
+    }
+    g_array_sort(entries, compare_entries);
+
+    RecordTree* tree = build_tree((RecordEntry*)entries->data, entries->len);
+    g_array_unref(entries);
+    g_free(site_packages);
+    g_free(contents);
+    return tree;
+}
+
+RecordTree* record_tree_ref(RecordTree* tree) {
+    g_atomic_int_inc(&tree->ref_count);
+    return tree;
+}
+
+void record_tree_unref(RecordTree* tree) {
+    if (!tree || !g_atomic_int_dec_and_test(&tree->ref_count)) return;
+
+    g_string_chunk_free(tree->names);
+    g_free(tree->nodes);
+    g_free(tree);
+}
+
+char* record_tree_get_path(const RecordTree* tree, guint node) {
+    GPtrArray* parts = g_ptr_array_new();
+    for (guint i = node; i != RECORD_ROOT; i = tree->nodes[i].parent) {
+        g_ptr_array_add(parts, (gpointer)tree->nodes[i].name);
+    }
+
+    GString* path = g_string_new(NULL);
+    for (guint i = parts->len; i > 0; i--) {
+        g_string_append(path, g_ptr_array_index(parts, i - 1));
+        if (i > 1) g_string_append_c(path, '/');
+    }
+    g_ptr_array_unref(parts);
+    return g_string_free(path, FALSE);
+}
+
+typedef struct {
+    char* venv_path;
+    char* package;
+} RecordRequest;
+
+static void record_request_free(gpointer data) {
+    RecordRequest* request = data;
+    g_free(request->venv_path);
+    g_free(request->package);
+    g_free(request);
+}
+
+static void record_thread(GTask* task,
+                          gpointer source_object G_GNUC_UNUSED,
+                          gpointer task_data,
+                          GCancellable* cancellable G_GNUC_UNUSED) {
+    RecordRequest* request = task_data;
+    GHashTable* records = venv_analyzer_find_records(request->venv_path);
+    char* key = package_normalize_name(request->package);
+    const char* path = records ? g_hash_table_lookup(records, key) : NULL;
+    g_free(key);
+
+    GError* error = NULL;
+    RecordTree* tree = NULL;
+    if (!path) {
+        g_set_error(&error, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_NO_RECORD,
+                    "%s has no RECORD listing its files", request->package);
+    } else {
+        tree = record_tree_load(path, TRUE, &error);
+    }
+    if (records) {
+        g_hash_table_unref(records);
+    }
+
+    if (!tree) {
+        g_task_return_error(task, error);
+    } else if (!g_task_return_error_if_cancelled(task)) {
+        g_task_return_pointer(task, tree, (GDestroyNotify)record_tree_unref);
+    } else {
+        record_tree_unref(tree);
+    }
+}
+
+void record_tree_load_async(const char* venv_path,
+                            const char* package,
+                            GCancellable* cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data) {
+    RecordRequest* request = g_new0(RecordRequest, 1);
+    request->venv_path = g_strdup(venv_path);
+    request->package = g_strdup(package);
+
+    GTask* task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, record_tree_load_async);
+    g_task_set_task_data(task, request, record_request_free);
+    g_task_run_in_thread(task, record_thread);
+    g_object_unref(task);
+}
+
+RecordTree* record_tree_load_finish(GAsyncResult* result, GError** error) {
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
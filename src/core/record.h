@@ -0,0 +1,64 @@
+#ifndef CORE_RECORD_H
+#define CORE_RECORD_H
+
+#include <gio/gio.h>
+
+// The files a distribution installed, read from the RECORD file pip
+// writes into its dist-info directory (one "path,hash,size" CSV line per
+// file, paths relative to site-packages) and folded into a directory tree
+// with subtotals.
+
+#define RECORD_ROOT 0
+
+typedef struct {
+    const char* name;     // Last path component; "" for the root
+    guint64 size;         // Bytes; for directories the sum over their contents
+    guint parent;         // Containing directory; the root is its own parent
+    guint first_child;    // Directories only: their children are the
+    guint n_children;     // nodes first_child .. first_child + n_children - 1
+    guint n_files;        // Files at or below this node
+    gboolean is_dir;
+    gboolean size_known;  // Files only: RECORD or the file system gave a size
+} RecordNode;
+
+// Immutable once loaded and reference counted, so rows of a file list
+// can keep it alive
+typedef struct {
+    gint ref_count;
+    RecordNode* nodes;    // Breadth first, so siblings are contiguous and
+    guint n_nodes;        // sorted by name; nodes[RECORD_ROOT] is the root
+    GStringChunk* names;
+} RecordTree;
+
+/**
+ * Parses a RECORD file. Entries without a size (RECORD itself, and
+ * bytecode compiled at install time) count as empty unless stat_missing
+ * is set, in which case the file next to site-packages is looked up.
+ * @return New tree or NULL on error
+ */
+RecordTree* record_tree_load(const char* path, gboolean stat_missing, GError** error);
+RecordTree* record_tree_ref(RecordTree* tree);
+void record_tree_unref(RecordTree* tree);
+
+/**
+ * Finds the RECORD of an installed package under venv_path and parses it
+ * in a worker thread, looking up the sizes RECORD leaves out
+ */
+void record_tree_load_async(const char* venv_path,
+                            const char* package,
+                            GCancellable* cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data);
+
+/**
+ * @return New tree, or NULL on error; VENV_ANALYZER_ERROR_NO_RECORD if
+ *         the package has no RECORD
+ */
+RecordTree* record_tree_load_finish(GAsyncResult* result, GError** error);
+
+/**
+ * @return Path of node relative to site-packages, free with g_free
+ */
+char* record_tree_get_path(const RecordTree* tree, guint node);
+
+#endif // CORE_RECORD_H
@@ -0,0 +1,50 @@
+#include "requirement_owners.h"
+
+typedef struct {
+    guint from;
+    guint to;
+} EdgeEnds;
+
+static const EdgeEnds* edge_at(GArray* edges, guint e) {
+    return (const EdgeEnds*)(edges->data + (gsize)e * g_array_get_element_size(edges));
+}
+
+guint* requirement_owners_find(guint n_nodes, GArray* edges, const gboolean* excluded) {
+    guint* owner = g_new(guint, MAX(n_nodes, 1));
+    gboolean* required = g_new0(gboolean, MAX(n_nodes, 1));
+    guint* first_edge = g_new0(guint, n_nodes + 1);
+    for (guint e = 0; e < edges->len; e++) {
+        const EdgeEnds* edge = edge_at(edges, e);
+        required[edge->to] = TRUE;
+        first_edge[edge->from + 1]++;
+    }
+    for (guint i = 0; i < n_nodes; i++) {
+        first_edge[i + 1] += first_edge[i];
+    }
+
+    // Edges are sorted by source, so first_edge indexes them directly
+    GQueue queue = G_QUEUE_INIT;
+    for (guint i = 0; i < n_nodes; i++) {
+        gboolean root = !required[i] && !(excluded && excluded[i]);
+        owner[i] = root ? i : OWNER_NONE;
+        if (root) g_queue_push_tail(&queue, GUINT_TO_POINTER(i));
+    }
+    while (!g_queue_is_empty(&queue)) {
+        guint v = GPOINTER_TO_UINT(g_queue_pop_head(&queue));
+        for (guint e = first_edge[v]; e < first_edge[v + 1]; e++) {
+            guint w = edge_at(edges, e)->to;
+            if (excluded && excluded[w]) continue;
+
+            guint spread = owner[w] == OWNER_NONE ? owner[v] :
+                           owner[w] == owner[v] ? owner[w] : OWNER_SHARED;
+            if (spread != owner[w]) {
+                owner[w] = spread;
+                g_queue_push_tail(&queue, GUINT_TO_POINTER(w));
+            }
+        }
+    }
+
+    g_free(required);
+    g_free(first_edge);
+    return owner;
+}
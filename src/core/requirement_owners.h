@@ -0,0 +1,26 @@
+#ifndef CORE_REQUIREMENT_OWNERS_H
+#define CORE_REQUIREMENT_OWNERS_H
+
+#include <glib.h>
+
+// Which top-level requirement (a package nothing depends on) each package
+// was installed for, shared by the graph's and the treemap's grouping by
+// requirement
+
+#define OWNER_NONE G_MAXUINT          // Only reached through dependency cycles
+#define OWNER_SHARED (G_MAXUINT - 1)  // Reached from two or more requirements
+
+/**
+ * Spreads owners from the roots along edges in a single worklist pass: a
+ * node's owner only ever goes from none to one root to shared, so each
+ * node is revisited at most twice.
+ * @param edges Sorted by source; elements start with guint from and to,
+ *              as EdgeKey and TreemapEdge do
+ * @param excluded gboolean per node left out of the pass, neither owning
+ *                 nor owned, or NULL
+ * @return Owner per node: the root's index, OWNER_NONE or OWNER_SHARED;
+ *         free with g_free
+ */
+guint* requirement_owners_find(guint n_nodes, GArray* edges, const gboolean* excluded);
+
+#endif // CORE_REQUIREMENT_OWNERS_H
@@ -0,0 +1,475 @@
+#include "snapshot.h"
+#include <string.h>
+
+// File layout, every section 8-byte aligned:
+//   SnapshotHeader
+//   SnapshotPackage[n_packages]      sorted by normalized name
+//   guint32[n_packages + 1]          first edge of each package
+//   SnapshotEdge[n_edges]
+//   guint32[n_packages + 1]          first dependent of each package
+//   guint32[n_reverse_edges]         dependent package indexes
+//   char[strings_size]               NUL-terminated, deduplicated strings
+#define SNAPSHOT_MAGIC "VENVSNAP"
+
+typedef struct {
+    char magic[8];
+    guint32 format_version;
+    guint32 n_packages;
+    guint32 n_edges;
+    guint32 n_reverse_edges;
+    guint64 created;
+    guint32 venv_path;
+    guint32 reserved;
+    guint64 packages_offset;
+    guint64 edge_index_offset;
+    guint64 edges_offset;
+    guint64 reverse_index_offset;
+    guint64 reverse_edges_offset;
+    guint64 strings_offset;
+    guint64 strings_size;
+} SnapshotHeader;
+
+typedef struct {
+    guint8 version_key[VERSION_KEY_LEN];
+    guint64 size;
+    guint64 fingerprint;
+    guint32 name;  // String table offsets
+    guint32 normalized_name;
+    guint32 version;
+    guint32 summary;
+} SnapshotPackage;
+
+typedef struct {
+    guint32 target;
+    guint32 name;
+    guint32 constraint;
+} SnapshotEdge;
+
+G_STATIC_ASSERT(sizeof(SnapshotHeader) == 96);
+G_STATIC_ASSERT(sizeof(SnapshotPackage) == 64);
+G_STATIC_ASSERT(sizeof(SnapshotEdge) == 12);
+
+struct _VenvSnapshot {
+    gint ref_count;
+    GMappedFile* file;
+    const SnapshotHeader* header;
+    const SnapshotPackage* packages;
+    const guint32* edge_index;
+    const SnapshotEdge* edges;
+    const guint32* reverse_index;
+    const guint32* reverse_edges;
+    const char* strings;
+    gsize strings_size;
+    guint n_packages;
+    guint n_edges;
+    guint n_reverse_edges;
+};
+
+// Writing
+
+typedef struct {
+    GByteArray* data;
+    GHashTable* offsets;  // string -> offset in data
+} StringTable;
+
+static guint32 string_table_add(StringTable* table, const char* str) {
+    gpointer offset;
+    if (g_hash_table_lookup_extended(table->offsets, str, NULL, &offset)) {
+        return GPOINTER_TO_UINT(offset);
+    }
+
+    guint32 new_offset = table->data->len;
+    g_byte_array_append(table->data, (const guint8*)str, strlen(str) + 1);
+    g_hash_table_insert(table->offsets, g_strdup(str), GUINT_TO_POINTER(new_offset));
+    return new_offset;
+}
+
+typedef struct {
+    char* normalized_name;
+    Package* package;
+} SortEntry;
+
+static int compare_sort_entries(gconstpointer a, gconstpointer b) {
+    return strcmp(((const SortEntry*)a)->normalized_name,
+                  ((const SortEntry*)b)->normalized_name);
+}
+
+static void append_aligned(GByteArray* out, const void* data, gsize len, guint64* offset) {
+    static const guint8 padding[8] = {0};
+    g_byte_array_append(out, padding, (8 - out->len % 8) % 8);
+    *offset = GUINT64_TO_LE((guint64)out->len);
+    g_byte_array_append(out, data, len);
+}
+
+gboolean venv_snapshot_write(const char* path,
+                             const char* venv_path,
+                             Package* packages,
+                             GError** error) {
+    GArray* entries = g_array_new(FALSE, FALSE, sizeof(SortEntry));
+    for (Package* pkg = packages; pkg; pkg = pkg->next) {
+        SortEntry entry = { package_normalize_name(pkg->name), pkg };
+        g_array_append_val(entries, entry);
+    }
+    g_array_sort(entries, compare_sort_entries);
+
+    guint n_packages = entries->len;
+    GHashTable* index_of = g_hash_table_new(g_str_hash, g_str_equal);
+    for (guint i = 0; i < n_packages; i++) {
+        SortEntry* entry = &g_array_index(entries, SortEntry, i);
+        g_hash_table_insert(index_of, entry->normalized_name, GUINT_TO_POINTER(i + 1));
+    }
+
+    StringTable strings = {
+        g_byte_array_new(),
+        g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL),
+    };
+    string_table_add(&strings, "");
+
+    SnapshotPackage* records = g_new0(SnapshotPackage, n_packages);
+    guint32* edge_index = g_new0(guint32, n_packages + 1);
+    guint32* dependent_counts = g_new0(guint32, n_packages + 1);
+    GArray* edges = g_array_new(FALSE, FALSE, sizeof(SnapshotEdge));
+
+    for (guint i = 0; i < n_packages; i++) {
+        SortEntry* entry = &g_array_index(entries, SortEntry, i);
+        Package* pkg = entry->package;
+        SnapshotPackage* record = &records[i];
+
+        package_version_key(pkg->version, record->version_key);
+        record->size = GUINT64_TO_LE((guint64)pkg->size);
+        record->fingerprint = GUINT64_TO_LE(pkg->fingerprint);
+        record->name = GUINT32_TO_LE(string_table_add(&strings, pkg->name));
+        record->normalized_name = GUINT32_TO_LE(string_table_add(&strings, entry->normalized_name));
+        record->version = GUINT32_TO_LE(string_table_add(&strings, pkg->version));
+        record->summary = GUINT32_TO_LE(string_table_add(&strings, pkg->description));
+
+        edge_index[i] = GUINT32_TO_LE(edges->len);
+        for (PackageDep* dep = pkg->dependencies; dep; dep = dep->next) {
+            char* key = package_normalize_name(dep->name);
+            guint target = GPOINTER_TO_UINT(g_hash_table_lookup(index_of, key));
+            g_free(key);
+
+            SnapshotEdge edge = {
+                GUINT32_TO_LE(target ? target - 1 : SNAPSHOT_NO_PACKAGE),
+                GUINT32_TO_LE(string_table_add(&strings, dep->name)),
+                GUINT32_TO_LE(string_table_add(&strings, dep->version)),
+            };
+            g_array_append_val(edges, edge);
+            if (target) dependent_counts[target - 1]++;
+        }
+    }
+    edge_index[n_packages] = GUINT32_TO_LE(edges->len);
+
+    // Reverse CSR; filling sources in index order keeps each row sorted
+    guint32* reverse_index = g_new0(guint32, n_packages + 1);
+    guint n_reverse = 0;
+    for (guint i = 0; i < n_packages; i++) {
+        reverse_index[i] = n_reverse;
+        n_reverse += dependent_counts[i];
+        dependent_counts[i] = reverse_index[i];
+    }
+    reverse_index[n_packages] = n_reverse;
+
+    guint32* reverse_edges = g_new0(guint32, MAX(n_reverse, 1));
+    for (guint i = 0; i < n_packages; i++) {
+        guint start = GUINT32_FROM_LE(edge_index[i]);
+        guint end = GUINT32_FROM_LE(edge_index[i + 1]);
+        for (guint e = start; e < end; e++) {
+            guint target = GUINT32_FROM_LE(g_array_index(edges, SnapshotEdge, e).target);
+            if (target != SNAPSHOT_NO_PACKAGE) {
+                reverse_edges[dependent_counts[target]++] = GUINT32_TO_LE(i);
+            }
+        }
+    }
+    for (guint i = 0; i <= n_packages; i++) {
+        reverse_index[i] = GUINT32_TO_LE(reverse_index[i]);
+    }
+
+    SnapshotHeader header = {0};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.format_version = GUINT32_TO_LE(SNAPSHOT_FORMAT_VERSION);
+    header.n_packages = GUINT32_TO_LE(n_packages);
+    header.n_edges = GUINT32_TO_LE(edges->len);
+    header.n_reverse_edges = GUINT32_TO_LE(n_reverse);
+    header.created = GUINT64_TO_LE((guint64)(g_get_real_time() / G_USEC_PER_SEC));
+    header.venv_path = GUINT32_TO_LE(string_table_add(&strings, venv_path));
+    header.strings_size = GUINT64_TO_LE((guint64)strings.data->len);
+
+    GByteArray* out = g_byte_array_new();
+    g_byte_array_append(out, (const guint8*)&header, sizeof(header));
+    append_aligned(out, records, n_packages * sizeof(SnapshotPackage), &header.packages_offset);
+    append_aligned(out, edge_index, (n_packages + 1) * sizeof(guint32), &header.edge_index_offset);
+    append_aligned(out, edges->data, edges->len * sizeof(SnapshotEdge), &header.edges_offset);
+    append_aligned(out, reverse_index, (n_packages + 1) * sizeof(guint32),
+                   &header.reverse_index_offset);
+    append_aligned(out, reverse_edges, n_reverse * sizeof(guint32), &header.reverse_edges_offset);
+    append_aligned(out, strings.data->data, strings.data->len, &header.strings_offset);
+    memcpy(out->data, &header, sizeof(header));
+
+    gboolean ok = g_file_set_contents(path, (const char*)out->data, out->len, error);
+
+    g_byte_array_unref(out);
+    g_free(reverse_edges);
+    g_free(reverse_index);
+    g_array_unref(edges);
+    g_free(dependent_counts);
+    g_free(edge_index);
+    g_free(records);
+    g_hash_table_unref(strings.offsets);
+    g_byte_array_unref(strings.data);
+    g_hash_table_unref(index_of);
+    for (guint i = 0; i < n_packages; i++) {
+        g_free(g_array_index(entries, SortEntry, i).normalized_name);
+    }
+    g_array_unref(entries);
+    return ok;
+}
+
+// Reading
+
+// Checks that count elements at offset lie inside the file and are aligned
+static gboolean section_fits(gsize length, guint64 offset, guint64 count, gsize element_size) {
+    offset = GUINT64_FROM_LE(offset);
+    return offset % 8 == 0 && offset <= length &&
+           count <= (length - offset) / element_size;
+}
+
+VenvSnapshot* venv_snapshot_open(const char* path, GError** error) {
+    GMappedFile* file = g_mapped_file_new(path, FALSE, error);
+    if (!file) return NULL;
+
+    const char* data = g_mapped_file_get_contents(file);
+    gsize length = g_mapped_file_get_length(file);
+    const SnapshotHeader* header = (const SnapshotHeader*)data;
+
+    if (length < sizeof(SnapshotHeader) ||
+        memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0) {
+        g_set_error(error, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_INVALID_SNAPSHOT,
+                   "%s is not a snapshot file", path);
+        g_mapped_file_unref(file);
+        return NULL;
+    }
+
+    if (GUINT32_FROM_LE(header->format_version) != SNAPSHOT_FORMAT_VERSION) {
+        g_set_error(error, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_INVALID_SNAPSHOT,
+                   "%s uses unsupported snapshot format %u", path,
+                   GUINT32_FROM_LE(header->format_version));
+        g_mapped_file_unref(file);
+        return NULL;
+    }
+
+    guint n_packages = GUINT32_FROM_LE(header->n_packages);
+    guint n_edges = GUINT32_FROM_LE(header->n_edges);
+    guint n_reverse_edges = GUINT32_FROM_LE(header->n_reverse_edges);
+    guint64 strings_size = GUINT64_FROM_LE(header->strings_size);
+    const char* strings = data + GUINT64_FROM_LE(header->strings_offset);
+
+    // Only the section bounds are checked here; accessors bounds-check the
+    // offsets they follow, so corrupt contents read as empty, never outside
+    if (!section_fits(length, header->packages_offset, n_packages, sizeof(SnapshotPackage)) ||
+        !section_fits(length, header->edge_index_offset, (guint64)n_packages + 1, sizeof(guint32)) ||
+        !section_fits(length, header->edges_offset, n_edges, sizeof(SnapshotEdge)) ||
+        !section_fits(length, header->reverse_index_offset, (guint64)n_packages + 1, sizeof(guint32)) ||
+        !section_fits(length, header->reverse_edges_offset, n_reverse_edges, sizeof(guint32)) ||
+        !section_fits(length, header->strings_offset, strings_size, 1) ||
+        strings_size == 0 || strings[strings_size - 1] != '\0') {
+        g_set_error(error, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_INVALID_SNAPSHOT,
+                   "%s is truncated or corrupt", path);
+        g_mapped_file_unref(file);
+        return NULL;
+    }
+
+    VenvSnapshot* snapshot = g_new0(VenvSnapshot, 1);
+    snapshot->ref_count = 1;
+    snapshot->file = file;
+    snapshot->header = header;
+    snapshot->packages = (const SnapshotPackage*)(data + GUINT64_FROM_LE(header->packages_offset));
+    snapshot->edge_index = (const guint32*)(data + GUINT64_FROM_LE(header->edge_index_offset));
+    snapshot->edges = (const SnapshotEdge*)(data + GUINT64_FROM_LE(header->edges_offset));
+    snapshot->reverse_index = (const guint32*)(data + GUINT64_FROM_LE(header->reverse_index_offset));
+    snapshot->reverse_edges = (const guint32*)(data + GUINT64_FROM_LE(header->reverse_edges_offset));
+    snapshot->strings = strings;
+    snapshot->strings_size = strings_size;
+    snapshot->n_packages = n_packages;
+    snapshot->n_edges = n_edges;
+    snapshot->n_reverse_edges = n_reverse_edges;
+    return snapshot;
+}
+
+VenvSnapshot* venv_snapshot_ref(VenvSnapshot* snapshot) {
+    g_atomic_int_inc(&snapshot->ref_count);
+    return snapshot;
+}
+
+void venv_snapshot_unref(VenvSnapshot* snapshot) {
+    if (!snapshot || !g_atomic_int_dec_and_test(&snapshot->ref_count)) return;
+
+    g_mapped_file_unref(snapshot->file);
+    g_free(snapshot);
+}
+
+static const char* snapshot_string(VenvSnapshot* snapshot, guint32 offset) {
+    offset = GUINT32_FROM_LE(offset);
+    return offset < snapshot->strings_size ? snapshot->strings + offset : "";
+}
+
+// Reads row [start, end) of a CSR index, clamped to the edge count
+static void csr_row(const guint32* index, guint row, guint n_edges, guint* start, guint* end) {
+    *end = MIN(GUINT32_FROM_LE(index[row + 1]), n_edges);
+    *start = MIN(GUINT32_FROM_LE(index[row]), *end);
+}
+
+const char* venv_snapshot_get_venv_path(VenvSnapshot* snapshot) {
+    return snapshot_string(snapshot, snapshot->header->venv_path);
+}
+
+gint64 venv_snapshot_get_created(VenvSnapshot* snapshot) {
+    return (gint64)GUINT64_FROM_LE(snapshot->header->created);
+}
+
+guint venv_snapshot_get_n_packages(VenvSnapshot* snapshot) {
+    return snapshot->n_packages;
+}
+
+const char* venv_snapshot_package_name(VenvSnapshot* snapshot, guint index) {
+    g_return_val_if_fail(index < snapshot->n_packages, "");
+    return snapshot_string(snapshot, snapshot->packages[index].name);
+}
+
+const char* venv_snapshot_package_normalized_name(VenvSnapshot* snapshot, guint index) {
+    g_return_val_if_fail(index < snapshot->n_packages, "");
+    return snapshot_string(snapshot, snapshot->packages[index].normalized_name);
+}
+
+const char* venv_snapshot_package_version(VenvSnapshot* snapshot, guint index) {
+    g_return_val_if_fail(index < snapshot->n_packages, "");
+    return snapshot_string(snapshot, snapshot->packages[index].version);
+}
+
+const char* venv_snapshot_package_summary(VenvSnapshot* snapshot, guint index) {
+    g_return_val_if_fail(index < snapshot->n_packages, "");
+    return snapshot_string(snapshot, snapshot->packages[index].summary);
+}
+
+const guint8* venv_snapshot_package_version_key(VenvSnapshot* snapshot, guint index) {
+    g_return_val_if_fail(index < snapshot->n_packages, NULL);
+    return snapshot->packages[index].version_key;
+}
+
+guint64 venv_snapshot_package_size(VenvSnapshot* snapshot, guint index) {
+    g_return_val_if_fail(index < snapshot->n_packages, 0);
+    return GUINT64_FROM_LE(snapshot->packages[index].size);
+}
+
+guint64 venv_snapshot_package_fingerprint(VenvSnapshot* snapshot, guint index) {
+    g_return_val_if_fail(index < snapshot->n_packages, 0);
+    return GUINT64_FROM_LE(snapshot->packages[index].fingerprint);
+}
+
+guint venv_snapshot_find_package(VenvSnapshot* snapshot, const char* name) {
+    char* key = package_normalize_name(name);
+    guint low = 0;
+    guint high = snapshot->n_packages;
+    guint found = SNAPSHOT_NO_PACKAGE;
+
+    while (low < high) {
+        guint mid = low + (high - low) / 2;
+        int order = strcmp(venv_snapshot_package_normalized_name(snapshot, mid), key);
+        if (order == 0) {
+            found = mid;
+            break;
+        }
+        if (order < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    g_free(key);
+    return found;
+}
+
+// Returns the edge for the nth dependency of a package, or NULL
+static const SnapshotEdge* dependency_edge(VenvSnapshot* snapshot, guint index, guint nth) {
+    g_return_val_if_fail(index < snapshot->n_packages, NULL);
+
+    guint start, end;
+    csr_row(snapshot->edge_index, index, snapshot->n_edges, &start, &end);
+    return nth < end - start ? &snapshot->edges[start + nth] : NULL;
+}
+
+guint venv_snapshot_package_n_dependencies(VenvSnapshot* snapshot, guint index) {
+    g_return_val_if_fail(index < snapshot->n_packages, 0);
+
+    guint start, end;
+    csr_row(snapshot->edge_index, index, snapshot->n_edges, &start, &end);
+    return end - start;
+}
+
+const char* venv_snapshot_dependency_name(VenvSnapshot* snapshot, guint index, guint nth) {
+    const SnapshotEdge* edge = dependency_edge(snapshot, index, nth);
+    return edge ? snapshot_string(snapshot, edge->name) : "";
+}
+
+const char* venv_snapshot_dependency_constraint(VenvSnapshot* snapshot, guint index, guint nth) {
+    const SnapshotEdge* edge = dependency_edge(snapshot, index, nth);
+    return edge ? snapshot_string(snapshot, edge->constraint) : "";
+}
+
+guint venv_snapshot_dependency_target(VenvSnapshot* snapshot, guint index, guint nth) {
+    const SnapshotEdge* edge = dependency_edge(snapshot, index, nth);
+    if (!edge) return SNAPSHOT_NO_PACKAGE;
+
+    guint target = GUINT32_FROM_LE(edge->target);
+    return target < snapshot->n_packages ? target : SNAPSHOT_NO_PACKAGE;
+}
+
+guint venv_snapshot_package_n_dependents(VenvSnapshot* snapshot, guint index) {
+    g_return_val_if_fail(index < snapshot->n_packages, 0);
+
+    guint start, end;
+    csr_row(snapshot->reverse_index, index, snapshot->n_reverse_edges, &start, &end);
+    return end - start;
+}
+
+guint venv_snapshot_dependent(VenvSnapshot* snapshot, guint index, guint nth) {
+    g_return_val_if_fail(index < snapshot->n_packages, SNAPSHOT_NO_PACKAGE);
+
+    guint start, end;
+    csr_row(snapshot->reverse_index, index, snapshot->n_reverse_edges, &start, &end);
+    if (nth >= end - start) return SNAPSHOT_NO_PACKAGE;
+
+    guint source = GUINT32_FROM_LE(snapshot->reverse_edges[start + nth]);
+    return source < snapshot->n_packages ? source : SNAPSHOT_NO_PACKAGE;
+}
+
+Package* venv_snapshot_to_packages(VenvSnapshot* snapshot) {
+    Package* head = NULL;
+    Package* tail = NULL;
+
+    for (guint i = 0; i < snapshot->n_packages; i++) {
+        Package* pkg = package_new(venv_snapshot_package_name(snapshot, i),
+                                   venv_snapshot_package_version(snapshot, i));
+        pkg->size = venv_snapshot_package_size(snapshot, i);
+        pkg->fingerprint = venv_snapshot_package_fingerprint(snapshot, i);
+        g_strlcpy(pkg->description, venv_snapshot_package_summary(snapshot, i),
+                  sizeof(pkg->description));
+
+        // package_add_dependency prepends, so add in reverse to keep order
+        guint n_deps = venv_snapshot_package_n_dependencies(snapshot, i);
+        for (guint d = n_deps; d-- > 0; ) {
+            package_add_dependency(pkg, venv_snapshot_dependency_name(snapshot, i, d),
+                                   venv_snapshot_dependency_constraint(snapshot, i, d));
+        }
+
+        if (tail) {
+            tail->next = pkg;
+        } else {
+            head = pkg;
+        }
+        tail = pkg;
+    }
+
+    return head;
+}
@@ -0,0 +1,75 @@
+#ifndef CORE_SNAPSHOT_H
+#define CORE_SNAPSHOT_H
+
+#include "../include/venv_analyzer.h"
+#include "package.h"
+#include <glib.h>
+
+// Binary scan snapshots. A snapshot file is mapped read-only and used in
+// place: opening one only validates the header, and every accessor reads
+// straight from the mapping. Integers are stored little-endian.
+
+#define SNAPSHOT_FORMAT_VERSION 1
+#define SNAPSHOT_NO_PACKAGE G_MAXUINT32
+
+/**
+ * Writes packages as a snapshot of venv_path, replacing path atomically
+ * @return FALSE on error
+ */
+gboolean venv_snapshot_write(const char* path,
+                             const char* venv_path,
+                             Package* packages,
+                             GError** error);
+
+/**
+ * Maps a snapshot file. Costs O(1) apart from page faults on later access.
+ * @return New snapshot or NULL on error
+ */
+VenvSnapshot* venv_snapshot_open(const char* path, GError** error);
+
+VenvSnapshot* venv_snapshot_ref(VenvSnapshot* snapshot);
+void venv_snapshot_unref(VenvSnapshot* snapshot);
+
+const char* venv_snapshot_get_venv_path(VenvSnapshot* snapshot);
+gint64 venv_snapshot_get_created(VenvSnapshot* snapshot);
+
+/**
+ * Packages are indexed 0..n-1 in PEP 503 normalized name order
+ */
+guint venv_snapshot_get_n_packages(VenvSnapshot* snapshot);
+const char* venv_snapshot_package_name(VenvSnapshot* snapshot, guint index);
+const char* venv_snapshot_package_normalized_name(VenvSnapshot* snapshot, guint index);
+const char* venv_snapshot_package_version(VenvSnapshot* snapshot, guint index);
+const char* venv_snapshot_package_summary(VenvSnapshot* snapshot, guint index);
+const guint8* venv_snapshot_package_version_key(VenvSnapshot* snapshot, guint index);
+guint64 venv_snapshot_package_size(VenvSnapshot* snapshot, guint index);
+guint64 venv_snapshot_package_fingerprint(VenvSnapshot* snapshot, guint index);
+
+/**
+ * Binary search by name, normalized before lookup
+ * @return Package index or SNAPSHOT_NO_PACKAGE
+ */
+guint venv_snapshot_find_package(VenvSnapshot* snapshot, const char* name);
+
+/**
+ * Dependencies of a package (CSR rows). The target is the index of the
+ * installed package, or SNAPSHOT_NO_PACKAGE if it is not installed.
+ */
+guint venv_snapshot_package_n_dependencies(VenvSnapshot* snapshot, guint index);
+const char* venv_snapshot_dependency_name(VenvSnapshot* snapshot, guint index, guint nth);
+const char* venv_snapshot_dependency_constraint(VenvSnapshot* snapshot, guint index, guint nth);
+guint venv_snapshot_dependency_target(VenvSnapshot* snapshot, guint index, guint nth);
+
+/**
+ * Installed packages that depend on a package, in index order
+ */
+guint venv_snapshot_package_n_dependents(VenvSnapshot* snapshot, guint index);
+guint venv_snapshot_dependent(VenvSnapshot* snapshot, guint index, guint nth);
+
+/**
+ * Builds a Package list from the snapshot for code that needs GObjects
+ * @return Newly allocated list in index order
+ */
+Package* venv_snapshot_to_packages(VenvSnapshot* snapshot);
+
+#endif // CORE_SNAPSHOT_H
@@ -0,0 +1,563 @@
+#include "treemap.h"
+#include "analyzer.h"
+#include "record.h"
+#include "requirement_owners.h"
+#include <string.h>
+
+// Files and directories beyond this many siblings, or together smaller
+// than this share of their parent, are merged into one "N more" rect.
+// Packages are never merged, so each can still be found by hovering.
+#define TREEMAP_MAX_CHILDREN 256
+#define TREEMAP_MERGE_SHARE 0.005
+
+typedef struct _TreemapItem TreemapItem;
+
+struct _TreemapItem {
+    char* label;
+    guint64 size;             // Containers: the sum of their children
+    TreemapRectKind kind;
+    gboolean conflict;
+    TreemapItem** children;   // Largest first, NULL for leaves
+    guint n_children;
+};
+
+struct _TreemapItems {
+    gint ref_count;
+    TreemapItem* root;        // Unlabelled; its children fill the treemap
+    TreemapGrouping grouping;
+};
+
+typedef struct {
+    guint from;
+    guint to;
+} TreemapEdge;
+
+// Copy of what the worker needs, taken on the main thread
+typedef struct {
+    GPtrArray* names;         // Unique package names, index = package index
+    GArray* sizes;            // guint64 per package
+    GArray* conflicts;        // gboolean per package
+    GArray* edges;            // TreemapEdge sorted by source, grouping by
+                              // requirement only
+    char* venv_path;
+    TreemapGrouping grouping;
+    TreemapItems* items;      // Resizing only: what to lay out again
+    double width;
+    double height;
+} TreemapRequest;
+
+static TreemapItem* item_new(char* label, guint64 size, TreemapRectKind kind) {
+    TreemapItem* item = g_new0(TreemapItem, 1);
+    item->label = label;
+    item->size = size;
+    item->kind = kind;
+    return item;
+}
+
+static void item_free(TreemapItem* item) {
+    for (guint i = 0; i < item->n_children; i++) {
+        item_free(item->children[i]);
+    }
+    g_free(item->children);
+    g_free(item->label);
+    g_free(item);
+}
+
+static TreemapItems* items_ref(TreemapItems* items) {
+    g_atomic_int_inc(&items->ref_count);
+    return items;
+}
+
+static void items_unref(TreemapItems* items) {
+    if (!items || !g_atomic_int_dec_and_test(&items->ref_count)) return;
+
+    item_free(items->root);
+    g_free(items);
+}
+
+static gint compare_items(gconstpointer a, gconstpointer b) {
+    const TreemapItem* x = *(TreemapItem* const*)a;
+    const TreemapItem* y = *(TreemapItem* const*)b;
+    if (x->size != y->size) return x->size < y->size ? 1 : -1;
+    return g_strcmp0(x->label, y->label);
+}
+
+// Takes ownership of children and sorts them largest first; with merge
+// set, the tail too small to show goes into one rect
+static void set_children(TreemapItem* item, GPtrArray* children, gboolean merge) {
+    g_ptr_array_sort(children, compare_items);
+
+    guint64 total = 0;
+    for (guint i = 0; i < children->len; i++) {
+        total += ((TreemapItem*)g_ptr_array_index(children, i))->size;
+    }
+
+    guint keep = children->len;
+    if (merge) {
+        guint64 tail = 0;
+        keep = MIN(keep, TREEMAP_MAX_CHILDREN);
+        for (guint i = keep; i < children->len; i++) {
+            tail += ((TreemapItem*)g_ptr_array_index(children, i))->size;
+        }
+        while (keep > 1) {
+            guint64 size = ((TreemapItem*)g_ptr_array_index(children, keep - 1))->size;
+            if ((double)(tail + size) >= total * TREEMAP_MERGE_SHARE) break;
+            tail += size;
+            keep--;
+        }
+
+        // Merging a single rect gains nothing
+        if (children->len - keep < 2) keep = children->len;
+        if (keep < children->len) {
+            TreemapItem* other = item_new(g_strdup_printf("%u more", children->len - keep),
+                                          tail, TREEMAP_RECT_OTHER);
+            for (guint i = keep; i < children->len; i++) {
+                item_free(g_ptr_array_index(children, i));
+            }
+            g_ptr_array_set_size(children, keep);
+            g_ptr_array_add(children, other);
+            g_ptr_array_sort(children, compare_items);
+        }
+    }
+
+    item->size = total;
+    item->n_children = children->len;
+    item->children = (TreemapItem**)g_ptr_array_free(children, children->len == 0);
+}
+
+static TreemapItem* package_item(TreemapRequest* request, guint i) {
+    TreemapItem* item = item_new(g_strdup(g_ptr_array_index(request->names, i)),
+                                 g_array_index(request->sizes, guint64, i),
+                                 TREEMAP_RECT_PACKAGE);
+    item->conflict = g_array_index(request->conflicts, gboolean, i);
+    return item;
+}
+
+// Directories with nothing but one subdirectory are shown as one, "a/b"
+static TreemapItem* record_item(const RecordTree* tree, guint node) {
+    const RecordNode* dir = &tree->nodes[node];
+    if (!dir->is_dir) {
+        return item_new(g_strdup(dir->name), dir->size, TREEMAP_RECT_FILE);
+    }
+
+    GString* label = g_string_new(dir->name);
+    while (dir->n_children == 1 && tree->nodes[dir->first_child].is_dir) {
+        dir = &tree->nodes[dir->first_child];
+        if (label->len > 0) g_string_append_c(label, '/');
+        g_string_append(label, dir->name);
+    }
+
+    GPtrArray* children = g_ptr_array_new();
+    for (guint i = 0; i < dir->n_children; i++) {
+        if (tree->nodes[dir->first_child + i].size == 0) continue;
+        g_ptr_array_add(children, record_item(tree, dir->first_child + i));
+    }
+    TreemapItem* item = item_new(g_string_free(label, FALSE), 0, TREEMAP_RECT_DIRECTORY);
+    set_children(item, children, TRUE);
+    return item;
+}
+
+// Packages whose RECORD lists nothing with a size keep their own size
+static GPtrArray* files_items(TreemapRequest* request, GCancellable* cancellable) {
+    GHashTable* records = venv_analyzer_find_records(request->venv_path);
+    GPtrArray* top = g_ptr_array_new();
+    for (guint i = 0; i < request->names->len; i++) {
+        if (g_cancellable_is_cancelled(cancellable)) break;
+
+        TreemapItem* item = package_item(request, i);
+        char* key = package_normalize_name(item->label);
+        const char* path = records ? g_hash_table_lookup(records, key) : NULL;
+        RecordTree* tree = path ? record_tree_load(path, FALSE, NULL) : NULL;
+        if (tree && tree->nodes[RECORD_ROOT].size > 0) {
+            // A package installing one top-level directory shows it
+            TreemapItem* files = record_item(tree, RECORD_ROOT);
+            item->size = files->size;
+            if (*files->label) {
+                item->children = g_new(TreemapItem*, 1);
+                item->children[0] = files;
+                item->n_children = 1;
+            } else {
+                item->children = g_steal_pointer(&files->children);
+                item->n_children = files->n_children;
+                files->n_children = 0;
+                item_free(files);
+            }
+        }
+        record_tree_unref(tree);
+        g_free(key);
+
+        if (item->size > 0) {
+            g_ptr_array_add(top, item);
+        } else {
+            item_free(item);
+        }
+    }
+    if (records) {
+        g_hash_table_unref(records);
+    }
+    return top;
+}
+
+// Requirements that need nothing of their own stay single packages;
+// packages only dependency cycles lead to are left ungrouped
+static GPtrArray* requirement_items(TreemapRequest* request) {
+    guint n_packages = request->names->len;
+    guint* owner = requirement_owners_find(n_packages, request->edges, NULL);
+    GPtrArray** members = g_new0(GPtrArray*, n_packages);
+    GPtrArray* shared = g_ptr_array_new();
+    GPtrArray* top = g_ptr_array_new();
+    for (guint i = 0; i < n_packages; i++) {
+        if (g_array_index(request->sizes, guint64, i) == 0) continue;
+
+        TreemapItem* item = package_item(request, i);
+        if (owner[i] < n_packages) {
+            if (!members[owner[i]]) members[owner[i]] = g_ptr_array_new();
+            g_ptr_array_add(members[owner[i]], item);
+        } else if (owner[i] == OWNER_SHARED) {
+            g_ptr_array_add(shared, item);
+        } else {
+            g_ptr_array_add(top, item);
+        }
+    }
+
+    for (guint i = 0; i < n_packages; i++) {
+        if (!members[i]) continue;
+        if (members[i]->len == 1) {
+            g_ptr_array_add(top, g_ptr_array_index(members[i], 0));
+            g_ptr_array_unref(members[i]);
+            continue;
+        }
+        TreemapItem* group = item_new(g_strdup(g_ptr_array_index(request->names, i)), 0,
+                                      TREEMAP_RECT_GROUP);
+        set_children(group, members[i], FALSE);
+        g_ptr_array_add(top, group);
+    }
+    if (shared->len > 0) {
+        TreemapItem* group = item_new(g_strdup("Shared dependencies"), 0, TREEMAP_RECT_GROUP);
+        set_children(group, shared, FALSE);
+        g_ptr_array_add(top, group);
+    } else {
+        g_ptr_array_unref(shared);
+    }
+
+    g_free(members);
+    g_free(owner);
+    return top;
+}
+
+// @return New items, or NULL if cancelled
+static TreemapItems* build_items(TreemapRequest* request, GCancellable* cancellable) {
+    GPtrArray* top;
+    if (request->grouping == TREEMAP_GROUP_BY_FILES) {
+        top = files_items(request, cancellable);
+    } else if (request->grouping == TREEMAP_GROUP_BY_REQUIREMENT) {
+        top = requirement_items(request);
+    } else {
+        top = g_ptr_array_new();
+        for (guint i = 0; i < request->names->len; i++) {
+            if (g_array_index(request->sizes, guint64, i) == 0) continue;
+            g_ptr_array_add(top, package_item(request, i));
+        }
+    }
+
+    TreemapItems* items = g_new0(TreemapItems, 1);
+    items->ref_count = 1;
+    items->grouping = request->grouping;
+    items->root = item_new(NULL, 0, TREEMAP_RECT_GROUP);
+    set_children(items->root, top, FALSE);
+    if (g_cancellable_is_cancelled(cancellable)) {
+        g_clear_pointer(&items, items_unref);
+    }
+    return items;
+}
+
+static double worst_ratio(double side, double row_area, double largest, double smallest) {
+    double side2 = side * side;
+    double area2 = row_area * row_area;
+    return MAX(side2 * largest / area2, area2 / (side2 * smallest));
+}
+
+// Squarified layout (Bruls, Huizing and van Wijk): rows of children go
+// along the shorter side of what is left, each row taking children for as
+// long as that brings its rects closer to squares. boxes gets x, y, width
+// and height of every child.
+static void squarify(TreemapItem** children, guint n_children, guint64 total,
+                     double x, double y, double width, double height, double* boxes) {
+    if (width <= 0 || height <= 0 || total == 0) {
+        for (guint i = 0; i < n_children; i++) {
+            double* box = &boxes[4 * i];
+            box[0] = x;
+            box[1] = y;
+            box[2] = box[3] = 0;
+        }
+        return;
+    }
+
+    double scale = width * height / total;
+    guint start = 0;
+    while (start < n_children) {
+        double side = MIN(width, height);
+        double largest = children[start]->size * scale;
+        double row_area = 0;
+        double worst = G_MAXDOUBLE;
+        guint end = start;
+        while (end < n_children) {
+            double area = children[end]->size * scale;
+            double ratio = worst_ratio(side, row_area + area, largest, area);
+            if (end > start && ratio > worst) break;
+            row_area += area;
+            worst = ratio;
+            end++;
+        }
+
+        double thickness = row_area / side;
+        double offset = 0;
+        for (guint i = start; i < end; i++) {
+            double* box = &boxes[4 * i];
+            double length = children[i]->size * scale / thickness;
+            if (width >= height) {
+                box[0] = x;
+                box[1] = y + offset;
+                box[2] = thickness;
+                box[3] = length;
+            } else {
+                box[0] = x + offset;
+                box[1] = y;
+                box[2] = length;
+                box[3] = thickness;
+            }
+            offset += length;
+        }
+        if (width >= height) {
+            x += thickness;
+            width = MAX(width - thickness, 0);
+        } else {
+            y += thickness;
+            height = MAX(height - thickness, 0);
+        }
+        start = end;
+    }
+}
+
+static void lay_out_children(GArray* rects, const TreemapItem* item, guint parent, guint depth,
+                             double x, double y, double width, double height);
+
+static void lay_out_item(GArray* rects, const TreemapItem* item, guint parent, guint depth,
+                         double x, double y, double width, double height) {
+    TreemapRect rect = {
+        .label = item->label,
+        .size = item->size,
+        .x = x,
+        .y = y,
+        .width = width,
+        .height = height,
+        .parent = parent,
+        .depth = depth,
+        .kind = item->kind,
+        .conflict = item->conflict,
+    };
+    guint index = rects->len;
+    g_array_append_val(rects, rect);
+
+    if (item->n_children > 0) {
+        gboolean header = width >= 3 * TREEMAP_HEADER && height >= 3 * TREEMAP_HEADER;
+        double top = header ? TREEMAP_HEADER : TREEMAP_PADDING;
+        lay_out_children(rects, item, index, depth + 1,
+                         x + MIN(TREEMAP_PADDING, width / 2), y + MIN(top, height / 2),
+                         MAX(width - 2 * TREEMAP_PADDING, 0),
+                         MAX(height - top - TREEMAP_PADDING, 0));
+    }
+    g_array_index(rects, TreemapRect, index).end = rects->len;
+}
+
+static void lay_out_children(GArray* rects, const TreemapItem* item, guint parent, guint depth,
+                             double x, double y, double width, double height) {
+    double* boxes = g_new(double, 4 * item->n_children);
+    squarify(item->children, item->n_children, item->size, x, y, width, height, boxes);
+    for (guint i = 0; i < item->n_children; i++) {
+        const double* box = &boxes[4 * i];
+        lay_out_item(rects, item->children[i], parent, depth, box[0], box[1], box[2], box[3]);
+    }
+    g_free(boxes);
+}
+
+static Treemap* treemap_new(TreemapItems* items, double width, double height) {
+    GArray* rects = g_array_new(FALSE, FALSE, sizeof(TreemapRect));
+    lay_out_children(rects, items->root, TREEMAP_NO_PARENT, 0, 0, 0, width, height);
+
+    Treemap* treemap = g_new0(Treemap, 1);
+    treemap->ref_count = 1;
+    treemap->n_rects = rects->len;
+    treemap->rects = (TreemapRect*)g_array_free(rects, FALSE);
+    treemap->width = width;
+    treemap->height = height;
+    treemap->total = items->root->size;
+    treemap->grouping = items->grouping;
+    treemap->items = items_ref(items);
+    return treemap;
+}
+
+Treemap* treemap_ref(Treemap* treemap) {
+    g_atomic_int_inc(&treemap->ref_count);
+    return treemap;
+}
+
+void treemap_unref(Treemap* treemap) {
+    if (!treemap || !g_atomic_int_dec_and_test(&treemap->ref_count)) return;
+
+    items_unref(treemap->items);
+    g_free(treemap->rects);
+    g_free(treemap);
+}
+
+static gboolean rect_intersects(const TreemapRect* rect,
+                                double x, double y, double width, double height) {
+    return rect->x <= x + width && rect->x + rect->width >= x &&
+           rect->y <= y + height && rect->y + rect->height >= y;
+}
+
+void treemap_query(Treemap* treemap, double x, double y, double width, double height,
+                   double min_size, GArray* rects) {
+    g_array_set_size(rects, 0);
+    guint i = 0;
+    while (i < treemap->n_rects) {
+        const TreemapRect* rect = &treemap->rects[i];
+        if (rect->width < min_size || rect->height < min_size ||
+            !rect_intersects(rect, x, y, width, height)) {
+            i = rect->end;
+            continue;
+        }
+        g_array_append_val(rects, i);
+        i++;
+    }
+}
+
+int treemap_rect_at(Treemap* treemap, double x, double y) {
+    int found = -1;
+    guint i = 0;
+    while (i < treemap->n_rects) {
+        const TreemapRect* rect = &treemap->rects[i];
+        if (x < rect->x || x >= rect->x + rect->width ||
+            y < rect->y || y >= rect->y + rect->height) {
+            i = rect->end;
+            continue;
+        }
+        found = (int)i;
+        i++;
+    }
+    return found;
+}
+
+static void treemap_request_free(gpointer data) {
+    TreemapRequest* request = data;
+    if (request->names) {
+        g_ptr_array_unref(request->names);
+        g_array_unref(request->sizes);
+        g_array_unref(request->conflicts);
+        g_array_unref(request->edges);
+    }
+    items_unref(request->items);
+    g_free(request->venv_path);
+    g_free(request);
+}
+
+// Duplicate names keep the first package, as in the graph
+static TreemapRequest* treemap_request_new(Package* packages, const char* venv_path,
+                                           TreemapGrouping grouping) {
+    TreemapRequest* request = g_new0(TreemapRequest, 1);
+    request->names = g_ptr_array_new_with_free_func(g_free);
+    request->sizes = g_array_new(FALSE, FALSE, sizeof(guint64));
+    request->conflicts = g_array_new(FALSE, FALSE, sizeof(gboolean));
+    request->edges = g_array_new(FALSE, FALSE, sizeof(TreemapEdge));
+    request->venv_path = g_strdup(venv_path);
+    request->grouping = grouping;
+
+    // name -> package index + 1
+    GHashTable* index = g_hash_table_new(g_str_hash, g_str_equal);
+    GPtrArray* included = g_ptr_array_new();
+    for (Package* pkg = packages; pkg; pkg = pkg->next) {
+        if (g_hash_table_contains(index, pkg->name)) continue;
+
+        guint64 size = pkg->size;
+        gboolean conflict = pkg->conflicts != NULL;
+        g_ptr_array_add(request->names, g_strdup(pkg->name));
+        g_array_append_val(request->sizes, size);
+        g_array_append_val(request->conflicts, conflict);
+        g_ptr_array_add(included, pkg);
+        g_hash_table_insert(index, pkg->name, GUINT_TO_POINTER(included->len));
+    }
+
+    if (grouping == TREEMAP_GROUP_BY_REQUIREMENT) {
+        for (guint i = 0; i < included->len; i++) {
+            Package* pkg = g_ptr_array_index(included, i);
+            for (PackageDep* dep = pkg->dependencies; dep; dep = dep->next) {
+                guint to = GPOINTER_TO_UINT(g_hash_table_lookup(index, dep->name));
+                if (!to || to - 1 == i) continue;
+                TreemapEdge edge = { i, to - 1 };
+                g_array_append_val(request->edges, edge);
+            }
+        }
+    }
+
+    g_ptr_array_unref(included);
+    g_hash_table_unref(index);
+    return request;
+}
+
+static void treemap_thread(GTask* task,
+                           gpointer source_object G_GNUC_UNUSED,
+                           gpointer task_data,
+                           GCancellable* cancellable) {
+    TreemapRequest* request = task_data;
+    TreemapItems* items = request->items ? items_ref(request->items)
+                                         : build_items(request, cancellable);
+    if (g_task_return_error_if_cancelled(task)) {
+        items_unref(items);
+        return;
+    }
+
+    Treemap* treemap = treemap_new(items, request->width, request->height);
+    items_unref(items);
+    g_task_return_pointer(task, treemap, (GDestroyNotify)treemap_unref);
+}
+
+static void run_request(TreemapRequest* request, double width, double height,
+                        GCancellable* cancellable, GAsyncReadyCallback callback,
+                        gpointer user_data) {
+    request->width = width;
+    request->height = height;
+
+    GTask* task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, treemap_compute_async);
+    g_task_set_task_data(task, request, treemap_request_free);
+    g_task_run_in_thread(task, treemap_thread);
+    g_object_unref(task);
+}
+
+void treemap_compute_async(Package* packages,
+                           const char* venv_path,
+                           TreemapGrouping grouping,
+                           double width,
+                           double height,
+                           GCancellable* cancellable,
+                           GAsyncReadyCallback callback,
+                           gpointer user_data) {
+    run_request(treemap_request_new(packages, venv_path, grouping), width, height,
+                cancellable, callback, user_data);
+}
+
+void treemap_resize_async(Treemap* treemap,
+                          double width,
+                          double height,
+                          GCancellable* cancellable,
+                          GAsyncReadyCallback callback,
+                          gpointer user_data) {
+    TreemapRequest* request = g_new0(TreemapRequest, 1);
+    request->grouping = treemap->grouping;
+    request->items = items_ref(treemap->items);
+    run_request(request, width, height, cancellable, callback, user_data);
+}
+
+Treemap* treemap_compute_finish(GAsyncResult* result, GError** error) {
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
@@ -0,0 +1,114 @@
+#ifndef CORE_TREEMAP_H
+#define CORE_TREEMAP_H
+
+#include "../include/venv_analyzer.h"
+#include "package.h"
+#include <gio/gio.h>
+
+// Squarified treemaps of where an environment's disk space goes, laid out
+// off the main thread. Like graph layouts, a finished treemap is immutable
+// and reference counted. The items a treemap shows are kept with it, so
+// the same treemap can be laid out again at another size without going
+// back to the packages or their RECORD files.
+
+typedef enum {
+    TREEMAP_GROUP_BY_NONE,
+    TREEMAP_GROUP_BY_REQUIREMENT,   // Under the top-level requirement that
+                                    // alone needs them, see graph_layout.h
+    TREEMAP_GROUP_BY_FILES          // Each package split into the directories
+                                    // and files its RECORD lists
+} TreemapGrouping;
+
+typedef enum {
+    TREEMAP_RECT_GROUP,       // Top-level requirement and what only it needs
+    TREEMAP_RECT_PACKAGE,
+    TREEMAP_RECT_DIRECTORY,
+    TREEMAP_RECT_FILE,
+    TREEMAP_RECT_OTHER        // Siblings too small to show, merged
+} TreemapRectKind;
+
+#define TREEMAP_NO_PARENT G_MAXUINT
+
+// Room a container leaves around its children and above them for its
+// label, in points; containers too small for a label get none
+#define TREEMAP_PADDING 2.0
+#define TREEMAP_HEADER 16.0
+
+typedef struct {
+    const char* label;
+    guint64 size;             // Bytes
+    double x;                 // Top left corner, in points
+    double y;
+    double width;
+    double height;
+    guint parent;             // Enclosing rect or TREEMAP_NO_PARENT
+    guint end;                // Index just past the rect's descendants
+    guint depth;              // 0 for rects without a parent
+    TreemapRectKind kind;
+    gboolean conflict;        // Package has conflicts
+} TreemapRect;
+
+typedef struct _TreemapItems TreemapItems;
+
+typedef struct {
+    gint ref_count;
+    TreemapRect* rects;       // Depth first: every rect is followed by its
+    guint n_rects;            // descendants, largest sibling first
+    double width;             // Size laid out, in points
+    double height;
+    guint64 total;            // Bytes shown
+    TreemapGrouping grouping;
+    TreemapItems* items;      // What was laid out, shared with resized copies
+} Treemap;
+
+Treemap* treemap_ref(Treemap* treemap);
+void treemap_unref(Treemap* treemap);
+
+/**
+ * Collects the rects intersecting a rectangle in treemap coordinates that
+ * are at least min_size wide and high, parents before children. Rects
+ * inside one that is left out are not visited at all. rects is cleared
+ * first and holds guint indices.
+ */
+void treemap_query(Treemap* treemap, double x, double y, double width, double height,
+                   double min_size, GArray* rects);
+
+/**
+ * Finds the innermost rect containing (x, y) in treemap coordinates
+ * @return Rect index or -1
+ */
+int treemap_rect_at(Treemap* treemap, double x, double y);
+
+/**
+ * Builds and lays out a treemap of the packages' sizes in a worker thread
+ * to fill width by height points. The packages are copied first. Grouping
+ * by files reads the RECORD files under venv_path on the worker; packages
+ * without one show up whole. Cancelling makes it finish with
+ * G_IO_ERROR_CANCELLED.
+ */
+void treemap_compute_async(Package* packages,
+                           const char* venv_path,
+                           TreemapGrouping grouping,
+                           double width,
+                           double height,
+                           GCancellable* cancellable,
+                           GAsyncReadyCallback callback,
+                           gpointer user_data);
+
+/**
+ * Lays out the items of treemap again at another size in a worker thread
+ */
+void treemap_resize_async(Treemap* treemap,
+                          double width,
+                          double height,
+                          GCancellable* cancellable,
+                          GAsyncReadyCallback callback,
+                          gpointer user_data);
+
+/**
+ * Finishes treemap_compute_async or treemap_resize_async
+ * @return New treemap or NULL on error
+ */
+Treemap* treemap_compute_finish(GAsyncResult* result, GError** error);
+
+#endif // CORE_TREEMAP_H
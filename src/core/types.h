@@ -1,7 +1,7 @@
 #ifndef TYPES_H
 #define TYPES_H
 
-#include <glib.h>
+#include <glib-object.h>
 
 #define MAX_PACKAGE_NAME 256
 #define MAX_VERSION_LEN 64
@@ -14,10 +14,12 @@ typedef struct _PackageDep {
 } PackageDep;
 
 typedef struct _Package {
+    GObject parent_instance;  // Packages are GObjects (see package.c)
     char name[MAX_PACKAGE_NAME];
     char version[MAX_VERSION_LEN];
     char description[1024];  // Add description field
     size_t size;
+    guint64 fingerprint;  // Hash of the dist-info metadata, 0 if unknown
     PackageDep* dependencies;
     PackageDep* conflicts;  // Changed from PackageConflict to PackageDep for consistency
     struct _Package* next;
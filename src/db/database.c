@@ -1,58 +1,650 @@
 #include "database.h"
 #include "../core/types.h"
 #include "../core/package.h"
+#include <gio/gio.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
-static char error_message[256];
-static const char* SCHEMA_FILE = "src/db/schema.sql";
+// Per thread, since the writer thread (db_writer.c) runs db_* calls too
+static _Thread_local char error_message[256];
+static const char* SCHEMA_RESOURCE = "/org/venv-analyzer/db/schema.sql";
 
-// Helper function to execute SQL from file
-static DbError execute_sql_file(sqlite3* db, const char* filepath) {
-    char* sql = NULL;
-    char* err_msg = NULL;
-    
-    FILE* file = fopen(filepath, "r");
-    if (!file) {
-        snprintf(error_message, sizeof(error_message), 
-                "Failed to open schema file: %s", filepath);
-        return DB_ERROR_INIT;
+// Bump together with a new entry in MIGRATIONS when schema.sql changes
+#define DB_SCHEMA_VERSION 4
+
+// Packages that belong to snapshot ?1 (same environment, interval covers ?1)
+#define SNAPSHOT_MEMBERS_SQL \
+    "FROM snapshot_packages m " \
+    "JOIN packages p ON p.id = m.package_id " \
+    "WHERE m.environment_id = (SELECT environment_id FROM snapshots WHERE id = ?1) " \
+    "AND m.added_in <= ?1 AND (m.removed_in IS NULL OR m.removed_in > ?1) "
+
+#define ENVIRONMENT_COLUMNS \
+    "e.id, e.venv_path, e.last_scan, e.latest_snapshot, e.package_count, e.total_size "
+
+// Statements prepared once per connection and reused across calls
+typedef enum {
+    DB_STMT_FIND_PACKAGE,
+    DB_STMT_INSERT_PACKAGE,
+    DB_STMT_INSERT_DEPENDENCY_BY_ID,
+    DB_STMT_SAVE_SETTING,
+    DB_STMT_GET_SETTING,
+    DB_STMT_INSERT_SNAPSHOT,
+    DB_STMT_OPEN_MEMBERS,
+    DB_STMT_CLOSE_MEMBER,
+    DB_STMT_ADD_MEMBER,
+    DB_STMT_LATEST_SNAPSHOT,
+    DB_STMT_GET_SNAPSHOT,
+    DB_STMT_LIST_SNAPSHOTS,
+    DB_STMT_LOAD_SNAPSHOT,
+    DB_STMT_DIFF_PACKAGES_OLD,
+    DB_STMT_DIFF_PACKAGES_NEW,
+    DB_STMT_DIFF_EDGES_OLD,
+    DB_STMT_DIFF_EDGES_NEW,
+    DB_STMT_UPSERT_ENVIRONMENT,
+    DB_STMT_FIND_ENVIRONMENT,
+    DB_STMT_UPDATE_ENVIRONMENT,
+    DB_STMT_CLEAR_CURRENT_EDGES,
+    DB_STMT_FILL_CURRENT_EDGES,
+    DB_STMT_LIST_ENVIRONMENTS,
+    DB_STMT_LARGEST_ENVIRONMENTS,
+    DB_STMT_ENVIRONMENTS_WITH_VERSION,
+    DB_STMT_ENVIRONMENTS_DEPENDING_ON,
+    DB_STMT_INDEX_WORDS,
+    DB_STMT_INDEX_TRIGRAMS,
+    DB_STMT_SEARCH_WORDS,
+    DB_STMT_SEARCH_WORDS_AND_TRIGRAMS,
+    DB_STMT_COUNT
+} DbStatementId;
+
+static const char* const STATEMENT_SQL[DB_STMT_COUNT] = {
+    [DB_STMT_FIND_PACKAGE] =
+        "SELECT id FROM packages WHERE content_hash = ?",
+    [DB_STMT_INSERT_PACKAGE] =
+        "INSERT INTO packages (content_hash, name, normalized_name, "
+        "version, version_key, summary, size, has_conflicts, fingerprint) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)",
+    [DB_STMT_INSERT_DEPENDENCY_BY_ID] =
+        "INSERT OR REPLACE INTO dependencies "
+        "(package_id, dependency_name, normalized_name, version_constraint) "
+        "VALUES (?, ?, ?, ?)",
+    [DB_STMT_SAVE_SETTING] =
+        "INSERT INTO env_settings (key, value, updated_at) "
+        "VALUES (?, ?, CURRENT_TIMESTAMP) "
+        "ON CONFLICT(key) DO UPDATE SET "
+        "value = excluded.value, updated_at = excluded.updated_at",
+    [DB_STMT_GET_SETTING] =
+        "SELECT value FROM env_settings WHERE key = ?",
+    [DB_STMT_INSERT_SNAPSHOT] =
+        "INSERT INTO snapshots (environment_id, package_count, total_size) "
+        "VALUES (?, ?, ?)",
+    [DB_STMT_OPEN_MEMBERS] =
+        "SELECT rowid, package_id FROM snapshot_packages "
+        "WHERE environment_id = ? AND removed_in IS NULL",
+    [DB_STMT_CLOSE_MEMBER] =
+        "UPDATE snapshot_packages SET removed_in = ? WHERE rowid = ?",
+    [DB_STMT_ADD_MEMBER] =
+        "INSERT INTO snapshot_packages (environment_id, package_id, added_in) "
+        "VALUES (?, ?, ?)",
+    [DB_STMT_LATEST_SNAPSHOT] =
+        "SELECT latest_snapshot FROM environments "
+        "WHERE venv_path = ? AND latest_snapshot IS NOT NULL",
+    [DB_STMT_GET_SNAPSHOT] =
+        "SELECT e.venv_path FROM snapshots s "
+        "JOIN environments e ON e.id = s.environment_id WHERE s.id = ?",
+    [DB_STMT_LIST_SNAPSHOTS] =
+        "SELECT s.id, e.venv_path, s.created_at, s.package_count, s.total_size "
+        "FROM environments e JOIN snapshots s ON s.environment_id = e.id "
+        "WHERE e.venv_path = ? ORDER BY s.id DESC",
+    // Dependencies come back newest first so prepending restores scan order
+    [DB_STMT_LOAD_SNAPSHOT] =
+        "SELECT p.id, p.name, p.version, p.size, p.fingerprint, "
+        "d.dependency_name, d.version_constraint, p.summary "
+        "FROM snapshot_packages m "
+        "JOIN packages p ON p.id = m.package_id "
+        "LEFT JOIN dependencies d ON d.package_id = p.id "
+        "WHERE m.environment_id = (SELECT environment_id FROM snapshots WHERE id = ?1) "
+        "AND m.added_in <= ?1 AND (m.removed_in IS NULL OR m.removed_in > ?1) "
+        "ORDER BY p.name, p.id, d.rowid DESC",
+    [DB_STMT_DIFF_PACKAGES_OLD] =
+        "SELECT p.id, p.name, p.version, p.version_key "
+        SNAPSHOT_MEMBERS_SQL "ORDER BY p.name",
+    [DB_STMT_DIFF_PACKAGES_NEW] =
+        "SELECT p.id, p.name, p.version, p.version_key "
+        SNAPSHOT_MEMBERS_SQL "ORDER BY p.name",
+    [DB_STMT_DIFF_EDGES_OLD] =
+        "SELECT dependency_name, version_constraint FROM dependencies "
+        "WHERE package_id = ? ORDER BY dependency_name",
+    [DB_STMT_DIFF_EDGES_NEW] =
+        "SELECT dependency_name, version_constraint FROM dependencies "
+        "WHERE package_id = ? ORDER BY dependency_name",
+    [DB_STMT_UPSERT_ENVIRONMENT] =
+        "INSERT INTO environments (venv_path) VALUES (?) "
+        "ON CONFLICT(venv_path) DO NOTHING",
+    [DB_STMT_FIND_ENVIRONMENT] =
+        "SELECT id FROM environments WHERE venv_path = ?",
+    [DB_STMT_UPDATE_ENVIRONMENT] =
+        "UPDATE environments SET latest_snapshot = ?, package_count = ?, "
+        "total_size = ?, last_scan = CURRENT_TIMESTAMP WHERE id = ?",
+    [DB_STMT_LIST_ENVIRONMENTS] =
+        "SELECT " ENVIRONMENT_COLUMNS ", NULL "
+        "FROM environments e ORDER BY e.venv_path",
+    [DB_STMT_LARGEST_ENVIRONMENTS] =
+        "SELECT " ENVIRONMENT_COLUMNS ", NULL "
+        "FROM environments e ORDER BY e.total_size DESC, e.id LIMIT ?",
+    // ?2 and ?3 bound a half-open range of version keys
+    [DB_STMT_ENVIRONMENTS_WITH_VERSION] =
+        "SELECT " ENVIRONMENT_COLUMNS ", p.version, p.version_key "
+        "FROM packages p "
+        "JOIN snapshot_packages m ON m.package_id = p.id AND m.removed_in IS NULL "
+        "JOIN environments e ON e.id = m.environment_id "
+        "WHERE p.normalized_name = ?1 AND p.version_key >= ?2 AND p.version_key < ?3 "
+        "ORDER BY e.venv_path",
+    [DB_STMT_CLEAR_CURRENT_EDGES] =
+        "DELETE FROM current_edges WHERE environment_id = ?",
+    [DB_STMT_FILL_CURRENT_EDGES] =
+        "INSERT OR IGNORE INTO current_edges "
+        "(environment_id, dependency_name, package_name) "
+        "SELECT ?1, d.normalized_name, p.normalized_name "
+        "FROM snapshot_packages m "
+        "JOIN packages p ON p.id = m.package_id "
+        "JOIN dependencies d ON d.package_id = p.id "
+        "WHERE m.environment_id = ?1 AND m.removed_in IS NULL",
+    // Walks reverse edges within each environment; the last column counts
+    // the installed packages that reach ?1
+    [DB_STMT_ENVIRONMENTS_DEPENDING_ON] =
+        "WITH RECURSIVE dependents(environment_id, name) AS ("
+        "  SELECT environment_id, package_name FROM current_edges "
+        "  WHERE dependency_name = ?1 "
+        "  UNION "
+        "  SELECT t.environment_id, x.package_name "
+        "  FROM dependents t "
+        "  JOIN current_edges x ON x.environment_id = t.environment_id "
+        "    AND x.dependency_name = t.name"
+        ") "
+        "SELECT " ENVIRONMENT_COLUMNS ", NULL, COUNT(*) "
+        "FROM dependents t JOIN environments e ON e.id = t.environment_id "
+        "GROUP BY e.id ORDER BY e.venv_path",
+    [DB_STMT_INDEX_WORDS] =
+        "INSERT INTO package_search (rowid, name, summary, dependencies) "
+        "VALUES (?, ?, ?, ?)",
+    [DB_STMT_INDEX_TRIGRAMS] =
+        "INSERT INTO package_name_trigrams (rowid, name) VALUES (?, ?)",
+    // ?1 word query, ?2 trigram query, ?3 venv path or NULL, ?4 limit
+    [DB_STMT_SEARCH_WORDS] =
+        "SELECT e.venv_path, p.name, p.version, p.summary "
+        "FROM package_search s "
+        "JOIN snapshot_packages m ON m.package_id = s.rowid AND m.removed_in IS NULL "
+        "JOIN environments e ON e.id = m.environment_id "
+        "JOIN packages p ON p.id = s.rowid "
+        "WHERE package_search MATCH ?1 AND (?3 IS NULL OR e.venv_path = ?3) "
+        "ORDER BY p.normalized_name, e.venv_path LIMIT ?4",
+    [DB_STMT_SEARCH_WORDS_AND_TRIGRAMS] =
+        "SELECT e.venv_path, p.name, p.version, p.summary "
+        "FROM (SELECT rowid AS id FROM package_search WHERE package_search MATCH ?1 "
+        "      UNION "
+        "      SELECT rowid FROM package_name_trigrams WHERE package_name_trigrams MATCH ?2) h "
+        "JOIN snapshot_packages m ON m.package_id = h.id AND m.removed_in IS NULL "
+        "JOIN environments e ON e.id = m.environment_id "
+        "JOIN packages p ON p.id = h.id "
+        "WHERE ?3 IS NULL OR e.venv_path = ?3 "
+        "ORDER BY p.normalized_name, e.venv_path LIMIT ?4",
+};
+
+struct _DbStatementCache {
+    sqlite3_stmt* stmts[DB_STMT_COUNT];
+};
+
+// Returns a reset statement from the connection's cache, preparing it on first use
+static sqlite3_stmt* get_cached_statement(VenvAnalyzer* analyzer, DbStatementId id) {
+    if (!analyzer->db_stmts) {
+        analyzer->db_stmts = g_new0(DbStatementCache, 1);
     }
-    
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    sql = malloc(size + 1);
-    if (!sql) {
-        fclose(file);
-        snprintf(error_message, sizeof(error_message), "Memory allocation failed");
-        return DB_ERROR_INIT;
+
+    sqlite3_stmt* stmt = analyzer->db_stmts->stmts[id];
+    if (stmt) {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        return stmt;
     }
-    
-    size_t read = fread(sql, 1, size, file);
-    if (read != (size_t)size) {
-        free(sql);
-        fclose(file);
-        snprintf(error_message, sizeof(error_message), "Failed to read schema file");
-        return DB_ERROR_INIT;
+
+    if (sqlite3_prepare_v3(analyzer->db, STATEMENT_SQL[id], -1,
+                           SQLITE_PREPARE_PERSISTENT, &stmt, NULL) != SQLITE_OK) {
+        snprintf(error_message, sizeof(error_message),
+                "Failed to prepare statement: %s", sqlite3_errmsg(analyzer->db));
+        return NULL;
     }
-    sql[size] = '\0';
-    fclose(file);
-    
+
+    analyzer->db_stmts->stmts[id] = stmt;
+    return stmt;
+}
+
+static void free_statement_cache(VenvAnalyzer* analyzer) {
+    if (!analyzer->db_stmts) return;
+
+    for (int i = 0; i < DB_STMT_COUNT; i++) {
+        sqlite3_finalize(analyzer->db_stmts->stmts[i]);
+    }
+    g_free(analyzer->db_stmts);
+    analyzer->db_stmts = NULL;
+}
+
+static DbError execute_sql(sqlite3* db, const char* sql, const char* what) {
+    char* err_msg = NULL;
     if (sqlite3_exec(db, sql, NULL, NULL, &err_msg) != SQLITE_OK) {
-        snprintf(error_message, sizeof(error_message),
-                "Schema execution failed: %s", err_msg);
+        snprintf(error_message, sizeof(error_message), "%s: %s", what, err_msg);
         sqlite3_free(err_msg);
-        free(sql);
         return DB_ERROR_QUERY;
     }
-    
-    free(sql);
     return DB_SUCCESS;
 }
 
+// Runs schema.sql, which is compiled into the binary (db.gresource.xml)
+static DbError execute_schema(sqlite3* db) {
+    GError* error = NULL;
+    GBytes* schema = g_resources_lookup_data(SCHEMA_RESOURCE,
+                                             G_RESOURCE_LOOKUP_FLAGS_NONE, &error);
+    if (!schema) {
+        snprintf(error_message, sizeof(error_message),
+                "Failed to load schema: %s", error->message);
+        g_error_free(error);
+        return DB_ERROR_INIT;
+    }
+
+    // Resource data is always followed by a nul byte
+    DbError result = execute_sql(db, g_bytes_get_data(schema, NULL),
+                                 "Schema execution failed");
+    g_bytes_unref(schema);
+    return result;
+}
+
+static guint64 fnv1a_update(guint64 hash, const void* data, gsize len) {
+    const guint8* bytes = data;
+    for (gsize i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Includes the terminator so ("ab", "c") and ("a", "bc") hash differently
+static guint64 fnv1a_string(guint64 hash, const char* str) {
+    return fnv1a_update(hash, str, strlen(str) + 1);
+}
+
+// Adds one dependency to a dependency sum; summing makes the order of a
+// package's dependencies irrelevant
+static guint64 add_dependency_hash(guint64 deps, const char* name, const char* constraint) {
+    guint64 dep_hash = fnv1a_string(0xcbf29ce484222325ULL, name);
+    return deps + fnv1a_string(dep_hash, constraint);
+}
+
+// Identity of a package row: everything stored with it, dependencies
+// included as their sum from add_dependency_hash
+static guint64 row_content_hash(const char* name, const char* version, const char* summary,
+                                size_t size, guint64 fingerprint, gboolean has_conflicts,
+                                guint64 deps) {
+    guint64 hash = 0xcbf29ce484222325ULL;
+    hash = fnv1a_string(hash, name);
+    hash = fnv1a_string(hash, version);
+    hash = fnv1a_string(hash, summary);
+    hash = fnv1a_update(hash, &size, sizeof(size));
+    hash = fnv1a_update(hash, &fingerprint, sizeof(fingerprint));
+    guint8 conflicts = has_conflicts != FALSE;
+    hash = fnv1a_update(hash, &conflicts, 1);
+    return fnv1a_update(hash, &deps, sizeof(deps));
+}
+
+static guint64 package_content_hash(const Package* package) {
+    guint64 deps = 0;
+    for (const PackageDep* dep = package->dependencies; dep; dep = dep->next) {
+        deps = add_dependency_hash(deps, dep->name, dep->version);
+    }
+    return row_content_hash(package->name, package->version, package->description,
+                            package->size, package->fingerprint,
+                            package->conflicts != NULL, deps);
+}
+
+static int get_schema_version(sqlite3* db) {
+    sqlite3_stmt* stmt;
+    int version = 0;
+
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version", -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            version = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    return version;
+}
+
+static gboolean table_exists(sqlite3* db, const char* name) {
+    sqlite3_stmt* stmt;
+    gboolean exists = FALSE;
+
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = ?",
+                           -1, &stmt, NULL) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+        exists = sqlite3_step(stmt) == SQLITE_ROW;
+        sqlite3_finalize(stmt);
+    }
+    return exists;
+}
+
+// package_normalize_name() as an SQL function, for backfilling columns
+static void sql_normalize_name(sqlite3_context* context, int argc G_GNUC_UNUSED,
+                               sqlite3_value** argv) {
+    const char* name = (const char*)sqlite3_value_text(argv[0]);
+    if (name) {
+        sqlite3_result_text(context, package_normalize_name(name), -1, g_free);
+    } else {
+        sqlite3_result_null(context);
+    }
+}
+
+// Schema migrations. MIGRATIONS[v] upgrades a database at user_version v
+// to v + 1 in place, keeping every stored scan. They only create what
+// later steps or existing rows need; schema.sql runs afterwards and adds
+// the remaining tables and indexes of the current version. The search
+// tables are derived from package rows and rebuilt after any upgrade.
+
+// Version 1 fingerprints packages to tell unchanged ones apart on rescans
+static DbError migrate_add_fingerprints(sqlite3* db) {
+    return execute_sql(db,
+                       "ALTER TABLE packages "
+                       "ADD COLUMN fingerprint INTEGER NOT NULL DEFAULT 0;",
+                       "Failed to add package fingerprints");
+}
+
+// Copies version 1 package rows into the content-addressed packages_v2,
+// keeping their ids so dependencies stay attached. Hashes go through
+// row_content_hash like every row inserted later.
+static DbError copy_content_addressed_packages(sqlite3* db) {
+    GHashTable* deps = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, g_free);
+    sqlite3_stmt* stmt = NULL;
+    sqlite3_stmt* insert = NULL;
+    DbError result = DB_ERROR_QUERY;
+
+    if (sqlite3_prepare_v2(db, "SELECT package_id, dependency_name, version_constraint "
+                               "FROM dependencies", -1, &stmt, NULL) != SQLITE_OK) {
+        goto out;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        gint64 id = sqlite3_column_int64(stmt, 0);
+        guint64* sum = g_hash_table_lookup(deps, &id);
+        if (!sum) {
+            sum = g_new0(guint64, 1);
+            g_hash_table_insert(deps, g_memdup2(&id, sizeof(id)), sum);
+        }
+        *sum = add_dependency_hash(*sum, (const char*)sqlite3_column_text(stmt, 1),
+                                   (const char*)sqlite3_column_text(stmt, 2));
+    }
+    if (sqlite3_finalize(stmt) != SQLITE_OK) {
+        stmt = NULL;
+        goto out;
+    }
+
+    if (sqlite3_prepare_v2(db, "SELECT id, name, version, size, has_conflicts, "
+                               "fingerprint, created_at FROM packages",
+                           -1, &stmt, NULL) != SQLITE_OK ||
+        sqlite3_prepare_v2(db, "INSERT INTO packages_v2 (id, content_hash, name, version, "
+                               "version_key, size, has_conflicts, fingerprint, created_at) "
+                               "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)",
+                           -1, &insert, NULL) != SQLITE_OK) {
+        goto out;
+    }
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        gint64 id = sqlite3_column_int64(stmt, 0);
+        const char* name = (const char*)sqlite3_column_text(stmt, 1);
+        const char* version = (const char*)sqlite3_column_text(stmt, 2);
+        size_t size = sqlite3_column_int64(stmt, 3);
+        gboolean has_conflicts = sqlite3_column_int(stmt, 4);
+        guint64 fingerprint = sqlite3_column_int64(stmt, 5);
+        guint64* sum = g_hash_table_lookup(deps, &id);
+
+        guint8 version_key[VERSION_KEY_LEN];
+        package_version_key(version, version_key);
+
+        // Version 1 rows have no summary
+        sqlite3_bind_int64(insert, 1, id);
+        sqlite3_bind_int64(insert, 2, (sqlite3_int64)row_content_hash(
+            name, version, "", size, fingerprint, has_conflicts, sum ? *sum : 0));
+        sqlite3_bind_text(insert, 3, name, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(insert, 4, version, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_blob(insert, 5, version_key, VERSION_KEY_LEN, SQLITE_TRANSIENT);
+        sqlite3_bind_value(insert, 6, sqlite3_column_value(stmt, 3));
+        sqlite3_bind_value(insert, 7, sqlite3_column_value(stmt, 4));
+        sqlite3_bind_int64(insert, 8, (sqlite3_int64)fingerprint);
+        sqlite3_bind_value(insert, 9, sqlite3_column_value(stmt, 6));
+        if (sqlite3_step(insert) != SQLITE_DONE) break;
+        sqlite3_reset(insert);
+    }
+    if (rc == SQLITE_DONE) result = DB_SUCCESS;
+
+out:
+    if (result != DB_SUCCESS) {
+        snprintf(error_message, sizeof(error_message),
+                "Failed to copy packages: %s", sqlite3_errmsg(db));
+    }
+    sqlite3_finalize(insert);
+    sqlite3_finalize(stmt);
+    g_hash_table_unref(deps);
+    return result;
+}
+
+// Version 2 stores immutable snapshots over content-addressed package
+// rows. The scan saved by version 1 becomes the first snapshot of the
+// environment recorded in env_settings.
+static DbError migrate_add_snapshots(sqlite3* db) {
+    DbError result = execute_sql(db,
+        "CREATE TABLE snapshots ("
+        "    id INTEGER PRIMARY KEY,"
+        "    venv_path TEXT NOT NULL,"
+        "    package_count INTEGER NOT NULL DEFAULT 0,"
+        "    total_size INTEGER NOT NULL DEFAULT 0,"
+        "    created_at DATETIME DEFAULT CURRENT_TIMESTAMP"
+        ");"
+        "CREATE TABLE snapshot_packages ("
+        "    package_id INTEGER NOT NULL REFERENCES packages(id),"
+        "    added_in INTEGER NOT NULL REFERENCES snapshots(id),"
+        "    removed_in INTEGER REFERENCES snapshots(id)"
+        ");"
+        "CREATE TABLE packages_v2 ("
+        "    id INTEGER PRIMARY KEY,"
+        "    content_hash INTEGER NOT NULL UNIQUE,"
+        "    name TEXT NOT NULL,"
+        "    version TEXT NOT NULL,"
+        "    version_key BLOB NOT NULL,"
+        "    size INTEGER,"
+        "    has_conflicts BOOLEAN DEFAULT FALSE,"
+        "    fingerprint INTEGER NOT NULL DEFAULT 0,"
+        "    created_at DATETIME DEFAULT CURRENT_TIMESTAMP"
+        ");",
+        "Failed to create snapshot tables");
+    if (result != DB_SUCCESS) return result;
+
+    result = copy_content_addressed_packages(db);
+    if (result != DB_SUCCESS) return result;
+
+    return execute_sql(db,
+        "DROP TABLE packages;"
+        "ALTER TABLE packages_v2 RENAME TO packages;"
+        "INSERT INTO snapshots (venv_path, package_count, total_size, created_at) "
+        "SELECT value, (SELECT COUNT(*) FROM packages), "
+        "       (SELECT COALESCE(SUM(size), 0) FROM packages), "
+        "       COALESCE((SELECT datetime(CAST(value AS INTEGER), 'unixepoch') "
+        "                 FROM env_settings WHERE key = 'last_scan' AND value <> ''), "
+        "                CURRENT_TIMESTAMP) "
+        "FROM env_settings "
+        "WHERE key = 'venv_path' AND value <> '' AND EXISTS (SELECT 1 FROM packages);"
+        "INSERT INTO snapshot_packages (package_id, added_in) "
+        "SELECT p.id, s.id FROM packages p, snapshots s;",
+        "Failed to record the saved scan as a snapshot");
+}
+
+// Version 3 groups snapshots by environment, keeps the current dependency
+// edges of each environment and stores PEP 503 names for joins
+static DbError migrate_add_environments(sqlite3* db) {
+    if (sqlite3_create_function(db, "package_normalize_name", 1,
+                                SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL,
+                                sql_normalize_name, NULL, NULL) != SQLITE_OK) {
+        snprintf(error_message, sizeof(error_message),
+                "Failed to register name normalization: %s", sqlite3_errmsg(db));
+        return DB_ERROR_INIT;
+    }
+
+    return execute_sql(db,
+        "CREATE TABLE environments ("
+        "    id INTEGER PRIMARY KEY,"
+        "    venv_path TEXT NOT NULL UNIQUE,"
+        "    latest_snapshot INTEGER,"
+        "    package_count INTEGER NOT NULL DEFAULT 0,"
+        "    total_size INTEGER NOT NULL DEFAULT 0,"
+        "    last_scan DATETIME"
+        ");"
+        "INSERT INTO environments (venv_path) "
+        "SELECT venv_path FROM snapshots GROUP BY venv_path ORDER BY MIN(id);"
+
+        "CREATE TABLE snapshots_v3 ("
+        "    id INTEGER PRIMARY KEY,"
+        "    environment_id INTEGER NOT NULL REFERENCES environments(id),"
+        "    package_count INTEGER NOT NULL DEFAULT 0,"
+        "    total_size INTEGER NOT NULL DEFAULT 0,"
+        "    created_at DATETIME DEFAULT CURRENT_TIMESTAMP"
+        ");"
+        "INSERT INTO snapshots_v3 (id, environment_id, package_count, total_size, created_at) "
+        "SELECT s.id, e.id, s.package_count, s.total_size, s.created_at "
+        "FROM snapshots s JOIN environments e ON e.venv_path = s.venv_path;"
+        "DROP TABLE snapshots;"
+        "ALTER TABLE snapshots_v3 RENAME TO snapshots;"
+
+        "CREATE TABLE snapshot_packages_v3 ("
+        "    environment_id INTEGER NOT NULL REFERENCES environments(id),"
+        "    package_id INTEGER NOT NULL REFERENCES packages(id),"
+        "    added_in INTEGER NOT NULL REFERENCES snapshots(id),"
+        "    removed_in INTEGER REFERENCES snapshots(id)"
+        ");"
+        "INSERT INTO snapshot_packages_v3 (environment_id, package_id, added_in, removed_in) "
+        "SELECT s.environment_id, m.package_id, m.added_in, m.removed_in "
+        "FROM snapshot_packages m JOIN snapshots s ON s.id = m.added_in;"
+        "DROP TABLE snapshot_packages;"
+        "ALTER TABLE snapshot_packages_v3 RENAME TO snapshot_packages;"
+
+        "ALTER TABLE packages ADD COLUMN normalized_name TEXT NOT NULL DEFAULT '';"
+        "UPDATE packages SET normalized_name = package_normalize_name(name);"
+        "ALTER TABLE dependencies ADD COLUMN normalized_name TEXT NOT NULL DEFAULT '';"
+        "UPDATE dependencies SET normalized_name = package_normalize_name(dependency_name);"
+        "DROP INDEX IF EXISTS idx_dependencies_name;"
+
+        "UPDATE environments SET latest_snapshot = "
+        "    (SELECT MAX(id) FROM snapshots WHERE environment_id = environments.id);"
+        "UPDATE environments SET "
+        "    package_count = (SELECT package_count FROM snapshots WHERE id = latest_snapshot),"
+        "    total_size = (SELECT total_size FROM snapshots WHERE id = latest_snapshot),"
+        "    last_scan = (SELECT created_at FROM snapshots WHERE id = latest_snapshot);"
+
+        "CREATE TABLE current_edges ("
+        "    environment_id INTEGER NOT NULL REFERENCES environments(id),"
+        "    dependency_name TEXT NOT NULL,"
+        "    package_name TEXT NOT NULL,"
+        "    PRIMARY KEY(environment_id, dependency_name, package_name)"
+        ") WITHOUT ROWID;"
+        "INSERT OR IGNORE INTO current_edges (environment_id, dependency_name, package_name) "
+        "SELECT m.environment_id, d.normalized_name, p.normalized_name "
+        "FROM snapshot_packages m "
+        "JOIN packages p ON p.id = m.package_id "
+        "JOIN dependencies d ON d.package_id = p.id "
+        "WHERE m.removed_in IS NULL;",
+        "Failed to group snapshots by environment");
+}
+
+// Version 4 stores package summaries for search
+static DbError migrate_add_summaries(sqlite3* db) {
+    return execute_sql(db,
+                       "ALTER TABLE packages ADD COLUMN summary TEXT NOT NULL DEFAULT '';",
+                       "Failed to add package summaries");
+}
+
+// The search tables hold nothing but an index of package rows, so
+// migrations drop them and this refills them from the migrated rows
+static DbError fill_search_index(sqlite3* db) {
+    return execute_sql(db,
+        "INSERT INTO package_search (rowid, name, summary, dependencies) "
+        "SELECT p.id, p.name, p.summary, "
+        "       COALESCE((SELECT group_concat(d.dependency_name, ' ') "
+        "                 FROM dependencies d WHERE d.package_id = p.id), '') "
+        "FROM packages p;"
+        "INSERT INTO package_name_trigrams (rowid, name) SELECT id, name FROM packages;",
+        "Failed to rebuild the search index");
+}
+
+static DbError (*const MIGRATIONS[])(sqlite3* db) = {
+    migrate_add_fingerprints,
+    migrate_add_snapshots,
+    migrate_add_environments,
+    migrate_add_summaries,
+};
+
+G_STATIC_ASSERT(G_N_ELEMENTS(MIGRATIONS) == DB_SCHEMA_VERSION);
+
+// Brings the database up to DB_SCHEMA_VERSION in one savepoint, so a
+// failed step leaves it as it was
+static DbError migrate_schema(sqlite3* db) {
+    // Steps rebuild tables by copying; dropping the originals must not
+    // cascade. Foreign keys can only be switched outside a transaction.
+    DbError result = execute_sql(db,
+                                 "PRAGMA foreign_keys = OFF;"
+                                 "SAVEPOINT migrate_schema;",
+                                 "Failed to begin migration");
+    if (result != DB_SUCCESS) return result;
+
+    int from = get_schema_version(db);
+    int version = from;
+    if (version > DB_SCHEMA_VERSION) {
+        snprintf(error_message, sizeof(error_message),
+                "Database schema version %d is newer than this build supports (%d)",
+                version, DB_SCHEMA_VERSION);
+        result = DB_ERROR_INIT;
+    } else if (version == 0 && !table_exists(db, "packages")) {
+        // A new database; schema.sql creates everything
+        version = DB_SCHEMA_VERSION;
+    }
+
+    gboolean upgrade = version < DB_SCHEMA_VERSION;
+    for (; result == DB_SUCCESS && version < DB_SCHEMA_VERSION; version++) {
+        result = MIGRATIONS[version](db);
+    }
+    if (result == DB_SUCCESS && upgrade) {
+        result = execute_sql(db,
+                             "DROP TABLE IF EXISTS package_search;"
+                             "DROP TABLE IF EXISTS package_name_trigrams;",
+                             "Failed to drop the search index");
+    }
+    if (result == DB_SUCCESS) {
+        result = execute_schema(db);
+    }
+    if (result == DB_SUCCESS && upgrade) {
+        result = fill_search_index(db);
+    }
+    if (result == DB_SUCCESS && from != DB_SCHEMA_VERSION) {
+        char* sql = g_strdup_printf("PRAGMA user_version = %d", DB_SCHEMA_VERSION);
+        result = execute_sql(db, sql, "Failed to record schema version");
+        g_free(sql);
+    }
+
+    if (result != DB_SUCCESS) {
+        // Keep the original error message; a failed rollback adds nothing useful
+        sqlite3_exec(db, "ROLLBACK TO migrate_schema; RELEASE migrate_schema",
+                     NULL, NULL, NULL);
+        return result;
+    }
+
+    return execute_sql(db, "RELEASE migrate_schema", "Failed to commit migration");
+}
+
 // Database initialization
 DbError db_init(VenvAnalyzer* analyzer, const char* db_path) {
     if (!analyzer || !db_path) {
@@ -67,13 +659,51 @@ DbError db_init(VenvAnalyzer* analyzer, const char* db_path) {
                 "Cannot open database: %s", sqlite3_errmsg(analyzer->db));
         return DB_ERROR_INIT;
     }
+
+    // WAL lets a whole scan commit with a single fsync; NORMAL sync is
+    // durable across application crashes in WAL mode
+    DbError result = execute_sql(analyzer->db,
+                                 "PRAGMA journal_mode = WAL;"
+                                 "PRAGMA synchronous = NORMAL;"
+                                 "PRAGMA temp_store = MEMORY;",
+                                 "Failed to configure database");
+    if (result != DB_SUCCESS) {
+        return result;
+    }
+    
+    // Other processes may hold the write lock briefly
+    sqlite3_busy_timeout(analyzer->db, 5000);
     
-    return execute_sql_file(analyzer->db, SCHEMA_FILE);
+    return migrate_schema(analyzer->db);
+}
+
+// Opens a connection for queries only. In WAL mode readers never wait for
+// the writer, so this can be used on the main thread while a save commits.
+// The schema must already have been created through db_init.
+DbError db_init_readonly(VenvAnalyzer* analyzer, const char* db_path) {
+    if (!analyzer || !db_path) {
+        snprintf(error_message, sizeof(error_message),
+                "Invalid parameters: analyzer or db_path is NULL");
+        return DB_ERROR_INIT;
+    }
+
+    int rc = sqlite3_open_v2(db_path, &analyzer->db, SQLITE_OPEN_READONLY, NULL);
+    if (rc != SQLITE_OK) {
+        snprintf(error_message, sizeof(error_message),
+                "Cannot open database: %s", sqlite3_errmsg(analyzer->db));
+        return DB_ERROR_INIT;
+    }
+
+    return execute_sql(analyzer->db, "PRAGMA temp_store = MEMORY;",
+                       "Failed to configure database");
 }
 
 // Database cleanup
 void db_close(VenvAnalyzer* analyzer) {
-    if (analyzer && analyzer->db) {
+    if (!analyzer) return;
+
+    free_statement_cache(analyzer);
+    if (analyzer->db) {
         sqlite3_close(analyzer->db);
         analyzer->db = NULL;
     }
@@ -113,67 +743,130 @@ DbError db_rollback(VenvAnalyzer* analyzer) {
     return DB_SUCCESS;
 }
 
-// Package operations
-DbError db_insert_package(VenvAnalyzer* analyzer, Package* package) {
-    sqlite3_stmt* stmt;
-    const char* sql = "INSERT OR REPLACE INTO packages (name, version, size) VALUES (?, ?, ?)";
-    
-    if (sqlite3_prepare_v2(analyzer->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        snprintf(error_message, sizeof(error_message),
-                "Failed to prepare package insert statement: %s",
-                sqlite3_errmsg(analyzer->db));
+static int compare_row_ids(const void* a, const void* b) {
+    sqlite3_int64 x = *(const sqlite3_int64*)a;
+    sqlite3_int64 y = *(const sqlite3_int64*)b;
+    return (x > y) - (x < y);
+}
+
+static DbError step_statement(VenvAnalyzer* analyzer, sqlite3_stmt* stmt, const char* what) {
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
+        snprintf(error_message, sizeof(error_message), "%s: %s",
+                what, sqlite3_errmsg(analyzer->db));
         return DB_ERROR_QUERY;
     }
-    
-    sqlite3_bind_text(stmt, 1, package->name, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, package->version, -1, SQLITE_STATIC);
-    sqlite3_bind_int64(stmt, 3, package->size);
-    
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
+    return DB_SUCCESS;
+}
+
+// Package operations
+static DbError insert_dependency_row(VenvAnalyzer* analyzer,
+                                     sqlite3_int64 package_id,
+                                     const PackageDep* dep) {
+    sqlite3_stmt* stmt = get_cached_statement(analyzer, DB_STMT_INSERT_DEPENDENCY_BY_ID);
+    if (!stmt) return DB_ERROR_QUERY;
+
+    sqlite3_bind_int64(stmt, 1, package_id);
+    sqlite3_bind_text(stmt, 2, dep->name, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, package_normalize_name(dep->name), -1, g_free);
+    sqlite3_bind_text(stmt, 4, dep->version, -1, SQLITE_STATIC);
+
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
         snprintf(error_message, sizeof(error_message),
-                "Failed to insert package: %s",
+                "Failed to insert dependency: %s",
                 sqlite3_errmsg(analyzer->db));
-        sqlite3_finalize(stmt);
         return DB_ERROR_QUERY;
     }
-    
-    sqlite3_finalize(stmt);
+
     return DB_SUCCESS;
 }
 
-// Dependency operations
-DbError db_add_dependency(VenvAnalyzer* analyzer, 
-                         const char* package_name,
-                         const char* dep_name,
-                         const char* version_constraint) {
-    sqlite3_stmt* stmt;
-    const char* sql = "INSERT OR REPLACE INTO dependencies "
-                     "(package_id, dependency_name, version_constraint) "
-                     "VALUES ((SELECT id FROM packages WHERE name = ?), ?, ?)";
-    
-    if (sqlite3_prepare_v2(analyzer->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        snprintf(error_message, sizeof(error_message),
-                "Failed to prepare dependency statement: %s",
-                sqlite3_errmsg(analyzer->db));
-        return DB_ERROR_QUERY;
+// Adds a new package row to the search indexes
+static DbError index_package_row(VenvAnalyzer* analyzer, sqlite3_int64 package_id,
+                                 const Package* package) {
+    sqlite3_stmt* stmt = get_cached_statement(analyzer, DB_STMT_INDEX_WORDS);
+    if (!stmt) return DB_ERROR_QUERY;
+
+    GString* dependencies = g_string_new(NULL);
+    for (const PackageDep* dep = package->dependencies; dep; dep = dep->next) {
+        if (dependencies->len) g_string_append_c(dependencies, ' ');
+        g_string_append(dependencies, dep->name);
     }
+
+    sqlite3_bind_int64(stmt, 1, package_id);
+    sqlite3_bind_text(stmt, 2, package->name, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, package->description, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, dependencies->str, dependencies->len, SQLITE_STATIC);
+    DbError result = step_statement(analyzer, stmt, "Failed to index package");
+    g_string_free(dependencies, TRUE);
+    if (result != DB_SUCCESS) return result;
+
+    stmt = get_cached_statement(analyzer, DB_STMT_INDEX_TRIGRAMS);
+    if (!stmt) return DB_ERROR_QUERY;
+
+    sqlite3_bind_int64(stmt, 1, package_id);
+    sqlite3_bind_text(stmt, 2, package->name, -1, SQLITE_STATIC);
+    return step_statement(analyzer, stmt, "Failed to index package name");
+}
+
+// Returns the id of the row holding this exact package content, inserting it
+// together with its dependencies the first time it is seen
+static sqlite3_int64 insert_package_row(VenvAnalyzer* analyzer, Package* package) {
+    sqlite3_int64 content_hash = (sqlite3_int64)package_content_hash(package);
+
+    sqlite3_stmt* stmt = get_cached_statement(analyzer, DB_STMT_FIND_PACKAGE);
+    if (!stmt) return -1;
+
+    sqlite3_bind_int64(stmt, 1, content_hash);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        sqlite3_int64 id = sqlite3_column_int64(stmt, 0);
+        sqlite3_reset(stmt);
+        return id;
+    }
+    sqlite3_reset(stmt);
+
+    stmt = get_cached_statement(analyzer, DB_STMT_INSERT_PACKAGE);
+    if (!stmt) return -1;
+
+    guint8 version_key[VERSION_KEY_LEN];
+    package_version_key(package->version, version_key);
+
+    sqlite3_bind_int64(stmt, 1, content_hash);
+    sqlite3_bind_text(stmt, 2, package->name, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, package_normalize_name(package->name), -1, g_free);
+    sqlite3_bind_text(stmt, 4, package->version, -1, SQLITE_STATIC);
+    sqlite3_bind_blob(stmt, 5, version_key, VERSION_KEY_LEN, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 6, package->description, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 7, package->size);
+    sqlite3_bind_int(stmt, 8, package->conflicts != NULL);
+    sqlite3_bind_int64(stmt, 9, (sqlite3_int64)package->fingerprint);
     
-    sqlite3_bind_text(stmt, 1, package_name, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, dep_name, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 3, version_constraint, -1, SQLITE_STATIC);
-    
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
         snprintf(error_message, sizeof(error_message),
-                "Failed to insert dependency: %s",
+                "Failed to insert package: %s",
                 sqlite3_errmsg(analyzer->db));
-        sqlite3_finalize(stmt);
-        return DB_ERROR_QUERY;
+        return -1;
     }
     
-    sqlite3_finalize(stmt);
-    return DB_SUCCESS;
+    sqlite3_int64 id = sqlite3_last_insert_rowid(analyzer->db);
+    for (PackageDep* dep = package->dependencies; dep; dep = dep->next) {
+        if (insert_dependency_row(analyzer, id, dep) != DB_SUCCESS) return -1;
+    }
+    if (index_package_row(analyzer, id, package) != DB_SUCCESS) return -1;
+    return id;
 }
 
+DbError db_insert_package(VenvAnalyzer* analyzer, Package* package) {
+    return insert_package_row(analyzer, package) < 0 ? DB_ERROR_QUERY : DB_SUCCESS;
+}
+
+// Dependency operations; package rows and their edges are immutable, so
+// dependencies only change by saving a new scan
 GList* db_get_dependencies(VenvAnalyzer* analyzer, const char* package_name) {
     sqlite3_stmt* stmt;
     GList* deps = NULL;
@@ -202,37 +895,803 @@ GList* db_get_dependencies(VenvAnalyzer* analyzer, const char* package_name) {
     return deps;
 }
 
-DbError db_remove_dependency(VenvAnalyzer* analyzer,
-                           const char* package_name,
-                           const char* dep_name) {
-    sqlite3_stmt* stmt;
-    const char* sql = "DELETE FROM dependencies "
-                     "WHERE package_id = (SELECT id FROM packages WHERE name = ?) "
-                     "AND dependency_name = ?";
-    
-    if (sqlite3_prepare_v2(analyzer->db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+// Settings management
+DbError db_save_setting(VenvAnalyzer* analyzer,
+                       const char* key,
+                       const char* value) {
+    sqlite3_stmt* stmt = get_cached_statement(analyzer, DB_STMT_SAVE_SETTING);
+    if (!stmt) return DB_ERROR_QUERY;
+
+    sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, value, -1, SQLITE_STATIC);
+
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
         snprintf(error_message, sizeof(error_message),
-                "Failed to prepare remove dependency statement: %s",
+                "Failed to save setting %s: %s", key,
                 sqlite3_errmsg(analyzer->db));
         return DB_ERROR_QUERY;
     }
-    
-    sqlite3_bind_text(stmt, 1, package_name, -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, dep_name, -1, SQLITE_STATIC);
-    
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
+
+    return DB_SUCCESS;
+}
+
+char* db_get_setting(VenvAnalyzer* analyzer, const char* key) {
+    sqlite3_stmt* stmt = get_cached_statement(analyzer, DB_STMT_GET_SETTING);
+    if (!stmt) return NULL;
+
+    sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+
+    char* value = NULL;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        value = g_strdup((const char*)sqlite3_column_text(stmt, 0));
+    }
+    sqlite3_reset(stmt);
+    return value;
+}
+
+// State management
+
+// Returns the id of the environment row for venv_path, creating it on first save
+static sqlite3_int64 ensure_environment_row(VenvAnalyzer* analyzer, const char* venv_path) {
+    sqlite3_stmt* stmt = get_cached_statement(analyzer, DB_STMT_UPSERT_ENVIRONMENT);
+    if (!stmt) return -1;
+
+    sqlite3_bind_text(stmt, 1, venv_path, -1, SQLITE_STATIC);
+    if (step_statement(analyzer, stmt, "Failed to register environment") != DB_SUCCESS) {
+        return -1;
+    }
+
+    stmt = get_cached_statement(analyzer, DB_STMT_FIND_ENVIRONMENT);
+    if (!stmt) return -1;
+
+    sqlite3_bind_text(stmt, 1, venv_path, -1, SQLITE_STATIC);
+    sqlite3_int64 id = -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        id = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_reset(stmt);
+    return id;
+}
+
+static sqlite3_int64 insert_snapshot_row(VenvAnalyzer* analyzer,
+                                         sqlite3_int64 environment_id,
+                                         gint64 package_count,
+                                         gint64 total_size) {
+    sqlite3_stmt* stmt = get_cached_statement(analyzer, DB_STMT_INSERT_SNAPSHOT);
+    if (!stmt) return -1;
+
+    sqlite3_bind_int64(stmt, 1, environment_id);
+    sqlite3_bind_int64(stmt, 2, package_count);
+    sqlite3_bind_int64(stmt, 3, total_size);
+
+    if (step_statement(analyzer, stmt, "Failed to create snapshot") != DB_SUCCESS) {
+        return -1;
+    }
+    return sqlite3_last_insert_rowid(analyzer->db);
+}
+
+static DbError update_environment_row(VenvAnalyzer* analyzer,
+                                      sqlite3_int64 environment_id,
+                                      sqlite3_int64 snapshot_id,
+                                      gint64 package_count,
+                                      gint64 total_size) {
+    sqlite3_stmt* stmt = get_cached_statement(analyzer, DB_STMT_UPDATE_ENVIRONMENT);
+    if (!stmt) return DB_ERROR_QUERY;
+
+    sqlite3_bind_int64(stmt, 1, snapshot_id);
+    sqlite3_bind_int64(stmt, 2, package_count);
+    sqlite3_bind_int64(stmt, 3, total_size);
+    sqlite3_bind_int64(stmt, 4, environment_id);
+    DbError result = step_statement(analyzer, stmt, "Failed to update environment");
+    if (result != DB_SUCCESS) return result;
+
+    stmt = get_cached_statement(analyzer, DB_STMT_CLEAR_CURRENT_EDGES);
+    if (!stmt) return DB_ERROR_QUERY;
+
+    sqlite3_bind_int64(stmt, 1, environment_id);
+    result = step_statement(analyzer, stmt, "Failed to clear environment edges");
+    if (result != DB_SUCCESS) return result;
+
+    stmt = get_cached_statement(analyzer, DB_STMT_FILL_CURRENT_EDGES);
+    if (!stmt) return DB_ERROR_QUERY;
+
+    sqlite3_bind_int64(stmt, 1, environment_id);
+    return step_statement(analyzer, stmt, "Failed to record environment edges");
+}
+
+// Closes the membership interval of every package that left the environment
+// and opens one for every package that joined it. Unchanged packages keep
+// their open interval, so a rescan touches only what changed.
+static DbError update_membership(VenvAnalyzer* analyzer,
+                                 sqlite3_int64 environment_id,
+                                 sqlite3_int64 snapshot_id,
+                                 GArray* package_ids) {
+    sqlite3_stmt* stmt = get_cached_statement(analyzer, DB_STMT_OPEN_MEMBERS);
+    if (!stmt) return DB_ERROR_QUERY;
+
+    guint8* retained = g_new0(guint8, package_ids->len);
+    GArray* closed = g_array_new(FALSE, FALSE, sizeof(sqlite3_int64));
+
+    sqlite3_bind_int64(stmt, 1, environment_id);
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        sqlite3_int64 rowid = sqlite3_column_int64(stmt, 0);
+        sqlite3_int64 package_id = sqlite3_column_int64(stmt, 1);
+        sqlite3_int64* found = bsearch(&package_id, package_ids->data, package_ids->len,
+                                       sizeof(sqlite3_int64), compare_row_ids);
+        if (found) {
+            retained[found - (sqlite3_int64*)package_ids->data] = 1;
+        } else {
+            g_array_append_val(closed, rowid);
+        }
+    }
+    sqlite3_reset(stmt);
+
+    DbError result = DB_SUCCESS;
+    if (rc != SQLITE_DONE) {
         snprintf(error_message, sizeof(error_message),
-                "Failed to remove dependency: %s",
-                sqlite3_errmsg(analyzer->db));
-        sqlite3_finalize(stmt);
+                "Failed to read snapshot membership: %s", sqlite3_errmsg(analyzer->db));
+        result = DB_ERROR_QUERY;
+    }
+
+    for (guint i = 0; i < closed->len && result == DB_SUCCESS; i++) {
+        stmt = get_cached_statement(analyzer, DB_STMT_CLOSE_MEMBER);
+        if (!stmt) {
+            result = DB_ERROR_QUERY;
+            break;
+        }
+        sqlite3_bind_int64(stmt, 1, snapshot_id);
+        sqlite3_bind_int64(stmt, 2, g_array_index(closed, sqlite3_int64, i));
+        result = step_statement(analyzer, stmt, "Failed to close package interval");
+    }
+
+    for (guint i = 0; i < package_ids->len && result == DB_SUCCESS; i++) {
+        if (retained[i]) continue;
+
+        stmt = get_cached_statement(analyzer, DB_STMT_ADD_MEMBER);
+        if (!stmt) {
+            result = DB_ERROR_QUERY;
+            break;
+        }
+        sqlite3_bind_int64(stmt, 1, environment_id);
+        sqlite3_bind_int64(stmt, 2, g_array_index(package_ids, sqlite3_int64, i));
+        sqlite3_bind_int64(stmt, 3, snapshot_id);
+        result = step_statement(analyzer, stmt, "Failed to open package interval");
+    }
+
+    g_array_free(closed, TRUE);
+    g_free(retained);
+    return result;
+}
+
+// Records the analyzer's packages as a new snapshot of its environment.
+// Package rows are shared by content, so only packages that changed since
+// the previous scan are written. Runs in a savepoint: on its own it is one
+// transaction, inside a writer batch it is undone alone on failure.
+DbError db_save_state(VenvAnalyzer* analyzer) {
+    if (!analyzer || !analyzer->db) {
+        snprintf(error_message, sizeof(error_message), "Database is not open");
+        return DB_ERROR_INIT;
+    }
+
+    DbError result = execute_sql(analyzer->db, "SAVEPOINT save_state",
+                                 "Failed to begin transaction");
+    if (result != DB_SUCCESS) return result;
+
+    gint64 package_count = 0;
+    gint64 total_size = 0;
+    for (Package* pkg = analyzer->packages; pkg; pkg = pkg->next) {
+        package_count++;
+        total_size += pkg->size;
+    }
+
+    GArray* package_ids = g_array_new(FALSE, FALSE, sizeof(sqlite3_int64));
+    sqlite3_int64 snapshot_id = -1;
+    sqlite3_int64 environment_id = ensure_environment_row(analyzer, analyzer->venv_path);
+    if (environment_id >= 0) {
+        snapshot_id = insert_snapshot_row(analyzer, environment_id, package_count, total_size);
+    }
+    if (snapshot_id < 0) result = DB_ERROR_QUERY;
+
+    for (Package* pkg = analyzer->packages; pkg && result == DB_SUCCESS; pkg = pkg->next) {
+        sqlite3_int64 package_id = insert_package_row(analyzer, pkg);
+        if (package_id < 0) {
+            result = DB_ERROR_QUERY;
+            break;
+        }
+        g_array_append_val(package_ids, package_id);
+    }
+
+    if (result == DB_SUCCESS) {
+        g_array_sort(package_ids, (GCompareFunc)compare_row_ids);
+        result = update_membership(analyzer, environment_id, snapshot_id, package_ids);
+    }
+    if (result == DB_SUCCESS) {
+        result = update_environment_row(analyzer, environment_id, snapshot_id,
+                                        package_count, total_size);
+    }
+    g_array_free(package_ids, TRUE);
+
+    if (result == DB_SUCCESS) {
+        char* timestamp = g_strdup_printf("%" G_GINT64_FORMAT,
+                                          g_get_real_time() / G_USEC_PER_SEC);
+        result = db_save_setting(analyzer, "venv_path", analyzer->venv_path);
+        if (result == DB_SUCCESS) {
+            result = db_save_setting(analyzer, "last_scan", timestamp);
+        }
+        g_free(timestamp);
+    }
+
+    if (result != DB_SUCCESS) {
+        // Keep the original error message; a failed rollback adds nothing useful
+        sqlite3_exec(analyzer->db, "ROLLBACK TO save_state; RELEASE save_state",
+                     NULL, NULL, NULL);
+        return result;
+    }
+
+    return execute_sql(analyzer->db, "RELEASE save_state",
+                       "Failed to commit transaction");
+}
+
+// Restores the newest snapshot of the last scanned environment
+DbError db_load_state(VenvAnalyzer* analyzer) {
+    if (!analyzer || !analyzer->db) {
+        snprintf(error_message, sizeof(error_message), "Database is not open");
+        return DB_ERROR_INIT;
+    }
+
+    char* venv_path = db_get_setting(analyzer, "venv_path");
+    if (!venv_path || !venv_path[0]) {
+        g_free(venv_path);
+        snprintf(error_message, sizeof(error_message), "No saved scan");
+        return DB_ERROR_NOT_FOUND;
+    }
+
+    sqlite3_stmt* stmt = get_cached_statement(analyzer, DB_STMT_LATEST_SNAPSHOT);
+    if (!stmt) {
+        g_free(venv_path);
         return DB_ERROR_QUERY;
     }
-    
-    sqlite3_finalize(stmt);
+
+    sqlite3_bind_text(stmt, 1, venv_path, -1, SQLITE_STATIC);
+    sqlite3_int64 snapshot_id = -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        snapshot_id = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_reset(stmt);
+    g_free(venv_path);
+
+    if (snapshot_id < 0) {
+        snprintf(error_message, sizeof(error_message), "No saved scan");
+        return DB_ERROR_NOT_FOUND;
+    }
+
+    return db_load_snapshot(analyzer, snapshot_id);
+}
+
+// Replaces the analyzer's packages with those of a stored snapshot using a
+// single join over memberships, packages and dependencies
+DbError db_load_snapshot(VenvAnalyzer* analyzer, sqlite3_int64 snapshot_id) {
+    if (!analyzer || !analyzer->db) {
+        snprintf(error_message, sizeof(error_message), "Database is not open");
+        return DB_ERROR_INIT;
+    }
+
+    sqlite3_stmt* stmt = get_cached_statement(analyzer, DB_STMT_GET_SNAPSHOT);
+    if (!stmt) return DB_ERROR_QUERY;
+
+    sqlite3_bind_int64(stmt, 1, snapshot_id);
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        sqlite3_reset(stmt);
+        snprintf(error_message, sizeof(error_message),
+                "Snapshot %" G_GINT64_FORMAT " not found", (gint64)snapshot_id);
+        return DB_ERROR_NOT_FOUND;
+    }
+    char* venv_path = g_strdup((const char*)sqlite3_column_text(stmt, 0));
+    sqlite3_reset(stmt);
+
+    stmt = get_cached_statement(analyzer, DB_STMT_LOAD_SNAPSHOT);
+    if (!stmt) {
+        g_free(venv_path);
+        return DB_ERROR_QUERY;
+    }
+
+    sqlite3_bind_int64(stmt, 1, snapshot_id);
+
+    Package* head = NULL;
+    Package* tail = NULL;
+    sqlite3_int64 current_id = -1;
+    int rc;
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        sqlite3_int64 id = sqlite3_column_int64(stmt, 0);
+        if (id != current_id) {
+            Package* pkg = package_new((const char*)sqlite3_column_text(stmt, 1),
+                                       (const char*)sqlite3_column_text(stmt, 2));
+            pkg->size = sqlite3_column_int64(stmt, 3);
+            pkg->fingerprint = (guint64)sqlite3_column_int64(stmt, 4);
+            g_strlcpy(pkg->description, (const char*)sqlite3_column_text(stmt, 7),
+                      sizeof(pkg->description));
+
+            if (tail) {
+                tail->next = pkg;
+            } else {
+                head = pkg;
+            }
+            tail = pkg;
+            current_id = id;
+        }
+
+        if (sqlite3_column_type(stmt, 5) != SQLITE_NULL) {
+            package_add_dependency(tail,
+                                   (const char*)sqlite3_column_text(stmt, 5),
+                                   (const char*)sqlite3_column_text(stmt, 6));
+        }
+    }
+    sqlite3_reset(stmt);
+
+    if (rc != SQLITE_DONE) {
+        snprintf(error_message, sizeof(error_message),
+                "Failed to load saved scan: %s", sqlite3_errmsg(analyzer->db));
+        while (head) {
+            Package* next = head->next;
+            package_free(head);
+            head = next;
+        }
+        g_free(venv_path);
+        return DB_ERROR_QUERY;
+    }
+
+    Package* pkg = analyzer->packages;
+    while (pkg) {
+        Package* next = pkg->next;
+        package_free(pkg);
+        pkg = next;
+    }
+    analyzer->packages = head;
+    g_strlcpy(analyzer->venv_path, venv_path, sizeof(analyzer->venv_path));
+
+    g_free(venv_path);
+    return DB_SUCCESS;
+}
+
+// Snapshot history
+
+void db_snapshot_free(DbSnapshot* snapshot) {
+    if (!snapshot) return;
+    g_free(snapshot->venv_path);
+    g_free(snapshot->created_at);
+    g_free(snapshot);
+}
+
+GPtrArray* db_list_snapshots(VenvAnalyzer* analyzer, const char* venv_path) {
+    GPtrArray* snapshots = g_ptr_array_new_with_free_func((GDestroyNotify)db_snapshot_free);
+
+    sqlite3_stmt* stmt = get_cached_statement(analyzer, DB_STMT_LIST_SNAPSHOTS);
+    if (!stmt) return snapshots;
+
+    sqlite3_bind_text(stmt, 1, venv_path, -1, SQLITE_STATIC);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        DbSnapshot* snapshot = g_new0(DbSnapshot, 1);
+        snapshot->id = sqlite3_column_int64(stmt, 0);
+        snapshot->venv_path = g_strdup((const char*)sqlite3_column_text(stmt, 1));
+        snapshot->created_at = g_strdup((const char*)sqlite3_column_text(stmt, 2));
+        snapshot->package_count = sqlite3_column_int64(stmt, 3);
+        snapshot->total_size = sqlite3_column_int64(stmt, 4);
+        g_ptr_array_add(snapshots, snapshot);
+    }
+    sqlite3_reset(stmt);
+    return snapshots;
+}
+
+void snapshot_change_free(SnapshotChange* change) {
+    if (!change) return;
+    g_free(change->name);
+    g_free(change->dependency);
+    g_free(change->old_value);
+    g_free(change->new_value);
+    g_free(change);
+}
+
+static void add_change(GPtrArray* changes, SnapshotChangeKind kind,
+                       const char* name, const char* dependency,
+                       const char* old_value, const char* new_value) {
+    SnapshotChange* change = g_new0(SnapshotChange, 1);
+    change->kind = kind;
+    change->name = g_strdup(name);
+    change->dependency = g_strdup(dependency);
+    change->old_value = g_strdup(old_value);
+    change->new_value = g_strdup(new_value);
+    g_ptr_array_add(changes, change);
+}
+
+static const char* column_text(sqlite3_stmt* stmt, int column) {
+    return (const char*)sqlite3_column_text(stmt, column);
+}
+
+// Merges two name-ordered cursors. cmp < 0 means only the old cursor has
+// the current key, cmp > 0 only the new one.
+static int merge_compare(sqlite3_stmt* old_stmt, int old_rc,
+                         sqlite3_stmt* new_stmt, int new_rc, int column) {
+    if (old_rc != SQLITE_ROW) return 1;
+    if (new_rc != SQLITE_ROW) return -1;
+    return strcmp(column_text(old_stmt, column), column_text(new_stmt, column));
+}
+
+static DbError diff_dependencies(VenvAnalyzer* analyzer, const char* name,
+                                 sqlite3_int64 old_id, sqlite3_int64 new_id,
+                                 GPtrArray* changes) {
+    sqlite3_stmt* old_stmt = get_cached_statement(analyzer, DB_STMT_DIFF_EDGES_OLD);
+    sqlite3_stmt* new_stmt = get_cached_statement(analyzer, DB_STMT_DIFF_EDGES_NEW);
+    if (!old_stmt || !new_stmt) return DB_ERROR_QUERY;
+
+    sqlite3_bind_int64(old_stmt, 1, old_id);
+    sqlite3_bind_int64(new_stmt, 1, new_id);
+
+    int old_rc = sqlite3_step(old_stmt);
+    int new_rc = sqlite3_step(new_stmt);
+    while (old_rc == SQLITE_ROW || new_rc == SQLITE_ROW) {
+        int cmp = merge_compare(old_stmt, old_rc, new_stmt, new_rc, 0);
+        if (cmp < 0) {
+            add_change(changes, SNAPSHOT_EDGE_REMOVED, name, column_text(old_stmt, 0),
+                       column_text(old_stmt, 1), NULL);
+            old_rc = sqlite3_step(old_stmt);
+        } else if (cmp > 0) {
+            add_change(changes, SNAPSHOT_EDGE_ADDED, name, column_text(new_stmt, 0),
+                       NULL, column_text(new_stmt, 1));
+            new_rc = sqlite3_step(new_stmt);
+        } else {
+            if (strcmp(column_text(old_stmt, 1), column_text(new_stmt, 1)) != 0) {
+                add_change(changes, SNAPSHOT_EDGE_CHANGED, name, column_text(old_stmt, 0),
+                           column_text(old_stmt, 1), column_text(new_stmt, 1));
+            }
+            old_rc = sqlite3_step(old_stmt);
+            new_rc = sqlite3_step(new_stmt);
+        }
+    }
+    sqlite3_reset(old_stmt);
+    sqlite3_reset(new_stmt);
+
+    if (old_rc != SQLITE_DONE || new_rc != SQLITE_DONE) {
+        snprintf(error_message, sizeof(error_message),
+                "Failed to diff dependencies: %s", sqlite3_errmsg(analyzer->db));
+        return DB_ERROR_QUERY;
+    }
+    return DB_SUCCESS;
+}
+
+// Compares two snapshots with a streaming merge over their name-ordered
+// package lists. Versions are ordered by their stored PEP 440 keys, and
+// dependency edges are only read for packages whose row differs.
+DbError db_diff_snapshots(VenvAnalyzer* analyzer,
+                          sqlite3_int64 old_snapshot,
+                          sqlite3_int64 new_snapshot,
+                          GPtrArray** changes) {
+    if (!analyzer || !analyzer->db || !changes) {
+        snprintf(error_message, sizeof(error_message), "Database is not open");
+        return DB_ERROR_INIT;
+    }
+
+    sqlite3_stmt* old_stmt = get_cached_statement(analyzer, DB_STMT_DIFF_PACKAGES_OLD);
+    sqlite3_stmt* new_stmt = get_cached_statement(analyzer, DB_STMT_DIFF_PACKAGES_NEW);
+    if (!old_stmt || !new_stmt) return DB_ERROR_QUERY;
+
+    sqlite3_bind_int64(old_stmt, 1, old_snapshot);
+    sqlite3_bind_int64(new_stmt, 1, new_snapshot);
+
+    GPtrArray* result = g_ptr_array_new_with_free_func((GDestroyNotify)snapshot_change_free);
+    DbError error = DB_SUCCESS;
+
+    int old_rc = sqlite3_step(old_stmt);
+    int new_rc = sqlite3_step(new_stmt);
+    while (error == DB_SUCCESS && (old_rc == SQLITE_ROW || new_rc == SQLITE_ROW)) {
+        int cmp = merge_compare(old_stmt, old_rc, new_stmt, new_rc, 1);
+        if (cmp < 0) {
+            add_change(result, SNAPSHOT_PACKAGE_REMOVED, column_text(old_stmt, 1), NULL,
+                       column_text(old_stmt, 2), NULL);
+            old_rc = sqlite3_step(old_stmt);
+            continue;
+        }
+        if (cmp > 0) {
+            add_change(result, SNAPSHOT_PACKAGE_ADDED, column_text(new_stmt, 1), NULL,
+                       NULL, column_text(new_stmt, 2));
+            new_rc = sqlite3_step(new_stmt);
+            continue;
+        }
+
+        sqlite3_int64 old_id = sqlite3_column_int64(old_stmt, 0);
+        sqlite3_int64 new_id = sqlite3_column_int64(new_stmt, 0);
+        if (old_id != new_id) {
+            const char* name = column_text(new_stmt, 1);
+            int order = memcmp(sqlite3_column_blob(old_stmt, 3),
+                               sqlite3_column_blob(new_stmt, 3), VERSION_KEY_LEN);
+            if (order != 0) {
+                add_change(result,
+                           order < 0 ? SNAPSHOT_PACKAGE_UPGRADED : SNAPSHOT_PACKAGE_DOWNGRADED,
+                           name, NULL, column_text(old_stmt, 2), column_text(new_stmt, 2));
+            }
+            error = diff_dependencies(analyzer, name, old_id, new_id, result);
+        }
+        old_rc = sqlite3_step(old_stmt);
+        new_rc = sqlite3_step(new_stmt);
+    }
+    sqlite3_reset(old_stmt);
+    sqlite3_reset(new_stmt);
+
+    if (error == DB_SUCCESS && (old_rc != SQLITE_DONE || new_rc != SQLITE_DONE)) {
+        snprintf(error_message, sizeof(error_message),
+                "Failed to diff snapshots: %s", sqlite3_errmsg(analyzer->db));
+        error = DB_ERROR_QUERY;
+    }
+
+    if (error != DB_SUCCESS) {
+        g_ptr_array_unref(result);
+        return error;
+    }
+
+    *changes = result;
+    return DB_SUCCESS;
+}
+
+// Cross-environment queries
+
+void db_environment_free(DbEnvironment* environment) {
+    if (!environment) return;
+    g_free(environment->venv_path);
+    g_free(environment->last_scan);
+    g_free(environment->version);
+    g_free(environment);
+}
+
+// Reads one row of ENVIRONMENT_COLUMNS followed by an optional version and
+// an optional dependent count
+static DbEnvironment* read_environment_row(sqlite3_stmt* stmt) {
+    DbEnvironment* environment = g_new0(DbEnvironment, 1);
+    environment->id = sqlite3_column_int64(stmt, 0);
+    environment->venv_path = g_strdup(column_text(stmt, 1));
+    environment->last_scan = g_strdup(column_text(stmt, 2));
+    environment->latest_snapshot = sqlite3_column_int64(stmt, 3);
+    environment->package_count = sqlite3_column_int64(stmt, 4);
+    environment->total_size = sqlite3_column_int64(stmt, 5);
+    environment->version = g_strdup(column_text(stmt, 6));
+    if (sqlite3_column_count(stmt) > 7 && sqlite3_column_type(stmt, 7) == SQLITE_INTEGER) {
+        environment->dependent_count = sqlite3_column_int64(stmt, 7);
+    }
+    return environment;
+}
+
+// Steps a bound environment query to completion and resets it
+static DbError collect_environments(VenvAnalyzer* analyzer, sqlite3_stmt* stmt,
+                                    GPtrArray** environments) {
+    GPtrArray* result = g_ptr_array_new_with_free_func((GDestroyNotify)db_environment_free);
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        g_ptr_array_add(result, read_environment_row(stmt));
+    }
+    sqlite3_reset(stmt);
+
+    if (rc != SQLITE_DONE) {
+        snprintf(error_message, sizeof(error_message),
+                "Failed to query environments: %s", sqlite3_errmsg(analyzer->db));
+        g_ptr_array_unref(result);
+        return DB_ERROR_QUERY;
+    }
+
+    *environments = result;
+    return DB_SUCCESS;
+}
+
+DbError db_list_environments(VenvAnalyzer* analyzer, GPtrArray** environments) {
+    sqlite3_stmt* stmt = get_cached_statement(analyzer, DB_STMT_LIST_ENVIRONMENTS);
+    if (!stmt) return DB_ERROR_QUERY;
+
+    return collect_environments(analyzer, stmt, environments);
+}
+
+DbError db_largest_environments(VenvAnalyzer* analyzer, guint limit,
+                                GPtrArray** environments) {
+    sqlite3_stmt* stmt = get_cached_statement(analyzer, DB_STMT_LARGEST_ENVIRONMENTS);
+    if (!stmt) return DB_ERROR_QUERY;
+
+    sqlite3_bind_int64(stmt, 1, limit);
+    return collect_environments(analyzer, stmt, environments);
+}
+
+DbError db_find_environments_depending_on(VenvAnalyzer* analyzer,
+                                          const char* package_name,
+                                          GPtrArray** environments) {
+    sqlite3_stmt* stmt = get_cached_statement(analyzer, DB_STMT_ENVIRONMENTS_DEPENDING_ON);
+    if (!stmt) return DB_ERROR_QUERY;
+
+    sqlite3_bind_text(stmt, 1, package_normalize_name(package_name), -1, g_free);
+    return collect_environments(analyzer, stmt, environments);
+}
+
+static gboolean range_excludes(const VersionRange* range, const void* key, int key_len) {
+    if (key_len != VERSION_KEY_LEN) return FALSE;
+    for (guint i = 0; i < range->excluded->len; i++) {
+        if (memcmp(range->excluded->data + i * VERSION_KEY_LEN, key, VERSION_KEY_LEN) == 0) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Environments whose current scan has package_name installed at a version
+// matching specifier. Each result's version field holds the installed version.
+DbError db_find_environments_with_package(VenvAnalyzer* analyzer,
+                                          const char* package_name,
+                                          const char* specifier,
+                                          GPtrArray** environments) {
+    VersionRange range;
+    if (!package_version_range_parse(specifier, &range)) {
+        snprintf(error_message, sizeof(error_message),
+                "Invalid version specifier: %s", specifier);
+        return DB_ERROR_QUERY;
+    }
+
+    sqlite3_stmt* stmt = get_cached_statement(analyzer, DB_STMT_ENVIRONMENTS_WITH_VERSION);
+    if (!stmt) {
+        package_version_range_clear(&range);
+        return DB_ERROR_QUERY;
+    }
+
+    sqlite3_bind_text(stmt, 1, package_normalize_name(package_name), -1, g_free);
+    if (range.lower_len > 0) {
+        sqlite3_bind_blob(stmt, 2, range.lower, range.lower_len, SQLITE_STATIC);
+    } else {
+        sqlite3_bind_zeroblob(stmt, 2, 0);
+    }
+    sqlite3_bind_blob(stmt, 3, range.upper, range.upper_len, SQLITE_STATIC);
+
+    GPtrArray* result = g_ptr_array_new_with_free_func((GDestroyNotify)db_environment_free);
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (range_excludes(&range, sqlite3_column_blob(stmt, 7), sqlite3_column_bytes(stmt, 7))) {
+            continue;
+        }
+        g_ptr_array_add(result, read_environment_row(stmt));
+    }
+    sqlite3_reset(stmt);
+    package_version_range_clear(&range);
+
+    if (rc != SQLITE_DONE) {
+        snprintf(error_message, sizeof(error_message),
+                "Failed to query environments: %s", sqlite3_errmsg(analyzer->db));
+        g_ptr_array_unref(result);
+        return DB_ERROR_QUERY;
+    }
+
+    *environments = result;
+    return DB_SUCCESS;
+}
+
+// Package search
+
+void db_search_result_free(DbSearchResult* result) {
+    if (!result) return;
+    g_free(result->venv_path);
+    g_free(result->name);
+    g_free(result->version);
+    g_free(result->summary);
+    g_free(result);
+}
+
+// Every word of the term must match as a word prefix: "typing ext" becomes
+// "typing"* "ext"*. Returns NULL when the term has no words.
+static char* build_word_query(const char* term) {
+    GString* query = g_string_new(NULL);
+    gboolean in_word = FALSE;
+
+    for (const char* p = term; *p; p = g_utf8_next_char(p)) {
+        gunichar c = g_utf8_get_char(p);
+        if (g_unichar_isalnum(c)) {
+            if (!in_word) {
+                if (query->len) g_string_append_c(query, ' ');
+                g_string_append_c(query, '"');
+                in_word = TRUE;
+            }
+            g_string_append_unichar(query, c);
+        } else if (in_word) {
+            g_string_append(query, "\"*");
+            in_word = FALSE;
+        }
+    }
+    if (in_word) g_string_append(query, "\"*");
+
+    if (query->len == 0) {
+        g_string_free(query, TRUE);
+        return NULL;
+    }
+    return g_string_free(query, FALSE);
+}
+
+// The whole term as one quoted phrase, which the trigram index matches as a
+// substring. Returns NULL for terms shorter than a trigram.
+static char* build_trigram_query(const char* term) {
+    if (g_utf8_strlen(term, -1) < 3) return NULL;
+
+    GString* query = g_string_new("\"");
+    for (const char* p = term; *p; p++) {
+        if (*p == '"') g_string_append_c(query, '"');
+        g_string_append_c(query, *p);
+    }
+    g_string_append_c(query, '"');
+    return g_string_free(query, FALSE);
+}
+
+// Searches package names, summaries and dependency names in the current
+// scan of venv_path, or of every environment when venv_path is NULL.
+// limit 0 returns all matches.
+DbError db_search_packages(VenvAnalyzer* analyzer,
+                           const char* term,
+                           const char* venv_path,
+                           guint limit,
+                           GPtrArray** results) {
+    if (!analyzer || !analyzer->db || !results) {
+        snprintf(error_message, sizeof(error_message), "Database is not open");
+        return DB_ERROR_INIT;
+    }
+
+    GPtrArray* found = g_ptr_array_new_with_free_func((GDestroyNotify)db_search_result_free);
+    char* stripped = g_strstrip(g_strdup(term ? term : ""));
+    char* word_query = build_word_query(stripped);
+    char* trigram_query = build_trigram_query(stripped);
+    g_free(stripped);
+
+    if (!word_query) {
+        g_free(trigram_query);
+        *results = found;
+        return DB_SUCCESS;
+    }
+
+    sqlite3_stmt* stmt = get_cached_statement(analyzer, trigram_query
+                                              ? DB_STMT_SEARCH_WORDS_AND_TRIGRAMS
+                                              : DB_STMT_SEARCH_WORDS);
+    if (!stmt) {
+        g_free(word_query);
+        g_free(trigram_query);
+        g_ptr_array_unref(found);
+        return DB_ERROR_QUERY;
+    }
+
+    sqlite3_bind_text(stmt, 1, word_query, -1, g_free);
+    if (trigram_query) sqlite3_bind_text(stmt, 2, trigram_query, -1, g_free);
+    sqlite3_bind_text(stmt, 3, venv_path, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 4, limit ? (sqlite3_int64)limit : -1);
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        DbSearchResult* result = g_new0(DbSearchResult, 1);
+        result->venv_path = g_strdup(column_text(stmt, 0));
+        result->name = g_strdup(column_text(stmt, 1));
+        result->version = g_strdup(column_text(stmt, 2));
+        result->summary = g_strdup(column_text(stmt, 3));
+        g_ptr_array_add(found, result);
+    }
+    sqlite3_reset(stmt);
+
+    if (rc != SQLITE_DONE) {
+        snprintf(error_message, sizeof(error_message),
+                "Failed to search packages: %s", sqlite3_errmsg(analyzer->db));
+        g_ptr_array_unref(found);
+        return DB_ERROR_QUERY;
+    }
+
+    *results = found;
     return DB_SUCCESS;
 }
 
 // Error handling
 const char* db_get_last_error(void) {
     return error_message[0] ? error_message : "No error";
+}
+
+// Reports an error that happened on another thread's connection
+void db_set_last_error(const char* message) {
+    g_strlcpy(error_message, message, sizeof(error_message));
 }
\ No newline at end of file
@@ -15,8 +15,61 @@ typedef enum {
     DB_ERROR_NOT_FOUND = -4
 } DbError;
 
+// A stored scan of one environment
+typedef struct {
+    sqlite3_int64 id;
+    char* venv_path;
+    char* created_at;
+    gint64 package_count;
+    gint64 total_size;
+} DbSnapshot;
+
+// An environment known to the database with the totals of its latest scan.
+// version is only set by db_find_environments_with_package and
+// dependent_count only by db_find_environments_depending_on.
+typedef struct {
+    sqlite3_int64 id;
+    char* venv_path;
+    char* last_scan;
+    sqlite3_int64 latest_snapshot;
+    gint64 package_count;
+    gint64 total_size;
+    char* version;
+    gint64 dependent_count;
+} DbEnvironment;
+
+// A package matched by db_search_packages in one environment
+typedef struct {
+    char* venv_path;
+    char* name;
+    char* version;
+    char* summary;
+} DbSearchResult;
+
+typedef enum {
+    SNAPSHOT_PACKAGE_ADDED,
+    SNAPSHOT_PACKAGE_REMOVED,
+    SNAPSHOT_PACKAGE_UPGRADED,
+    SNAPSHOT_PACKAGE_DOWNGRADED,
+    SNAPSHOT_EDGE_ADDED,
+    SNAPSHOT_EDGE_REMOVED,
+    SNAPSHOT_EDGE_CHANGED
+} SnapshotChangeKind;
+
+// One difference between two snapshots. old_value/new_value hold versions
+// for package changes and version constraints for edge changes; dependency
+// is only set for edge changes.
+typedef struct {
+    SnapshotChangeKind kind;
+    char* name;
+    char* dependency;
+    char* old_value;
+    char* new_value;
+} SnapshotChange;
+
 // Database initialization and cleanup
 DbError db_init(VenvAnalyzer* analyzer, const char* db_path);
+DbError db_init_readonly(VenvAnalyzer* analyzer, const char* db_path);
 void db_close(VenvAnalyzer* analyzer);
 
 // Transaction management
@@ -32,13 +85,6 @@ Package* db_get_package(VenvAnalyzer* analyzer, const char* name);
 GList* db_get_all_packages(VenvAnalyzer* analyzer);
 
 // Dependency operations
-DbError db_add_dependency(VenvAnalyzer* analyzer, 
-                         const char* package_name,
-                         const char* dep_name,
-                         const char* version_constraint);
-DbError db_remove_dependency(VenvAnalyzer* analyzer,
-                           const char* package_name,
-                           const char* dep_name);
 GList* db_get_dependencies(VenvAnalyzer* analyzer, const char* package_name);
 
 // Settings management
@@ -50,8 +96,41 @@ char* db_get_setting(VenvAnalyzer* analyzer, const char* key);
 // State management
 DbError db_save_state(VenvAnalyzer* analyzer);
 DbError db_load_state(VenvAnalyzer* analyzer);
+DbError db_load_snapshot(VenvAnalyzer* analyzer, sqlite3_int64 snapshot_id);
+
+// Snapshot history
+GPtrArray* db_list_snapshots(VenvAnalyzer* analyzer, const char* venv_path);
+void db_snapshot_free(DbSnapshot* snapshot);
+DbError db_diff_snapshots(VenvAnalyzer* analyzer,
+                          sqlite3_int64 old_snapshot,
+                          sqlite3_int64 new_snapshot,
+                          GPtrArray** changes);
+void snapshot_change_free(SnapshotChange* change);
+
+// Cross-environment queries over the latest scan of every environment;
+// results are GPtrArrays of DbEnvironment* owned by the caller
+DbError db_list_environments(VenvAnalyzer* analyzer, GPtrArray** environments);
+DbError db_largest_environments(VenvAnalyzer* analyzer, guint limit,
+                                GPtrArray** environments);
+DbError db_find_environments_with_package(VenvAnalyzer* analyzer,
+                                          const char* package_name,
+                                          const char* specifier,
+                                          GPtrArray** environments);
+DbError db_find_environments_depending_on(VenvAnalyzer* analyzer,
+                                          const char* package_name,
+                                          GPtrArray** environments);
+void db_environment_free(DbEnvironment* environment);
+
+// Full-text package search; venv_path NULL searches every environment
+DbError db_search_packages(VenvAnalyzer* analyzer,
+                           const char* term,
+                           const char* venv_path,
+                           guint limit,
+                           GPtrArray** results);
+void db_search_result_free(DbSearchResult* result);
 
 // Error handling
 const char* db_get_last_error(void);
+void db_set_last_error(const char* message);
 
 #endif // DB_DATABASE_H
\ No newline at end of file
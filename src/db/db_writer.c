@@ -0,0 +1,332 @@
+#include "db_writer.h"
+#include "../core/package.h"
+#include <string.h>
+
+// A synchronous caller waiting on its stack for one job
+typedef struct {
+    DbError result;
+    char message[256];
+    gboolean done;
+} WriteWaiter;
+
+typedef struct {
+    char* venv_path;        // Environment to save, NULL for barriers
+    Package* packages;      // Copies owned by the job
+    GPtrArray* tasks;       // GTask* completed once the job is committed
+    WriteWaiter* waiter;    // Synchronous caller, or NULL
+    DbError result;
+    char message[256];
+} WriteJob;
+
+struct _DbWriter {
+    // Connection holder for the db_* functions; only db, db_stmts,
+    // venv_path and packages are ever set
+    VenvAnalyzer* connection;
+    GThread* thread;
+
+    // Everything below is guarded by mutex; changed is broadcast whenever
+    // the queue, the batch or a waiter changes
+    GMutex mutex;
+    GCond changed;
+    GQueue queue;           // WriteJob* not yet picked up
+    GPtrArray* batch;       // WriteJob* being written
+    gboolean closing;
+};
+
+static void free_package_list(Package* pkg) {
+    while (pkg) {
+        Package* next = pkg->next;
+        package_free(pkg);
+        pkg = next;
+    }
+}
+
+static Package* copy_package_list(Package* packages) {
+    Package* head = NULL;
+    Package** tail = &head;
+    for (Package* pkg = packages; pkg; pkg = pkg->next) {
+        *tail = package_copy(pkg);
+        tail = &(*tail)->next;
+    }
+    return head;
+}
+
+static WriteJob* write_job_new(const char* venv_path, Package* packages, GTask* task) {
+    WriteJob* job = g_new0(WriteJob, 1);
+    job->venv_path = g_strdup(venv_path);
+    job->packages = copy_package_list(packages);
+    job->tasks = g_ptr_array_new_with_free_func(g_object_unref);
+    if (task) g_ptr_array_add(job->tasks, task);
+    return job;
+}
+
+static void write_job_free(WriteJob* job) {
+    free_package_list(job->packages);
+    g_ptr_array_unref(job->tasks);
+    g_free(job->venv_path);
+    g_free(job);
+}
+
+static void fail_job(WriteJob* job, DbError result, const char* message) {
+    job->result = result;
+    g_strlcpy(job->message, message, sizeof(job->message));
+}
+
+static void apply_job(DbWriter* writer, WriteJob* job) {
+    if (!job->venv_path) return;
+
+    VenvAnalyzer* connection = writer->connection;
+    g_strlcpy(connection->venv_path, job->venv_path, sizeof(connection->venv_path));
+    connection->packages = job->packages;
+    DbError result = db_save_state(connection);
+    connection->packages = NULL;
+
+    if (result != DB_SUCCESS) {
+        fail_job(job, result, db_get_last_error());
+    }
+}
+
+// Writes a batch in one transaction, so it costs a single commit. Each save
+// runs in its own savepoint and a failure only undoes that save.
+static void write_batch(DbWriter* writer, GPtrArray* batch) {
+    gboolean has_writes = FALSE;
+    for (guint i = 0; i < batch->len && !has_writes; i++) {
+        has_writes = ((WriteJob*)g_ptr_array_index(batch, i))->venv_path != NULL;
+    }
+    if (!has_writes) return;
+
+    sqlite3* db = writer->connection->db;
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK) {
+        for (guint i = 0; i < batch->len; i++) {
+            fail_job(g_ptr_array_index(batch, i), DB_ERROR_QUERY, sqlite3_errmsg(db));
+        }
+        return;
+    }
+
+    for (guint i = 0; i < batch->len; i++) {
+        apply_job(writer, g_ptr_array_index(batch, i));
+    }
+
+    if (sqlite3_exec(db, "COMMIT", NULL, NULL, NULL) != SQLITE_OK) {
+        char message[256];
+        g_strlcpy(message, sqlite3_errmsg(db), sizeof(message));
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        for (guint i = 0; i < batch->len; i++) {
+            WriteJob* job = g_ptr_array_index(batch, i);
+            if (job->venv_path && job->result == DB_SUCCESS) {
+                fail_job(job, DB_ERROR_QUERY, message);
+            }
+        }
+    }
+}
+
+static void complete_job(WriteJob* job) {
+    for (guint i = 0; i < job->tasks->len; i++) {
+        GTask* task = g_ptr_array_index(job->tasks, i);
+        if (job->result == DB_SUCCESS) {
+            g_task_return_boolean(task, TRUE);
+        } else {
+            g_task_return_new_error(task, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_DB_FAILED,
+                                    "Failed to save scan: %s", job->message);
+        }
+    }
+}
+
+static gpointer writer_thread(gpointer data) {
+    DbWriter* writer = data;
+
+    g_mutex_lock(&writer->mutex);
+    while (TRUE) {
+        while (g_queue_is_empty(&writer->queue) && !writer->closing) {
+            g_cond_wait(&writer->changed, &writer->mutex);
+        }
+        // Closing still drains the queue first
+        if (g_queue_is_empty(&writer->queue)) break;
+
+        WriteJob* job;
+        while ((job = g_queue_pop_head(&writer->queue))) {
+            g_ptr_array_add(writer->batch, job);
+        }
+        g_cond_broadcast(&writer->changed);
+        g_mutex_unlock(&writer->mutex);
+
+        write_batch(writer, writer->batch);
+
+        g_mutex_lock(&writer->mutex);
+        GPtrArray* batch = writer->batch;
+        writer->batch = g_ptr_array_new();
+        for (guint i = 0; i < batch->len; i++) {
+            job = g_ptr_array_index(batch, i);
+            if (job->waiter) {
+                job->waiter->result = job->result;
+                g_strlcpy(job->waiter->message, job->message, sizeof(job->waiter->message));
+                job->waiter->done = TRUE;
+            }
+        }
+        g_cond_broadcast(&writer->changed);
+        g_mutex_unlock(&writer->mutex);
+
+        // Tasks call back on their own main context
+        for (guint i = 0; i < batch->len; i++) {
+            job = g_ptr_array_index(batch, i);
+            complete_job(job);
+            write_job_free(job);
+        }
+        g_ptr_array_unref(batch);
+
+        g_mutex_lock(&writer->mutex);
+    }
+    g_mutex_unlock(&writer->mutex);
+
+    return NULL;
+}
+
+// A save directly behind an unwritten save of the same environment would
+// be superseded by it anyway, so the newer packages replace the older ones
+// and both callers complete with the one write
+static gboolean can_replace(WriteJob* queued, WriteJob* job) {
+    return queued && job->venv_path && queued->venv_path && !queued->waiter &&
+           strcmp(queued->venv_path, job->venv_path) == 0;
+}
+
+static void push_job(DbWriter* writer, WriteJob* job) {
+    g_mutex_lock(&writer->mutex);
+    while (TRUE) {
+        WriteJob* last = g_queue_peek_tail(&writer->queue);
+        if (can_replace(last, job)) {
+            free_package_list(last->packages);
+            last->packages = job->packages;
+            last->waiter = job->waiter;
+            job->packages = NULL;
+            g_ptr_array_extend_and_steal(last->tasks, job->tasks);
+            job->tasks = g_ptr_array_new();
+            write_job_free(job);
+            break;
+        }
+        // A full queue means the writer is behind; wait for it to catch up
+        if (g_queue_get_length(&writer->queue) < DB_WRITER_MAX_PENDING) {
+            g_queue_push_tail(&writer->queue, job);
+            break;
+        }
+        g_cond_wait(&writer->changed, &writer->mutex);
+    }
+    g_cond_broadcast(&writer->changed);
+    g_mutex_unlock(&writer->mutex);
+}
+
+static void wait_for_job(DbWriter* writer, WriteWaiter* waiter) {
+    g_mutex_lock(&writer->mutex);
+    while (!waiter->done) {
+        g_cond_wait(&writer->changed, &writer->mutex);
+    }
+    g_mutex_unlock(&writer->mutex);
+}
+
+DbWriter* db_writer_new(const char* db_path) {
+    VenvAnalyzer* connection = g_new0(VenvAnalyzer, 1);
+    if (db_init(connection, db_path) != DB_SUCCESS) {
+        db_close(connection);
+        g_free(connection);
+        return NULL;
+    }
+
+    DbWriter* writer = g_new0(DbWriter, 1);
+    writer->connection = connection;
+    g_mutex_init(&writer->mutex);
+    g_cond_init(&writer->changed);
+    g_queue_init(&writer->queue);
+    writer->batch = g_ptr_array_new();
+
+    // The connection is only used from the writer thread from here on
+    writer->thread = g_thread_new("db-writer", writer_thread, writer);
+    return writer;
+}
+
+void db_writer_free(DbWriter* writer) {
+    if (!writer) return;
+
+    g_mutex_lock(&writer->mutex);
+    writer->closing = TRUE;
+    g_cond_broadcast(&writer->changed);
+    g_mutex_unlock(&writer->mutex);
+    g_thread_join(writer->thread);
+
+    db_close(writer->connection);
+    g_free(writer->connection);
+    g_ptr_array_unref(writer->batch);
+    g_cond_clear(&writer->changed);
+    g_mutex_clear(&writer->mutex);
+    g_free(writer);
+}
+
+void db_writer_save_state_async(DbWriter* writer,
+                                const char* venv_path,
+                                Package* packages,
+                                GAsyncReadyCallback callback,
+                                gpointer user_data) {
+    GTask* task = g_task_new(NULL, NULL, callback, user_data);
+    g_task_set_source_tag(task, db_writer_save_state_async);
+    push_job(writer, write_job_new(venv_path, packages, task));
+}
+
+gboolean db_writer_save_state_finish(DbWriter* writer G_GNUC_UNUSED,
+                                     GAsyncResult* result,
+                                     GError** error) {
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+DbError db_writer_save_state(DbWriter* writer,
+                             const char* venv_path,
+                             Package* packages) {
+    WriteWaiter waiter = { 0 };
+    WriteJob* job = write_job_new(venv_path, packages, NULL);
+    job->waiter = &waiter;
+    push_job(writer, job);
+    wait_for_job(writer, &waiter);
+
+    if (waiter.result != DB_SUCCESS) {
+        db_set_last_error(waiter.message);
+    }
+    return waiter.result;
+}
+
+void db_writer_barrier_async(DbWriter* writer,
+                             GAsyncReadyCallback callback,
+                             gpointer user_data) {
+    GTask* task = g_task_new(NULL, NULL, callback, user_data);
+    g_task_set_source_tag(task, db_writer_barrier_async);
+    push_job(writer, write_job_new(NULL, NULL, task));
+}
+
+gboolean db_writer_barrier_finish(DbWriter* writer G_GNUC_UNUSED,
+                                  GAsyncResult* result,
+                                  GError** error) {
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+void db_writer_flush(DbWriter* writer) {
+    WriteWaiter waiter = { 0 };
+    WriteJob* job = write_job_new(NULL, NULL, NULL);
+    job->waiter = &waiter;
+    push_job(writer, job);
+    wait_for_job(writer, &waiter);
+}
+
+static gboolean job_saves(WriteJob* job, const char* venv_path) {
+    return job->venv_path && strcmp(job->venv_path, venv_path) == 0;
+}
+
+gboolean db_writer_has_pending(DbWriter* writer, const char* venv_path) {
+    gboolean pending = FALSE;
+
+    g_mutex_lock(&writer->mutex);
+    for (GList* l = writer->queue.head; l && !pending; l = l->next) {
+        pending = job_saves(l->data, venv_path);
+    }
+    for (guint i = 0; i < writer->batch->len && !pending; i++) {
+        pending = job_saves(g_ptr_array_index(writer->batch, i), venv_path);
+    }
+    g_mutex_unlock(&writer->mutex);
+
+    return pending;
+}
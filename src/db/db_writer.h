@@ -0,0 +1,73 @@
+#ifndef DB_WRITER_H
+#define DB_WRITER_H
+
+#include "database.h"
+#include <gio/gio.h>
+
+// All database writes go through one writer thread that owns the only
+// read-write connection. Callers queue jobs and return immediately; the
+// thread drains whatever is queued into a single transaction, so a burst
+// of saves costs one commit. Queries keep using their own read-only
+// connections (db_init_readonly), which WAL never blocks.
+
+typedef struct _DbWriter DbWriter;
+
+// Queued jobs before producers have to wait for the writer
+#define DB_WRITER_MAX_PENDING 16
+
+/**
+ * Opens the read-write connection, migrates the schema and starts the
+ * writer thread. The schema is ready for readers when this returns.
+ * @return New writer or NULL on error (see db_get_last_error)
+ */
+DbWriter* db_writer_new(const char* db_path);
+
+/**
+ * Commits everything still queued, then stops the thread and closes the
+ * connection
+ */
+void db_writer_free(DbWriter* writer);
+
+/**
+ * Queues a snapshot of packages for venv_path (see db_save_state). The
+ * packages are copied, so the caller may change them right away. A save
+ * queued directly behind another save of the same environment replaces it.
+ */
+void db_writer_save_state_async(DbWriter* writer,
+                                const char* venv_path,
+                                Package* packages,
+                                GAsyncReadyCallback callback,
+                                gpointer user_data);
+gboolean db_writer_save_state_finish(DbWriter* writer,
+                                     GAsyncResult* result,
+                                     GError** error);
+
+/**
+ * Like db_writer_save_state_async, but waits for the commit
+ */
+DbError db_writer_save_state(DbWriter* writer,
+                             const char* venv_path,
+                             Package* packages);
+
+/**
+ * Completes once every job queued before it has been committed
+ */
+void db_writer_barrier_async(DbWriter* writer,
+                             GAsyncReadyCallback callback,
+                             gpointer user_data);
+gboolean db_writer_barrier_finish(DbWriter* writer,
+                                  GAsyncResult* result,
+                                  GError** error);
+
+/**
+ * Blocks until every job queued so far has been committed
+ */
+void db_writer_flush(DbWriter* writer);
+
+/**
+ * Whether a save of venv_path is queued or being written, i.e. whether a
+ * reader may still see an older scan of it
+ */
+gboolean db_writer_has_pending(DbWriter* writer, const char* venv_path);
+
+#endif // DB_WRITER_H
@@ -1,24 +1,87 @@
--- Packages table
+-- Environments known to this database, one row per venv path. The totals
+-- mirror the latest snapshot so fleet-wide rankings never touch packages.
+CREATE TABLE IF NOT EXISTS environments (
+    id INTEGER PRIMARY KEY,
+    venv_path TEXT NOT NULL UNIQUE,
+    latest_snapshot INTEGER,
+    package_count INTEGER NOT NULL DEFAULT 0,
+    total_size INTEGER NOT NULL DEFAULT 0,
+    last_scan DATETIME
+);
+
+-- Scan snapshots; a snapshot is immutable once its transaction commits
+CREATE TABLE IF NOT EXISTS snapshots (
+    id INTEGER PRIMARY KEY,
+    environment_id INTEGER NOT NULL REFERENCES environments(id),
+    package_count INTEGER NOT NULL DEFAULT 0,
+    total_size INTEGER NOT NULL DEFAULT 0,
+    created_at DATETIME DEFAULT CURRENT_TIMESTAMP
+);
+
+-- Packages table; rows are content-addressed and shared by every snapshot
+-- that contains an identical package (same version, size and dependencies)
 CREATE TABLE IF NOT EXISTS packages (
     id INTEGER PRIMARY KEY,
+    content_hash INTEGER NOT NULL UNIQUE,
     name TEXT NOT NULL,
+    normalized_name TEXT NOT NULL,
     version TEXT NOT NULL,
+    version_key BLOB NOT NULL,
+    summary TEXT NOT NULL DEFAULT '',
     size INTEGER,
     has_conflicts BOOLEAN DEFAULT FALSE,
-    created_at DATETIME DEFAULT CURRENT_TIMESTAMP,
-    UNIQUE(name, version)
+    fingerprint INTEGER NOT NULL DEFAULT 0,
+    created_at DATETIME DEFAULT CURRENT_TIMESTAMP
 );
 
--- Dependencies table with version constraints
+-- Dependencies table with version constraints; edges belong to an
+-- immutable package row and are shared along with it. normalized_name is
+-- the PEP 503 form of dependency_name and joins to packages.normalized_name.
 CREATE TABLE IF NOT EXISTS dependencies (
     package_id INTEGER,
     dependency_name TEXT NOT NULL,
+    normalized_name TEXT NOT NULL,
     version_constraint TEXT NOT NULL DEFAULT '*',
     created_at DATETIME DEFAULT CURRENT_TIMESTAMP,
     FOREIGN KEY(package_id) REFERENCES packages(id) ON DELETE CASCADE,
     PRIMARY KEY(package_id, dependency_name)
 );
 
+-- Snapshot membership as intervals: a package row belongs to every snapshot
+-- of the environment from added_in up to (excluding) removed_in, so a
+-- rescan only writes rows for packages that changed. Rows with a NULL
+-- removed_in describe what is installed right now.
+CREATE TABLE IF NOT EXISTS snapshot_packages (
+    environment_id INTEGER NOT NULL REFERENCES environments(id),
+    package_id INTEGER NOT NULL REFERENCES packages(id),
+    added_in INTEGER NOT NULL REFERENCES snapshots(id),
+    removed_in INTEGER REFERENCES snapshots(id)
+);
+
+-- Dependency edges of what each environment has installed right now, by
+-- normalized name. Rebuilt for an environment on every save so reverse
+-- dependency walks only follow edges that exist in that environment.
+CREATE TABLE IF NOT EXISTS current_edges (
+    environment_id INTEGER NOT NULL REFERENCES environments(id),
+    dependency_name TEXT NOT NULL,
+    package_name TEXT NOT NULL,
+    PRIMARY KEY(environment_id, dependency_name, package_name)
+) WITHOUT ROWID;
+
+-- Package search, keyed by packages.id. Package rows are immutable, so an
+-- entry is written once together with its row and the indexes keep no copy
+-- of the text. package_search matches words and word prefixes in names,
+-- summaries and dependency names; package_name_trigrams matches any
+-- substring of three or more characters in a name.
+CREATE VIRTUAL TABLE IF NOT EXISTS package_search USING fts5(
+    name, summary, dependencies,
+    content = '', prefix = '2 3', tokenize = 'unicode61 remove_diacritics 2'
+);
+
+CREATE VIRTUAL TABLE IF NOT EXISTS package_name_trigrams USING fts5(
+    name, content = '', tokenize = 'trigram'
+);
+
 -- Environment settings table
 CREATE TABLE IF NOT EXISTS env_settings (
     key TEXT PRIMARY KEY,
@@ -34,6 +97,22 @@ INSERT OR IGNORE INTO env_settings (key, value, description) VALUES
     ('last_scan', '', 'Timestamp of last environment scan'),
     ('scan_interval', '86400', 'Scan interval in seconds');
 
--- Indexes for better query performance
+-- Indexes for better query performance. The cross-environment queries
+-- are answered from these alone: version ranges scan
+-- idx_packages_version, installed checks probe the partial
+-- idx_snapshot_packages_current index, and reverse dependency walks
+-- follow idx_current_edges_dependency.
 CREATE INDEX IF NOT EXISTS idx_packages_name ON packages(name);
-CREATE INDEX IF NOT EXISTS idx_dependencies_name ON dependencies(dependency_name);
\ No newline at end of file
+CREATE INDEX IF NOT EXISTS idx_packages_version
+    ON packages(normalized_name, version_key);
+CREATE INDEX IF NOT EXISTS idx_dependencies_target
+    ON dependencies(normalized_name, package_id);
+CREATE INDEX IF NOT EXISTS idx_current_edges_dependency
+    ON current_edges(dependency_name, environment_id, package_name);
+CREATE INDEX IF NOT EXISTS idx_environments_size
+    ON environments(total_size DESC, id);
+CREATE INDEX IF NOT EXISTS idx_snapshots_environment ON snapshots(environment_id, id);
+CREATE INDEX IF NOT EXISTS idx_snapshot_packages_history
+    ON snapshot_packages(environment_id, added_in, removed_in, package_id);
+CREATE INDEX IF NOT EXISTS idx_snapshot_packages_current
+    ON snapshot_packages(package_id, environment_id) WHERE removed_in IS NULL;
@@ -1,6 +1,298 @@
 #include "../include/venv_analyzer.h"
 #include "../include/ui/main_window.h"
+#include "core/analyzer.h"
+#include "core/snapshot.h"
+#include "db/database.h"
 #include <gtk/gtk.h>
+#include <stdio.h>
+#include <string.h>
+
+static const GOptionEntry option_entries[] = {
+    { "search", 's', 0, G_OPTION_ARG_STRING, NULL,
+      "Search saved scans for packages and exit", "TERM" },
+    { "venv", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+      "Limit command-line queries to one environment", "PATH" },
+    { "write-snapshot", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+      "Scan the --venv environment into a binary snapshot and exit", "FILE" },
+    { "open-snapshot", 0, 0, G_OPTION_ARG_FILENAME, NULL,
+      "List the packages of a binary snapshot and exit", "FILE" },
+    { "history", 0, 0, G_OPTION_ARG_NONE, NULL,
+      "List the saved scans of the --venv environment and exit", NULL },
+    { "diff", 0, 0, G_OPTION_ARG_STRING, NULL,
+      "Compare two saved scans of one environment and exit", "OLD..NEW" },
+    { "environments", 0, 0, G_OPTION_ARG_NONE, NULL,
+      "List saved environments and exit", NULL },
+    { "largest", 0, 0, G_OPTION_ARG_INT, NULL,
+      "List the N largest saved environments and exit", "N" },
+    { "installed", 0, 0, G_OPTION_ARG_STRING, NULL,
+      "List saved environments with a matching package installed and exit",
+      "NAME[SPECIFIER]" },
+    { "depending-on", 0, 0, G_OPTION_ARG_STRING, NULL,
+      "List saved environments whose packages depend on NAME and exit", "NAME" },
+    G_OPTION_ENTRY_NULL
+};
+
+// Prints one "path<TAB>name==version<TAB>summary" line per match
+static int run_search(const char* term, const char* venv_path) {
+    VenvAnalyzer* analyzer = venv_analyzer_new_headless();
+    GError* error = NULL;
+
+    GPtrArray* results = venv_analyzer_search_saved(analyzer, term, venv_path, &error);
+    if (!results) {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        venv_analyzer_free(analyzer);
+        return 1;
+    }
+
+    for (guint i = 0; i < results->len; i++) {
+        DbSearchResult* result = g_ptr_array_index(results, i);
+        g_print("%s\t%s==%s\t%s\n", result->venv_path, result->name,
+                result->version, result->summary);
+    }
+
+    g_ptr_array_unref(results);
+    venv_analyzer_free(analyzer);
+    return 0;
+}
+
+static int run_write_snapshot(const char* path, const char* venv_path) {
+    if (!venv_path) {
+        g_printerr("--write-snapshot needs --venv\n");
+        return 1;
+    }
+
+    VenvAnalyzer* analyzer = venv_analyzer_new_headless();
+    g_strlcpy(analyzer->venv_path, venv_path, sizeof(analyzer->venv_path));
+
+    GError* error = NULL;
+    int status = 0;
+    if (!venv_analyzer_scan(analyzer, &error) ||
+        !venv_analyzer_write_snapshot(analyzer, path, &error)) {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        status = 1;
+    }
+
+    venv_analyzer_free(analyzer);
+    return status;
+}
+
+// Reads straight from the mapping, without building Package objects.
+// Prints "name==version<TAB>size<TAB>dependencies<TAB>dependents" per
+// package, limited to names containing term when one is given.
+static int run_open_snapshot(const char* path, const char* term) {
+    GError* error = NULL;
+    VenvSnapshot* snapshot = venv_snapshot_open(path, &error);
+    if (!snapshot) {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+
+    char* needle = term ? g_utf8_casefold(term, -1) : NULL;
+    guint n_packages = venv_snapshot_get_n_packages(snapshot);
+    for (guint i = 0; i < n_packages; i++) {
+        if (needle && !strstr(venv_snapshot_package_normalized_name(snapshot, i), needle)) {
+            continue;
+        }
+        g_print("%s==%s\t%" G_GUINT64_FORMAT "\t%u\t%u\n",
+                venv_snapshot_package_name(snapshot, i),
+                venv_snapshot_package_version(snapshot, i),
+                venv_snapshot_package_size(snapshot, i),
+                venv_snapshot_package_n_dependencies(snapshot, i),
+                venv_snapshot_package_n_dependents(snapshot, i));
+    }
+
+    g_free(needle);
+    venv_snapshot_unref(snapshot);
+    return 0;
+}
+
+// Prints "id<TAB>created<TAB>packages<TAB>size" per saved scan, newest first
+static int run_history(const char* venv_path) {
+    if (!venv_path) {
+        g_printerr("--history needs --venv\n");
+        return 1;
+    }
+
+    VenvAnalyzer* analyzer = venv_analyzer_new_headless();
+    GError* error = NULL;
+
+    GPtrArray* scans = venv_analyzer_list_saved_scans(analyzer, venv_path, &error);
+    if (!scans) {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        venv_analyzer_free(analyzer);
+        return 1;
+    }
+
+    for (guint i = 0; i < scans->len; i++) {
+        DbSnapshot* scan = g_ptr_array_index(scans, i);
+        g_print("%" G_GINT64_FORMAT "\t%s\t%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\n",
+                (gint64)scan->id, scan->created_at, scan->package_count,
+                scan->total_size);
+    }
+
+    g_ptr_array_unref(scans);
+    venv_analyzer_free(analyzer);
+    return 0;
+}
+
+// Prints "kind<TAB>name<TAB>dependency<TAB>old<TAB>new" per change, with
+// "-" for fields a change does not have
+static int run_diff(const char* range) {
+    static const char* const kinds[] = {
+        [SNAPSHOT_PACKAGE_ADDED] = "added",
+        [SNAPSHOT_PACKAGE_REMOVED] = "removed",
+        [SNAPSHOT_PACKAGE_UPGRADED] = "upgraded",
+        [SNAPSHOT_PACKAGE_DOWNGRADED] = "downgraded",
+        [SNAPSHOT_EDGE_ADDED] = "edge-added",
+        [SNAPSHOT_EDGE_REMOVED] = "edge-removed",
+        [SNAPSHOT_EDGE_CHANGED] = "edge-changed",
+    };
+
+    gint64 old_scan, new_scan;
+    int end = 0;
+    if (sscanf(range, "%" G_GINT64_FORMAT "..%" G_GINT64_FORMAT "%n",
+               &old_scan, &new_scan, &end) != 2 || range[end]) {
+        g_printerr("--diff expects two scan ids as OLD..NEW, see --history\n");
+        return 1;
+    }
+
+    VenvAnalyzer* analyzer = venv_analyzer_new_headless();
+    GError* error = NULL;
+
+    GPtrArray* changes = venv_analyzer_diff_saved_scans(analyzer, old_scan, new_scan, &error);
+    if (!changes) {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        venv_analyzer_free(analyzer);
+        return 1;
+    }
+
+    for (guint i = 0; i < changes->len; i++) {
+        SnapshotChange* change = g_ptr_array_index(changes, i);
+        g_print("%s\t%s\t%s\t%s\t%s\n", kinds[change->kind], change->name,
+                change->dependency ? change->dependency : "-",
+                change->old_value ? change->old_value : "-",
+                change->new_value ? change->new_value : "-");
+    }
+
+    g_ptr_array_unref(changes);
+    venv_analyzer_free(analyzer);
+    return 0;
+}
+
+typedef enum {
+    ENVIRONMENT_QUERY_LIST,
+    ENVIRONMENT_QUERY_INSTALLED,
+    ENVIRONMENT_QUERY_DEPENDING_ON
+} EnvironmentQuery;
+
+// Prints "path<TAB>packages<TAB>size<TAB>last scan" per environment, followed
+// by the installed version or the number of dependents for those queries.
+// For ENVIRONMENT_QUERY_INSTALLED, argument is a requirement such as
+// "requests>=2,<3".
+static int run_environments(EnvironmentQuery query, const char* argument, guint limit) {
+    VenvAnalyzer* analyzer = venv_analyzer_new_headless();
+    GError* error = NULL;
+    GPtrArray* environments = NULL;
+
+    if (query == ENVIRONMENT_QUERY_INSTALLED) {
+        gsize name_len = strcspn(argument, "<>=!~ ,;");
+        char* name = g_strndup(argument, name_len);
+        char* specifier = g_strstrip(g_strdup(argument + name_len));
+        environments = venv_analyzer_find_saved_environments(analyzer, name,
+                                                             specifier[0] ? specifier : NULL,
+                                                             &error);
+        g_free(specifier);
+        g_free(name);
+    } else if (query == ENVIRONMENT_QUERY_DEPENDING_ON) {
+        environments = venv_analyzer_find_saved_dependents(analyzer, argument, &error);
+    } else {
+        environments = venv_analyzer_list_saved_environments(analyzer, limit, &error);
+    }
+
+    if (!environments) {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        venv_analyzer_free(analyzer);
+        return 1;
+    }
+
+    for (guint i = 0; i < environments->len; i++) {
+        DbEnvironment* environment = g_ptr_array_index(environments, i);
+        g_print("%s\t%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\t%s",
+                environment->venv_path, environment->package_count,
+                environment->total_size,
+                environment->last_scan ? environment->last_scan : "-");
+        if (query == ENVIRONMENT_QUERY_INSTALLED) {
+            g_print("\t%s", environment->version);
+        } else if (query == ENVIRONMENT_QUERY_DEPENDING_ON) {
+            g_print("\t%" G_GINT64_FORMAT, environment->dependent_count);
+        }
+        g_print("\n");
+    }
+
+    g_ptr_array_unref(environments);
+    venv_analyzer_free(analyzer);
+    return 0;
+}
+
+// Command-line queries run here, before GTK is initialized, so they work
+// without a display. Returning -1 continues with the GUI.
+static int on_handle_local_options(GApplication* app G_GNUC_UNUSED,
+                                   GVariantDict* options,
+                                   gpointer user_data G_GNUC_UNUSED) {
+    const char* venv_path = NULL;
+    g_variant_dict_lookup(options, "venv", "^&ay", &venv_path);
+
+    const char* snapshot_path = NULL;
+    if (g_variant_dict_lookup(options, "write-snapshot", "^&ay", &snapshot_path)) {
+        return run_write_snapshot(snapshot_path, venv_path);
+    }
+
+    const char* term = NULL;
+    g_variant_dict_lookup(options, "search", "&s", &term);
+    if (g_variant_dict_lookup(options, "open-snapshot", "^&ay", &snapshot_path)) {
+        return run_open_snapshot(snapshot_path, term);
+    }
+
+    if (term) {
+        return run_search(term, venv_path);
+    }
+
+    gboolean flag = FALSE;
+    if (g_variant_dict_lookup(options, "history", "b", &flag) && flag) {
+        return run_history(venv_path);
+    }
+
+    const char* argument = NULL;
+    if (g_variant_dict_lookup(options, "diff", "&s", &argument)) {
+        return run_diff(argument);
+    }
+    if (g_variant_dict_lookup(options, "installed", "&s", &argument)) {
+        return run_environments(ENVIRONMENT_QUERY_INSTALLED, argument, 0);
+    }
+    if (g_variant_dict_lookup(options, "depending-on", "&s", &argument)) {
+        return run_environments(ENVIRONMENT_QUERY_DEPENDING_ON, argument, 0);
+    }
+
+    gint32 limit = 0;
+    if (g_variant_dict_lookup(options, "largest", "i", &limit)) {
+        if (limit <= 0) {
+            g_printerr("--largest needs a positive count\n");
+            return 1;
+        }
+        return run_environments(ENVIRONMENT_QUERY_LIST, NULL, limit);
+    }
+    if (g_variant_dict_lookup(options, "environments", "b", &flag) && flag) {
+        return run_environments(ENVIRONMENT_QUERY_LIST, NULL, 0);
+    }
+
+    return -1;
+}
 
 static void on_activate(GtkApplication* app, 
                        gpointer user_data G_GNUC_UNUSED) {
@@ -17,14 +309,17 @@ static void on_activate(GtkApplication* app,
         return;
     }
     
+    main_window_load_last_scan(window);
     gtk_window_present(GTK_WINDOW(window));
 }
 
-int main(void) {
+int main(int argc, char* argv[]) {
     GtkApplication* app = gtk_application_new("org.gtk.pythondepanalyzer",
                                             G_APPLICATION_DEFAULT_FLAGS);
+    g_application_add_main_option_entries(G_APPLICATION(app), option_entries);
+    g_signal_connect(app, "handle-local-options", G_CALLBACK(on_handle_local_options), NULL);
     g_signal_connect(app, "activate", G_CALLBACK(on_activate), NULL);
-    int status = g_application_run(G_APPLICATION(app), 0, NULL);
+    int status = g_application_run(G_APPLICATION(app), argc, argv);
     g_object_unref(app);
     return status;
 }
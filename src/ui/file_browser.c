@@ -0,0 +1,438 @@
+#include "../include/venv_analyzer.h"
+#include "../core/record.h"
+#include "file_browser.h"
+#include <gtk/gtk.h>
+
+typedef enum {
+    FILE_SORT_NAME,
+    FILE_SORT_SIZE,
+    FILE_SORT_FILES
+} FileSortKey;
+
+typedef struct {
+    VenvAnalyzer* analyzer;
+    GtkWidget* column_view;
+    GtkWidget* summary;
+    char* package;           // Name of the package to show, or NULL
+    char* wanted;            // Identifies the installed version of package
+    char* loaded;            // The version tree is, or is being, read for
+    RecordTree* tree;
+    GCancellable* cancellable;
+    FileSortKey sort_key;
+    gboolean descending;
+} FileBrowser;
+
+// One node of a RecordTree. Rows only exist while the list view binds
+// them, so a package with tens of thousands of files costs a few dozen.
+#define VENV_TYPE_FILE_ROW (venv_file_row_get_type())
+G_DECLARE_FINAL_TYPE(VenvFileRow, venv_file_row, VENV, FILE_ROW, GObject)
+
+struct _VenvFileRow {
+    GObject parent_instance;
+    RecordTree* tree;
+    guint node;
+};
+
+G_DEFINE_TYPE(VenvFileRow, venv_file_row, G_TYPE_OBJECT)
+
+static void venv_file_row_finalize(GObject* object) {
+    record_tree_unref(VENV_FILE_ROW(object)->tree);
+    G_OBJECT_CLASS(venv_file_row_parent_class)->finalize(object);
+}
+
+static void venv_file_row_class_init(VenvFileRowClass* klass) {
+    G_OBJECT_CLASS(klass)->finalize = venv_file_row_finalize;
+}
+
+static void venv_file_row_init(VenvFileRow* row G_GNUC_UNUSED) {
+}
+
+static VenvFileRow* venv_file_row_new(RecordTree* tree, guint node) {
+    VenvFileRow* row = g_object_new(VENV_TYPE_FILE_ROW, NULL);
+    row->tree = record_tree_ref(tree);
+    row->node = node;
+    return row;
+}
+
+// The children of one directory in sort order. Only the permutation is
+// stored; rows are made on request, and subdirectories get their own
+// model when they are first expanded.
+#define VENV_TYPE_FILE_DIR_MODEL (venv_file_dir_model_get_type())
+G_DECLARE_FINAL_TYPE(VenvFileDirModel, venv_file_dir_model, VENV, FILE_DIR_MODEL, GObject)
+
+struct _VenvFileDirModel {
+    GObject parent_instance;
+    RecordTree* tree;
+    guint node;
+    guint* order;            // Child offsets from the first child
+};
+
+static GType venv_file_dir_model_get_item_type(GListModel* model G_GNUC_UNUSED) {
+    return VENV_TYPE_FILE_ROW;
+}
+
+static guint venv_file_dir_model_get_n_items(GListModel* model) {
+    VenvFileDirModel* self = VENV_FILE_DIR_MODEL(model);
+    return self->tree->nodes[self->node].n_children;
+}
+
+static gpointer venv_file_dir_model_get_item(GListModel* model, guint position) {
+    VenvFileDirModel* self = VENV_FILE_DIR_MODEL(model);
+    const RecordNode* dir = &self->tree->nodes[self->node];
+    if (position >= dir->n_children) return NULL;
+    return venv_file_row_new(self->tree, dir->first_child + self->order[position]);
+}
+
+static void venv_file_dir_model_list_model_init(GListModelInterface* iface) {
+    iface->get_item_type = venv_file_dir_model_get_item_type;
+    iface->get_n_items = venv_file_dir_model_get_n_items;
+    iface->get_item = venv_file_dir_model_get_item;
+}
+
+G_DEFINE_TYPE_WITH_CODE(VenvFileDirModel, venv_file_dir_model, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL,
+                                              venv_file_dir_model_list_model_init))
+
+static void venv_file_dir_model_finalize(GObject* object) {
+    VenvFileDirModel* self = VENV_FILE_DIR_MODEL(object);
+    record_tree_unref(self->tree);
+    g_free(self->order);
+    G_OBJECT_CLASS(venv_file_dir_model_parent_class)->finalize(object);
+}
+
+static void venv_file_dir_model_class_init(VenvFileDirModelClass* klass) {
+    G_OBJECT_CLASS(klass)->finalize = venv_file_dir_model_finalize;
+}
+
+static void venv_file_dir_model_init(VenvFileDirModel* self G_GNUC_UNUSED) {
+}
+
+typedef struct {
+    const RecordNode* children;
+    FileSortKey key;
+    gboolean descending;
+} ChildOrder;
+
+// Siblings are stored sorted by name, so the offset breaks ties by name
+static gint compare_children(gconstpointer a, gconstpointer b, gpointer user_data) {
+    const ChildOrder* order = user_data;
+    guint i = *(const guint*)a;
+    guint j = *(const guint*)b;
+    guint64 x = 0;
+    guint64 y = 0;
+    switch (order->key) {
+        case FILE_SORT_SIZE:
+            x = order->children[i].size;
+            y = order->children[j].size;
+            break;
+        case FILE_SORT_FILES:
+            x = order->children[i].n_files;
+            y = order->children[j].n_files;
+            break;
+        case FILE_SORT_NAME:
+            x = i;
+            y = j;
+            break;
+    }
+    if (x == y) return (i > j) - (i < j);
+    gint result = (x > y) - (x < y);
+    return order->descending ? -result : result;
+}
+
+static GListModel* venv_file_dir_model_new(RecordTree* tree, guint node,
+                                           FileSortKey key, gboolean descending) {
+    VenvFileDirModel* self = g_object_new(VENV_TYPE_FILE_DIR_MODEL, NULL);
+    const RecordNode* dir = &tree->nodes[node];
+    self->tree = record_tree_ref(tree);
+    self->node = node;
+    self->order = g_new(guint, dir->n_children);
+    for (guint i = 0; i < dir->n_children; i++) {
+        self->order[i] = i;
+    }
+
+    ChildOrder order = { &tree->nodes[dir->first_child], key, descending };
+    if (key != FILE_SORT_NAME || descending) {
+        g_sort_array(self->order, dir->n_children, sizeof(guint), compare_children, &order);
+    }
+    return G_LIST_MODEL(self);
+}
+
+static GListModel* create_child_model(gpointer item, gpointer user_data) {
+    VenvFileRow* row = item;
+    FileBrowser* browser = user_data;
+    if (!row->tree->nodes[row->node].is_dir) return NULL;
+    return venv_file_dir_model_new(row->tree, row->node, browser->sort_key, browser->descending);
+}
+
+static VenvFileRow* get_file_row(GtkListItem* list_item) {
+    GtkTreeListRow* row = gtk_list_item_get_item(list_item);
+    return row ? gtk_tree_list_row_get_item(row) : NULL;
+}
+
+static void setup_name_cell(GtkListItemFactory* factory G_GNUC_UNUSED,
+                            GtkListItem* list_item,
+                            gpointer user_data G_GNUC_UNUSED) {
+    GtkWidget* expander = gtk_tree_expander_new();
+    GtkWidget* label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(label), 0);
+    gtk_label_set_ellipsize(GTK_LABEL(label), PANGO_ELLIPSIZE_MIDDLE);
+    gtk_tree_expander_set_child(GTK_TREE_EXPANDER(expander), label);
+    gtk_list_item_set_child(list_item, expander);
+}
+
+static void bind_name_cell(GtkListItemFactory* factory G_GNUC_UNUSED,
+                           GtkListItem* list_item,
+                           gpointer user_data G_GNUC_UNUSED) {
+    GtkWidget* expander = gtk_list_item_get_child(list_item);
+    GtkWidget* label = gtk_tree_expander_get_child(GTK_TREE_EXPANDER(expander));
+    gtk_tree_expander_set_list_row(GTK_TREE_EXPANDER(expander),
+                                   gtk_list_item_get_item(list_item));
+
+    VenvFileRow* row = get_file_row(list_item);
+    if (!row) return;
+    const RecordNode* node = &row->tree->nodes[row->node];
+    if (node->is_dir) {
+        char* text = g_strconcat(node->name, "/", NULL);
+        gtk_label_set_text(GTK_LABEL(label), text);
+        g_free(text);
+    } else {
+        gtk_label_set_text(GTK_LABEL(label), node->name);
+    }
+    g_object_unref(row);
+}
+
+static void setup_number_cell(GtkListItemFactory* factory G_GNUC_UNUSED,
+                              GtkListItem* list_item,
+                              gpointer user_data G_GNUC_UNUSED) {
+    GtkWidget* label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(label), 1);
+    gtk_widget_add_css_class(label, "numeric");
+    gtk_list_item_set_child(list_item, label);
+}
+
+static void bind_size_cell(GtkListItemFactory* factory G_GNUC_UNUSED,
+                           GtkListItem* list_item,
+                           gpointer user_data G_GNUC_UNUSED) {
+    GtkWidget* label = gtk_list_item_get_child(list_item);
+    VenvFileRow* row = get_file_row(list_item);
+    if (!row) return;
+
+    // Files that are gone from disk and had no size in RECORD
+    const RecordNode* node = &row->tree->nodes[row->node];
+    if (!node->is_dir && !node->size_known) {
+        gtk_label_set_text(GTK_LABEL(label), "?");
+    } else {
+        char* size = g_format_size(node->size);
+        gtk_label_set_text(GTK_LABEL(label), size);
+        g_free(size);
+    }
+    g_object_unref(row);
+}
+
+static void bind_files_cell(GtkListItemFactory* factory G_GNUC_UNUSED,
+                            GtkListItem* list_item,
+                            gpointer user_data G_GNUC_UNUSED) {
+    GtkWidget* label = gtk_list_item_get_child(list_item);
+    VenvFileRow* row = get_file_row(list_item);
+    if (!row) return;
+
+    const RecordNode* node = &row->tree->nodes[row->node];
+    if (node->is_dir) {
+        char* count = g_strdup_printf("%u", node->n_files);
+        gtk_label_set_text(GTK_LABEL(label), count);
+        g_free(count);
+    } else {
+        gtk_label_set_text(GTK_LABEL(label), "");
+    }
+    g_object_unref(row);
+}
+
+static FileBrowser* get_browser(GtkWidget* widget) {
+    return g_object_get_data(G_OBJECT(widget), "browser");
+}
+
+// Sorting replaces the whole model: directories are sorted as they are
+// expanded, so one already open would otherwise keep its old order
+static void show_tree(FileBrowser* browser) {
+    if (!browser->tree) {
+        gtk_column_view_set_model(GTK_COLUMN_VIEW(browser->column_view), NULL);
+        return;
+    }
+
+    GListModel* root = venv_file_dir_model_new(browser->tree, RECORD_ROOT,
+                                               browser->sort_key, browser->descending);
+    GtkTreeListModel* tree = gtk_tree_list_model_new(root, FALSE, FALSE,
+                                                     create_child_model, browser, NULL);
+    GtkSingleSelection* selection = gtk_single_selection_new(G_LIST_MODEL(tree));
+    gtk_single_selection_set_autoselect(selection, FALSE);
+    gtk_column_view_set_model(GTK_COLUMN_VIEW(browser->column_view),
+                              GTK_SELECTION_MODEL(selection));
+    g_object_unref(selection);
+}
+
+static void on_record_loaded(GObject* source G_GNUC_UNUSED,
+                             GAsyncResult* result,
+                             gpointer user_data) {
+    GtkWidget* widget = user_data;
+    FileBrowser* browser = get_browser(widget);
+    GError* error = NULL;
+    RecordTree* tree = record_tree_load_finish(result, &error);
+
+    // Another package was asked for in the meantime
+    if (!tree && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_error_free(error);
+        g_object_unref(widget);
+        return;
+    }
+
+    g_clear_object(&browser->cancellable);
+    if (!tree) {
+        gtk_label_set_text(GTK_LABEL(browser->summary), error->message);
+        g_error_free(error);
+    } else {
+        browser->tree = tree;
+        const RecordNode* root = &tree->nodes[RECORD_ROOT];
+        char* size = g_format_size(root->size);
+        char* summary = g_strdup_printf("%u files, %s", root->n_files, size);
+        gtk_label_set_text(GTK_LABEL(browser->summary), summary);
+        g_free(summary);
+        g_free(size);
+        show_tree(browser);
+    }
+    g_object_unref(widget);
+}
+
+static void cancel_load(FileBrowser* browser) {
+    if (browser->cancellable) {
+        g_cancellable_cancel(browser->cancellable);
+        g_clear_object(&browser->cancellable);
+    }
+}
+
+static void clear_tree(FileBrowser* browser) {
+    cancel_load(browser);
+    g_clear_pointer(&browser->tree, record_tree_unref);
+    g_clear_pointer(&browser->loaded, g_free);
+    show_tree(browser);
+}
+
+// Reads the wanted package unless it is already shown or on its way
+static void load_package(GtkWidget* widget) {
+    FileBrowser* browser = get_browser(widget);
+    if (!browser->wanted) {
+        clear_tree(browser);
+        gtk_label_set_text(GTK_LABEL(browser->summary), "No package selected");
+        return;
+    }
+    if (!gtk_widget_get_mapped(widget) || g_strcmp0(browser->wanted, browser->loaded) == 0) {
+        return;
+    }
+
+    clear_tree(browser);
+    browser->loaded = g_strdup(browser->wanted);
+    gtk_label_set_text(GTK_LABEL(browser->summary), "Reading RECORD…");
+    browser->cancellable = g_cancellable_new();
+    record_tree_load_async(browser->analyzer->venv_path, browser->package,
+                           browser->cancellable, on_record_loaded, g_object_ref(widget));
+}
+
+static void on_browser_map(GtkWidget* widget, gpointer user_data G_GNUC_UNUSED) {
+    load_package(widget);
+}
+
+static void on_sort_changed(GtkSorter* sorter, GtkSorterChange change G_GNUC_UNUSED,
+                            GtkWidget* widget) {
+    FileBrowser* browser = get_browser(widget);
+    GtkColumnViewSorter* columns = GTK_COLUMN_VIEW_SORTER(sorter);
+    GtkColumnViewColumn* column = gtk_column_view_sorter_get_primary_sort_column(columns);
+    if (!column) return;
+
+    FileSortKey key = GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(column), "sort-key"));
+    gboolean descending = gtk_column_view_sorter_get_primary_sort_order(columns)
+                          == GTK_SORT_DESCENDING;
+    if (key == browser->sort_key && descending == browser->descending) return;
+
+    browser->sort_key = key;
+    browser->descending = descending;
+    show_tree(browser);
+}
+
+static void file_browser_free(FileBrowser* browser) {
+    cancel_load(browser);
+    record_tree_unref(browser->tree);
+    g_free(browser->package);
+    g_free(browser->wanted);
+    g_free(browser->loaded);
+    g_free(browser);
+}
+
+// The column view only keeps the sorter as header state; rows are
+// ordered by the models, which know the keys without unpacking items
+static GtkColumnViewColumn* add_column(GtkWidget* column_view, const char* title,
+                                       GCallback setup, GCallback bind, FileSortKey key) {
+    GtkListItemFactory* factory = gtk_signal_list_item_factory_new();
+    g_signal_connect(factory, "setup", setup, NULL);
+    g_signal_connect(factory, "bind", bind, NULL);
+
+    GtkColumnViewColumn* column = gtk_column_view_column_new(title, factory);
+    GtkSorter* sorter = GTK_SORTER(gtk_custom_sorter_new(NULL, NULL, NULL));
+    gtk_column_view_column_set_sorter(column, sorter);
+    g_object_unref(sorter);
+    g_object_set_data(G_OBJECT(column), "sort-key", GUINT_TO_POINTER(key));
+    gtk_column_view_append_column(GTK_COLUMN_VIEW(column_view), column);
+    g_object_unref(column);
+    return column;
+}
+
+GtkWidget* file_browser_new(VenvAnalyzer* analyzer) {
+    GtkWidget* box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    FileBrowser* browser = g_new0(FileBrowser, 1);
+    browser->analyzer = analyzer;
+    browser->sort_key = FILE_SORT_SIZE;
+    browser->descending = TRUE;
+    g_object_set_data_full(G_OBJECT(box), "browser", browser,
+                           (GDestroyNotify)file_browser_free);
+
+    browser->summary = gtk_label_new("No package selected");
+    gtk_label_set_xalign(GTK_LABEL(browser->summary), 0);
+    gtk_widget_set_margin_start(browser->summary, 6);
+    gtk_widget_set_margin_top(browser->summary, 6);
+    gtk_widget_set_margin_bottom(browser->summary, 6);
+    gtk_box_append(GTK_BOX(box), browser->summary);
+
+    browser->column_view = gtk_column_view_new(NULL);
+    GtkColumnViewColumn* name = add_column(browser->column_view, "Path",
+                                           G_CALLBACK(setup_name_cell),
+                                           G_CALLBACK(bind_name_cell), FILE_SORT_NAME);
+    gtk_column_view_column_set_expand(name, TRUE);
+    GtkColumnViewColumn* size = add_column(browser->column_view, "Size",
+                                           G_CALLBACK(setup_number_cell),
+                                           G_CALLBACK(bind_size_cell), FILE_SORT_SIZE);
+    add_column(browser->column_view, "Files", G_CALLBACK(setup_number_cell),
+               G_CALLBACK(bind_files_cell), FILE_SORT_FILES);
+    gtk_column_view_sort_by_column(GTK_COLUMN_VIEW(browser->column_view), size,
+                                   GTK_SORT_DESCENDING);
+    g_signal_connect(gtk_column_view_get_sorter(GTK_COLUMN_VIEW(browser->column_view)),
+                     "changed", G_CALLBACK(on_sort_changed), box);
+
+    GtkWidget* scrolled = gtk_scrolled_window_new();
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled),
+                                   GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_widget_set_vexpand(scrolled, TRUE);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), browser->column_view);
+    gtk_box_append(GTK_BOX(box), scrolled);
+
+    g_signal_connect(box, "map", G_CALLBACK(on_browser_map), NULL);
+    return box;
+}
+
+void file_browser_set_package(GtkWidget* widget, Package* package) {
+    FileBrowser* browser = get_browser(widget);
+    g_free(browser->package);
+    g_free(browser->wanted);
+    browser->package = package ? g_strdup(package->name) : NULL;
+    browser->wanted = package ? g_strdup_printf("%s %s %" G_GUINT64_FORMAT, package->name,
+                                                package->version, package->fingerprint)
+                              : NULL;
+    load_package(widget);
+}
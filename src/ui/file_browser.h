@@ -0,0 +1,21 @@
+#ifndef FILE_BROWSER_H
+#define FILE_BROWSER_H
+
+#include "../include/venv_analyzer.h"
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+// Files a package installed, as a tree of directories with subtotals
+GtkWidget* file_browser_new(VenvAnalyzer* analyzer);
+
+/**
+ * Shows the files of package, or nothing for NULL. Its RECORD is only
+ * read once the browser is on screen, and only again if the package
+ * changed in a rescan.
+ */
+void file_browser_set_package(GtkWidget* browser, Package* package);
+
+G_END_DECLS
+
+#endif // FILE_BROWSER_H
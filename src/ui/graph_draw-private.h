@@ -0,0 +1,20 @@
+#ifndef GRAPH_DRAW_PRIVATE_H
+#define GRAPH_DRAW_PRIVATE_H
+
+#include "../core/graph_layout.h"
+#include <cairo/cairo.h>
+#include <pango/pangocairo.h>
+
+// Drawing shared by the graph view's tiles and image export, in layout
+// coordinates
+
+// Strokes the edges whose indices are in edges, straight unless curved
+void graph_draw_edges(cairo_t* cr, GraphLayout* layout, GArray* edges, gboolean curved);
+
+// Draws node's box, highlighted if it is named selected, and label if not NULL
+void graph_draw_node(cairo_t* cr, const LayoutNode* node, const char* selected, PangoLayout* label);
+
+// Fills one box per LayoutCluster in clusters
+void graph_draw_clusters(cairo_t* cr, GArray* clusters);
+
+#endif // GRAPH_DRAW_PRIVATE_H
@@ -0,0 +1,102 @@
+#include "graph_draw-private.h"
+#include <math.h>
+#include <string.h>
+
+static void edge_path(cairo_t* cr, const LayoutEdge* edge, gboolean curved) {
+    const double* p = edge->points;
+    cairo_move_to(cr, p[0], p[1]);
+    if (!curved) {
+        guint last = edge->n_points - 1;
+        cairo_line_to(cr, p[2 * last], p[2 * last + 1]);
+        return;
+    }
+    for (guint i = 1; i + 2 < edge->n_points; i += 3) {
+        cairo_curve_to(cr,
+                      p[2 * i], p[2 * i + 1],
+                      p[2 * i + 2], p[2 * i + 3],
+                      p[2 * i + 4], p[2 * i + 5]);
+    }
+}
+
+// Plain edges go into one path and are stroked once; edges standing for
+// several dependencies are drawn wider, one by one
+void graph_draw_edges(cairo_t* cr, GraphLayout* layout, GArray* edges, gboolean curved) {
+    cairo_set_source_rgba(cr, 0.5, 0.5, 0.5, 0.8);
+    cairo_new_path(cr);
+    for (guint e = 0; e < edges->len; e++) {
+        const LayoutEdge* edge = &layout->edges[g_array_index(edges, guint, e)];
+        if (edge->n_points < 4 || edge->count > 1) continue;
+        edge_path(cr, edge, curved);
+    }
+    cairo_set_line_width(cr, 1.0);
+    cairo_stroke(cr);
+
+    for (guint e = 0; e < edges->len; e++) {
+        const LayoutEdge* edge = &layout->edges[g_array_index(edges, guint, e)];
+        if (edge->n_points < 4 || edge->count <= 1) continue;
+        edge_path(cr, edge, curved);
+        cairo_set_line_width(cr, 1.0 + log2(edge->count));
+        cairo_stroke(cr);
+    }
+}
+
+// Each cluster is drawn as the box around its nodes, darker the more
+// nodes it holds
+void graph_draw_clusters(cairo_t* cr, GArray* clusters) {
+    for (guint i = 0; i < clusters->len; i++) {
+        const LayoutCluster* cluster = &g_array_index(clusters, LayoutCluster, i);
+        double alpha = MIN(0.25 + 0.1 * cluster->n_nodes, 0.9);
+        if (cluster->conflict) {
+            cairo_set_source_rgba(cr, 0.9, 0.5, 0.5, alpha);
+        } else {
+            cairo_set_source_rgba(cr, 0.6, 0.6, 0.7, alpha);
+        }
+        cairo_rectangle(cr, cluster->x, cluster->y, cluster->width, cluster->height);
+        cairo_fill(cr);
+    }
+}
+
+void graph_draw_node(cairo_t* cr, const LayoutNode* node, const char* selected, PangoLayout* label) {
+    double w = node->width;
+    double h = node->height;
+    
+    // Draw node background
+    cairo_save(cr);
+    cairo_translate(cr, node->x, node->y);
+    
+    // Fill background
+    if (selected && strcmp(selected, node->name) == 0) {
+        cairo_set_source_rgb(cr, 0.9, 0.9, 1.0);
+    } else if (node->conflict) {
+        cairo_set_source_rgb(cr, 1.0, 0.9, 0.9);
+    } else if (node->members > 0) {
+        cairo_set_source_rgb(cr, 0.93, 0.96, 0.93);
+    } else {
+        cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+    }
+    
+    cairo_rectangle(cr, -w/2, -h/2, w, h);
+    cairo_fill_preserve(cr);
+    
+    // Draw border, dashed for stubs and heavier for collapsed groups
+    cairo_set_source_rgb(cr, 0.7, 0.7, 0.7);
+    cairo_set_line_width(cr, node->members > 0 ? 2.5 : 1.0);
+    if (node->hidden > 0) {
+        cairo_set_dash(cr, (const double[]){ 4.0, 2.0 }, 2, 0);
+    }
+    cairo_stroke(cr);
+    
+    if (!label) {
+        cairo_restore(cr);
+        return;
+    }
+    
+    // Draw label, centred
+    int text_width, text_height;
+    pango_layout_get_size(label, &text_width, &text_height);
+    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
+    cairo_move_to(cr, -text_width / 2.0 / PANGO_SCALE, -text_height / 2.0 / PANGO_SCALE);
+    pango_cairo_show_layout(cr, label);
+    
+    cairo_restore(cr);
+}
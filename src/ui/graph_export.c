@@ -0,0 +1,289 @@
+#include "graph_export.h"
+#include "graph_draw-private.h"
+#include <math.h>
+#include <string.h>
+
+// Strips hold at most this many bytes of pixels and are rendered in tiles
+// at most TILE_SIZE pixels wide, well within cairo's image size limit
+#define STRIP_BYTES (8 * 1024 * 1024)
+#define TILE_SIZE 2048
+
+// Edges are stroked past their bounding boxes by up to half their width
+#define TILE_OVERLAP 8.0
+
+// SVG
+
+static const char SVG_STYLE[] =
+    "<style>\n"
+    "path { fill: none; stroke: #808080; stroke-opacity: 0.8; }\n"
+    "rect { fill: #ffffff; stroke: #b3b3b3; }\n"
+    "rect.group { fill: #edf5ed; stroke-width: 2.5; }\n"
+    "rect.conflict { fill: #ffe6e6; }\n"
+    "rect.stub { stroke-dasharray: 4 2; }\n"
+    "text { font-family: " GRAPH_LAYOUT_FONT "; text-anchor: middle;"
+    " dominant-baseline: central; }\n"
+    "</style>\n";
+
+static void write_point(ExportWriter* writer, const double* point) {
+    export_write_literal(writer, " ");
+    export_write_number(writer, point[0]);
+    export_write_literal(writer, ",");
+    export_write_number(writer, point[1]);
+}
+
+// Same path as the view draws zoomed in: one bezier per three points
+static void write_edge(ExportWriter* writer, const LayoutEdge* edge) {
+    const double* p = edge->points;
+    export_write_literal(writer, "<path d=\"M");
+    write_point(writer, p);
+    if (edge->n_points < 4) {
+        export_write_literal(writer, " L");
+        write_point(writer, &p[2 * (edge->n_points - 1)]);
+    }
+    for (guint i = 1; i + 2 < edge->n_points; i += 3) {
+        export_write_literal(writer, " C");
+        write_point(writer, &p[2 * i]);
+        write_point(writer, &p[2 * i + 2]);
+        write_point(writer, &p[2 * i + 4]);
+    }
+    export_write_literal(writer, "\"");
+    if (edge->count > 1) {
+        export_write_literal(writer, " stroke-width=\"");
+        export_write_number(writer, 1.0 + log2(edge->count));
+        export_write_literal(writer, "\"");
+    }
+    export_write_literal(writer, "/>\n");
+}
+
+static void write_node(ExportWriter* writer, const LayoutNode* node) {
+    const char* classes[3];
+    guint n_classes = 0;
+    if (node->members > 0) classes[n_classes++] = "group";
+    if (node->conflict) classes[n_classes++] = "conflict";
+    if (node->hidden > 0) classes[n_classes++] = "stub";
+
+    export_write_literal(writer, "<rect");
+    for (guint i = 0; i < n_classes; i++) {
+        export_printf(writer, "%s%s", i == 0 ? " class=\"" : " ", classes[i]);
+    }
+    if (n_classes > 0) export_write_literal(writer, "\"");
+    export_write_literal(writer, " x=\"");
+    export_write_number(writer, node->x - node->width / 2);
+    export_write_literal(writer, "\" y=\"");
+    export_write_number(writer, node->y - node->height / 2);
+    export_write_literal(writer, "\" width=\"");
+    export_write_number(writer, node->width);
+    export_write_literal(writer, "\" height=\"");
+    export_write_number(writer, node->height);
+    export_write_literal(writer, "\"/>\n<text x=\"");
+    export_write_number(writer, node->x);
+    export_write_literal(writer, "\" y=\"");
+    export_write_number(writer, node->y);
+    export_write_literal(writer, "\">");
+    char* label = graph_layout_node_label(node);
+    export_write_escaped(writer, label, EXPORT_ESCAPE_XML);
+    g_free(label);
+    export_write_literal(writer, "</text>\n");
+}
+
+gboolean graph_export_svg(ExportWriter* writer, GraphLayout* layout) {
+    export_write_literal(writer, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                                 "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"");
+    export_write_number(writer, layout->width);
+    export_write_literal(writer, "\" height=\"");
+    export_write_number(writer, layout->height);
+    export_write_literal(writer, "\" font-size=\"");
+    export_write_number(writer, GRAPH_LAYOUT_FONT_SIZE);
+    export_write_literal(writer, "\">\n");
+    export_write_literal(writer, SVG_STYLE);
+    export_write_literal(writer, "<rect width=\"100%\" height=\"100%\" style=\"stroke: none\"/>\n");
+
+    // Edges first, then nodes on top, as the view draws them
+    for (guint i = 0; i < layout->n_edges && !writer->error; i++) {
+        if (layout->edges[i].n_points >= 2) write_edge(writer, &layout->edges[i]);
+    }
+    for (guint i = 0; i < layout->n_nodes && !writer->error; i++) {
+        write_node(writer, &layout->nodes[i]);
+    }
+
+    export_write_literal(writer, "</svg>\n");
+    return writer->error == NULL;
+}
+
+// PNG
+
+static const guint8 PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+static guint32 crc_table[256];
+
+static void init_crc_table(void) {
+    static gsize initialized = 0;
+    if (!g_once_init_enter(&initialized)) return;
+
+    for (guint32 n = 0; n < 256; n++) {
+        guint32 c = n;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[n] = c;
+    }
+    g_once_init_leave(&initialized, 1);
+}
+
+static guint32 crc_update(guint32 crc, const guint8* data, gsize length) {
+    for (gsize i = 0; i < length; i++) {
+        crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static void write_chunk(ExportWriter* writer, const char* type,
+                        const guint8* data, guint32 length) {
+    guint32 size = GUINT32_TO_BE(length);
+    guint32 crc = crc_update(0xffffffffu, (const guint8*)type, 4);
+    crc = GUINT32_TO_BE(crc_update(crc, data, length) ^ 0xffffffffu);
+    export_write(writer, &size, 4);
+    export_write(writer, type, 4);
+    export_write(writer, data, length);
+    export_write(writer, &crc, 4);
+}
+
+typedef struct {
+    ExportWriter* writer;
+    GConverter* zlib;
+    guint8 out[64 * 1024];
+} PngStream;
+
+// Every block of compressed output becomes one IDAT chunk
+static void deflate_rows(PngStream* png, const guint8* data, gsize length, gboolean last) {
+    ExportWriter* writer = png->writer;
+    GConverterFlags flags = last ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_NO_FLAGS;
+    while (!writer->error) {
+        gsize read = 0;
+        gsize written = 0;
+        GConverterResult result = g_converter_convert(png->zlib, data, length,
+                                                      png->out, sizeof(png->out), flags,
+                                                      &read, &written, &writer->error);
+        if (result == G_CONVERTER_ERROR) return;
+        if (written > 0) write_chunk(writer, "IDAT", png->out, written);
+        data += read;
+        length -= read;
+        if (result == G_CONVERTER_FINISHED || (length == 0 && !last)) return;
+    }
+}
+
+static void render_tile(cairo_surface_t* surface, GraphLayout* layout, double scale,
+                        int left, int top, int width, int height,
+                        GArray* nodes, GArray* edges, PangoLayout* label) {
+    cairo_t* cr = cairo_create(surface);
+    cairo_rectangle(cr, 0, 0, width, height);
+    cairo_clip(cr);
+    cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+    cairo_paint(cr);
+    cairo_translate(cr, -left, -top);
+    cairo_scale(cr, scale, scale);
+
+    graph_layout_query(layout,
+                       left / scale - TILE_OVERLAP, top / scale - TILE_OVERLAP,
+                       width / scale + 2 * TILE_OVERLAP, height / scale + 2 * TILE_OVERLAP,
+                       nodes, edges);
+    graph_draw_edges(cr, layout, edges, TRUE);
+    for (guint i = 0; i < nodes->len; i++) {
+        const LayoutNode* node = &layout->nodes[g_array_index(nodes, guint, i)];
+        char* text = graph_layout_node_label(node);
+        pango_layout_set_text(label, text, -1);
+        g_free(text);
+        graph_draw_node(cr, node, NULL, label);
+    }
+    cairo_destroy(cr);
+    cairo_surface_flush(surface);
+}
+
+// Cairo pixels are native-endian premultiplied ARGB; PNG wants RGBA bytes
+static void copy_pixels(cairo_surface_t* surface, int width, int height,
+                        guint8* rows, gsize row_stride, int left) {
+    const guint8* data = cairo_image_surface_get_data(surface);
+    int stride = cairo_image_surface_get_stride(surface);
+    for (int y = 0; y < height; y++) {
+        const guint32* in = (const guint32*)(data + (gsize)y * stride);
+        guint8* out = rows + y * row_stride + 1 + (gsize)left * 4;
+        for (int x = 0; x < width; x++) {
+            guint32 pixel = in[x];
+            guint a = pixel >> 24;
+            guint r = (pixel >> 16) & 0xff;
+            guint g = (pixel >> 8) & 0xff;
+            guint b = pixel & 0xff;
+            if (a != 0 && a != 255) {
+                r = r * 255 / a;
+                g = g * 255 / a;
+                b = b * 255 / a;
+            }
+            out[4 * x] = r;
+            out[4 * x + 1] = g;
+            out[4 * x + 2] = b;
+            out[4 * x + 3] = a;
+        }
+    }
+}
+
+gboolean graph_export_png(ExportWriter* writer, GraphLayout* layout, double scale) {
+    init_crc_table();
+    int width = MAX(1, (int)ceil(layout->width * scale));
+    int height = MAX(1, (int)ceil(layout->height * scale));
+
+    guint8 header[13];
+    guint32 be_width = GUINT32_TO_BE(width);
+    guint32 be_height = GUINT32_TO_BE(height);
+    memcpy(header, &be_width, 4);
+    memcpy(header + 4, &be_height, 4);
+    header[8] = 8;     // Bits per channel
+    header[9] = 6;     // RGBA
+    header[10] = 0;    // Deflate
+    header[11] = 0;    // Filter type byte per row
+    header[12] = 0;    // Not interlaced
+    export_write(writer, PNG_SIGNATURE, sizeof(PNG_SIGNATURE));
+    write_chunk(writer, "IHDR", header, sizeof(header));
+
+    // Each row starts with its filter type, 0 for none
+    gsize row_stride = 1 + (gsize)width * 4;
+    int strip_rows = (int)CLAMP(STRIP_BYTES / row_stride, 1, TILE_SIZE);
+    guint8* rows = g_malloc0(row_stride * strip_rows);
+    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+                                                          MIN(width, TILE_SIZE), strip_rows);
+
+    PangoContext* context = pango_font_map_create_context(pango_cairo_font_map_get_default());
+    pango_context_set_round_glyph_positions(context, FALSE);
+    PangoFontDescription* font = pango_font_description_from_string(GRAPH_LAYOUT_FONT);
+    pango_font_description_set_absolute_size(font, GRAPH_LAYOUT_FONT_SIZE * PANGO_SCALE);
+    PangoLayout* label = pango_layout_new(context);
+    pango_layout_set_font_description(label, font);
+
+    GArray* nodes = g_array_new(FALSE, FALSE, sizeof(guint));
+    GArray* edges = g_array_new(FALSE, FALSE, sizeof(guint));
+    PngStream* png = g_new(PngStream, 1);
+    png->writer = writer;
+    png->zlib = G_CONVERTER(g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB, 6));
+
+    for (int top = 0; top < height && !writer->error; top += strip_rows) {
+        int strip_height = MIN(strip_rows, height - top);
+        for (int left = 0; left < width; left += TILE_SIZE) {
+            int tile_width = MIN(TILE_SIZE, width - left);
+            render_tile(surface, layout, scale, left, top, tile_width, strip_height,
+                        nodes, edges, label);
+            copy_pixels(surface, tile_width, strip_height, rows, row_stride, left);
+        }
+        deflate_rows(png, rows, row_stride * strip_height, top + strip_height >= height);
+    }
+    write_chunk(writer, "IEND", NULL, 0);
+
+    g_object_unref(png->zlib);
+    g_free(png);
+    g_array_unref(nodes);
+    g_array_unref(edges);
+    g_object_unref(label);
+    pango_font_description_free(font);
+    g_object_unref(context);
+    cairo_surface_destroy(surface);
+    g_free(rows);
+    return writer->error == NULL;
+}
@@ -0,0 +1,20 @@
+#ifndef GRAPH_EXPORT_H
+#define GRAPH_EXPORT_H
+
+#include "../core/graph_layout.h"
+#include "../core/export.h"
+
+/**
+ * Writes layout as an SVG document, one element per edge and node in
+ * drawing order, with the view's colours
+ */
+gboolean graph_export_svg(ExportWriter* writer, GraphLayout* layout);
+
+/**
+ * Rasterises layout at scale pixels per point into a PNG. Rows are
+ * rendered and compressed a strip at a time, each strip in tiles, so
+ * memory stays bounded whatever the size of the image.
+ */
+gboolean graph_export_png(ExportWriter* writer, GraphLayout* layout, double scale);
+
+#endif // GRAPH_EXPORT_H
@@ -1,32 +1,315 @@
 #include "graph_view.h"
 #include "../core/package.h"
+#include "../core/graph_layout.h"
+#include "../core/fuzzy_match.h"
+#include "graph_draw-private.h"
+#include "graph_export.h"
 #include <cairo/cairo.h>
-#include <graphviz/gvc.h>
+#include <pango/pangocairo.h>
 #include <math.h>
 
+// Level of detail: below these zoom levels labels are left out, edges
+// are drawn straight, and nodes are merged per index cell once a cell is
+// smaller than CLUSTER_MAX_PIXELS on screen
+#define LABEL_MIN_SCALE 0.5
+#define CURVE_MIN_SCALE 0.3
+#define CLUSTER_MAX_PIXELS 24.0
+
+// The graph is rasterised once per layout into square tiles at
+// power-of-two zoom levels; frames only place cached textures, and the
+// selected node is the one thing drawn fresh
+#define TILE_SIZE 512
+
+// Besides the tiles the current frame draws, the cache keeps as many
+// again, and at least this many, of the most recently drawn ones, so
+// panning back or zooming across a level does not render them again
+#define TILE_CACHE_MIN_SPARE 16
+
+// Overview of the whole layout in the bottom right corner, rendered once
+// per layout; clicking or dragging on it moves the view there
+#define MINIMAP_SIZE 180.0
+#define MINIMAP_MARGIN 12.0
+
 // Forward declarations
-void draw_edge(cairo_t* cr, Agedge_t* e);
-void draw_node(cairo_t* cr, Agnode_t* n, const char* selected);
 static void update_graph(VenvGraphView* self);
 
 struct _VenvGraphView {
     GtkWidget parent_instance;
     
     VenvAnalyzer* analyzer;
-    GVC_t* gvc;
-    Agraph_t* graph;
+    GraphLayout* layout;                 // Layout being drawn, or NULL
+    GCancellable* layout_cancellable;    // Layout being computed, or NULL
+    GraphLayoutEngine engine;
+    char* focus;                         // Package in focus mode, or NULL
+    guint focus_hops;
+    GHashTable* expanded;                // Names of expanded stubs' packages
+    GraphLayoutGrouping grouping;
+    GHashTable* expanded_groups;         // Names of groups shown as their members
+    
+    // Reused by every frame for what the viewport shows
+    GArray* visible_nodes;
+    GArray* visible_edges;
+    GArray* visible_clusters;
+    
+    GHashTable* tiles;                   // TileKey -> CachedTile
+    int tile_scale_factor;
+    guint64 tile_frame;                  // Counts frames, for evicting tiles
+    GdkTexture* minimap;                 // Rendered on first use, or NULL
+    
+    // Labels are shaped once and replayed by every tile that shows them
+    PangoContext* label_context;
+    PangoFontDescription* label_font;
+    GHashTable* labels;                  // Label text -> PangoLayout
+    FuzzyIndex* node_names;              // Built on the first jump per layout, or NULL
+    GArray* named_nodes;                 // Node index per node_names entry
     double scale;
     double translate_x;
     double translate_y;
     char* selected_node;
+    int hovered_node;                    // Index into layout's nodes, or -1
+    int selected_index;                  // Index of selected_node, or -1
     
     // Add drag state
     double drag_start_x;
     double drag_start_y;
+    gboolean minimap_drag;               // Drag started on the minimap
 };
 
 G_DEFINE_TYPE(VenvGraphView, venv_graph_view, GTK_TYPE_WIDGET)
 
+typedef struct {
+    int level;
+    int x;
+    int y;
+} TileKey;
+
+static guint tile_key_hash(gconstpointer key) {
+    const TileKey* tile = key;
+    return ((guint)tile->level * 31 + (guint)tile->x) * 1000003u + (guint)tile->y;
+}
+
+static gboolean tile_key_equal(gconstpointer a, gconstpointer b) {
+    const TileKey* x = a;
+    const TileKey* y = b;
+    return x->level == y->level && x->x == y->x && x->y == y->y;
+}
+
+typedef struct {
+    GdkTexture* texture;  // NULL if the tile is empty
+    guint64 frame;        // Last frame that drew it
+} CachedTile;
+
+static void tile_free(gpointer data) {
+    CachedTile* tile = data;
+    g_clear_object(&tile->texture);
+    g_free(tile);
+}
+
+static PangoLayout* get_label(VenvGraphView* self, const LayoutNode* node) {
+    char* text = graph_layout_node_label(node);
+    PangoLayout* label = g_hash_table_lookup(self->labels, text);
+    if (label) {
+        g_free(text);
+        return label;
+    }
+
+    label = pango_layout_new(self->label_context);
+    pango_layout_set_font_description(label, self->label_font);
+    pango_layout_set_text(label, text, -1);
+    g_hash_table_insert(self->labels, text, label);
+    return label;
+}
+
+// Draws the part of the layout under one tile, with the level of detail
+// of the tile's zoom level. Returns NULL if the tile is empty.
+static GdkTexture* render_tile(VenvGraphView* self, double level_scale, int x, int y) {
+    GraphLayout* layout = self->layout;
+    double span = TILE_SIZE / level_scale;
+    double left = x * span;
+    double top = y * span;
+    gboolean clustered = graph_layout_cluster_size(layout) * level_scale < CLUSTER_MAX_PIXELS;
+
+    graph_layout_query(layout, left, top, span, span,
+                       clustered ? NULL : self->visible_nodes, self->visible_edges);
+    if (clustered) {
+        graph_layout_query_clusters(layout, left, top, span, span, self->visible_clusters);
+    }
+    guint n_items = self->visible_edges->len +
+                    (clustered ? self->visible_clusters->len : self->visible_nodes->len);
+    if (n_items == 0) return NULL;
+
+    int size = TILE_SIZE * self->tile_scale_factor;
+    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+    cairo_t* cr = cairo_create(surface);
+    cairo_scale(cr, level_scale * self->tile_scale_factor, level_scale * self->tile_scale_factor);
+    cairo_translate(cr, -left, -top);
+
+    // Draw edges first
+    graph_draw_edges(cr, layout, self->visible_edges, level_scale >= CURVE_MIN_SCALE);
+
+    // Draw nodes on top
+    if (clustered) {
+        graph_draw_clusters(cr, self->visible_clusters);
+    } else {
+        gboolean labels = level_scale >= LABEL_MIN_SCALE;
+        for (guint i = 0; i < self->visible_nodes->len; i++) {
+            const LayoutNode* node = &layout->nodes[g_array_index(self->visible_nodes, guint, i)];
+            graph_draw_node(cr, node, NULL, labels ? get_label(self, node) : NULL);
+        }
+    }
+    cairo_destroy(cr);
+
+    cairo_surface_flush(surface);
+    int stride = cairo_image_surface_get_stride(surface);
+    GBytes* bytes = g_bytes_new(cairo_image_surface_get_data(surface), (gsize)stride * size);
+    GdkTexture* texture = gdk_memory_texture_new(size, size, GDK_MEMORY_DEFAULT, bytes, stride);
+    g_bytes_unref(bytes);
+    cairo_surface_destroy(surface);
+    return texture;
+}
+
+static GdkTexture* get_tile(VenvGraphView* self, int level, double level_scale, int x, int y) {
+    TileKey key = { level, x, y };
+    CachedTile* tile = g_hash_table_lookup(self->tiles, &key);
+    if (!tile) {
+        tile = g_new(CachedTile, 1);
+        tile->texture = render_tile(self, level_scale, x, y);
+        g_hash_table_insert(self->tiles, g_memdup2(&key, sizeof(key)), tile);
+    }
+    tile->frame = self->tile_frame;
+    return tile->texture;
+}
+
+typedef struct {
+    TileKey key;
+    guint64 frame;
+} TileAge;
+
+static gint compare_tile_ages(gconstpointer a, gconstpointer b) {
+    guint64 x = ((const TileAge*)a)->frame;
+    guint64 y = ((const TileAge*)b)->frame;
+    return (x > y) - (x < y);
+}
+
+// Drops the least recently drawn tiles beyond what the cache keeps for a
+// frame of n_visible tiles. Tiles of the current frame are never dropped.
+static void evict_tiles(VenvGraphView* self, guint n_visible) {
+    guint limit = n_visible + MAX(n_visible, TILE_CACHE_MIN_SPARE);
+    guint size = g_hash_table_size(self->tiles);
+    if (size <= limit) return;
+
+    GArray* ages = g_array_sized_new(FALSE, FALSE, sizeof(TileAge), size);
+    GHashTableIter iter;
+    gpointer key, tile;
+    g_hash_table_iter_init(&iter, self->tiles);
+    while (g_hash_table_iter_next(&iter, &key, &tile)) {
+        TileAge age = { *(TileKey*)key, ((CachedTile*)tile)->frame };
+        g_array_append_val(ages, age);
+    }
+    g_array_sort(ages, compare_tile_ages);
+
+    for (guint i = 0; i < size - limit; i++) {
+        TileAge* age = &g_array_index(ages, TileAge, i);
+        if (age->frame == self->tile_frame) break;
+        g_hash_table_remove(self->tiles, &age->key);
+    }
+    g_array_unref(ages);
+}
+
+// Where the minimap goes in widget coordinates, and how many widget
+// pixels it gives a point of the layout
+static gboolean minimap_rect(VenvGraphView* self, graphene_rect_t* rect, double* scale) {
+    GraphLayout* layout = self->layout;
+    if (!layout || layout->width <= 0 || layout->height <= 0) return FALSE;
+
+    *scale = MINIMAP_SIZE / MAX(layout->width, layout->height);
+    double width = layout->width * *scale;
+    double height = layout->height * *scale;
+    *rect = GRAPHENE_RECT_INIT(gtk_widget_get_width(GTK_WIDGET(self)) - width - MINIMAP_MARGIN,
+                               gtk_widget_get_height(GTK_WIDGET(self)) - height - MINIMAP_MARGIN,
+                               width, height);
+    return TRUE;
+}
+
+static gboolean in_minimap(VenvGraphView* self, double x, double y) {
+    graphene_rect_t rect;
+    double scale;
+    return minimap_rect(self, &rect, &scale) &&
+           graphene_rect_contains_point(&rect, &GRAPHENE_POINT_INIT(x, y));
+}
+
+// Index cells stand in for nodes, so this stays cheap for any layout
+static GdkTexture* render_minimap(VenvGraphView* self, double scale) {
+    GraphLayout* layout = self->layout;
+    int width = (int)ceil(layout->width * scale * self->tile_scale_factor);
+    int height = (int)ceil(layout->height * scale * self->tile_scale_factor);
+    cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+    cairo_t* cr = cairo_create(surface);
+
+    cairo_set_source_rgba(cr, 1.0, 1.0, 1.0, 0.9);
+    cairo_paint(cr);
+    cairo_scale(cr, scale * self->tile_scale_factor, scale * self->tile_scale_factor);
+    graph_layout_query_clusters(layout, 0, 0, layout->width, layout->height,
+                                self->visible_clusters);
+    graph_draw_clusters(cr, self->visible_clusters);
+    cairo_destroy(cr);
+
+    cairo_surface_flush(surface);
+    int stride = cairo_image_surface_get_stride(surface);
+    GBytes* bytes = g_bytes_new(cairo_image_surface_get_data(surface), (gsize)stride * height);
+    GdkTexture* texture = gdk_memory_texture_new(width, height, GDK_MEMORY_DEFAULT, bytes, stride);
+    g_bytes_unref(bytes);
+    cairo_surface_destroy(surface);
+    return texture;
+}
+
+static void snapshot_minimap(VenvGraphView* self, GtkSnapshot* snapshot,
+                             const graphene_rect_t* bounds) {
+    graphene_rect_t rect;
+    double scale;
+    if (!minimap_rect(self, &rect, &scale)) return;
+
+    if (!self->minimap) {
+        self->minimap = render_minimap(self, scale);
+    }
+    gtk_snapshot_append_texture(snapshot, self->minimap, &rect);
+
+    // The part of the layout the view shows, clipped to the minimap
+    graphene_rect_t viewport = GRAPHENE_RECT_INIT(
+        rect.origin.x + (bounds->origin.x - self->translate_x) / self->scale * scale,
+        rect.origin.y + (bounds->origin.y - self->translate_y) / self->scale * scale,
+        bounds->size.width / self->scale * scale,
+        bounds->size.height / self->scale * scale);
+    if (!graphene_rect_intersection(&viewport, &rect, &viewport)) return;
+
+    cairo_t* cr = gtk_snapshot_append_cairo(snapshot, &rect);
+    cairo_set_line_width(cr, 1.0);
+    cairo_set_source_rgb(cr, 0.6, 0.6, 0.6);
+    cairo_rectangle(cr, rect.origin.x + 0.5, rect.origin.y + 0.5,
+                    rect.size.width - 1, rect.size.height - 1);
+    cairo_stroke(cr);
+    cairo_set_source_rgba(cr, 0.2, 0.4, 0.9, 0.15);
+    cairo_rectangle(cr, viewport.origin.x, viewport.origin.y,
+                    viewport.size.width, viewport.size.height);
+    cairo_fill_preserve(cr);
+    cairo_set_source_rgb(cr, 0.2, 0.4, 0.9);
+    cairo_stroke(cr);
+    cairo_destroy(cr);
+}
+
+// Centres the view on the layout point under (x, y) on the minimap
+static void minimap_jump(VenvGraphView* self, double x, double y) {
+    graphene_rect_t rect;
+    double scale;
+    if (!minimap_rect(self, &rect, &scale)) return;
+
+    double layout_x = CLAMP(x - rect.origin.x, 0, rect.size.width) / scale;
+    double layout_y = CLAMP(y - rect.origin.y, 0, rect.size.height) / scale;
+    self->translate_x = gtk_widget_get_width(GTK_WIDGET(self)) / 2.0 - layout_x * self->scale;
+    self->translate_y = gtk_widget_get_height(GTK_WIDGET(self)) / 2.0 - layout_y * self->scale;
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+}
+
 void venv_graph_view_snapshot(GtkWidget* widget, GtkSnapshot* snapshot) {
     VenvGraphView* self = VENV_GRAPH_VIEW(widget);
     graphene_rect_t bounds;
@@ -38,99 +321,58 @@ void venv_graph_view_snapshot(GtkWidget* widget, GtkSnapshot* snapshot) {
                             &(GdkRGBA){.red = 1.0, .green = 1.0, .blue = 1.0, .alpha = 1.0},
                             &bounds);
 
-    // Create cairo context from snapshot
-    cairo_t* cr = gtk_snapshot_append_cairo(snapshot,
-                                          &GRAPHENE_RECT_INIT(
-                                              bounds.origin.x,
-                                              bounds.origin.y,
-                                              bounds.size.width,
-                                              bounds.size.height));
-
-    // Set up transform
-    cairo_translate(cr, self->translate_x, self->translate_y);
-    cairo_scale(cr, self->scale, self->scale);
-
-    // Draw graph
-    if (self->graph) {
-        // Draw edges first
-        for (Agnode_t* n = agfstnode(self->graph); n; n = agnxtnode(self->graph, n)) {
-            for (Agedge_t* e = agfstedge(self->graph, n); e; e = agnxtedge(self->graph, e, n)) {
-                draw_edge(cr, e);
-            }
-        }
+    GraphLayout* layout = self->layout;
+    if (!layout) return;
 
-        // Draw nodes on top
-        for (Agnode_t* n = agfstnode(self->graph); n; n = agnxtnode(self->graph, n)) {
-            draw_node(cr, n, self->selected_node);
-        }
+    int scale_factor = gtk_widget_get_scale_factor(widget);
+    if (scale_factor != self->tile_scale_factor) {
+        g_hash_table_remove_all(self->tiles);
+        g_clear_object(&self->minimap);
+        self->tile_scale_factor = scale_factor;
     }
+    self->tile_frame++;
 
-    cairo_destroy(cr);
-}
+    // Tiles come from the nearest power-of-two zoom level and are scaled
+    // to the current one, so panning and zooming only move textures
+    int level = (int)lround(log2(self->scale));
+    double level_scale = ldexp(1.0, level);
+    double tile_pixels = TILE_SIZE / level_scale * self->scale;
 
-void draw_edge(cairo_t* cr, Agedge_t* e) {
-    // Get edge points
-    splines* spl = ED_spl(e);
-    if (!spl) return;
-    
-    bezier* bz = &spl->list[0];
-    if (bz->size < 4) return;
-    
-    // Draw edge path
-    cairo_new_path(cr);
-    cairo_move_to(cr, bz->list[0].x, bz->list[0].y);
-    
-    for (int i = 1; i < bz->size; i += 3) {
-        cairo_curve_to(cr,
-                      bz->list[i].x, bz->list[i].y,
-                      bz->list[i+1].x, bz->list[i+1].y,
-                      bz->list[i+2].x, bz->list[i+2].y);
+    int x0 = (int)floor((bounds.origin.x - self->translate_x) / tile_pixels);
+    int y0 = (int)floor((bounds.origin.y - self->translate_y) / tile_pixels);
+    int x1 = (int)floor((bounds.origin.x + bounds.size.width - self->translate_x) / tile_pixels);
+    int y1 = (int)floor((bounds.origin.y + bounds.size.height - self->translate_y) / tile_pixels);
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            GdkTexture* texture = get_tile(self, level, level_scale, x, y);
+            if (!texture) continue;
+
+            gtk_snapshot_append_texture(snapshot, texture,
+                                        &GRAPHENE_RECT_INIT(self->translate_x + x * tile_pixels,
+                                                            self->translate_y + y * tile_pixels,
+                                                            tile_pixels, tile_pixels));
+        }
     }
-    
-    cairo_set_source_rgba(cr, 0.5, 0.5, 0.5, 0.8);
-    cairo_set_line_width(cr, 1.0);
-    cairo_stroke(cr);
-}
+    evict_tiles(self, (guint)((x1 - x0 + 1) * (y1 - y0 + 1)));
 
-void draw_node(cairo_t* cr, Agnode_t* n, const char* selected) {
-    pointf pos = ND_coord(n);
-    double w = ND_width(n) * 72;  // Convert to points
-    double h = ND_height(n) * 72;
-    
-    // Draw node background
-    cairo_save(cr);
-    cairo_translate(cr, pos.x, pos.y);
-    
-    // Fill background
-    if (selected && strcmp(selected, agnameof(n)) == 0) {
-        cairo_set_source_rgb(cr, 0.9, 0.9, 1.0);
-    } else if (agget(n, "color") && strcmp(agget(n, "color"), "red") == 0) {
-        cairo_set_source_rgb(cr, 1.0, 0.9, 0.9);
-    } else {
-        cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+    // Draw the selection highlight over the tiles
+    gboolean clustered = graph_layout_cluster_size(layout) * level_scale < CLUSTER_MAX_PIXELS;
+    if (self->selected_index >= 0 && !clustered) {
+        const LayoutNode* node = &layout->nodes[self->selected_index];
+        cairo_t* cr = gtk_snapshot_append_cairo(snapshot,
+                                              &GRAPHENE_RECT_INIT(
+                                                  self->translate_x + (node->x - node->width / 2) * self->scale - 1,
+                                                  self->translate_y + (node->y - node->height / 2) * self->scale - 1,
+                                                  node->width * self->scale + 2,
+                                                  node->height * self->scale + 2));
+        cairo_translate(cr, self->translate_x, self->translate_y);
+        cairo_scale(cr, self->scale, self->scale);
+        graph_draw_node(cr, node, node->name,
+                  level_scale >= LABEL_MIN_SCALE ? get_label(self, node) : NULL);
+        cairo_destroy(cr);
     }
-    
-    cairo_rectangle(cr, -w/2, -h/2, w, h);
-    cairo_fill_preserve(cr);
-    
-    // Draw border
-    cairo_set_source_rgb(cr, 0.7, 0.7, 0.7);
-    cairo_set_line_width(cr, 1.0);
-    cairo_stroke(cr);
-    
-    // Draw label
-    cairo_set_source_rgb(cr, 0.0, 0.0, 0.0);
-    cairo_select_font_face(cr, "Sans", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
-    cairo_set_font_size(cr, 12.0);
-    
-    cairo_text_extents_t extents;
-    const char* name = agnameof(n);
-    cairo_text_extents(cr, name, &extents);
-    
-    cairo_move_to(cr, -extents.width/2, extents.height/2);
-    cairo_show_text(cr, name);
-    
-    cairo_restore(cr);
+
+    snapshot_minimap(self, snapshot, &bounds);
 }
 
 static void
@@ -138,16 +380,24 @@ venv_graph_view_dispose(GObject* object)
 {
     VenvGraphView* self = VENV_GRAPH_VIEW(object);
     
-    if (self->graph) {
-        gvFreeLayout(self->gvc, self->graph);
-        agclose(self->graph);
-        self->graph = NULL;
-    }
-    
-    if (self->gvc) {
-        gvFreeContext(self->gvc);
-        self->gvc = NULL;
+    if (self->layout_cancellable) {
+        g_cancellable_cancel(self->layout_cancellable);
+        g_clear_object(&self->layout_cancellable);
     }
+    g_clear_pointer(&self->layout, graph_layout_unref);
+    g_clear_pointer(&self->focus, g_free);
+    g_clear_pointer(&self->expanded, g_hash_table_unref);
+    g_clear_pointer(&self->expanded_groups, g_hash_table_unref);
+    g_clear_pointer(&self->visible_nodes, g_array_unref);
+    g_clear_pointer(&self->visible_edges, g_array_unref);
+    g_clear_pointer(&self->visible_clusters, g_array_unref);
+    g_clear_pointer(&self->tiles, g_hash_table_unref);
+    g_clear_object(&self->minimap);
+    g_clear_pointer(&self->labels, g_hash_table_unref);
+    g_clear_pointer(&self->node_names, fuzzy_index_free);
+    g_clear_pointer(&self->named_nodes, g_array_unref);
+    g_clear_pointer(&self->label_font, pango_font_description_free);
+    g_clear_object(&self->label_context);
     
     g_free(self->selected_node);
     self->selected_node = NULL;
@@ -166,41 +416,77 @@ venv_graph_view_class_init(VenvGraphViewClass* klass)
     gtk_widget_class_set_layout_manager_type(widget_class, GTK_TYPE_BIN_LAYOUT);
 }
 
-static void update_graph(VenvGraphView* self) {
-    if (!self->analyzer) return;
-    
-    if (self->graph) {
-        gvFreeLayout(self->gvc, self->graph);
-        agclose(self->graph);
-    }
-    
-    self->graph = agopen("deps", Agdirected, NULL);
-    agsafeset(self->graph, "rankdir", "LR", "");
-    
-    // Create nodes
-    for (Package* pkg = self->analyzer->packages; pkg; pkg = pkg->next) {
-        Agnode_t* node = agnode(self->graph, pkg->name, TRUE);
-        if (pkg->conflicts) {
-            agsafeset(node, "color", "red", "black");
+// Takes ownership of layout. Node indices and tiles of the old layout
+// don't carry over.
+static void set_layout(VenvGraphView* self, GraphLayout* layout) {
+    g_clear_pointer(&self->layout, graph_layout_unref);
+    self->layout = layout;
+    self->hovered_node = -1;
+    self->selected_index = -1;
+    for (guint i = 0; self->selected_node && i < layout->n_nodes; i++) {
+        if (strcmp(layout->nodes[i].name, self->selected_node) == 0) {
+            self->selected_index = (int)i;
+            break;
         }
     }
-    
-    // Create edges
-    for (Package* pkg = self->analyzer->packages; pkg; pkg = pkg->next) {
-        for (PackageDep* dep = pkg->dependencies; dep; dep = dep->next) {
-            Agnode_t* from = agfindnode(self->graph, pkg->name);
-            Agnode_t* to = agfindnode(self->graph, dep->name);
-            if (from && to) {
-                agedge(self->graph, from, to, NULL, TRUE);
-            }
+    g_hash_table_remove_all(self->tiles);
+    g_clear_object(&self->minimap);
+    g_clear_pointer(&self->node_names, fuzzy_index_free);
+    g_clear_pointer(&self->named_nodes, g_array_unref);
+    
+    // Labels outlive layouts, but not ones no longer shown for long
+    if (g_hash_table_size(self->labels) > 2 * layout->n_nodes) {
+        g_hash_table_remove_all(self->labels);
+    }
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+}
+
+static void on_layout_ready(GObject* source G_GNUC_UNUSED,
+                            GAsyncResult* result,
+                            gpointer user_data) {
+    VenvGraphView* self = user_data;
+    GError* error = NULL;
+
+    GraphLayout* layout = graph_layout_compute_finish(result, &error);
+    if (!layout) {
+        // Cancelled layouts were superseded by a newer one
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_warning("%s", error->message);
         }
+        g_error_free(error);
+        g_object_unref(self);
+        return;
     }
+
+    // Publish the finished layout; the old one is dropped in the same step
+    g_clear_object(&self->layout_cancellable);
+    set_layout(self, layout);
+    g_object_unref(self);
+}
+
+// Intermediate layouts are drawn like finished ones while the engine
+// keeps refining
+static void on_layout_progress(GraphLayout* layout, gpointer user_data) {
+    VenvGraphView* self = user_data;
+    set_layout(self, graph_layout_ref(layout));
+}
+
+// Keeps drawing the current layout until the new one is ready
+static void update_graph(VenvGraphView* self) {
+    if (!self->analyzer) return;
     
-    // Layout
-    gvLayout(self->gvc, self->graph, "dot");
-    
-    // Request redraw
-    gtk_widget_queue_draw(GTK_WIDGET(self));
+    if (self->layout_cancellable) {
+        g_cancellable_cancel(self->layout_cancellable);
+        g_object_unref(self->layout_cancellable);
+    }
+    self->layout_cancellable = g_cancellable_new();
+    
+    GraphLayoutFocus focus = { self->focus, self->focus_hops, self->expanded };
+    GraphLayoutGroups groups = { self->grouping, self->expanded_groups };
+    graph_layout_compute_async(self->analyzer->packages, self->engine, self->layout,
+                               self->focus ? &focus : NULL, &groups,
+                               self->layout_cancellable, on_layout_progress,
+                               on_layout_ready, g_object_ref(self));
 }
 
 static void on_motion(GtkEventControllerMotion* controller G_GNUC_UNUSED,
@@ -209,30 +495,85 @@ static void on_motion(GtkEventControllerMotion* controller G_GNUC_UNUSED,
     VenvGraphView* self = VENV_GRAPH_VIEW(data);
     
     // Hit testing for node selection
-    if (self->graph) {
+    if (self->layout && !in_minimap(self, x, y)) {
         x = (x - self->translate_x) / self->scale;
         y = (y - self->translate_y) / self->scale;
         
-        for (Agnode_t* n = agfstnode(self->graph); n; n = agnxtnode(self->graph, n)) {
-            pointf pos = ND_coord(n);
-            double w = ND_width(n) * 36;
-            double h = ND_height(n) * 36;
-            
-            if (x >= pos.x - w/2 && x <= pos.x + w/2 &&
-                y >= pos.y - h/2 && y <= pos.y + h/2) {
-                g_free(self->selected_node);
-                self->selected_node = g_strdup(agnameof(n));
-                gtk_widget_queue_draw(GTK_WIDGET(self));
-                break;
-            }
+        // Only a change of hovered node needs a redraw
+        int index = graph_layout_node_at(self->layout, x, y);
+        if (index == self->hovered_node) return;
+        
+        self->hovered_node = index;
+        if (index >= 0 && g_strcmp0(self->selected_node, self->layout->nodes[index].name) != 0) {
+            g_free(self->selected_node);
+            self->selected_node = g_strdup(self->layout->nodes[index].name);
+            self->selected_index = index;
+            gtk_widget_queue_draw(GTK_WIDGET(self));
         }
     }
 }
 
+// A click on a collapsed group shows its members. In focus mode a click
+// on a stub shows the rest of its package's neighbours, and a double
+// click on a package moves the focus there.
+static void on_click_released(GtkGestureClick* gesture G_GNUC_UNUSED,
+                              int n_press,
+                              double x, double y,
+                              gpointer data) {
+    VenvGraphView* self = VENV_GRAPH_VIEW(data);
+    if (!self->layout || in_minimap(self, x, y)) return;
+
+    x = (x - self->translate_x) / self->scale;
+    y = (y - self->translate_y) / self->scale;
+    int index = graph_layout_node_at(self->layout, x, y);
+    if (index < 0) return;
+
+    const LayoutNode* node = &self->layout->nodes[index];
+    if (node->members > 0 && n_press == 1) {
+        g_hash_table_add(self->expanded_groups, g_strdup(node->group));
+        update_graph(self);
+    } else if (!self->focus) {
+        return;
+    } else if (node->hidden > 0 && n_press == 1) {
+        const char* package = node->name + strlen(GRAPH_LAYOUT_STUB_PREFIX);
+        g_hash_table_add(self->expanded, g_strdup(package));
+        update_graph(self);
+    } else if (node->hidden == 0 && node->members == 0 && n_press == 2) {
+        venv_graph_view_set_focus(GTK_WIDGET(self), node->name, self->focus_hops);
+    }
+}
+
+// A right click on a member of an expanded group collapses the group
+static void on_secondary_click_released(GtkGestureClick* gesture G_GNUC_UNUSED,
+                                        int n_press G_GNUC_UNUSED,
+                                        double x, double y,
+                                        gpointer data) {
+    VenvGraphView* self = VENV_GRAPH_VIEW(data);
+    if (!self->layout || in_minimap(self, x, y)) return;
+
+    x = (x - self->translate_x) / self->scale;
+    y = (y - self->translate_y) / self->scale;
+    int index = graph_layout_node_at(self->layout, x, y);
+    if (index < 0) return;
+
+    const LayoutNode* node = &self->layout->nodes[index];
+    if (node->members == 0 && node->group &&
+        g_hash_table_remove(self->expanded_groups, node->group)) {
+        update_graph(self);
+    }
+}
+
 static void on_drag_begin(GtkGestureDrag* gesture G_GNUC_UNUSED,
                          double x, double y, 
                          gpointer data) {
     VenvGraphView* self = VENV_GRAPH_VIEW(data);
+    self->minimap_drag = in_minimap(self, x, y);
+    if (self->minimap_drag) {
+        self->drag_start_x = x;
+        self->drag_start_y = y;
+        minimap_jump(self, x, y);
+        return;
+    }
     self->drag_start_x = x - self->translate_x;
     self->drag_start_y = y - self->translate_y;
 }
@@ -244,6 +585,10 @@ static void on_drag_update(GtkGestureDrag* gesture,
     VenvGraphView* self = VENV_GRAPH_VIEW(data);
     double x, y;
     gtk_gesture_drag_get_offset(gesture, &x, &y);
+    if (self->minimap_drag) {
+        minimap_jump(self, self->drag_start_x + x, self->drag_start_y + y);
+        return;
+    }
     
     self->translate_x = x + self->drag_start_x;
     self->translate_y = y + self->drag_start_y;
@@ -280,7 +625,22 @@ static void venv_graph_view_init(VenvGraphView* self) {
     self->translate_x = 0;
     self->translate_y = 0;
     self->selected_node = NULL;
-    self->gvc = gvContext();
+    self->hovered_node = -1;
+    self->selected_index = -1;
+    self->focus_hops = GRAPH_VIEW_DEFAULT_FOCUS_HOPS;
+    self->expanded = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    self->expanded_groups = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    self->visible_nodes = g_array_new(FALSE, FALSE, sizeof(guint));
+    self->visible_edges = g_array_new(FALSE, FALSE, sizeof(guint));
+    self->visible_clusters = g_array_new(FALSE, FALSE, sizeof(LayoutCluster));
+    self->tiles = g_hash_table_new_full(tile_key_hash, tile_key_equal, g_free, tile_free);
+    
+    // Same font and shaping the layout measured the labels with
+    self->label_context = pango_font_map_create_context(pango_cairo_font_map_get_default());
+    pango_context_set_round_glyph_positions(self->label_context, FALSE);
+    self->label_font = pango_font_description_from_string(GRAPH_LAYOUT_FONT);
+    pango_font_description_set_absolute_size(self->label_font, GRAPH_LAYOUT_FONT_SIZE * PANGO_SCALE);
+    self->labels = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
     
     // Setup event controllers
     GtkEventController* motion = gtk_event_controller_motion_new();
@@ -292,6 +652,15 @@ static void venv_graph_view_init(VenvGraphView* self) {
     g_signal_connect(drag, "drag-update", G_CALLBACK(on_drag_update), self);
     gtk_widget_add_controller(GTK_WIDGET(self), GTK_EVENT_CONTROLLER(drag));
     
+    GtkGesture* click = gtk_gesture_click_new();
+    g_signal_connect(click, "released", G_CALLBACK(on_click_released), self);
+    gtk_widget_add_controller(GTK_WIDGET(self), GTK_EVENT_CONTROLLER(click));
+    
+    GtkGesture* secondary_click = gtk_gesture_click_new();
+    gtk_gesture_single_set_button(GTK_GESTURE_SINGLE(secondary_click), GDK_BUTTON_SECONDARY);
+    g_signal_connect(secondary_click, "released", G_CALLBACK(on_secondary_click_released), self);
+    gtk_widget_add_controller(GTK_WIDGET(self), GTK_EVENT_CONTROLLER(secondary_click));
+    
     GtkEventController* scroll = gtk_event_controller_scroll_new(GTK_EVENT_CONTROLLER_SCROLL_BOTH_AXES);
     g_signal_connect(scroll, "scroll", G_CALLBACK(on_scroll), self);
     gtk_widget_add_controller(GTK_WIDGET(self), scroll);
@@ -307,4 +676,165 @@ GtkWidget* venv_graph_view_new(VenvAnalyzer* analyzer) {
 void venv_graph_view_update(GtkWidget* widget) {
     g_return_if_fail(VENV_IS_GRAPH_VIEW(widget));
     update_graph(VENV_GRAPH_VIEW(widget));
-}
\ No newline at end of file
+}
+
+void venv_graph_view_set_engine(GtkWidget* widget, GraphLayoutEngine engine) {
+    g_return_if_fail(VENV_IS_GRAPH_VIEW(widget));
+    VenvGraphView* self = VENV_GRAPH_VIEW(widget);
+    if (self->engine == engine) return;
+
+    self->engine = engine;
+    update_graph(self);
+}
+
+void venv_graph_view_set_grouping(GtkWidget* widget, GraphLayoutGrouping grouping) {
+    g_return_if_fail(VENV_IS_GRAPH_VIEW(widget));
+    VenvGraphView* self = VENV_GRAPH_VIEW(widget);
+    if (self->grouping == grouping) return;
+
+    g_hash_table_remove_all(self->expanded_groups);
+    self->grouping = grouping;
+    update_graph(self);
+}
+
+void venv_graph_view_set_focus(GtkWidget* widget, const char* package, guint hops) {
+    g_return_if_fail(VENV_IS_GRAPH_VIEW(widget));
+    VenvGraphView* self = VENV_GRAPH_VIEW(widget);
+    if (g_strcmp0(self->focus, package) == 0 && self->focus_hops == hops) return;
+
+    // Expanded stubs belong to the old neighbourhood
+    if (g_strcmp0(self->focus, package) != 0) {
+        g_hash_table_remove_all(self->expanded);
+    }
+    g_free(self->focus);
+    self->focus = g_strdup(package);
+    self->focus_hops = hops;
+    update_graph(self);
+}
+
+gboolean venv_graph_view_jump_to(GtkWidget* widget, const char* query) {
+    g_return_val_if_fail(VENV_IS_GRAPH_VIEW(widget), FALSE);
+    VenvGraphView* self = VENV_GRAPH_VIEW(widget);
+    if (!self->layout || !query || !*query) return FALSE;
+
+    // Only packages can be jumped to; "+N more" stubs and collapsed groups
+    // are named after packages and would shadow them
+    if (!self->node_names) {
+        self->node_names = fuzzy_index_new();
+        self->named_nodes = g_array_new(FALSE, FALSE, sizeof(guint));
+        for (guint i = 0; i < self->layout->n_nodes; i++) {
+            const LayoutNode* node = &self->layout->nodes[i];
+            if (g_str_has_prefix(node->name, GRAPH_LAYOUT_STUB_PREFIX) ||
+                g_str_has_prefix(node->name, GRAPH_LAYOUT_GROUP_PREFIX)) {
+                continue;
+            }
+            fuzzy_index_add(self->node_names, node->name);
+            g_array_append_val(self->named_nodes, i);
+        }
+    }
+
+    GArray* matches = g_array_new(FALSE, FALSE, sizeof(FuzzyMatch));
+    fuzzy_index_search(self->node_names, query, matches);
+    fuzzy_index_rank(self->node_names, matches, 1);
+    gboolean found = matches->len > 0;
+    if (found) {
+        guint match = g_array_index(matches, FuzzyMatch, 0).index;
+        guint index = g_array_index(self->named_nodes, guint, match);
+        const LayoutNode* node = &self->layout->nodes[index];
+        g_free(self->selected_node);
+        self->selected_node = g_strdup(node->name);
+        self->selected_index = (int)index;
+
+        // Close enough for the highlight and label to show
+        self->scale = MAX(self->scale, 1.0);
+        self->translate_x = gtk_widget_get_width(widget) / 2.0 - node->x * self->scale;
+        self->translate_y = gtk_widget_get_height(widget) / 2.0 - node->y * self->scale;
+        gtk_widget_queue_draw(widget);
+    }
+    g_array_unref(matches);
+    return found;
+}
+
+typedef struct {
+    GraphLayout* layout;
+    char* path;
+    gboolean svg;
+    double scale;
+} ExportRequest;
+
+static void export_request_free(gpointer data) {
+    ExportRequest* request = data;
+    graph_layout_unref(request->layout);
+    g_free(request->path);
+    g_free(request);
+}
+
+// Layouts are immutable once published, so the worker can draw the one
+// the view holds; cancelling abandons the file at the next write
+static void export_thread(GTask* task,
+                          gpointer source_object G_GNUC_UNUSED,
+                          gpointer task_data,
+                          GCancellable* cancellable) {
+    ExportRequest* request = task_data;
+    GError* error = NULL;
+
+    ExportWriter writer;
+    if (!export_writer_open(&writer, request->path, &error)) {
+        g_task_return_error(task, error);
+        return;
+    }
+    writer.cancellable = cancellable;
+    if (request->svg) {
+        graph_export_svg(&writer, request->layout);
+    } else {
+        graph_export_png(&writer, request->layout, request->scale);
+    }
+
+    gboolean exported = export_writer_close(&writer, request->path, &error);
+    if (g_task_return_error_if_cancelled(task)) {
+        g_clear_error(&error);
+    } else if (!exported) {
+        g_task_return_error(task, error);
+    } else {
+        g_task_return_boolean(task, TRUE);
+    }
+}
+
+void venv_graph_view_export_async(GtkWidget* widget, const char* path, const char* format,
+                                  GCancellable* cancellable,
+                                  GAsyncReadyCallback callback, gpointer user_data) {
+    g_return_if_fail(VENV_IS_GRAPH_VIEW(widget));
+    VenvGraphView* self = VENV_GRAPH_VIEW(widget);
+    GTask* task = g_task_new(self, cancellable, callback, user_data);
+    g_task_set_source_tag(task, venv_graph_view_export_async);
+
+    gboolean svg = g_ascii_strcasecmp(format, "svg") == 0;
+    if (!svg && g_ascii_strcasecmp(format, "png") != 0) {
+        g_task_return_new_error(task, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_EXPORT_FAILED,
+                                "Graphs cannot be exported as %s", format);
+        g_object_unref(task);
+        return;
+    }
+    if (!self->layout) {
+        g_task_return_new_error(task, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_EXPORT_FAILED,
+                                "The graph has not been laid out yet");
+        g_object_unref(task);
+        return;
+    }
+
+    // Images are as sharp as the view's own tiles
+    ExportRequest* request = g_new(ExportRequest, 1);
+    request->layout = graph_layout_ref(self->layout);
+    request->path = g_strdup(path);
+    request->svg = svg;
+    request->scale = gtk_widget_get_scale_factor(widget);
+    g_task_set_task_data(task, request, export_request_free);
+    g_task_run_in_thread(task, export_thread);
+    g_object_unref(task);
+}
+
+gboolean venv_graph_view_export_finish(GtkWidget* widget, GAsyncResult* result,
+                                       GError** error) {
+    g_return_val_if_fail(g_task_is_valid(result, widget), FALSE);
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
@@ -2,6 +2,7 @@
 #define GRAPH_VIEW_H
 
 #include "../include/venv_analyzer.h"
+#include "../core/graph_layout.h"
 
 G_BEGIN_DECLS
 
@@ -12,7 +13,44 @@ G_DECLARE_FINAL_TYPE(VenvGraphView, venv_graph_view, VENV, GRAPH_VIEW, GtkWidget
 void venv_graph_view_snapshot(GtkWidget* widget, GtkSnapshot* snapshot);
 GtkWidget* venv_graph_view_new(VenvAnalyzer* analyzer);
 void venv_graph_view_update(GtkWidget* view);
-void venv_graph_view_export(GtkWidget* view, const char* path, const char* format);
+void venv_graph_view_set_engine(GtkWidget* view, GraphLayoutEngine engine);
+
+/**
+ * Collapses groups of packages into single nodes, or shows every package
+ * with GRAPH_LAYOUT_GROUP_BY_NONE. All groups start collapsed.
+ */
+void venv_graph_view_set_grouping(GtkWidget* view, GraphLayoutGrouping grouping);
+
+#define GRAPH_VIEW_DEFAULT_FOCUS_HOPS 2
+
+/**
+ * Shows only the packages within hops dependency edges of package, in
+ * either direction, or the whole graph if package is NULL
+ */
+void venv_graph_view_set_focus(GtkWidget* view, const char* package, guint hops);
+
+/**
+ * Writes the graph as laid out to path, as "svg" or "png", on a worker
+ * thread. Both are streamed out, so memory use does not depend on the
+ * size of the graph. Cancelling leaves path untouched and finishes with
+ * G_IO_ERROR_CANCELLED.
+ */
+void venv_graph_view_export_async(GtkWidget* view, const char* path, const char* format,
+                                  GCancellable* cancellable,
+                                  GAsyncReadyCallback callback, gpointer user_data);
+
+/**
+ * @return FALSE on error
+ */
+gboolean venv_graph_view_export_finish(GtkWidget* view, GAsyncResult* result,
+                                       GError** error);
+
+/**
+ * Selects the node best matching query as a fuzzy fragment of its name
+ * and centres the view on it
+ * @return FALSE if no node matches
+ */
+gboolean venv_graph_view_jump_to(GtkWidget* view, const char* query);
 
 G_END_DECLS
 
@@ -4,15 +4,23 @@
 #include "main_window.h"
 #include "graph_view.h"
 #include "package_list.h"
+#include "treemap_view.h"
+#include "file_browser.h"
+#include "../core/analyzer.h"
 #include <gtk/gtk.h>
 
 // Forward declarations
-static void on_package_selected(GtkListBox* box, GtkListBoxRow* row, MainWindow* window);
+static void on_package_selected(GtkSingleSelection* selection, GParamSpec* pspec, MainWindow* window);
 static void update_package_details(MainWindow* window, Package* package);
 static void on_scan_clicked(GtkButton* button, MainWindow* window);
 static void on_folder_selected(GObject* source, GAsyncResult* result, gpointer user_data);
 static void on_choose_folder_clicked(GtkButton* button, MainWindow* window);
+static void on_snapshot_selected(GObject* source, GAsyncResult* result, gpointer user_data);
+static void on_open_snapshot_clicked(GtkButton* button, MainWindow* window);
+static void on_layout_engine_changed(GtkDropDown* dropdown, GParamSpec* pspec, MainWindow* window);
+static void update_focus(MainWindow* window);
 static MainWindow* get_main_window(GtkWidget* widget);
+static void main_window_data_free(MainWindow* window);
 
 // CSS definitions
 static const char* CSS_DEFINITIONS = 
@@ -32,8 +40,33 @@ static void setup_css(void) {
     g_object_unref(provider);
 }
 
+static void on_scan_saved(GObject* source G_GNUC_UNUSED,
+                          GAsyncResult* result,
+                          gpointer user_data) {
+    VenvAnalyzer* analyzer = user_data;
+    GError* error = NULL;
+    if (!venv_analyzer_save_to_db_finish(analyzer, result, &error)) {
+        g_warning("%s", error->message);
+        g_error_free(error);
+    }
+}
+
+// The commit happens on the database writer thread
+static void save_scan(MainWindow* window) {
+    venv_analyzer_save_to_db_async(window->analyzer, on_scan_saved, window->analyzer);
+}
+
+// A full scan supersedes any revalidation of the previously loaded one
+static void cancel_revalidation(MainWindow* window) {
+    if (window->revalidate_cancellable) {
+        g_cancellable_cancel(window->revalidate_cancellable);
+        g_clear_object(&window->revalidate_cancellable);
+    }
+}
+
 static void on_scan_clicked(GtkButton* button G_GNUC_UNUSED, MainWindow* window) {
     GError* error = NULL;
+    cancel_revalidation(window);
     if (!venv_analyzer_scan(window->analyzer, &error)) {
         main_window_set_status(window->window, 
             error ? error->message : "Failed to scan virtual environment");
@@ -41,6 +74,7 @@ static void on_scan_clicked(GtkButton* button G_GNUC_UNUSED, MainWindow* window)
         return;
     }
     
+    save_scan(window);
     main_window_refresh_view(window->window);
 }
 
@@ -60,12 +94,14 @@ static void on_folder_selected(GObject* source, GAsyncResult* result, gpointer u
         char* path = g_file_get_path(folder);
         if (path) {
             g_strlcpy(window->analyzer->venv_path, path, sizeof(window->analyzer->venv_path));
+            cancel_revalidation(window);
             
             if (!venv_analyzer_scan(window->analyzer, &error)) {
                 main_window_set_status(window->window, 
                     error ? error->message : "Failed to scan virtual environment");
                 if (error) g_error_free(error);
             } else {
+                save_scan(window);
                 main_window_refresh_view(window->window);
             }
             
@@ -91,6 +127,193 @@ static void on_choose_folder_clicked(GtkButton* button, MainWindow* window) {
                                 window);
 }
 
+// Snapshots are opaque exports of another scan, so they are shown as-is and
+// neither saved to the database nor revalidated against the disk
+static void on_snapshot_selected(GObject* source, GAsyncResult* result, gpointer user_data) {
+    GtkFileDialog* dialog = GTK_FILE_DIALOG(source);
+    MainWindow* window = (MainWindow*)user_data;
+    GError* error = NULL;
+
+    GFile* file = gtk_file_dialog_open_finish(dialog, result, &error);
+    if (file) {
+        char* path = g_file_get_path(file);
+        if (path) {
+            cancel_revalidation(window);
+            if (!venv_analyzer_open_snapshot(window->analyzer, path, &error)) {
+                main_window_set_status(window->window, error->message);
+                g_error_free(error);
+            } else {
+                main_window_refresh_view(window->window);
+                update_package_details(window, NULL);
+            }
+            g_free(path);
+        }
+        g_object_unref(file);
+    } else if (error) {
+        g_warning("Error selecting snapshot: %s", error->message);
+        g_error_free(error);
+    }
+    g_object_unref(dialog);
+}
+
+static void on_open_snapshot_clicked(GtkButton* button, MainWindow* window) {
+    GtkFileDialog* dialog = gtk_file_dialog_new();
+    gtk_file_dialog_set_title(dialog, "Open Snapshot");
+    gtk_file_dialog_set_modal(dialog, TRUE);
+
+    GtkWindow* parent = GTK_WINDOW(gtk_widget_get_root(GTK_WIDGET(button)));
+    gtk_file_dialog_open(dialog, parent, NULL,
+                         (GAsyncReadyCallback)on_snapshot_selected, window);
+}
+
+static void cancel_export(MainWindow* window) {
+    if (window->export_cancellable) {
+        g_cancellable_cancel(window->export_cancellable);
+        g_clear_object(&window->export_cancellable);
+    }
+    g_clear_pointer(&window->export_path, g_free);
+}
+
+static void set_exported_status(MainWindow* window, const char* path) {
+    char* message = g_strdup_printf("Exported %s", path);
+    main_window_set_status(window->window, message);
+    g_free(message);
+}
+
+static void on_graph_exported(GObject* source, GAsyncResult* result, gpointer user_data) {
+    // Cancelled when another export started or the window went away
+    if (g_cancellable_is_cancelled(g_task_get_cancellable(G_TASK(result)))) {
+        return;
+    }
+
+    MainWindow* window = user_data;
+    GError* error = NULL;
+    if (!venv_graph_view_export_finish(GTK_WIDGET(source), result, &error)) {
+        main_window_set_status(window->window, error->message);
+        g_error_free(error);
+    } else {
+        set_exported_status(window, window->export_path);
+    }
+    g_clear_object(&window->export_cancellable);
+    g_clear_pointer(&window->export_path, g_free);
+}
+
+// The file name picks the format: the package graph as data, written
+// right away, or the graph as laid out as an image, rendered on a worker
+// thread. A new export replaces an image export still running.
+static void export_to(MainWindow* window, const char* path) {
+    cancel_export(window);
+
+    char* lower = g_ascii_strdown(path, -1);
+    const char* image_format = g_str_has_suffix(lower, ".svg") ? "svg"
+                             : g_str_has_suffix(lower, ".png") ? "png" : NULL;
+    GError* error = NULL;
+    gboolean exported = FALSE;
+    if (image_format) {
+        window->export_cancellable = g_cancellable_new();
+        window->export_path = g_strdup(path);
+        char* message = g_strdup_printf("Exporting %s…", path);
+        main_window_set_status(window->window, message);
+        g_free(message);
+        venv_graph_view_export_async(window->graph_view, path, image_format,
+                                     window->export_cancellable, on_graph_exported, window);
+        g_free(lower);
+        return;
+    }
+
+    if (g_str_has_suffix(lower, ".json")) {
+        exported = venv_analyzer_export_json(window->analyzer, path, &error);
+    } else if (g_str_has_suffix(lower, ".dot") || g_str_has_suffix(lower, ".gv")) {
+        exported = venv_analyzer_export_dot(window->analyzer, path, &error);
+    } else {
+        g_set_error(&error, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_EXPORT_FAILED,
+                    "Export file names must end in .json, .dot, .svg or .png");
+    }
+    g_free(lower);
+
+    if (exported) {
+        set_exported_status(window, path);
+    } else {
+        main_window_set_status(window->window, error->message);
+        g_error_free(error);
+    }
+}
+
+static void on_export_selected(GObject* source, GAsyncResult* result, gpointer user_data) {
+    GtkFileDialog* dialog = GTK_FILE_DIALOG(source);
+    MainWindow* window = user_data;
+    GError* error = NULL;
+
+    GFile* file = gtk_file_dialog_save_finish(dialog, result, &error);
+    if (file) {
+        char* path = g_file_get_path(file);
+        if (path) {
+            export_to(window, path);
+            g_free(path);
+        }
+        g_object_unref(file);
+    } else if (error) {
+        g_warning("Error choosing export file: %s", error->message);
+        g_error_free(error);
+    }
+    g_object_unref(dialog);
+}
+
+static void on_export_clicked(GtkButton* button, MainWindow* window) {
+    GtkFileDialog* dialog = gtk_file_dialog_new();
+    gtk_file_dialog_set_title(dialog, "Export Dependencies");
+    gtk_file_dialog_set_modal(dialog, TRUE);
+    gtk_file_dialog_set_initial_name(dialog, "dependencies.svg");
+
+    GtkWindow* parent = GTK_WINDOW(gtk_widget_get_root(GTK_WIDGET(button)));
+    gtk_file_dialog_save(dialog, parent, NULL,
+                         (GAsyncReadyCallback)on_export_selected, window);
+}
+
+static void on_layout_engine_changed(GtkDropDown* dropdown, GParamSpec* pspec G_GNUC_UNUSED,
+                                     MainWindow* window) {
+    // Items are in GraphLayoutEngine order
+    venv_graph_view_set_engine(window->graph_view,
+                               (GraphLayoutEngine)gtk_drop_down_get_selected(dropdown));
+}
+
+static void on_grouping_changed(GtkDropDown* dropdown, GParamSpec* pspec G_GNUC_UNUSED,
+                                MainWindow* window) {
+    // Items are in GraphLayoutGrouping order
+    venv_graph_view_set_grouping(window->graph_view,
+                                 (GraphLayoutGrouping)gtk_drop_down_get_selected(dropdown));
+}
+
+static void on_treemap_grouping_changed(GtkDropDown* dropdown, GParamSpec* pspec G_GNUC_UNUSED,
+                                        MainWindow* window) {
+    // Items are in TreemapGrouping order
+    venv_treemap_view_set_grouping(window->treemap_view,
+                                   (TreemapGrouping)gtk_drop_down_get_selected(dropdown));
+}
+
+static void update_focus(MainWindow* window) {
+    gboolean active = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(window->focus_toggle));
+    guint hops = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(window->focus_hops));
+    venv_graph_view_set_focus(window->graph_view, active ? window->selected_package : NULL, hops);
+}
+
+static void on_focus_toggled(GtkToggleButton* button G_GNUC_UNUSED, MainWindow* window) {
+    update_focus(window);
+}
+
+static void on_focus_hops_changed(GtkSpinButton* spin G_GNUC_UNUSED, MainWindow* window) {
+    update_focus(window);
+}
+
+static void on_jump_changed(GtkSearchEntry* entry, MainWindow* window) {
+    const char* query = gtk_editable_get_text(GTK_EDITABLE(entry));
+    if (*query && !venv_graph_view_jump_to(window->graph_view, query)) {
+        char* message = g_strdup_printf("No package in the graph matches \"%s\"", query);
+        main_window_set_status(window->window, message);
+        g_free(message);
+    }
+}
+
 static GtkWidget* create_toolbar(MainWindow* window) {
     GtkWidget* toolbar = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
     gtk_widget_set_margin_start(toolbar, 10);
@@ -106,9 +329,78 @@ static GtkWidget* create_toolbar(MainWindow* window) {
     gtk_box_append(GTK_BOX(toolbar), scan_button);
     g_signal_connect(scan_button, "clicked", G_CALLBACK(on_scan_clicked), window);
 
+    GtkWidget* snapshot_button = gtk_button_new_with_label("Open Snapshot");
+    gtk_box_append(GTK_BOX(toolbar), snapshot_button);
+    g_signal_connect(snapshot_button, "clicked", G_CALLBACK(on_open_snapshot_clicked), window);
+
+    GtkWidget* export_button = gtk_button_new_with_label("Export");
+    gtk_widget_set_tooltip_text(export_button,
+                                "Save the dependency graph as JSON or DOT, or as an SVG or PNG image");
+    gtk_box_append(GTK_BOX(toolbar), export_button);
+    g_signal_connect(export_button, "clicked", G_CALLBACK(on_export_clicked), window);
+
+    const char* engines[] = { "Automatic layout", "Graphviz dot", "Layered", "Force-directed", NULL };
+    GtkWidget* engine_dropdown = gtk_drop_down_new_from_strings(engines);
+    gtk_widget_set_tooltip_text(engine_dropdown, "Graph layout engine");
+    gtk_box_append(GTK_BOX(toolbar), engine_dropdown);
+    g_signal_connect(engine_dropdown, "notify::selected",
+                     G_CALLBACK(on_layout_engine_changed), window);
+
+    // Collapsed groups expand on click and collapse again on right click
+    const char* groupings[] = { "No grouping", "Group by name", "Group by requirement", NULL };
+    GtkWidget* grouping_dropdown = gtk_drop_down_new_from_strings(groupings);
+    gtk_widget_set_tooltip_text(grouping_dropdown, "Collapse groups of packages into one node");
+    gtk_box_append(GTK_BOX(toolbar), grouping_dropdown);
+    g_signal_connect(grouping_dropdown, "notify::selected",
+                     G_CALLBACK(on_grouping_changed), window);
+
+    // Focus mode lays out only the neighbourhood of the selected package
+    window->focus_toggle = gtk_toggle_button_new_with_label("Focus");
+    gtk_widget_set_tooltip_text(window->focus_toggle,
+                                "Show only packages near the selected one");
+    gtk_box_append(GTK_BOX(toolbar), window->focus_toggle);
+    g_signal_connect(window->focus_toggle, "toggled", G_CALLBACK(on_focus_toggled), window);
+
+    window->focus_hops = gtk_spin_button_new_with_range(1, 10, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(window->focus_hops), GRAPH_VIEW_DEFAULT_FOCUS_HOPS);
+    gtk_widget_set_tooltip_text(window->focus_hops, "Dependency hops shown in focus mode");
+    gtk_box_append(GTK_BOX(toolbar), window->focus_hops);
+    g_signal_connect(window->focus_hops, "value-changed",
+                     G_CALLBACK(on_focus_hops_changed), window);
+
+    // Every keystroke moves to the best match, so no search delay
+    GtkWidget* jump_entry = gtk_search_entry_new();
+    gtk_search_entry_set_search_delay(GTK_SEARCH_ENTRY(jump_entry), 0);
+    gtk_search_entry_set_placeholder_text(GTK_SEARCH_ENTRY(jump_entry), "Jump to package");
+    gtk_widget_set_tooltip_text(jump_entry, "Find a package in the graph by fragments of its name");
+    gtk_box_append(GTK_BOX(toolbar), jump_entry);
+    g_signal_connect(jump_entry, "search-changed", G_CALLBACK(on_jump_changed), window);
+    g_signal_connect(jump_entry, "activate", G_CALLBACK(on_jump_changed), window);
+
     return toolbar;
 }
 
+// Disk usage of the packages, laid out only once the page is shown
+static GtkWidget* create_treemap_page(MainWindow* window) {
+    GtkWidget* page = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+
+    const char* groupings[] = { "No grouping", "Group by requirement", "Split into files", NULL };
+    GtkWidget* grouping_dropdown = gtk_drop_down_new_from_strings(groupings);
+    gtk_widget_set_tooltip_text(grouping_dropdown, "How package sizes are broken down");
+    gtk_widget_set_halign(grouping_dropdown, GTK_ALIGN_START);
+    gtk_widget_set_margin_start(grouping_dropdown, 6);
+    gtk_widget_set_margin_top(grouping_dropdown, 6);
+    gtk_widget_set_margin_bottom(grouping_dropdown, 6);
+    gtk_box_append(GTK_BOX(page), grouping_dropdown);
+    g_signal_connect(grouping_dropdown, "notify::selected",
+                     G_CALLBACK(on_treemap_grouping_changed), window);
+
+    window->treemap_view = venv_treemap_view_new(window->analyzer);
+    gtk_widget_set_vexpand(window->treemap_view, TRUE);
+    gtk_box_append(GTK_BOX(page), window->treemap_view);
+    return page;
+}
+
 static GtkWidget* create_details_view(MainWindow* window) {
     if (!window) return NULL;
 
@@ -145,6 +437,8 @@ static void update_package_details(MainWindow* window, Package* package) {
         return;
     }
 
+    file_browser_set_package(window->file_browser, package);
+
     GtkTextView* text_view = GTK_TEXT_VIEW(window->details_view);
     if (!GTK_IS_TEXT_VIEW(text_view)) {
         g_warning("Invalid text view widget");
@@ -209,19 +503,32 @@ static void update_package_details(MainWindow* window, Package* package) {
 }
 
 static GtkWidget* create_package_list(MainWindow* window) {
-    GtkWidget* list = gtk_list_box_new();
-    gtk_widget_add_css_class(list, "package-list");
-    g_signal_connect(list, "row-selected", G_CALLBACK(on_package_selected), window);
+    GtkWidget* list = package_list_new(window->analyzer);
+    GtkSingleSelection* selection = g_object_get_data(G_OBJECT(list), "selection");
+    g_signal_connect(selection, "notify::selected-item", G_CALLBACK(on_package_selected), window);
     window->package_list = list;
     return list;
 }
 
-static void on_package_selected(GtkListBox* box G_GNUC_UNUSED, 
-                              GtkListBoxRow* row,
+static void on_package_selected(GtkSingleSelection* selection,
+                              GParamSpec* pspec G_GNUC_UNUSED,
                               MainWindow* window) {
-    if (!row) return;
-    Package* package = g_object_get_data(G_OBJECT(row), "package");
+    // NULL when the selection is cleared, e.g. filtered out by a search;
+    // the details pane and focus mode then go back to their empty state
+    Package* package = gtk_single_selection_get_selected_item(selection);
     update_package_details(window, package);
+
+    g_free(window->selected_package);
+    window->selected_package = package ? g_strdup(package->name) : NULL;
+    update_focus(window);
+}
+
+static void main_window_data_free(MainWindow* window) {
+    cancel_revalidation(window);
+    cancel_export(window);
+    venv_analyzer_flush_db(window->analyzer);
+    g_free(window->selected_package);
+    g_free(window);
 }
 
 GtkWidget* venv_main_window_new(GtkApplication* app, VenvAnalyzer* analyzer) {
@@ -257,13 +564,38 @@ GtkWidget* venv_main_window_new(GtkApplication* app, VenvAnalyzer* analyzer) {
     gtk_widget_set_vexpand(content, TRUE);
     gtk_box_append(GTK_BOX(box), content);
 
-    win->package_list = create_package_list(win);
     gtk_widget_set_size_request(win->package_list, 200, -1);
     gtk_paned_set_start_child(GTK_PANED(content), win->package_list);
 
-    gtk_paned_set_end_child(GTK_PANED(content), details);
+    win->graph_view = venv_graph_view_new(analyzer);
+    gtk_widget_add_css_class(win->graph_view, "graph-view");
+    gtk_widget_set_size_request(win->graph_view, -1, 200);
 
-    g_object_set_data_full(G_OBJECT(win->window), "window-data", win, g_free);
+    GtkWidget* views = gtk_notebook_new();
+    gtk_notebook_append_page(GTK_NOTEBOOK(views), win->graph_view,
+                             gtk_label_new("Dependencies"));
+    gtk_notebook_append_page(GTK_NOTEBOOK(views), create_treemap_page(win),
+                             gtk_label_new("Disk usage"));
+
+    // The files of the selected package are only read on the Files page
+    win->file_browser = file_browser_new(analyzer);
+    GtkWidget* package_pages = gtk_notebook_new();
+    gtk_notebook_append_page(GTK_NOTEBOOK(package_pages), details,
+                             gtk_label_new("Details"));
+    gtk_notebook_append_page(GTK_NOTEBOOK(package_pages), win->file_browser,
+                             gtk_label_new("Files"));
+
+    GtkWidget* right = gtk_paned_new(GTK_ORIENTATION_VERTICAL);
+    gtk_paned_set_start_child(GTK_PANED(right), views);
+    gtk_paned_set_end_child(GTK_PANED(right), package_pages);
+    gtk_paned_set_end_child(GTK_PANED(content), right);
+
+    gtk_widget_add_css_class(analyzer->status_bar, "status-bar");
+    gtk_label_set_xalign(GTK_LABEL(analyzer->status_bar), 0);
+    gtk_box_append(GTK_BOX(box), analyzer->status_bar);
+
+    g_object_set_data_full(G_OBJECT(win->window), "window-data", win,
+                           (GDestroyNotify)main_window_data_free);
 
     update_package_details(win, NULL);
 
@@ -274,6 +606,52 @@ static MainWindow* get_main_window(GtkWidget* widget) {
     return g_object_get_data(G_OBJECT(widget), "window-data");
 }
 
+static void on_revalidated(GObject* source G_GNUC_UNUSED,
+                           GAsyncResult* result,
+                           gpointer user_data) {
+    // Cancelled when a new scan started or the window went away
+    if (g_cancellable_is_cancelled(g_task_get_cancellable(G_TASK(result)))) {
+        return;
+    }
+
+    MainWindow* window = user_data;
+    GError* error = NULL;
+    guint n_changed = 0;
+
+    g_clear_object(&window->revalidate_cancellable);
+    if (!venv_analyzer_revalidate_finish(window->analyzer, result, &n_changed, &error)) {
+        main_window_set_status(window->window, error->message);
+        g_error_free(error);
+        return;
+    }
+
+    if (n_changed > 0) {
+        save_scan(window);
+        main_window_refresh_view(window->window);
+    }
+}
+
+void main_window_load_last_scan(GtkWidget* window) {
+    MainWindow* win = get_main_window(window);
+    if (!win) return;
+
+    GError* error = NULL;
+    if (!venv_analyzer_load_from_db(win->analyzer, &error)) {
+        g_debug("No saved scan restored: %s", error->message);
+        g_error_free(error);
+        return;
+    }
+
+    main_window_refresh_view(window);
+    update_package_details(win, NULL);
+
+    // Show the saved scan now, then fix up whatever changed on disk since
+    cancel_revalidation(win);
+    win->revalidate_cancellable = g_cancellable_new();
+    venv_analyzer_revalidate_async(win->analyzer, win->revalidate_cancellable,
+                                   on_revalidated, win);
+}
+
 void main_window_set_status(GtkWidget* window, const char* message) {
     MainWindow* win = get_main_window(window);
     if (win && win->analyzer->status_bar) {
@@ -285,8 +663,11 @@ void main_window_refresh_view(GtkWidget* window) {
     MainWindow* win = get_main_window(window);
     if (!win) return;
     
-    main_window_update_package_list(window, win->analyzer);
-    main_window_update_dependency_graph(window, win->analyzer);
+    // A rescan that changed nothing leaves the list and graph alone
+    if (main_window_update_package_list(window, win->analyzer) > 0) {
+        main_window_update_dependency_graph(window, win->analyzer);
+        venv_treemap_view_update(win->treemap_view);
+    }
     
     int pkg_count = 0;
     int conflicts = 0;
@@ -305,31 +686,31 @@ void main_window_refresh_view(GtkWidget* window) {
     g_string_free(status, TRUE);
 }
 
-void main_window_update_package_list(GtkWidget* window, VenvAnalyzer* analyzer) {
+guint main_window_update_package_list(GtkWidget* window, VenvAnalyzer* analyzer) {
     if (!GTK_IS_WIDGET(window)) {
         g_warning("Invalid window widget");
-        return;
+        return 0;
     }
 
     MainWindow* win = get_main_window(window);
     if (!win) {
         g_warning("Could not get main window data");
-        return;
+        return 0;
     }
 
     if (!win->package_list || !GTK_IS_WIDGET(win->package_list)) {
         g_warning("Invalid package list widget");
-        return;
+        return 0;
     }
 
-    package_list_update(win->package_list, analyzer);
+    return package_list_update(win->package_list, analyzer);
 }
 
 void main_window_update_dependency_graph(GtkWidget* window G_GNUC_UNUSED,
                                       VenvAnalyzer* analyzer G_GNUC_UNUSED)
 {
     MainWindow* win = get_main_window(window);
-    if (win && win->details_view) {
-        venv_graph_view_update(win->details_view);
+    if (win && win->graph_view) {
+        venv_graph_view_update(win->graph_view);
     }
 }
\ No newline at end of file
@@ -9,7 +9,15 @@ typedef struct {
     GtkWidget* details_view;
     GtkWidget* package_list;
     GtkWidget* graph_view;
+    GtkWidget* treemap_view;
+    GtkWidget* file_browser;
     VenvAnalyzer* analyzer;
+    GCancellable* revalidate_cancellable;
+    GCancellable* export_cancellable;  // Image export in progress, or NULL
+    char* export_path;                 // Where that export writes
+    GtkWidget* focus_toggle;
+    GtkWidget* focus_hops;
+    char* selected_package;     // Name of the package selected in the list
 } MainWindow;
 
 // Signal handlers
@@ -20,7 +28,8 @@ static void on_scan_clicked(GtkButton* button, MainWindow* window);
 GtkWidget* venv_main_window_new(GtkApplication* app, VenvAnalyzer* analyzer);
 void main_window_set_status(GtkWidget* window, const char* message);
 void main_window_refresh_view(GtkWidget* window);
-void main_window_update_package_list(GtkWidget* window, VenvAnalyzer* analyzer);
+void main_window_load_last_scan(GtkWidget* window);
+guint main_window_update_package_list(GtkWidget* window, VenvAnalyzer* analyzer);
 void main_window_update_dependency_graph(GtkWidget* window, VenvAnalyzer* analyzer);
 
 #endif /* MAIN_WINDOW_H */
\ No newline at end of file
@@ -1,32 +1,9 @@
 #include "../../include/venv_analyzer.h"  // Fix include path
 #include "../core/package.h"
+#include "../core/analyzer.h"
 #include "package_list.h"
 #include <gtk/gtk.h>
 
-#define PACKAGE_TYPE_ITEM (package_item_get_type())
-G_DECLARE_FINAL_TYPE(PackageItem, package_item, PACKAGE, ITEM, GObject)
-
-// Package item structure for the list model
-struct _PackageItem {
-    GObject parent_instance;
-    Package* package;
-};
-
-G_DEFINE_TYPE(PackageItem, package_item, G_TYPE_OBJECT)
-
-static void
-package_item_init(PackageItem* self)
-{
-    self->package = NULL;
-}
-
-static void
-package_item_class_init(PackageItemClass* class)
-{
-    // Remove unused variable
-    // No operations needed in class init for now
-}
-
 static void
 setup_list_factory(GtkListItemFactory* factory G_GNUC_UNUSED,
                   GtkListItem* list_item,
@@ -60,80 +37,288 @@ bind_list_factory(GtkListItemFactory* factory G_GNUC_UNUSED,
     GtkWidget* name_label = gtk_widget_get_first_child(box);
     GtkWidget* version_label = gtk_widget_get_next_sibling(name_label);
     
-    PackageItem* item = gtk_list_item_get_item(list_item);
-    if (!item || !item->package) return;
+    Package* package = gtk_list_item_get_item(list_item);
+    if (!package) return;
     
-    gtk_label_set_text(GTK_LABEL(name_label), item->package->name);
-    gtk_label_set_text(GTK_LABEL(version_label), item->package->version);
+    gtk_label_set_text(GTK_LABEL(name_label), package->name);
+    gtk_label_set_text(GTK_LABEL(version_label), package->version);
     
-    if (item->package->conflicts) {
+    if (package->conflicts) {
         gtk_widget_add_css_class(box, "warning");
     } else {
         gtk_widget_remove_css_class(box, "warning");
     }
 }
 
+static gboolean filter_package(gpointer item, gpointer user_data) {
+    return venv_analyzer_package_visible(user_data, item);
+}
+
+// Sort expressions only look up keys the analyzer precomputed, and the
+// sort model extracts them once per row rather than once per comparison
+static guint64 package_sort_value(Package* pkg, VenvAnalyzer* analyzer) {
+    return venv_analyzer_package_sort_key(analyzer, pkg, analyzer->sort_key);
+}
+
+static guint64 package_search_rank(Package* pkg, VenvAnalyzer* analyzer) {
+    return venv_analyzer_package_search_rank(analyzer, pkg);
+}
+
+static guint64 package_name_rank(Package* pkg, VenvAnalyzer* analyzer) {
+    return venv_analyzer_package_sort_key(analyzer, pkg, PACKAGE_SORT_NAME);
+}
+
+// Searching re-runs the filter and puts the best matches first; rows are
+// bound to whatever is visible
+static void on_search_changed(GtkSearchEntry* entry, gpointer user_data) {
+    GtkWidget* list = user_data;
+    VenvAnalyzer* analyzer = g_object_get_data(G_OBJECT(list), "analyzer");
+    GtkFilter* filter = g_object_get_data(G_OBJECT(list), "filter");
+    GtkSorter* relevance = g_object_get_data(G_OBJECT(list), "relevance-sorter");
+
+    gboolean had_search = analyzer->search_term != NULL;
+    venv_analyzer_set_search(analyzer, gtk_editable_get_text(GTK_EDITABLE(entry)));
+    gtk_filter_changed(filter, GTK_FILTER_CHANGE_DIFFERENT);
+    if (had_search || analyzer->search_term) {
+        gtk_sorter_changed(relevance, GTK_SORTER_CHANGE_DIFFERENT);
+    }
+}
+
+static void update_sort(GtkWidget* list) {
+    VenvAnalyzer* analyzer = g_object_get_data(G_OBJECT(list), "analyzer");
+    GtkNumericSorter* sorter = g_object_get_data(G_OBJECT(list), "sorter");
+    GtkDropDown* sort_dropdown = g_object_get_data(G_OBJECT(list), "sort-dropdown");
+    GtkToggleButton* descending = g_object_get_data(G_OBJECT(list), "sort-descending");
+
+    // Items are in PackageSortKey order
+    PackageSortKey key = (PackageSortKey)gtk_drop_down_get_selected(sort_dropdown);
+    gboolean ascending = !gtk_toggle_button_get_active(descending);
+    PackageSortKey previous = analyzer->sort_key;
+    venv_analyzer_set_sort(analyzer, key, ascending);
+
+    // Flipping the order only inverts the sorted list; a new key has to
+    // be extracted for every row
+    gtk_numeric_sorter_set_sort_order(sorter, ascending ? GTK_SORT_ASCENDING
+                                                        : GTK_SORT_DESCENDING);
+    if (key != previous) {
+        gtk_sorter_changed(GTK_SORTER(sorter), GTK_SORTER_CHANGE_DIFFERENT);
+    }
+}
+
+static void on_sort_changed(GtkDropDown* dropdown G_GNUC_UNUSED,
+                            GParamSpec* pspec G_GNUC_UNUSED,
+                            GtkWidget* list) {
+    update_sort(list);
+}
+
+static void on_sort_order_toggled(GtkToggleButton* button, GtkWidget* list) {
+    gtk_button_set_icon_name(GTK_BUTTON(button), gtk_toggle_button_get_active(button)
+                             ? "view-sort-descending-symbolic"
+                             : "view-sort-ascending-symbolic");
+    update_sort(list);
+}
+
+// Direct and required packages are alternatives, so the first of the two
+// narrows the list and the second widens it again; none means both
+static guint shown_kinds(PackageFilterFlags flags) {
+    guint kinds = flags & (PACKAGE_FILTER_DIRECT | PACKAGE_FILTER_DEPS);
+    return kinds ? kinds : PACKAGE_FILTER_DIRECT | PACKAGE_FILTER_DEPS;
+}
+
+// Lets the filter model re-check only the rows that can change: the
+// visible ones when the filter tightens, the hidden ones when it loosens
+static GtkFilterChange filter_change(PackageFilterFlags from, PackageFilterFlags to) {
+    guint from_kinds = shown_kinds(from);
+    guint to_kinds = shown_kinds(to);
+    gboolean from_conflicts = (from & PACKAGE_FILTER_CONFLICTS) != 0;
+    gboolean to_conflicts = (to & PACKAGE_FILTER_CONFLICTS) != 0;
+
+    if (!(to_kinds & ~from_kinds) && (to_conflicts || !from_conflicts)) {
+        return GTK_FILTER_CHANGE_MORE_STRICT;
+    }
+    if (!(from_kinds & ~to_kinds) && (from_conflicts || !to_conflicts)) {
+        return GTK_FILTER_CHANGE_LESS_STRICT;
+    }
+    return GTK_FILTER_CHANGE_DIFFERENT;
+}
+
+static void on_filter_toggled(GtkToggleButton* button, GtkWidget* list) {
+    VenvAnalyzer* analyzer = g_object_get_data(G_OBJECT(list), "analyzer");
+    GtkFilter* filter = g_object_get_data(G_OBJECT(list), "filter");
+    PackageFilterFlags flag = GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(button), "flag"));
+
+    PackageFilterFlags previous = analyzer->filter_flags;
+    PackageFilterFlags flags = gtk_toggle_button_get_active(button)
+                             ? previous | flag : previous & ~flag;
+    if (flags == previous) return;
+
+    venv_analyzer_set_filter(analyzer, flags);
+    gtk_filter_changed(filter, filter_change(previous, flags));
+}
+
+static GtkWidget* filter_toggle_new(GtkWidget* list, const char* label,
+                                    const char* tooltip, PackageFilterFlags flag) {
+    GtkWidget* button = gtk_toggle_button_new_with_label(label);
+    gtk_widget_set_tooltip_text(button, tooltip);
+    g_object_set_data(G_OBJECT(button), "flag", GUINT_TO_POINTER(flag));
+    g_signal_connect(button, "toggled", G_CALLBACK(on_filter_toggled), list);
+    return button;
+}
+
+static GtkWidget* create_view_controls(GtkWidget* list) {
+    GtkWidget* controls = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_widget_set_margin_start(controls, 6);
+    gtk_widget_set_margin_end(controls, 6);
+    gtk_widget_set_margin_bottom(controls, 6);
+
+    // Items are in PackageSortKey order
+    const char* sort_keys[] = { "Name", "Version", "Size", "Size with dependencies",
+                                "Used by", "Depends on", NULL };
+    GtkWidget* sort_dropdown = gtk_drop_down_new_from_strings(sort_keys);
+    gtk_widget_set_tooltip_text(sort_dropdown, "Sort packages by");
+    gtk_box_append(GTK_BOX(controls), sort_dropdown);
+
+    GtkWidget* descending = gtk_toggle_button_new();
+    gtk_button_set_icon_name(GTK_BUTTON(descending), "view-sort-ascending-symbolic");
+    gtk_widget_set_tooltip_text(descending, "Reverse the sort order");
+    gtk_box_append(GTK_BOX(controls), descending);
+
+    g_object_set_data(G_OBJECT(list), "sort-dropdown", sort_dropdown);
+    g_object_set_data(G_OBJECT(list), "sort-descending", descending);
+    g_signal_connect(sort_dropdown, "notify::selected", G_CALLBACK(on_sort_changed), list);
+    g_signal_connect(descending, "toggled", G_CALLBACK(on_sort_order_toggled), list);
+
+    GtkWidget* filters = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+    gtk_widget_add_css_class(filters, "linked");
+    gtk_widget_set_halign(filters, GTK_ALIGN_END);
+    gtk_widget_set_hexpand(filters, TRUE);
+    gtk_box_append(GTK_BOX(filters),
+                   filter_toggle_new(list, "Conflicts", "Only packages with conflicts",
+                                     PACKAGE_FILTER_CONFLICTS));
+    gtk_box_append(GTK_BOX(filters),
+                   filter_toggle_new(list, "Direct", "Packages nothing else depends on",
+                                     PACKAGE_FILTER_DIRECT));
+    gtk_box_append(GTK_BOX(filters),
+                   filter_toggle_new(list, "Required", "Packages something depends on",
+                                     PACKAGE_FILTER_DEPS));
+    gtk_box_append(GTK_BOX(controls), filters);
+
+    return controls;
+}
+
 GtkWidget* package_list_new(VenvAnalyzer* analyzer) {
+    GtkWidget* box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+
+    // The index answers well within a frame, so skip the default delay
+    GtkWidget* search_entry = gtk_search_entry_new();
+    gtk_search_entry_set_search_delay(GTK_SEARCH_ENTRY(search_entry), 0);
+    gtk_widget_set_margin_start(search_entry, 6);
+    gtk_widget_set_margin_end(search_entry, 6);
+    gtk_widget_set_margin_top(search_entry, 6);
+    gtk_widget_set_margin_bottom(search_entry, 6);
+    gtk_box_append(GTK_BOX(box), search_entry);
+    gtk_box_append(GTK_BOX(box), create_view_controls(box));
+
     // Create scrolled window to contain the list
     GtkWidget* scrolled = gtk_scrolled_window_new();
     gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled),
                                  GTK_POLICY_NEVER,
                                  GTK_POLICY_AUTOMATIC);
+    gtk_widget_set_vexpand(scrolled, TRUE);
+    gtk_box_append(GTK_BOX(box), scrolled);
+
+    // The analyzer's package store, filtered and sorted; the list view
+    // only creates rows for what is on screen and recycles them. Both
+    // models work in batches from the main loop, so refiltering or
+    // re-sorting a long list never stalls typing.
+    GtkFilter* filter = GTK_FILTER(gtk_custom_filter_new(filter_package, analyzer, NULL));
+    GtkExpression* search_rank = gtk_cclosure_expression_new(G_TYPE_UINT64, NULL, 0, NULL,
+                                                             G_CALLBACK(package_search_rank),
+                                                             analyzer, NULL);
+    GtkNumericSorter* relevance = gtk_numeric_sorter_new(search_rank);
+    GtkExpression* value = gtk_cclosure_expression_new(G_TYPE_UINT64, NULL, 0, NULL,
+                                                       G_CALLBACK(package_sort_value),
+                                                       analyzer, NULL);
+    GtkNumericSorter* sorter = gtk_numeric_sorter_new(value);
+    GtkExpression* name_rank = gtk_cclosure_expression_new(G_TYPE_UINT64, NULL, 0, NULL,
+                                                           G_CALLBACK(package_name_rank),
+                                                           analyzer, NULL);
+    // Search results come best first whatever the chosen order; without a
+    // search every row ranks the same
+    GtkMultiSorter* sorters = gtk_multi_sorter_new();
+    gtk_multi_sorter_append(sorters, GTK_SORTER(g_object_ref(relevance)));
+    gtk_multi_sorter_append(sorters, GTK_SORTER(g_object_ref(sorter)));
+    gtk_multi_sorter_append(sorters, GTK_SORTER(gtk_numeric_sorter_new(name_rank)));
 
-    // Create the list box
-    GtkWidget* list_box = gtk_list_box_new();
-    gtk_widget_add_css_class(list_box, "package-list");
+    GListModel* model = G_LIST_MODEL(g_object_ref(analyzer->package_store));
+    GtkFilterListModel* filtered = gtk_filter_list_model_new(model, g_object_ref(filter));
+    gtk_filter_list_model_set_incremental(filtered, TRUE);
+    GtkSortListModel* sorted = gtk_sort_list_model_new(G_LIST_MODEL(filtered),
+                                                       GTK_SORTER(sorters));
+    gtk_sort_list_model_set_incremental(sorted, TRUE);
+    model = G_LIST_MODEL(sorted);
+
+    GtkSingleSelection* selection = gtk_single_selection_new(model);
+    gtk_single_selection_set_autoselect(selection, FALSE);
+    gtk_single_selection_set_can_unselect(selection, TRUE);
+
+    GtkListItemFactory* factory = gtk_signal_list_item_factory_new();
+    g_signal_connect(factory, "setup", G_CALLBACK(setup_list_factory), NULL);
+    g_signal_connect(factory, "bind", G_CALLBACK(bind_list_factory), NULL);
+
+    GtkWidget* list_view = gtk_list_view_new(GTK_SELECTION_MODEL(selection), factory);
+    gtk_widget_add_css_class(list_view, "package-list");
     
-    // Add list box to scrolled window
-    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), list_box);
+    // Add list view to scrolled window
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), list_view);
     
     // Store references
-    g_object_set_data(G_OBJECT(scrolled), "list-box", list_box);
-    g_object_set_data(G_OBJECT(scrolled), "analyzer", analyzer);
+    g_object_set_data(G_OBJECT(box), "list-view", list_view);
+    g_object_set_data(G_OBJECT(box), "selection", selection);
+    g_object_set_data_full(G_OBJECT(box), "filter", filter, g_object_unref);
+    g_object_set_data_full(G_OBJECT(box), "sorter", sorter, g_object_unref);
+    g_object_set_data_full(G_OBJECT(box), "relevance-sorter", relevance, g_object_unref);
+    g_object_set_data(G_OBJECT(box), "search-entry", search_entry);
+    g_object_set_data(G_OBJECT(box), "analyzer", analyzer);
+
+    g_signal_connect(search_entry, "search-changed", G_CALLBACK(on_search_changed), box);
     
     // Initialize the list
-    package_list_update(scrolled, analyzer);
+    package_list_update(box, analyzer);
     
-    return scrolled;
+    return box;
 }
 
-void package_list_update(GtkWidget* widget, VenvAnalyzer* analyzer) {
-    g_return_if_fail(GTK_IS_SCROLLED_WINDOW(widget));
+guint package_list_update(GtkWidget* widget, VenvAnalyzer* analyzer) {
+    g_return_val_if_fail(GTK_IS_WIDGET(widget), 0);
     
-    GtkWidget* list_box = g_object_get_data(G_OBJECT(widget), "list-box");
-    g_return_if_fail(GTK_IS_LIST_BOX(list_box));
-    
-    // Remove existing rows
-    GtkWidget* child;
-    while ((child = gtk_widget_get_first_child(list_box)) != NULL) {
-        gtk_list_box_remove(GTK_LIST_BOX(list_box), child);
-    }
-    
-    // Add new rows for each package
-    for (Package* pkg = analyzer->packages; pkg; pkg = pkg->next) {
-        GtkWidget* row = gtk_list_box_row_new();
-        GtkWidget* box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
-        
-        gtk_widget_set_margin_start(box, 6);
-        gtk_widget_set_margin_end(box, 6);
-        gtk_widget_set_margin_top(box, 3);
-        gtk_widget_set_margin_bottom(box, 3);
-        
-        GtkWidget* name_label = gtk_label_new(pkg->name);
-        GtkWidget* version_label = gtk_label_new(pkg->version);
-        
-        gtk_label_set_xalign(GTK_LABEL(name_label), 0);
-        gtk_widget_set_hexpand(name_label, TRUE);
-        gtk_label_set_xalign(GTK_LABEL(version_label), 1);
-        
-        gtk_box_append(GTK_BOX(box), name_label);
-        gtk_box_append(GTK_BOX(box), version_label);
-        
-        gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(row), box);
-        g_object_set_data(G_OBJECT(row), "package", pkg);
-        
-        gtk_list_box_append(GTK_LIST_BOX(list_box), row);
+    GtkFilter* filter = g_object_get_data(G_OBJECT(widget), "filter");
+    g_return_val_if_fail(GTK_IS_FILTER(filter), 0);
+
+    // Sort keys, search matches and filter facts are derived from the
+    // package list, and new rows are filtered against them as they are
+    // spliced in
+    venv_analyzer_refresh_view(analyzer);
+    guint changed = venv_analyzer_sync_package_store(analyzer);
+    if (changed == 0) return 0;
+
+    // A changed package can change whether others are required or match
+    // the search; without a filter or search nothing else can move
+    if (analyzer->search_term || analyzer->filter_flags != PACKAGE_FILTER_NONE) {
+        gtk_filter_changed(filter, GTK_FILTER_CHANGE_DIFFERENT);
     }
+
+    // Ranks and totals of unchanged rows move too, and the sort model
+    // holds on to the keys it extracted
+    GtkSorter* sorter = g_object_get_data(G_OBJECT(widget), "sorter");
+    gtk_sorter_changed(sorter, GTK_SORTER_CHANGE_DIFFERENT);
+    return changed;
+}
+
+Package* package_list_get_selected_package(GtkWidget* list) {
+    GtkSingleSelection* selection = g_object_get_data(G_OBJECT(list), "selection");
+    g_return_val_if_fail(GTK_IS_SINGLE_SELECTION(selection), NULL);
+    return gtk_single_selection_get_selected_item(selection);
 }
 
 void
@@ -20,7 +20,7 @@ enum {
 
 // Package list widget creation and management
 GtkWidget*      package_list_new                    (VenvAnalyzer* analyzer);
-void            package_list_update                  (GtkWidget* list, 
+guint           package_list_update                  (GtkWidget* list, 
                                                      VenvAnalyzer* analyzer);
 Package*        package_list_get_selected_package    (GtkWidget* list);
 
@@ -0,0 +1,476 @@
+#include "treemap_view.h"
+#include <cairo/cairo.h>
+#include <pango/pangocairo.h>
+#include <math.h>
+
+// Treemaps are laid out at the widget's size rounded up to this many
+// pixels, and drawn scaled to fit while one for a new size is computed
+#define SIZE_STEP 32
+
+// Rects smaller than this on screen are covered by their parent's colour
+// and not visited; labels need room for a line of text
+#define MIN_RECT_PIXELS 2.0
+#define LABEL_MIN_WIDTH 40.0
+#define LABEL_MIN_HEIGHT 14.0
+#define LABEL_INSET 3.0
+
+#define MAX_ZOOM 256.0
+
+struct _VenvTreemapView {
+    GtkWidget parent_instance;
+
+    VenvAnalyzer* analyzer;
+    Treemap* treemap;                    // Treemap being drawn, or NULL
+    GCancellable* cancellable;           // Treemap being computed, or NULL
+    TreemapGrouping grouping;
+    double pending_width;                // Size being computed
+    double pending_height;
+
+    // Latest treemap of every grouping, so switching back or resizing
+    // only lays out again what was already read
+    Treemap* cached[TREEMAP_GROUP_BY_FILES + 1];
+
+    GArray* visible_rects;               // Reused by every frame
+    int hovered_rect;                    // Index into treemap's rects, or -1
+
+    // Zoom relative to fitting the whole treemap, around a centre given
+    // as a fraction of its size, so both survive a new layout
+    double zoom;
+    double center_x;
+    double center_y;
+    double drag_start_x;
+    double drag_start_y;
+};
+
+G_DEFINE_TYPE(VenvTreemapView, venv_treemap_view, GTK_TYPE_WIDGET)
+
+typedef struct {
+    double scale;                        // Widget pixels per treemap point
+    double translate_x;                  // Where the treemap's origin goes
+    double translate_y;
+} TreemapTransform;
+
+static gboolean get_transform(VenvTreemapView* self, TreemapTransform* transform) {
+    Treemap* treemap = self->treemap;
+    int width = gtk_widget_get_width(GTK_WIDGET(self));
+    int height = gtk_widget_get_height(GTK_WIDGET(self));
+    if (!treemap || treemap->width <= 0 || treemap->height <= 0 || width <= 0 || height <= 0) {
+        return FALSE;
+    }
+
+    double fit = MIN(width / treemap->width, height / treemap->height);
+    transform->scale = fit * self->zoom;
+    transform->translate_x = width / 2.0 - self->center_x * treemap->width * transform->scale;
+    transform->translate_y = height / 2.0 - self->center_y * treemap->height * transform->scale;
+    return TRUE;
+}
+
+// Keeps the view on the treemap; at full size it is centred
+static void clamp_center(VenvTreemapView* self) {
+    Treemap* treemap = self->treemap;
+    int width = gtk_widget_get_width(GTK_WIDGET(self));
+    int height = gtk_widget_get_height(GTK_WIDGET(self));
+    if (!treemap || width <= 0 || height <= 0) return;
+
+    double fit = MIN(width / treemap->width, height / treemap->height);
+    double half_x = width / (2.0 * treemap->width * fit * self->zoom);
+    double half_y = height / (2.0 * treemap->height * fit * self->zoom);
+    self->center_x = half_x >= 0.5 ? 0.5 : CLAMP(self->center_x, half_x, 1.0 - half_x);
+    self->center_y = half_y >= 0.5 ? 0.5 : CLAMP(self->center_y, half_y, 1.0 - half_y);
+}
+
+// Packages keep the hue of the top-level rect they are in, and get
+// lighter the deeper they are nested
+static void rect_color(Treemap* treemap, guint index, GdkRGBA* color) {
+    const TreemapRect* rect = &treemap->rects[index];
+    if (rect->kind == TREEMAP_RECT_OTHER) {
+        *color = (GdkRGBA){ 0.8, 0.8, 0.8, 1.0 };
+        return;
+    }
+    if (rect->conflict) {
+        *color = (GdkRGBA){ 0.95, 0.6, 0.6, 1.0 };
+        return;
+    }
+
+    guint top = index;
+    while (treemap->rects[top].parent != TREEMAP_NO_PARENT) {
+        top = treemap->rects[top].parent;
+    }
+    float hue = (g_str_hash(treemap->rects[top].label) % 360) / 360.0f;
+    float value = MIN(0.75f + 0.05f * rect->depth, 0.97f);
+    float red, green, blue;
+    gtk_hsv_to_rgb(hue, 0.35f, value, &red, &green, &blue);
+    *color = (GdkRGBA){ red, green, blue, 1.0 };
+}
+
+static void draw_label(cairo_t* cr, PangoLayout* label, const TreemapRect* rect,
+                       double x, double y, double width) {
+    char* size = g_format_size(rect->size);
+    char* text = g_strdup_printf("%s  %s", rect->label, size);
+    pango_layout_set_text(label, text, -1);
+    pango_layout_set_width(label, (int)((width - 2 * LABEL_INSET) * PANGO_SCALE));
+    cairo_set_source_rgb(cr, 0.1, 0.1, 0.1);
+    cairo_move_to(cr, x + LABEL_INSET, y + 1);
+    pango_cairo_show_layout(cr, label);
+    g_free(text);
+    g_free(size);
+}
+
+static void venv_treemap_view_snapshot(GtkWidget* widget, GtkSnapshot* snapshot) {
+    VenvTreemapView* self = VENV_TREEMAP_VIEW(widget);
+    graphene_rect_t bounds;
+    if (!gtk_widget_compute_bounds(widget, widget, &bounds)) return;
+
+    gtk_snapshot_append_color(snapshot,
+                              &(GdkRGBA){.red = 1.0, .green = 1.0, .blue = 1.0, .alpha = 1.0},
+                              &bounds);
+
+    TreemapTransform t;
+    if (!get_transform(self, &t)) return;
+
+    // Only rects on screen and big enough to see are visited
+    Treemap* treemap = self->treemap;
+    treemap_query(treemap, -t.translate_x / t.scale, -t.translate_y / t.scale,
+                  bounds.size.width / t.scale, bounds.size.height / t.scale,
+                  MIN_RECT_PIXELS / t.scale, self->visible_rects);
+
+    cairo_t* cr = gtk_snapshot_append_cairo(snapshot, &bounds);
+    PangoLayout* label = gtk_widget_create_pango_layout(widget, NULL);
+    pango_layout_set_ellipsize(label, PANGO_ELLIPSIZE_END);
+    cairo_set_line_width(cr, 1.0);
+    for (guint i = 0; i < self->visible_rects->len; i++) {
+        guint index = g_array_index(self->visible_rects, guint, i);
+        const TreemapRect* rect = &treemap->rects[index];
+        double x = t.translate_x + rect->x * t.scale;
+        double y = t.translate_y + rect->y * t.scale;
+        double width = rect->width * t.scale;
+        double height = rect->height * t.scale;
+
+        GdkRGBA color;
+        rect_color(treemap, index, &color);
+        gdk_cairo_set_source_rgba(cr, &color);
+        cairo_rectangle(cr, x, y, width, height);
+        cairo_fill_preserve(cr);
+        cairo_set_source_rgba(cr, 0.3, 0.3, 0.3, 0.6);
+        cairo_stroke(cr);
+
+        // Containers are labelled in their header, leaves in their corner
+        gboolean container = rect->end > index + 1;
+        double header = TREEMAP_HEADER * t.scale;
+        if (width >= LABEL_MIN_WIDTH && height >= LABEL_MIN_HEIGHT &&
+            (!container || header >= LABEL_MIN_HEIGHT)) {
+            draw_label(cr, label, rect, x, y, width);
+        }
+    }
+
+    if (self->hovered_rect >= 0) {
+        const TreemapRect* rect = &treemap->rects[self->hovered_rect];
+        cairo_set_line_width(cr, 2.0);
+        cairo_set_source_rgb(cr, 0.2, 0.4, 0.9);
+        cairo_rectangle(cr, t.translate_x + rect->x * t.scale, t.translate_y + rect->y * t.scale,
+                        rect->width * t.scale, rect->height * t.scale);
+        cairo_stroke(cr);
+    }
+
+    g_object_unref(label);
+    cairo_destroy(cr);
+}
+
+static int rect_at(VenvTreemapView* self, double x, double y) {
+    TreemapTransform t;
+    if (!get_transform(self, &t)) return -1;
+    return treemap_rect_at(self->treemap, (x - t.translate_x) / t.scale,
+                           (y - t.translate_y) / t.scale);
+}
+
+// Takes ownership of treemap. Rect indices of the old one don't carry over.
+static void set_treemap(VenvTreemapView* self, Treemap* treemap) {
+    g_clear_pointer(&self->treemap, treemap_unref);
+    self->treemap = treemap;
+    self->hovered_rect = -1;
+    clamp_center(self);
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+}
+
+static void cancel_treemap(VenvTreemapView* self) {
+    if (self->cancellable) {
+        g_cancellable_cancel(self->cancellable);
+        g_clear_object(&self->cancellable);
+    }
+}
+
+static void on_treemap_ready(GObject* source G_GNUC_UNUSED,
+                             GAsyncResult* result,
+                             gpointer user_data) {
+    VenvTreemapView* self = user_data;
+    GError* error = NULL;
+
+    Treemap* treemap = treemap_compute_finish(result, &error);
+    if (!treemap) {
+        // Cancelled treemaps were superseded by a newer one
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+            g_warning("%s", error->message);
+        }
+        g_error_free(error);
+        g_object_unref(self);
+        return;
+    }
+
+    g_clear_object(&self->cancellable);
+    g_clear_pointer(&self->cached[treemap->grouping], treemap_unref);
+    self->cached[treemap->grouping] = treemap_ref(treemap);
+    set_treemap(self, treemap);
+    g_object_unref(self);
+}
+
+// Shows the treemap for the current grouping and size, from the cache if
+// it has one, computing it otherwise. A cached treemap of another size is
+// drawn scaled in the meantime and laid out again rather than rebuilt.
+static void ensure_treemap(VenvTreemapView* self) {
+    int widget_width = gtk_widget_get_width(GTK_WIDGET(self));
+    int widget_height = gtk_widget_get_height(GTK_WIDGET(self));
+    if (!self->analyzer || widget_width <= 0 || widget_height <= 0 ||
+        !gtk_widget_get_mapped(GTK_WIDGET(self))) {
+        return;
+    }
+
+    double width = ceil(widget_width / (double)SIZE_STEP) * SIZE_STEP;
+    double height = ceil(widget_height / (double)SIZE_STEP) * SIZE_STEP;
+    Treemap* cached = self->cached[self->grouping];
+    if (cached && cached != self->treemap) {
+        set_treemap(self, treemap_ref(cached));
+    }
+    if (cached && cached->width == width && cached->height == height) {
+        cancel_treemap(self);
+        return;
+    }
+    if (self->cancellable && self->pending_width == width && self->pending_height == height) {
+        return;
+    }
+
+    cancel_treemap(self);
+    self->cancellable = g_cancellable_new();
+    self->pending_width = width;
+    self->pending_height = height;
+    if (cached) {
+        treemap_resize_async(cached, width, height, self->cancellable,
+                             on_treemap_ready, g_object_ref(self));
+    } else {
+        treemap_compute_async(self->analyzer->packages, self->analyzer->venv_path,
+                              self->grouping, width, height, self->cancellable,
+                              on_treemap_ready, g_object_ref(self));
+    }
+}
+
+static void venv_treemap_view_size_allocate(GtkWidget* widget, int width, int height,
+                                            int baseline) {
+    GTK_WIDGET_CLASS(venv_treemap_view_parent_class)->size_allocate(widget, width, height,
+                                                                    baseline);
+    VenvTreemapView* self = VENV_TREEMAP_VIEW(widget);
+    clamp_center(self);
+    ensure_treemap(self);
+}
+
+static void venv_treemap_view_map(GtkWidget* widget) {
+    GTK_WIDGET_CLASS(venv_treemap_view_parent_class)->map(widget);
+    ensure_treemap(VENV_TREEMAP_VIEW(widget));
+}
+
+static void venv_treemap_view_dispose(GObject* object) {
+    VenvTreemapView* self = VENV_TREEMAP_VIEW(object);
+
+    cancel_treemap(self);
+    g_clear_pointer(&self->treemap, treemap_unref);
+    for (guint i = 0; i < G_N_ELEMENTS(self->cached); i++) {
+        g_clear_pointer(&self->cached[i], treemap_unref);
+    }
+    g_clear_pointer(&self->visible_rects, g_array_unref);
+
+    G_OBJECT_CLASS(venv_treemap_view_parent_class)->dispose(object);
+}
+
+static void venv_treemap_view_class_init(VenvTreemapViewClass* klass) {
+    GObjectClass* object_class = G_OBJECT_CLASS(klass);
+    GtkWidgetClass* widget_class = GTK_WIDGET_CLASS(klass);
+
+    object_class->dispose = venv_treemap_view_dispose;
+    widget_class->snapshot = venv_treemap_view_snapshot;
+    widget_class->size_allocate = venv_treemap_view_size_allocate;
+    widget_class->map = venv_treemap_view_map;
+}
+
+static void on_motion(GtkEventControllerMotion* controller G_GNUC_UNUSED,
+                      double x, double y,
+                      gpointer data) {
+    VenvTreemapView* self = VENV_TREEMAP_VIEW(data);
+    int index = rect_at(self, x, y);
+    if (index == self->hovered_rect) return;
+
+    self->hovered_rect = index;
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+}
+
+// Names the rect with everything it is nested in, "group › package › dir"
+static gboolean on_query_tooltip(GtkWidget* widget, int x, int y,
+                                 gboolean keyboard G_GNUC_UNUSED,
+                                 GtkTooltip* tooltip,
+                                 gpointer data G_GNUC_UNUSED) {
+    VenvTreemapView* self = VENV_TREEMAP_VIEW(widget);
+    int index = rect_at(self, x, y);
+    if (index < 0) return FALSE;
+
+    Treemap* treemap = self->treemap;
+    const TreemapRect* rect = &treemap->rects[index];
+    GString* text = g_string_new(rect->label);
+    for (guint i = rect->parent; i != TREEMAP_NO_PARENT; i = treemap->rects[i].parent) {
+        g_string_prepend(text, " › ");
+        g_string_prepend(text, treemap->rects[i].label);
+    }
+    char* size = g_format_size(rect->size);
+    g_string_append_printf(text, "\n%s, %.1f%% of the environment", size,
+                           treemap->total ? 100.0 * rect->size / treemap->total : 0.0);
+    gtk_tooltip_set_text(tooltip, text->str);
+    g_free(size);
+    g_string_free(text, TRUE);
+    return TRUE;
+}
+
+// A double click zooms in on the package or directory clicked
+static void on_click_released(GtkGestureClick* gesture G_GNUC_UNUSED,
+                              int n_press,
+                              double x, double y,
+                              gpointer data) {
+    VenvTreemapView* self = VENV_TREEMAP_VIEW(data);
+    int index = rect_at(self, x, y);
+    if (n_press != 2 || index < 0) return;
+
+    Treemap* treemap = self->treemap;
+    const TreemapRect* rect = &treemap->rects[index];
+    if (rect->end == (guint)index + 1 && rect->parent != TREEMAP_NO_PARENT) {
+        rect = &treemap->rects[rect->parent];
+    }
+    self->zoom = CLAMP(MIN(treemap->width / rect->width, treemap->height / rect->height),
+                       1.0, MAX_ZOOM);
+    self->center_x = (rect->x + rect->width / 2) / treemap->width;
+    self->center_y = (rect->y + rect->height / 2) / treemap->height;
+    clamp_center(self);
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+}
+
+// A right click shows everything again
+static void on_secondary_click_released(GtkGestureClick* gesture G_GNUC_UNUSED,
+                                        int n_press G_GNUC_UNUSED,
+                                        double x G_GNUC_UNUSED, double y G_GNUC_UNUSED,
+                                        gpointer data) {
+    VenvTreemapView* self = VENV_TREEMAP_VIEW(data);
+    self->zoom = 1.0;
+    clamp_center(self);
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+}
+
+static void on_drag_begin(GtkGestureDrag* gesture G_GNUC_UNUSED,
+                          double x G_GNUC_UNUSED, double y G_GNUC_UNUSED,
+                          gpointer data) {
+    VenvTreemapView* self = VENV_TREEMAP_VIEW(data);
+    self->drag_start_x = self->center_x;
+    self->drag_start_y = self->center_y;
+}
+
+static void on_drag_update(GtkGestureDrag* gesture G_GNUC_UNUSED,
+                           double offset_x, double offset_y,
+                           gpointer data) {
+    VenvTreemapView* self = VENV_TREEMAP_VIEW(data);
+    TreemapTransform t;
+    if (!get_transform(self, &t)) return;
+
+    self->center_x = self->drag_start_x - offset_x / (self->treemap->width * t.scale);
+    self->center_y = self->drag_start_y - offset_y / (self->treemap->height * t.scale);
+    clamp_center(self);
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+}
+
+// Zooms around the mouse position
+static void on_scroll(GtkEventControllerScroll* controller,
+                      double dx G_GNUC_UNUSED, double dy,
+                      gpointer data) {
+    VenvTreemapView* self = VENV_TREEMAP_VIEW(data);
+    TreemapTransform t;
+    if (!get_transform(self, &t)) return;
+
+    double x, y;
+    GdkEvent* event = gtk_event_controller_get_current_event(GTK_EVENT_CONTROLLER(controller));
+    gdk_event_get_position(event, &x, &y);
+
+    double zoom = CLAMP(self->zoom * (dy > 0 ? 0.9 : 1.1), 1.0, MAX_ZOOM);
+    double point_x = (x - t.translate_x) / t.scale;
+    double point_y = (y - t.translate_y) / t.scale;
+    double scale = t.scale * zoom / self->zoom;
+    int width = gtk_widget_get_width(GTK_WIDGET(self));
+    int height = gtk_widget_get_height(GTK_WIDGET(self));
+    self->zoom = zoom;
+    self->center_x = (point_x - (x - width / 2.0) / scale) / self->treemap->width;
+    self->center_y = (point_y - (y - height / 2.0) / scale) / self->treemap->height;
+    clamp_center(self);
+    gtk_widget_queue_draw(GTK_WIDGET(self));
+}
+
+static void venv_treemap_view_init(VenvTreemapView* self) {
+    self->zoom = 1.0;
+    self->center_x = 0.5;
+    self->center_y = 0.5;
+    self->hovered_rect = -1;
+    self->visible_rects = g_array_new(FALSE, FALSE, sizeof(guint));
+
+    gtk_widget_set_has_tooltip(GTK_WIDGET(self), TRUE);
+    g_signal_connect(self, "query-tooltip", G_CALLBACK(on_query_tooltip), NULL);
+
+    GtkEventController* motion = gtk_event_controller_motion_new();
+    g_signal_connect(motion, "motion", G_CALLBACK(on_motion), self);
+    gtk_widget_add_controller(GTK_WIDGET(self), motion);
+
+    GtkGesture* drag = gtk_gesture_drag_new();
+    g_signal_connect(drag, "drag-begin", G_CALLBACK(on_drag_begin), self);
+    g_signal_connect(drag, "drag-update", G_CALLBACK(on_drag_update), self);
+    gtk_widget_add_controller(GTK_WIDGET(self), GTK_EVENT_CONTROLLER(drag));
+
+    GtkGesture* click = gtk_gesture_click_new();
+    g_signal_connect(click, "released", G_CALLBACK(on_click_released), self);
+    gtk_widget_add_controller(GTK_WIDGET(self), GTK_EVENT_CONTROLLER(click));
+
+    GtkGesture* secondary_click = gtk_gesture_click_new();
+    gtk_gesture_single_set_button(GTK_GESTURE_SINGLE(secondary_click), GDK_BUTTON_SECONDARY);
+    g_signal_connect(secondary_click, "released", G_CALLBACK(on_secondary_click_released), self);
+    gtk_widget_add_controller(GTK_WIDGET(self), GTK_EVENT_CONTROLLER(secondary_click));
+
+    GtkEventController* scroll = gtk_event_controller_scroll_new(GTK_EVENT_CONTROLLER_SCROLL_VERTICAL);
+    g_signal_connect(scroll, "scroll", G_CALLBACK(on_scroll), self);
+    gtk_widget_add_controller(GTK_WIDGET(self), scroll);
+}
+
+GtkWidget* venv_treemap_view_new(VenvAnalyzer* analyzer) {
+    VenvTreemapView* view = g_object_new(VENV_TYPE_TREEMAP_VIEW, NULL);
+    view->analyzer = analyzer;
+    return GTK_WIDGET(view);
+}
+
+void venv_treemap_view_update(GtkWidget* widget) {
+    g_return_if_fail(VENV_IS_TREEMAP_VIEW(widget));
+    VenvTreemapView* self = VENV_TREEMAP_VIEW(widget);
+
+    // The treemap shown stays until the new one is ready
+    cancel_treemap(self);
+    for (guint i = 0; i < G_N_ELEMENTS(self->cached); i++) {
+        g_clear_pointer(&self->cached[i], treemap_unref);
+    }
+    ensure_treemap(self);
+}
+
+void venv_treemap_view_set_grouping(GtkWidget* widget, TreemapGrouping grouping) {
+    g_return_if_fail(VENV_IS_TREEMAP_VIEW(widget));
+    VenvTreemapView* self = VENV_TREEMAP_VIEW(widget);
+    if (self->grouping == grouping) return;
+
+    self->grouping = grouping;
+    cancel_treemap(self);
+    ensure_treemap(self);
+}
@@ -0,0 +1,23 @@
+#ifndef TREEMAP_VIEW_H
+#define TREEMAP_VIEW_H
+
+#include "../include/venv_analyzer.h"
+#include "../core/treemap.h"
+
+G_BEGIN_DECLS
+
+#define VENV_TYPE_TREEMAP_VIEW (venv_treemap_view_get_type())
+G_DECLARE_FINAL_TYPE(VenvTreemapView, venv_treemap_view, VENV, TREEMAP_VIEW, GtkWidget)
+
+GtkWidget* venv_treemap_view_new(VenvAnalyzer* analyzer);
+
+/**
+ * Lays out the current packages again, dropping treemaps of the old ones.
+ * Nothing is computed until the view is shown.
+ */
+void venv_treemap_view_update(GtkWidget* view);
+void venv_treemap_view_set_grouping(GtkWidget* view, TreemapGrouping grouping);
+
+G_END_DECLS
+
+#endif // TREEMAP_VIEW_H
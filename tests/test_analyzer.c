@@ -0,0 +1,142 @@
+#include "analyzer.h"
+#include "package.h"
+#include "snapshot.h"
+#include <glib/gstdio.h>
+
+typedef struct {
+    char* dir;
+    char* path;
+    VenvAnalyzer* analyzer;
+} AnalyzerFixture;
+
+// requests needs an older urllib3 than the one installed; flask needs a
+// werkzeug that is not installed at all, which is missing, not conflicting
+static Package* make_packages(void) {
+    Package* requests = package_new("requests", "2.31.0");
+    package_add_dependency(requests, "urllib3", "<2,>=1.21.1");
+    package_add_dependency(requests, "idna", ">=2.5,<4");
+    package_add_dependency(requests, "certifi", "*");
+
+    Package* urllib3 = package_new("urllib3", "2.1.0");
+    Package* idna = package_new("IDNA", "3.6");
+    Package* certifi = package_new("certifi", "2024.2.2");
+    Package* flask = package_new("flask", "3.0.0");
+    package_add_dependency(flask, "Werkzeug", ">=3.0.0");
+
+    package_set_next(requests, urllib3);
+    package_set_next(urllib3, idna);
+    package_set_next(idna, certifi);
+    package_set_next(certifi, flask);
+    return requests;
+}
+
+static void fixture_set_up(AnalyzerFixture* fixture, gconstpointer user_data G_GNUC_UNUSED) {
+    GError* error = NULL;
+    fixture->dir = g_dir_make_tmp("venv-analyzer-test-XXXXXX", &error);
+    g_assert_no_error(error);
+    fixture->path = g_build_filename(fixture->dir, "scan.snapshot", NULL);
+
+    Package* packages = make_packages();
+    g_assert_true(venv_snapshot_write(fixture->path, "/venvs/app", packages, &error));
+    g_assert_no_error(error);
+    for (Package* pkg = packages; pkg;) {
+        Package* next = pkg->next;
+        package_free(pkg);
+        pkg = next;
+    }
+
+    fixture->analyzer = venv_analyzer_new_headless();
+    g_assert_true(venv_analyzer_open_snapshot(fixture->analyzer, fixture->path, &error));
+    g_assert_no_error(error);
+}
+
+static void fixture_tear_down(AnalyzerFixture* fixture, gconstpointer user_data G_GNUC_UNUSED) {
+    venv_analyzer_free(fixture->analyzer);
+    g_unlink(fixture->path);
+    g_rmdir(fixture->dir);
+    g_free(fixture->path);
+    g_free(fixture->dir);
+}
+
+static Package* find_package(VenvAnalyzer* analyzer, const char* name) {
+    Package* pkg = venv_analyzer_get_package(analyzer, name);
+    g_assert_nonnull(pkg);
+    return pkg;
+}
+
+static guint count_conflicts(const Package* pkg) {
+    guint n = 0;
+    for (const PackageDep* conflict = pkg->conflicts; conflict; conflict = conflict->next) {
+        n++;
+    }
+    return n;
+}
+
+static void test_conflicts_filter(AnalyzerFixture* fixture,
+                                  gconstpointer user_data G_GNUC_UNUSED) {
+    VenvAnalyzer* analyzer = fixture->analyzer;
+    Package* requests = find_package(analyzer, "requests");
+    g_assert_cmpuint(count_conflicts(requests), ==, 1);
+    g_assert_cmpstr(requests->conflicts->name, ==, "urllib3");
+    g_assert_cmpstr(requests->conflicts->version, ==, "2.1.0");
+
+    venv_analyzer_set_filter(analyzer, PACKAGE_FILTER_CONFLICTS);
+    venv_analyzer_refresh_view(analyzer);
+    for (Package* pkg = analyzer->packages; pkg; pkg = pkg->next) {
+        g_assert_cmpint(venv_analyzer_package_visible(analyzer, pkg), ==, pkg == requests);
+    }
+
+    venv_analyzer_set_filter(analyzer, PACKAGE_FILTER_NONE);
+    venv_analyzer_refresh_view(analyzer);
+    g_assert_true(venv_analyzer_package_visible(analyzer, find_package(analyzer, "flask")));
+}
+
+// Conflicts are worked out again for every list, never added on top
+static void test_conflicts_recomputed(AnalyzerFixture* fixture,
+                                      gconstpointer user_data G_GNUC_UNUSED) {
+    VenvAnalyzer* analyzer = fixture->analyzer;
+    g_assert_true(venv_analyzer_check_conflicts(analyzer));
+    g_assert_cmpuint(count_conflicts(find_package(analyzer, "requests")), ==, 1);
+
+    // Reopening keeps the unchanged package objects
+    Package* requests = find_package(analyzer, "requests");
+    GError* error = NULL;
+    g_assert_true(venv_analyzer_open_snapshot(analyzer, fixture->path, &error));
+    g_assert_no_error(error);
+    g_assert_true(find_package(analyzer, "requests") == requests);
+    g_assert_cmpuint(count_conflicts(requests), ==, 1);
+
+    // Once the installed urllib3 fits, the conflict goes
+    g_strlcpy(find_package(analyzer, "urllib3")->version, "1.26.18", MAX_VERSION_LEN);
+    g_assert_false(venv_analyzer_check_conflicts(analyzer));
+    g_assert_null(requests->conflicts);
+}
+
+static void test_version_satisfies(void) {
+    g_assert_true(package_version_satisfies("2.1.0", "*"));
+    g_assert_true(package_version_satisfies("2.1.0", ""));
+    g_assert_true(package_version_satisfies("1.26.18", "<2,>=1.21.1"));
+    g_assert_false(package_version_satisfies("2.1.0", "<2,>=1.21.1"));
+    g_assert_false(package_version_satisfies("1.21", ">=1.21.1"));
+    g_assert_true(package_version_satisfies("2.2.5", "~=2.2"));
+    g_assert_false(package_version_satisfies("3.0", "~=2.2"));
+    g_assert_true(package_version_satisfies("1.4.2", "==1.4.*"));
+    g_assert_false(package_version_satisfies("1.5", "!=1.5"));
+    g_assert_true(package_version_satisfies("2.0", "<=2.0"));
+    g_assert_false(package_version_satisfies("2.0", ">2.0"));
+
+    // A specifier that cannot be read is not counted as a conflict
+    g_assert_true(package_version_satisfies("2.1.0", ">="));
+}
+
+int main(int argc, char** argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/analyzer/conflicts/filter", AnalyzerFixture, NULL,
+               fixture_set_up, test_conflicts_filter, fixture_tear_down);
+    g_test_add("/analyzer/conflicts/recomputed", AnalyzerFixture, NULL,
+               fixture_set_up, test_conflicts_recomputed, fixture_tear_down);
+    g_test_add_func("/analyzer/version-satisfies", test_version_satisfies);
+
+    return g_test_run();
+}
@@ -0,0 +1,299 @@
+#include "db/database.h"
+#include "package.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+// Databases written by older versions, as they were left on disk. Each
+// test opens one with db_init, which migrates it to the current schema.
+
+static const char V1_DATABASE[] =
+    "CREATE TABLE packages ("
+    "    id INTEGER PRIMARY KEY,"
+    "    name TEXT NOT NULL,"
+    "    version TEXT NOT NULL,"
+    "    size INTEGER,"
+    "    has_conflicts BOOLEAN DEFAULT FALSE,"
+    "    fingerprint INTEGER NOT NULL DEFAULT 0,"
+    "    created_at DATETIME DEFAULT CURRENT_TIMESTAMP,"
+    "    UNIQUE(name, version));"
+    "CREATE TABLE dependencies ("
+    "    package_id INTEGER,"
+    "    dependency_name TEXT NOT NULL,"
+    "    version_constraint TEXT NOT NULL DEFAULT '*',"
+    "    created_at DATETIME DEFAULT CURRENT_TIMESTAMP,"
+    "    FOREIGN KEY(package_id) REFERENCES packages(id) ON DELETE CASCADE,"
+    "    PRIMARY KEY(package_id, dependency_name));"
+    "CREATE TABLE env_settings ("
+    "    key TEXT PRIMARY KEY,"
+    "    value TEXT NOT NULL,"
+    "    description TEXT,"
+    "    updated_at DATETIME DEFAULT CURRENT_TIMESTAMP);"
+    "CREATE INDEX idx_packages_name ON packages(name);"
+    "CREATE INDEX idx_dependencies_name ON dependencies(dependency_name);"
+    "PRAGMA user_version = 1;"
+    "INSERT INTO packages (id, name, version, size, has_conflicts, fingerprint) VALUES"
+    "    (1, 'requests', '2.31.0', 100, 0, 11),"
+    "    (2, 'urllib3', '2.0.7', 50, 0, 12),"
+    "    (3, 'Charset_Normalizer', '3.3.2', 30, 1, 13);"
+    "INSERT INTO dependencies (package_id, dependency_name, version_constraint) VALUES"
+    "    (1, 'urllib3', '>=1.21'),"
+    "    (1, 'charset-normalizer', '*');"
+    "INSERT INTO env_settings (key, value) VALUES"
+    "    ('venv_path', '/venvs/app'),"
+    "    ('last_scan', '1700000000');";
+
+// Two scans of /venvs/app, urllib3 upgraded in between, and one of
+// /venvs/other. Version keys are filled in by set_version_keys.
+static const char V2_DATABASE[] =
+    "CREATE TABLE snapshots ("
+    "    id INTEGER PRIMARY KEY,"
+    "    venv_path TEXT NOT NULL,"
+    "    package_count INTEGER NOT NULL DEFAULT 0,"
+    "    total_size INTEGER NOT NULL DEFAULT 0,"
+    "    created_at DATETIME DEFAULT CURRENT_TIMESTAMP);"
+    "CREATE TABLE packages ("
+    "    id INTEGER PRIMARY KEY,"
+    "    content_hash INTEGER NOT NULL UNIQUE,"
+    "    name TEXT NOT NULL,"
+    "    version TEXT NOT NULL,"
+    "    version_key BLOB NOT NULL,"
+    "    size INTEGER,"
+    "    has_conflicts BOOLEAN DEFAULT FALSE,"
+    "    fingerprint INTEGER NOT NULL DEFAULT 0,"
+    "    created_at DATETIME DEFAULT CURRENT_TIMESTAMP);"
+    "CREATE TABLE dependencies ("
+    "    package_id INTEGER,"
+    "    dependency_name TEXT NOT NULL,"
+    "    version_constraint TEXT NOT NULL DEFAULT '*',"
+    "    created_at DATETIME DEFAULT CURRENT_TIMESTAMP,"
+    "    FOREIGN KEY(package_id) REFERENCES packages(id) ON DELETE CASCADE,"
+    "    PRIMARY KEY(package_id, dependency_name));"
+    "CREATE TABLE snapshot_packages ("
+    "    package_id INTEGER NOT NULL REFERENCES packages(id),"
+    "    added_in INTEGER NOT NULL REFERENCES snapshots(id),"
+    "    removed_in INTEGER REFERENCES snapshots(id));"
+    "CREATE TABLE env_settings ("
+    "    key TEXT PRIMARY KEY,"
+    "    value TEXT NOT NULL,"
+    "    description TEXT,"
+    "    updated_at DATETIME DEFAULT CURRENT_TIMESTAMP);"
+    "CREATE INDEX idx_packages_name ON packages(name);"
+    "CREATE INDEX idx_dependencies_name ON dependencies(dependency_name);"
+    "CREATE INDEX idx_snapshots_venv ON snapshots(venv_path, id);"
+    "CREATE INDEX idx_snapshot_packages_added"
+    "    ON snapshot_packages(added_in, removed_in, package_id);"
+    "PRAGMA user_version = 2;"
+    "INSERT INTO snapshots (id, venv_path, package_count, total_size, created_at) VALUES"
+    "    (1, '/venvs/app', 2, 150, '2024-01-01 00:00:00'),"
+    "    (2, '/venvs/app', 2, 160, '2024-02-01 00:00:00'),"
+    "    (3, '/venvs/other', 1, 50, '2024-02-02 00:00:00');"
+    "INSERT INTO packages (id, content_hash, name, version, version_key, size, fingerprint)"
+    "    VALUES (1, 101, 'requests', '2.31.0', x'', 100, 1),"
+    "           (2, 102, 'urllib3', '2.0.7', x'', 50, 2),"
+    "           (3, 103, 'urllib3', '2.1.0', x'', 60, 3);"
+    "INSERT INTO dependencies (package_id, dependency_name, version_constraint) VALUES"
+    "    (1, 'urllib3', '>=1.21');"
+    "INSERT INTO snapshot_packages (package_id, added_in, removed_in) VALUES"
+    "    (1, 1, NULL), (2, 1, 2), (3, 2, NULL), (2, 3, NULL);"
+    "INSERT INTO env_settings (key, value) VALUES ('venv_path', '/venvs/app');";
+
+typedef struct {
+    char* dir;
+    char* path;
+    VenvAnalyzer analyzer;
+} DbFixture;
+
+static void fixture_set_up(DbFixture* fixture, gconstpointer user_data G_GNUC_UNUSED) {
+    GError* error = NULL;
+    fixture->dir = g_dir_make_tmp("venv-analyzer-test-XXXXXX", &error);
+    g_assert_no_error(error);
+    fixture->path = g_build_filename(fixture->dir, "packages.db", NULL);
+    memset(&fixture->analyzer, 0, sizeof(fixture->analyzer));
+}
+
+static void fixture_tear_down(DbFixture* fixture, gconstpointer user_data G_GNUC_UNUSED) {
+    db_close(&fixture->analyzer);
+    for (Package* pkg = fixture->analyzer.packages; pkg;) {
+        Package* next = pkg->next;
+        package_free(pkg);
+        pkg = next;
+    }
+
+    const char* suffixes[] = { "", "-wal", "-shm" };
+    for (guint i = 0; i < G_N_ELEMENTS(suffixes); i++) {
+        char* file = g_strconcat(fixture->path, suffixes[i], NULL);
+        g_unlink(file);
+        g_free(file);
+    }
+    g_rmdir(fixture->dir);
+    g_free(fixture->path);
+    g_free(fixture->dir);
+}
+
+static void create_database(const char* path, const char* sql) {
+    sqlite3* db = NULL;
+    g_assert_cmpint(sqlite3_open(path, &db), ==, SQLITE_OK);
+    char* message = NULL;
+    int rc = sqlite3_exec(db, sql, NULL, NULL, &message);
+    if (rc != SQLITE_OK) g_error("Setting up %s: %s", path, message);
+    sqlite3_close(db);
+}
+
+// Keys as version 2 stored them, so the migrated rows still order by version
+static void set_version_keys(const char* path) {
+    sqlite3* db = NULL;
+    g_assert_cmpint(sqlite3_open(path, &db), ==, SQLITE_OK);
+    sqlite3_stmt* select = NULL;
+    sqlite3_stmt* update = NULL;
+    sqlite3_prepare_v2(db, "SELECT id, version FROM packages", -1, &select, NULL);
+    sqlite3_prepare_v2(db, "UPDATE packages SET version_key = ?2 WHERE id = ?1", -1,
+                       &update, NULL);
+    while (sqlite3_step(select) == SQLITE_ROW) {
+        guint8 key[VERSION_KEY_LEN];
+        package_version_key((const char*)sqlite3_column_text(select, 1), key);
+        sqlite3_bind_int64(update, 1, sqlite3_column_int64(select, 0));
+        sqlite3_bind_blob(update, 2, key, sizeof(key), SQLITE_TRANSIENT);
+        g_assert_cmpint(sqlite3_step(update), ==, SQLITE_DONE);
+        sqlite3_reset(update);
+    }
+    sqlite3_finalize(select);
+    sqlite3_finalize(update);
+    sqlite3_close(db);
+}
+
+static gint64 query_int(DbFixture* fixture, const char* sql) {
+    sqlite3_stmt* stmt = NULL;
+    g_assert_cmpint(sqlite3_prepare_v2(fixture->analyzer.db, sql, -1, &stmt, NULL), ==,
+                    SQLITE_OK);
+    g_assert_cmpint(sqlite3_step(stmt), ==, SQLITE_ROW);
+    gint64 value = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+static void open_database(DbFixture* fixture) {
+    if (db_init(&fixture->analyzer, fixture->path) != DB_SUCCESS) {
+        g_error("db_init: %s", db_get_last_error());
+    }
+}
+
+static void test_migrate_v2_keeps_history(DbFixture* fixture,
+                                          gconstpointer user_data G_GNUC_UNUSED) {
+    create_database(fixture->path, V2_DATABASE);
+    set_version_keys(fixture->path);
+    open_database(fixture);
+    g_assert_cmpint(query_int(fixture, "PRAGMA user_version"), ==, 4);
+
+    GPtrArray* snapshots = db_list_snapshots(&fixture->analyzer, "/venvs/app");
+    g_assert_cmpuint(snapshots->len, ==, 2);
+    g_ptr_array_unref(snapshots);
+    snapshots = db_list_snapshots(&fixture->analyzer, "/venvs/other");
+    g_assert_cmpuint(snapshots->len, ==, 1);
+    g_ptr_array_unref(snapshots);
+
+    GPtrArray* changes = NULL;
+    g_assert_cmpint(db_diff_snapshots(&fixture->analyzer, 1, 2, &changes), ==, DB_SUCCESS);
+    g_assert_cmpuint(changes->len, ==, 1);
+    SnapshotChange* change = g_ptr_array_index(changes, 0);
+    g_assert_cmpint(change->kind, ==, SNAPSHOT_PACKAGE_UPGRADED);
+    g_assert_cmpstr(change->name, ==, "urllib3");
+    g_assert_cmpstr(change->old_value, ==, "2.0.7");
+    g_assert_cmpstr(change->new_value, ==, "2.1.0");
+    g_ptr_array_unref(changes);
+
+    GPtrArray* environments = NULL;
+    g_assert_cmpint(db_find_environments_depending_on(&fixture->analyzer, "urllib3",
+                                                      &environments), ==, DB_SUCCESS);
+    g_assert_cmpuint(environments->len, ==, 1);
+    DbEnvironment* environment = g_ptr_array_index(environments, 0);
+    g_assert_cmpstr(environment->venv_path, ==, "/venvs/app");
+    g_ptr_array_unref(environments);
+}
+
+static void test_migrate_v1_becomes_snapshot(DbFixture* fixture,
+                                             gconstpointer user_data G_GNUC_UNUSED) {
+    create_database(fixture->path, V1_DATABASE);
+    open_database(fixture);
+
+    GPtrArray* snapshots = db_list_snapshots(&fixture->analyzer, "/venvs/app");
+    g_assert_cmpuint(snapshots->len, ==, 1);
+    DbSnapshot* snapshot = g_ptr_array_index(snapshots, 0);
+    g_assert_cmpint(snapshot->package_count, ==, 3);
+    g_assert_cmpint(snapshot->total_size, ==, 180);
+    g_ptr_array_unref(snapshots);
+
+    g_assert_cmpint(db_load_state(&fixture->analyzer), ==, DB_SUCCESS);
+    guint n_packages = 0;
+    for (Package* pkg = fixture->analyzer.packages; pkg; pkg = pkg->next) {
+        n_packages++;
+        if (g_str_equal(pkg->name, "requests")) {
+            g_assert_true(package_has_dependency(pkg, "urllib3"));
+            g_assert_true(package_has_dependency(pkg, "charset-normalizer"));
+        }
+    }
+    g_assert_cmpuint(n_packages, ==, 3);
+}
+
+static gboolean has_result(GPtrArray* results, const char* name) {
+    for (guint i = 0; i < results->len; i++) {
+        DbSearchResult* result = g_ptr_array_index(results, i);
+        if (g_str_equal(result->name, name)) {
+            g_assert_cmpstr(result->venv_path, ==, "/venvs/app");
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Only the search tables are rebuilt; they are filled from the packages,
+// so names and dependency names are found again
+static void test_migrate_rebuilds_search(DbFixture* fixture,
+                                         gconstpointer user_data G_GNUC_UNUSED) {
+    create_database(fixture->path, V1_DATABASE);
+    open_database(fixture);
+
+    GPtrArray* results = NULL;
+    g_assert_cmpint(db_search_packages(&fixture->analyzer, "charset", NULL, 0, &results), ==,
+                    DB_SUCCESS);
+    g_assert_cmpuint(results->len, ==, 2);
+    g_assert_true(has_result(results, "Charset_Normalizer"));
+    g_assert_true(has_result(results, "requests"));
+    g_ptr_array_unref(results);
+}
+
+static void test_migrate_once(DbFixture* fixture, gconstpointer user_data G_GNUC_UNUSED) {
+    create_database(fixture->path, V2_DATABASE);
+    set_version_keys(fixture->path);
+    open_database(fixture);
+    gint64 n_rows = query_int(fixture, "SELECT COUNT(*) FROM snapshot_packages");
+    db_close(&fixture->analyzer);
+
+    open_database(fixture);
+    g_assert_cmpint(query_int(fixture, "PRAGMA user_version"), ==, 4);
+    g_assert_cmpint(query_int(fixture, "SELECT COUNT(*) FROM snapshot_packages"), ==, n_rows);
+    g_assert_cmpint(query_int(fixture, "SELECT COUNT(*) FROM snapshots"), ==, 3);
+}
+
+static void test_newer_database_refused(DbFixture* fixture,
+                                        gconstpointer user_data G_GNUC_UNUSED) {
+    create_database(fixture->path, "CREATE TABLE packages (id INTEGER PRIMARY KEY);"
+                                   "PRAGMA user_version = 99;");
+    g_assert_cmpint(db_init(&fixture->analyzer, fixture->path), !=, DB_SUCCESS);
+}
+
+int main(int argc, char** argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/database/migrate/v2-keeps-history", DbFixture, NULL,
+               fixture_set_up, test_migrate_v2_keeps_history, fixture_tear_down);
+    g_test_add("/database/migrate/v1-becomes-snapshot", DbFixture, NULL,
+               fixture_set_up, test_migrate_v1_becomes_snapshot, fixture_tear_down);
+    g_test_add("/database/migrate/rebuilds-search", DbFixture, NULL,
+               fixture_set_up, test_migrate_rebuilds_search, fixture_tear_down);
+    g_test_add("/database/migrate/once", DbFixture, NULL,
+               fixture_set_up, test_migrate_once, fixture_tear_down);
+    g_test_add("/database/migrate/newer-refused", DbFixture, NULL,
+               fixture_set_up, test_newer_database_refused, fixture_tear_down);
+
+    return g_test_run();
+}
@@ -0,0 +1,182 @@
+#include "fuzzy_match-private.h"
+#include <string.h>
+
+static FuzzyIndex* index_of(const char* const* names) {
+    FuzzyIndex* index = fuzzy_index_new();
+    for (guint i = 0; names[i]; i++) {
+        g_assert_cmpuint(fuzzy_index_add(index, names[i]), ==, i);
+    }
+    return index;
+}
+
+static GArray* search(const FuzzyIndex* index, const char* query) {
+    GArray* matches = g_array_new(FALSE, FALSE, sizeof(FuzzyMatch));
+    fuzzy_index_search(index, query, matches);
+    return matches;
+}
+
+static int score_of(GArray* matches, guint i) {
+    for (guint m = 0; m < matches->len; m++) {
+        FuzzyMatch* match = &g_array_index(matches, FuzzyMatch, m);
+        if (match->index == i) return match->score;
+    }
+    g_assert_not_reached();
+    return 0;
+}
+
+static void test_subsequence(void) {
+    static const char* const names[] = {
+        "grpcio-status", "grpcio", "PyYAML", "types-requests", NULL,
+    };
+    FuzzyIndex* index = index_of(names);
+    g_assert_cmpuint(fuzzy_index_get_size(index), ==, 4);
+    g_assert_cmpstr(fuzzy_index_get_name(index, 2), ==, "pyyaml");
+
+    GArray* matches = search(index, "grpcst");
+    g_assert_cmpuint(matches->len, ==, 1);
+    g_assert_cmpuint(g_array_index(matches, FuzzyMatch, 0).index, ==, 0);
+    g_array_unref(matches);
+
+    matches = search(index, "YAML");
+    g_assert_cmpuint(matches->len, ==, 1);
+    g_assert_cmpuint(g_array_index(matches, FuzzyMatch, 0).index, ==, 2);
+    g_array_unref(matches);
+
+    // Every character is present, but not in this order
+    matches = search(index, "oicprg");
+    g_assert_cmpuint(matches->len, ==, 0);
+    g_array_unref(matches);
+
+    matches = search(index, "");
+    g_assert_cmpuint(matches->len, ==, 0);
+    g_array_unref(matches);
+
+    fuzzy_index_free(index);
+}
+
+static void test_scoring(void) {
+    static const char* const names[] = {
+        "requests",        // Consecutive from the start
+        "types-requests",  // Consecutive after a separator
+        "xrequests",       // Consecutive, no bonus
+        "rxexqxuxexsxt",   // From the start, with gaps
+        NULL,
+    };
+    FuzzyIndex* index = index_of(names);
+    GArray* matches = search(index, "request");
+    g_assert_cmpuint(matches->len, ==, 4);
+
+    g_assert_cmpint(score_of(matches, 0), >, score_of(matches, 1));
+    g_assert_cmpint(score_of(matches, 1), >, score_of(matches, 2));
+    g_assert_cmpint(score_of(matches, 2), >, score_of(matches, 3));
+    g_array_unref(matches);
+
+    fuzzy_index_free(index);
+}
+
+// The first place the query starts is not always the best: here the
+// later "ab" is consecutive and the earlier one is not
+static void test_scoring_latest_start(void) {
+    static const char* const names[] = { "xa-xab", "xab", NULL };
+    FuzzyIndex* index = index_of(names);
+    GArray* matches = search(index, "ab");
+    g_assert_cmpuint(matches->len, ==, 2);
+    g_assert_cmpint(score_of(matches, 0), ==, score_of(matches, 1));
+    g_array_unref(matches);
+    fuzzy_index_free(index);
+}
+
+static void test_rank(void) {
+    static const char* const names[] = {
+        "six-requests", "requests-toolbelt", "requests", "xrequests", "requests-oauthlib",
+        "urllib3", NULL,
+    };
+    FuzzyIndex* index = index_of(names);
+
+    GArray* all = search(index, "requests");
+    g_assert_cmpuint(all->len, ==, 5);
+    fuzzy_index_rank(index, all, 0);
+
+    // Equal scores go to the shorter name, then to the first added
+    static const guint expected[] = { 2, 1, 4, 0, 3 };
+    for (guint i = 0; i < G_N_ELEMENTS(expected); i++) {
+        g_assert_cmpuint(g_array_index(all, FuzzyMatch, i).index, ==, expected[i]);
+    }
+
+    // Selecting the best few agrees with sorting everything
+    for (guint limit = 1; limit <= all->len + 1; limit++) {
+        GArray* best = search(index, "requests");
+        fuzzy_index_rank(index, best, limit);
+        g_assert_cmpuint(best->len, ==, MIN(limit, all->len));
+        for (guint i = 0; i < best->len; i++) {
+            g_assert_cmpuint(g_array_index(best, FuzzyMatch, i).index, ==,
+                             g_array_index(all, FuzzyMatch, i).index);
+        }
+        g_array_unref(best);
+    }
+    g_array_unref(all);
+
+    fuzzy_index_free(index);
+}
+
+static char* random_name(GRand* rand) {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789-_.";
+    guint length = g_rand_int_range(rand, 1, 24);
+    char* name = g_malloc(length + 1);
+    for (guint i = 0; i < length; i++) {
+        name[i] = alphabet[g_rand_int_range(rand, 0, sizeof(alphabet) - 1)];
+    }
+    name[length] = '\0';
+    return name;
+}
+
+// Each vector prefilter handles a tail the width does not divide, so
+// index sizes cover every remainder
+static void test_prefilters_agree(void) {
+    static const FuzzyPrefilter prefilters[] = {
+        FUZZY_PREFILTER_BEST, FUZZY_PREFILTER_SSE2, FUZZY_PREFILTER_AVX2,
+    };
+    static const char* const queries[] = {
+        "a", "req", "grpcst", "-_.", "q0", "zz9", "abcdefgh", "e.e",
+    };
+    GRand* rand = g_rand_new_with_seed(47);
+    GArray* expected = g_array_new(FALSE, FALSE, sizeof(FuzzyMatch));
+    GArray* actual = g_array_new(FALSE, FALSE, sizeof(FuzzyMatch));
+
+    for (guint size = 0; size < 64; size++) {
+        FuzzyIndex* index = fuzzy_index_new();
+        for (guint i = 0; i < size * 7; i++) {
+            char* name = random_name(rand);
+            fuzzy_index_add(index, name);
+            g_free(name);
+        }
+
+        for (guint q = 0; q < G_N_ELEMENTS(queries); q++) {
+            fuzzy_index_search_with(index, FUZZY_PREFILTER_SCALAR, queries[q], expected);
+            for (guint p = 0; p < G_N_ELEMENTS(prefilters); p++) {
+                if (!fuzzy_prefilter_supported(prefilters[p])) continue;
+
+                fuzzy_index_search_with(index, prefilters[p], queries[q], actual);
+                g_assert_cmpmem(actual->data, actual->len * sizeof(FuzzyMatch),
+                                expected->data, expected->len * sizeof(FuzzyMatch));
+            }
+        }
+        fuzzy_index_free(index);
+    }
+
+    g_array_unref(expected);
+    g_array_unref(actual);
+    g_rand_free(rand);
+}
+
+int main(int argc, char** argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/fuzzy-match/subsequence", test_subsequence);
+    g_test_add_func("/fuzzy-match/scoring", test_scoring);
+    g_test_add_func("/fuzzy-match/scoring-latest-start", test_scoring_latest_start);
+    g_test_add_func("/fuzzy-match/rank", test_rank);
+    g_test_add_func("/fuzzy-match/prefilters-agree", test_prefilters_agree);
+
+    return g_test_run();
+}
@@ -0,0 +1,92 @@
+#include "graph_layout-private.h"
+#include <stdlib.h>
+
+typedef struct {
+    guint upper;  // Positions in the upper and lower rank
+    guint lower;
+} Segment;
+
+static guint64 count(const guint* ends, guint n_ends, guint n_lower) {
+    guint* tree = g_new(guint, n_lower + 1);
+    guint64 crossings = layered_layout_count_crossings(ends, n_ends, n_lower, tree);
+    g_free(tree);
+    return crossings;
+}
+
+static void test_crossings_small(void) {
+    g_assert_cmpuint(count(NULL, 0, 0), ==, 0);
+
+    static const guint parallel[] = { 0, 1, 2 };
+    g_assert_cmpuint(count(parallel, 3, 3), ==, 0);
+
+    static const guint reversed[] = { 2, 1, 0 };
+    g_assert_cmpuint(count(reversed, 3, 3), ==, 3);
+
+    // Segments meeting at a node do not cross
+    static const guint fan[] = { 0, 1, 1 };
+    g_assert_cmpuint(count(fan, 3, 2), ==, 0);
+    static const guint shared[] = { 1, 1 };
+    g_assert_cmpuint(count(shared, 2, 2), ==, 0);
+
+    // K2,2 drawn in two ranks always has one crossing
+    static const guint complete[] = { 0, 1, 0, 1 };
+    g_assert_cmpuint(count(complete, 4, 2), ==, 1);
+}
+
+static gint compare_segments(gconstpointer a, gconstpointer b) {
+    const Segment* x = a;
+    const Segment* y = b;
+    if (x->upper != y->upper) return x->upper < y->upper ? -1 : 1;
+    return (x->lower > y->lower) - (x->lower < y->lower);
+}
+
+// Two segments cross when their ends are in opposite orders
+static guint64 count_pairs(const Segment* segments, guint n) {
+    guint64 crossings = 0;
+    for (guint i = 0; i < n; i++) {
+        for (guint j = i + 1; j < n; j++) {
+            const Segment* a = &segments[i];
+            const Segment* b = &segments[j];
+            if ((a->upper < b->upper && a->lower > b->lower) ||
+                (a->upper > b->upper && a->lower < b->lower)) {
+                crossings++;
+            }
+        }
+    }
+    return crossings;
+}
+
+static void test_crossings_random(void) {
+    GRand* rand = g_rand_new_with_seed(35);
+    for (guint round = 0; round < 500; round++) {
+        guint n_upper = g_rand_int_range(rand, 1, 12);
+        guint n_lower = g_rand_int_range(rand, 1, 12);
+        guint n = g_rand_int_range(rand, 0, 40);
+
+        Segment* segments = g_new(Segment, MAX(n, 1));
+        for (guint i = 0; i < n; i++) {
+            segments[i].upper = g_rand_int_range(rand, 0, n_upper);
+            segments[i].lower = g_rand_int_range(rand, 0, n_lower);
+        }
+        qsort(segments, n, sizeof(Segment), compare_segments);
+
+        guint* ends = g_new(guint, MAX(n, 1));
+        for (guint i = 0; i < n; i++) {
+            ends[i] = segments[i].lower;
+        }
+        g_assert_cmpuint(count(ends, n, n_lower), ==, count_pairs(segments, n));
+
+        g_free(ends);
+        g_free(segments);
+    }
+    g_rand_free(rand);
+}
+
+int main(int argc, char** argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/layered-layout/crossings/small", test_crossings_small);
+    g_test_add_func("/layered-layout/crossings/random", test_crossings_random);
+
+    return g_test_run();
+}
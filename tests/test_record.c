@@ -0,0 +1,141 @@
+#include "record.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+// A site-packages directory with one installed distribution
+typedef struct {
+    char* dir;
+    char* dist_info;
+    char* record;
+    char* package;
+    char* data;  // A file RECORD lists without a size
+} RecordFixture;
+
+static const char RECORD[] =
+    "pkg/__init__.py,sha256=aaaa,30\n"
+    "\"pkg/a,b.py\",sha256=bbbb,10\n"
+    "\"pkg/say \"\"hi\"\".txt\",sha256=cccc,20\r\n"
+    "\"pkg/end\"\"\",sha256=dddd,5\n"
+    "\n"
+    "\"pkg/unterminated,sha256=eeee,1000\n"
+    "\"pkg/sub/only path\"\n"
+    "pkg/data.bin,,\n"
+    "pkg-1.0.dist-info/RECORD,,";
+
+static void fixture_set_up(RecordFixture* fixture, gconstpointer user_data G_GNUC_UNUSED) {
+    GError* error = NULL;
+    fixture->dir = g_dir_make_tmp("venv-analyzer-test-XXXXXX", &error);
+    g_assert_no_error(error);
+    fixture->dist_info = g_build_filename(fixture->dir, "pkg-1.0.dist-info", NULL);
+    fixture->record = g_build_filename(fixture->dist_info, "RECORD", NULL);
+    fixture->package = g_build_filename(fixture->dir, "pkg", NULL);
+    fixture->data = g_build_filename(fixture->package, "data.bin", NULL);
+
+    g_assert_cmpint(g_mkdir(fixture->dist_info, 0755), ==, 0);
+    g_assert_cmpint(g_mkdir(fixture->package, 0755), ==, 0);
+    g_file_set_contents(fixture->record, RECORD, -1, &error);
+    g_assert_no_error(error);
+    g_file_set_contents(fixture->data, "1234567", -1, &error);
+    g_assert_no_error(error);
+}
+
+static void fixture_tear_down(RecordFixture* fixture, gconstpointer user_data G_GNUC_UNUSED) {
+    g_unlink(fixture->data);
+    g_unlink(fixture->record);
+    g_rmdir(fixture->package);
+    g_rmdir(fixture->dist_info);
+    g_rmdir(fixture->dir);
+    g_free(fixture->data);
+    g_free(fixture->package);
+    g_free(fixture->record);
+    g_free(fixture->dist_info);
+    g_free(fixture->dir);
+}
+
+static const RecordNode* find_node(const RecordTree* tree, const char* path) {
+    for (guint i = 0; i < tree->n_nodes; i++) {
+        char* node_path = record_tree_get_path(tree, i);
+        gboolean found = g_str_equal(node_path, path);
+        g_free(node_path);
+        if (found) return &tree->nodes[i];
+    }
+    return NULL;
+}
+
+static void assert_file(const RecordTree* tree, const char* path, guint64 size,
+                        gboolean size_known) {
+    const RecordNode* node = find_node(tree, path);
+    g_assert_nonnull(node);
+    g_assert_false(node->is_dir);
+    g_assert_cmpuint(node->size, ==, size);
+    g_assert_cmpint(node->size_known, ==, size_known);
+}
+
+static void test_quoted_paths(RecordFixture* fixture, gconstpointer user_data G_GNUC_UNUSED) {
+    GError* error = NULL;
+    RecordTree* tree = record_tree_load(fixture->record, FALSE, &error);
+    g_assert_no_error(error);
+
+    assert_file(tree, "pkg/__init__.py", 30, TRUE);
+    assert_file(tree, "pkg/a,b.py", 10, TRUE);
+    assert_file(tree, "pkg/say \"hi\".txt", 20, TRUE);
+    assert_file(tree, "pkg/end\"", 5, TRUE);
+    assert_file(tree, "pkg/sub/only path", 0, FALSE);
+    assert_file(tree, "pkg/data.bin", 0, FALSE);
+    assert_file(tree, "pkg-1.0.dist-info/RECORD", 0, FALSE);
+
+    // The line with an unterminated quote is dropped whole
+    g_assert_null(find_node(tree, "pkg/unterminated"));
+    g_assert_null(find_node(tree, "pkg/unterminated,sha256=eeee,1000"));
+
+    const RecordNode* root = &tree->nodes[RECORD_ROOT];
+    g_assert_cmpuint(root->size, ==, 65);
+    g_assert_cmpuint(root->n_files, ==, 7);
+    g_assert_cmpuint(root->n_children, ==, 2);
+    g_assert_cmpstr(tree->nodes[root->first_child].name, ==, "pkg");
+    g_assert_cmpstr(tree->nodes[root->first_child + 1].name, ==, "pkg-1.0.dist-info");
+
+    const RecordNode* package = find_node(tree, "pkg");
+    g_assert_true(package->is_dir);
+    g_assert_cmpuint(package->size, ==, 65);
+    g_assert_cmpuint(package->n_files, ==, 6);
+    g_assert_cmpuint(package->n_children, ==, 6);
+
+    record_tree_unref(tree);
+}
+
+static void test_stat_missing(RecordFixture* fixture, gconstpointer user_data G_GNUC_UNUSED) {
+    GError* error = NULL;
+    RecordTree* tree = record_tree_load(fixture->record, TRUE, &error);
+    g_assert_no_error(error);
+
+    assert_file(tree, "pkg/data.bin", 7, TRUE);
+    assert_file(tree, "pkg-1.0.dist-info/RECORD", sizeof(RECORD) - 1, TRUE);
+    // Listed but not on disk
+    assert_file(tree, "pkg/sub/only path", 0, FALSE);
+    g_assert_cmpuint(tree->nodes[RECORD_ROOT].size, ==, 65 + 7 + sizeof(RECORD) - 1);
+
+    record_tree_unref(tree);
+}
+
+static void test_missing_file(RecordFixture* fixture, gconstpointer user_data G_GNUC_UNUSED) {
+    char* path = g_build_filename(fixture->dir, "missing.dist-info", "RECORD", NULL);
+    GError* error = NULL;
+    g_assert_null(record_tree_load(path, FALSE, &error));
+    g_assert_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+    g_error_free(error);
+    g_free(path);
+}
+
+int main(int argc, char** argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/record/quoted-paths", RecordFixture, NULL,
+               fixture_set_up, test_quoted_paths, fixture_tear_down);
+    g_test_add("/record/stat-missing", RecordFixture, NULL,
+               fixture_set_up, test_stat_missing, fixture_tear_down);
+    g_test_add("/record/missing-file", RecordFixture, NULL,
+               fixture_set_up, test_missing_file, fixture_tear_down);
+
+    return g_test_run();
+}
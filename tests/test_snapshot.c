@@ -0,0 +1,230 @@
+#include "snapshot.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+// Header field offsets, as laid out by SnapshotHeader in snapshot.c
+#define HEADER_SIZE 96
+#define HEADER_FORMAT_VERSION 8
+#define HEADER_PACKAGES_OFFSET 40
+#define HEADER_EDGE_INDEX_OFFSET 48
+#define HEADER_STRINGS_OFFSET 80
+#define HEADER_STRINGS_SIZE 88
+
+typedef struct {
+    char* dir;
+    char* path;
+    char* contents;  // The snapshot written by fixture_set_up
+    gsize length;
+} SnapshotFixture;
+
+static Package* make_packages(void) {
+    Package* requests = package_new("requests", "2.31.0");
+    requests->size = 100;
+    package_add_dependency(requests, "urllib3", ">=1.21");
+    package_add_dependency(requests, "idna", "*");
+
+    Package* urllib3 = package_new("urllib3", "2.1.0");
+    urllib3->size = 50;
+
+    Package* charset = package_new("Charset_Normalizer", "3.3.2");
+    charset->size = 30;
+
+    package_set_next(requests, urllib3);
+    package_set_next(urllib3, charset);
+    return requests;
+}
+
+static void fixture_set_up(SnapshotFixture* fixture, gconstpointer user_data G_GNUC_UNUSED) {
+    GError* error = NULL;
+    fixture->dir = g_dir_make_tmp("venv-analyzer-test-XXXXXX", &error);
+    g_assert_no_error(error);
+    fixture->path = g_build_filename(fixture->dir, "scan.snapshot", NULL);
+
+    Package* packages = make_packages();
+    g_assert_true(venv_snapshot_write(fixture->path, "/venvs/app", packages, &error));
+    g_assert_no_error(error);
+    for (Package* pkg = packages; pkg;) {
+        Package* next = pkg->next;
+        package_free(pkg);
+        pkg = next;
+    }
+
+    g_file_get_contents(fixture->path, &fixture->contents, &fixture->length, &error);
+    g_assert_no_error(error);
+}
+
+static void fixture_tear_down(SnapshotFixture* fixture, gconstpointer user_data G_GNUC_UNUSED) {
+    g_unlink(fixture->path);
+    g_rmdir(fixture->dir);
+    g_free(fixture->contents);
+    g_free(fixture->path);
+    g_free(fixture->dir);
+}
+
+static void write_file(SnapshotFixture* fixture, const char* contents, gsize length) {
+    GError* error = NULL;
+    g_file_set_contents(fixture->path, contents, length, &error);
+    g_assert_no_error(error);
+}
+
+// Writes the fixture snapshot with a header field replaced
+static void write_with_field(SnapshotFixture* fixture, gsize field, const void* value,
+                             gsize size) {
+    char* contents = g_memdup2(fixture->contents, fixture->length);
+    memcpy(contents + field, value, size);
+    write_file(fixture, contents, fixture->length);
+    g_free(contents);
+}
+
+static guint64 read_u64(const char* data) {
+    guint64 value;
+    memcpy(&value, data, sizeof(value));
+    return GUINT64_FROM_LE(value);
+}
+
+static void assert_invalid(SnapshotFixture* fixture) {
+    GError* error = NULL;
+    VenvSnapshot* snapshot = venv_snapshot_open(fixture->path, &error);
+    g_assert_null(snapshot);
+    g_assert_error(error, VENV_ANALYZER_ERROR, VENV_ANALYZER_ERROR_INVALID_SNAPSHOT);
+    g_error_free(error);
+}
+
+static void test_round_trip(SnapshotFixture* fixture, gconstpointer user_data G_GNUC_UNUSED) {
+    GError* error = NULL;
+    VenvSnapshot* snapshot = venv_snapshot_open(fixture->path, &error);
+    g_assert_no_error(error);
+
+    g_assert_cmpstr(venv_snapshot_get_venv_path(snapshot), ==, "/venvs/app");
+    g_assert_cmpuint(venv_snapshot_get_n_packages(snapshot), ==, 3);
+    g_assert_cmpstr(venv_snapshot_package_name(snapshot, 0), ==, "Charset_Normalizer");
+    g_assert_cmpstr(venv_snapshot_package_normalized_name(snapshot, 0), ==,
+                    "charset-normalizer");
+
+    guint requests = venv_snapshot_find_package(snapshot, "Requests");
+    guint urllib3 = venv_snapshot_find_package(snapshot, "urllib3");
+    g_assert_cmpuint(requests, !=, SNAPSHOT_NO_PACKAGE);
+    g_assert_cmpuint(urllib3, !=, SNAPSHOT_NO_PACKAGE);
+    g_assert_cmpuint(venv_snapshot_find_package(snapshot, "idna"), ==, SNAPSHOT_NO_PACKAGE);
+    g_assert_cmpstr(venv_snapshot_package_version(snapshot, requests), ==, "2.31.0");
+    g_assert_cmpuint(venv_snapshot_package_size(snapshot, requests), ==, 100);
+
+    guint n_dependencies = venv_snapshot_package_n_dependencies(snapshot, requests);
+    g_assert_cmpuint(n_dependencies, ==, 2);
+    gboolean found_urllib3 = FALSE;
+    for (guint i = 0; i < n_dependencies; i++) {
+        const char* name = venv_snapshot_dependency_name(snapshot, requests, i);
+        guint target = venv_snapshot_dependency_target(snapshot, requests, i);
+        if (g_str_equal(name, "urllib3")) {
+            found_urllib3 = TRUE;
+            g_assert_cmpuint(target, ==, urllib3);
+            g_assert_cmpstr(venv_snapshot_dependency_constraint(snapshot, requests, i), ==,
+                            ">=1.21");
+        } else {
+            g_assert_cmpstr(name, ==, "idna");
+            g_assert_cmpuint(target, ==, SNAPSHOT_NO_PACKAGE);
+        }
+    }
+    g_assert_true(found_urllib3);
+
+    g_assert_cmpuint(venv_snapshot_package_n_dependents(snapshot, urllib3), ==, 1);
+    g_assert_cmpuint(venv_snapshot_dependent(snapshot, urllib3, 0), ==, requests);
+
+    venv_snapshot_unref(snapshot);
+}
+
+static void test_not_a_snapshot(SnapshotFixture* fixture, gconstpointer user_data G_GNUC_UNUSED) {
+    write_file(fixture, "", 0);
+    assert_invalid(fixture);
+
+    char garbage[HEADER_SIZE * 2];
+    memset(garbage, 'x', sizeof(garbage));
+    write_file(fixture, garbage, sizeof(garbage));
+    assert_invalid(fixture);
+
+    // A valid magic with the rest of the header cut off
+    write_file(fixture, fixture->contents, HEADER_SIZE - 1);
+    assert_invalid(fixture);
+}
+
+static void test_unsupported_format(SnapshotFixture* fixture,
+                                    gconstpointer user_data G_GNUC_UNUSED) {
+    guint32 version = GUINT32_TO_LE(SNAPSHOT_FORMAT_VERSION + 1);
+    write_with_field(fixture, HEADER_FORMAT_VERSION, &version, sizeof(version));
+    assert_invalid(fixture);
+}
+
+// The string table comes last, so every cut leaves a section outside the file
+static void test_truncated(SnapshotFixture* fixture, gconstpointer user_data G_GNUC_UNUSED) {
+    for (gsize length = HEADER_SIZE; length < fixture->length; length++) {
+        write_file(fixture, fixture->contents, length);
+        assert_invalid(fixture);
+    }
+}
+
+static void test_bad_sections(SnapshotFixture* fixture, gconstpointer user_data G_GNUC_UNUSED) {
+    guint64 past_end = GUINT64_TO_LE(((guint64)fixture->length + 8) & ~(guint64)7);
+    write_with_field(fixture, HEADER_PACKAGES_OFFSET, &past_end, sizeof(past_end));
+    assert_invalid(fixture);
+
+    guint64 huge = GUINT64_TO_LE(G_MAXUINT64 & ~(guint64)7);
+    write_with_field(fixture, HEADER_STRINGS_OFFSET, &huge, sizeof(huge));
+    assert_invalid(fixture);
+    write_with_field(fixture, HEADER_STRINGS_SIZE, &huge, sizeof(huge));
+    assert_invalid(fixture);
+
+    guint64 misaligned = GUINT64_TO_LE(read_u64(fixture->contents + HEADER_EDGE_INDEX_OFFSET) + 4);
+    write_with_field(fixture, HEADER_EDGE_INDEX_OFFSET, &misaligned, sizeof(misaligned));
+    assert_invalid(fixture);
+
+    // Drops the terminating NUL from the string table
+    guint64 strings_size = read_u64(fixture->contents + HEADER_STRINGS_SIZE);
+    guint64 shorter = GUINT64_TO_LE(strings_size - 1);
+    write_with_field(fixture, HEADER_STRINGS_SIZE, &shorter, sizeof(shorter));
+    assert_invalid(fixture);
+}
+
+// Offsets inside valid sections are not checked on open; reading them
+// must stay inside the mapping and give empty values
+static void test_corrupt_contents(SnapshotFixture* fixture,
+                                  gconstpointer user_data G_GNUC_UNUSED) {
+    // The package records are followed by the edge index
+    char* contents = g_memdup2(fixture->contents, fixture->length);
+    guint64 packages = read_u64(contents + HEADER_PACKAGES_OFFSET);
+    guint64 edge_index_end = read_u64(contents + HEADER_EDGE_INDEX_OFFSET) + 4 * sizeof(guint32);
+    memset(contents + packages, 0xff, edge_index_end - packages);
+    write_file(fixture, contents, fixture->length);
+    g_free(contents);
+
+    GError* error = NULL;
+    VenvSnapshot* snapshot = venv_snapshot_open(fixture->path, &error);
+    g_assert_no_error(error);
+    g_assert_cmpuint(venv_snapshot_get_n_packages(snapshot), ==, 3);
+    for (guint i = 0; i < 3; i++) {
+        g_assert_cmpstr(venv_snapshot_package_name(snapshot, i), ==, "");
+        g_assert_cmpstr(venv_snapshot_package_version(snapshot, i), ==, "");
+        g_assert_cmpuint(venv_snapshot_package_n_dependencies(snapshot, i), ==, 0);
+        g_assert_cmpstr(venv_snapshot_dependency_name(snapshot, i, 0), ==, "");
+    }
+    g_assert_cmpuint(venv_snapshot_find_package(snapshot, "requests"), ==, SNAPSHOT_NO_PACKAGE);
+    venv_snapshot_unref(snapshot);
+}
+
+int main(int argc, char** argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add("/snapshot/round-trip", SnapshotFixture, NULL,
+               fixture_set_up, test_round_trip, fixture_tear_down);
+    g_test_add("/snapshot/corrupt/not-a-snapshot", SnapshotFixture, NULL,
+               fixture_set_up, test_not_a_snapshot, fixture_tear_down);
+    g_test_add("/snapshot/corrupt/unsupported-format", SnapshotFixture, NULL,
+               fixture_set_up, test_unsupported_format, fixture_tear_down);
+    g_test_add("/snapshot/corrupt/truncated", SnapshotFixture, NULL,
+               fixture_set_up, test_truncated, fixture_tear_down);
+    g_test_add("/snapshot/corrupt/bad-sections", SnapshotFixture, NULL,
+               fixture_set_up, test_bad_sections, fixture_tear_down);
+    g_test_add("/snapshot/corrupt/contents", SnapshotFixture, NULL,
+               fixture_set_up, test_corrupt_contents, fixture_tear_down);
+
+    return g_test_run();
+}
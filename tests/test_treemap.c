@@ -0,0 +1,221 @@
+#include "treemap.h"
+#include <math.h>
+
+#define EPSILON 1e-6
+
+typedef struct {
+    GMainLoop* loop;
+    Treemap* treemap;
+} TreemapWait;
+
+static void on_treemap_computed(GObject* source G_GNUC_UNUSED, GAsyncResult* result,
+                                gpointer user_data) {
+    TreemapWait* wait = user_data;
+    GError* error = NULL;
+    wait->treemap = treemap_compute_finish(result, &error);
+    g_assert_no_error(error);
+    g_main_loop_quit(wait->loop);
+}
+
+static Treemap* wait_for_treemap(TreemapWait* wait) {
+    g_main_loop_run(wait->loop);
+    g_main_loop_unref(wait->loop);
+    g_assert_nonnull(wait->treemap);
+    return wait->treemap;
+}
+
+static Treemap* compute(Package* packages, TreemapGrouping grouping,
+                        double width, double height) {
+    TreemapWait wait = { g_main_loop_new(NULL, FALSE), NULL };
+    treemap_compute_async(packages, "/venvs/app", grouping, width, height, NULL,
+                          on_treemap_computed, &wait);
+    return wait_for_treemap(&wait);
+}
+
+static Treemap* resize(Treemap* treemap, double width, double height) {
+    TreemapWait wait = { g_main_loop_new(NULL, FALSE), NULL };
+    treemap_resize_async(treemap, width, height, NULL, on_treemap_computed, &wait);
+    return wait_for_treemap(&wait);
+}
+
+// Packages named and sized by the arguments, "name", size, ..., NULL
+static Package* make_packages(const char* first, ...) {
+    Package* head = NULL;
+    Package* tail = NULL;
+    va_list args;
+    va_start(args, first);
+    for (const char* name = first; name; name = va_arg(args, const char*)) {
+        Package* pkg = package_new(name, "1.0");
+        pkg->size = va_arg(args, guint64);
+        if (tail) {
+            package_set_next(tail, pkg);
+        } else {
+            head = pkg;
+        }
+        tail = pkg;
+    }
+    va_end(args);
+    return head;
+}
+
+static void free_packages(Package* packages) {
+    while (packages) {
+        Package* next = packages->next;
+        package_free(packages);
+        packages = next;
+    }
+}
+
+static const TreemapRect* find_rect(Treemap* treemap, const char* label) {
+    for (guint i = 0; i < treemap->n_rects; i++) {
+        if (g_strcmp0(treemap->rects[i].label, label) == 0) return &treemap->rects[i];
+    }
+    g_assert_not_reached();
+    return NULL;
+}
+
+static double overlap(double a, double a_length, double b, double b_length) {
+    return MAX(0, MIN(a + a_length, b + b_length) - MAX(a, b));
+}
+
+// Children of parent (all top-level rects for TREEMAP_NO_PARENT) must
+// tile the box exactly, each taking area in proportion to its size
+static void assert_tiles(Treemap* treemap, guint parent,
+                         double x, double y, double width, double height) {
+    guint64 total = 0;
+    double area = 0;
+    for (guint i = 0; i < treemap->n_rects; i++) {
+        if (treemap->rects[i].parent == parent) total += treemap->rects[i].size;
+    }
+
+    for (guint i = 0; i < treemap->n_rects; i++) {
+        const TreemapRect* rect = &treemap->rects[i];
+        if (rect->parent != parent) continue;
+
+        g_assert_cmpfloat(rect->x, >=, x - EPSILON);
+        g_assert_cmpfloat(rect->y, >=, y - EPSILON);
+        g_assert_cmpfloat(rect->x + rect->width, <=, x + width + EPSILON);
+        g_assert_cmpfloat(rect->y + rect->height, <=, y + height + EPSILON);
+        g_assert_cmpfloat_with_epsilon(rect->width * rect->height,
+                                       width * height * rect->size / total, EPSILON);
+        area += rect->width * rect->height;
+
+        for (guint j = i + 1; j < treemap->n_rects; j++) {
+            const TreemapRect* other = &treemap->rects[j];
+            if (other->parent != parent) continue;
+            g_assert_cmpfloat(overlap(rect->x, rect->width, other->x, other->width) *
+                              overlap(rect->y, rect->height, other->y, other->height),
+                              <, EPSILON);
+        }
+    }
+    g_assert_cmpfloat_with_epsilon(area, width * height, EPSILON);
+}
+
+static void test_squarify_tiles(void) {
+    Package* packages = make_packages("numpy", (guint64)600, "pandas", (guint64)300,
+                                      "six", (guint64)60, "idna", (guint64)30,
+                                      "pytz", (guint64)10, "empty", (guint64)0, NULL);
+    Treemap* treemap = compute(packages, TREEMAP_GROUP_BY_NONE, 400, 300);
+    free_packages(packages);
+
+    // Empty packages have nothing to show
+    g_assert_cmpuint(treemap->n_rects, ==, 5);
+    g_assert_cmpuint(treemap->total, ==, 1000);
+    for (guint i = 0; i < treemap->n_rects; i++) {
+        g_assert_cmpuint(treemap->rects[i].parent, ==, TREEMAP_NO_PARENT);
+        g_assert_cmpuint(treemap->rects[i].end, ==, i + 1);
+        if (i > 0) g_assert_cmpuint(treemap->rects[i].size, <=, treemap->rects[i - 1].size);
+    }
+    assert_tiles(treemap, TREEMAP_NO_PARENT, 0, 0, 400, 300);
+
+    const TreemapRect* six = find_rect(treemap, "six");
+    g_assert_cmpint(treemap_rect_at(treemap, six->x + six->width / 2,
+                                    six->y + six->height / 2), ==, six - treemap->rects);
+    g_assert_cmpint(treemap_rect_at(treemap, 401, 10), ==, -1);
+
+    // The same items fill another size
+    Treemap* resized = resize(treemap, 120, 900);
+    g_assert_cmpuint(resized->n_rects, ==, 5);
+    assert_tiles(resized, TREEMAP_NO_PARENT, 0, 0, 120, 900);
+    treemap_unref(resized);
+    treemap_unref(treemap);
+}
+
+// Four equal items in a square are laid out as four squares
+static void test_squarify_squares(void) {
+    Package* packages = make_packages("a", (guint64)5, "b", (guint64)5, "c", (guint64)5,
+                                      "d", (guint64)5, NULL);
+    Treemap* treemap = compute(packages, TREEMAP_GROUP_BY_NONE, 100, 100);
+    free_packages(packages);
+
+    g_assert_cmpuint(treemap->n_rects, ==, 4);
+    for (guint i = 0; i < treemap->n_rects; i++) {
+        g_assert_cmpfloat_with_epsilon(treemap->rects[i].width, 50, EPSILON);
+        g_assert_cmpfloat_with_epsilon(treemap->rects[i].height, 50, EPSILON);
+    }
+    assert_tiles(treemap, TREEMAP_NO_PARENT, 0, 0, 100, 100);
+    treemap_unref(treemap);
+}
+
+static void test_squarify_empty_bounds(void) {
+    Package* packages = make_packages("numpy", (guint64)600, "six", (guint64)60, NULL);
+    Treemap* treemap = compute(packages, TREEMAP_GROUP_BY_NONE, 0, 300);
+    free_packages(packages);
+
+    g_assert_cmpuint(treemap->n_rects, ==, 2);
+    for (guint i = 0; i < treemap->n_rects; i++) {
+        g_assert_cmpfloat(treemap->rects[i].width, ==, 0);
+        g_assert_cmpfloat(treemap->rects[i].height, ==, 0);
+    }
+    treemap_unref(treemap);
+}
+
+// flask alone needs werkzeug and jinja2, which share markupsafe with
+// nothing else; six is needed by both top-level requirements
+static void test_group_by_requirement(void) {
+    Package* packages = make_packages("flask", (guint64)100, "werkzeug", (guint64)200,
+                                      "jinja2", (guint64)150, "markupsafe", (guint64)50,
+                                      "six", (guint64)40, "requests", (guint64)300, NULL);
+    Package* flask = packages;
+    Package* werkzeug = flask->next;
+    Package* jinja2 = werkzeug->next;
+    Package* requests = jinja2->next->next->next;
+    package_add_dependency(flask, "werkzeug", "*");
+    package_add_dependency(flask, "jinja2", "*");
+    package_add_dependency(flask, "six", "*");
+    package_add_dependency(jinja2, "markupsafe", "*");
+    package_add_dependency(requests, "six", "*");
+
+    Treemap* treemap = compute(packages, TREEMAP_GROUP_BY_REQUIREMENT, 600, 400);
+    free_packages(packages);
+
+    const TreemapRect* group = find_rect(treemap, "flask");
+    g_assert_cmpint(group->kind, ==, TREEMAP_RECT_GROUP);
+    g_assert_cmpuint(group->size, ==, 500);
+    const TreemapRect* shared = find_rect(treemap, "Shared dependencies");
+    g_assert_cmpint(shared->kind, ==, TREEMAP_RECT_GROUP);
+    g_assert_cmpuint(shared->size, ==, 40);
+    g_assert_cmpuint(find_rect(treemap, "markupsafe")->parent, ==, group - treemap->rects);
+    g_assert_cmpuint(find_rect(treemap, "requests")->parent, ==, TREEMAP_NO_PARENT);
+
+    assert_tiles(treemap, TREEMAP_NO_PARENT, 0, 0, 600, 400);
+
+    // Members fill their group inside its padding and label
+    guint index = group - treemap->rects;
+    g_assert_cmpuint(group->end - index - 1, ==, 4);
+    assert_tiles(treemap, index, group->x + TREEMAP_PADDING, group->y + TREEMAP_HEADER,
+                 group->width - 2 * TREEMAP_PADDING,
+                 group->height - TREEMAP_HEADER - TREEMAP_PADDING);
+    treemap_unref(treemap);
+}
+
+int main(int argc, char** argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/treemap/squarify/tiles", test_squarify_tiles);
+    g_test_add_func("/treemap/squarify/squares", test_squarify_squares);
+    g_test_add_func("/treemap/squarify/empty-bounds", test_squarify_empty_bounds);
+    g_test_add_func("/treemap/group-by-requirement", test_group_by_requirement);
+
+    return g_test_run();
+}